@@ -0,0 +1,362 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <thread>
+#ifdef _WIN32
+# include <windows.h>
+#elif defined(__linux__)
+# include <sched.h>
+#endif
+#include "affinity.h"
+
+namespace tc {
+
+bool Affinity::GetModeByName(const std::string &name, Mode &mode) noexcept
+{
+  static const Mode modes[] = { Mode::NONE, Mode::CORES, Mode::PHYSICAL };
+  for (unsigned i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+    if (name == GetModeName(modes[i])) {
+      mode = modes[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+
+const char* Affinity::GetModeName(Mode mode) noexcept
+{
+  switch (mode) {
+    case Mode::CORES:     return "cores";
+    case Mode::PHYSICAL:  return "physical";
+    default:              return "none";
+  }
+}
+
+
+std::atomic<int>& Affinity::GetModeRef() noexcept
+{
+  static std::atomic<int> mode((int)Mode::NONE);
+  return mode;
+}
+
+
+std::atomic<unsigned>& Affinity::GetThreadsRef() noexcept
+{
+  static std::atomic<unsigned> threads(0);
+  return threads;
+}
+
+
+void Affinity::SetMode(Mode mode, unsigned threads) noexcept
+{
+  GetModeRef().store((int)mode);
+  GetThreadsRef().store(threads);
+}
+
+
+Affinity::Mode Affinity::GetMode() noexcept
+{
+  return (Mode)GetModeRef().load(std::memory_order_relaxed);
+}
+
+
+unsigned Affinity::GetThreads() noexcept
+{
+  return GetThreadsRef().load(std::memory_order_relaxed);
+}
+
+
+const std::vector<int>& Affinity::GetCpus() noexcept
+{
+  return GetTopology().cpus;
+}
+
+
+unsigned Affinity::GetPhysicalCores() noexcept
+{
+  return GetTopology().cores.size();
+}
+
+
+unsigned Affinity::GetCpuQuota() noexcept
+{
+  return GetTopology().quota;
+}
+
+
+unsigned Affinity::GetAutoThreads(Mode mode) noexcept
+{
+  const Topology &topo = GetTopology();
+  unsigned cpus = topo.cpus.size();
+  unsigned threads = (mode == Mode::PHYSICAL) ? topo.cores.size() : cpus;
+  if (topo.quota > 0) threads = std::min(threads, topo.quota);
+  // pinned worker threads would compete with the I/O threads
+  if (mode != Mode::NONE && threads >= cpus && cpus > 1) threads = cpus - 1;
+  return std::max(1u, threads);
+}
+
+
+std::vector<int> Affinity::GetWorkerCpus(Mode mode, unsigned threads) noexcept
+{
+  std::vector<int> cpus;
+  if (mode != Mode::NONE) {
+    cpus = GetOrderedCpus(mode);
+    if (threads < cpus.size()) cpus.resize(std::max(1u, threads));
+  }
+  return cpus;
+}
+
+
+std::vector<int> Affinity::GetIoCpus(Mode mode, unsigned threads) noexcept
+{
+  std::vector<int> freeCores, freeCpus;
+  const Topology &topo = GetTopology();
+  if (mode == Mode::NONE || threads >= topo.cpus.size()) return freeCpus;
+
+  std::vector<int> workers = GetWorkerCpus(mode, threads);
+  for (auto core = topo.cores.cbegin(); core != topo.cores.cend(); ++core) {
+    bool used = false;
+    for (auto cpu = core->cbegin(); cpu != core->cend(); ++cpu) {
+      if (std::find(workers.cbegin(), workers.cend(), *cpu) != workers.cend()) {
+        used = true;
+      } else {
+        freeCpus.push_back(*cpu);
+      }
+    }
+    if (!used) freeCores.insert(freeCores.end(), core->cbegin(), core->cend());
+  }
+
+  // SMT siblings of worker threads only if all physical cores are occupied
+  std::vector<int> &cpus = freeCores.empty() ? freeCpus : freeCores;
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+}
+
+
+bool Affinity::PinCurrentThread(const std::vector<int> &cpus) noexcept
+{
+  const std::vector<int> &list = cpus.empty() ? GetCpus() : cpus;
+#if defined(_WIN32)
+  DWORD_PTR mask = 0;
+  for (auto iter = list.cbegin(); iter != list.cend(); ++iter) {
+    if (*iter < (int)(sizeof(DWORD_PTR)*8)) mask |= (DWORD_PTR)1 << *iter;
+  }
+  return (mask != 0 && ::SetThreadAffinityMask(::GetCurrentThread(), mask) != 0);
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto iter = list.cbegin(); iter != list.cend(); ++iter) {
+    if (*iter < CPU_SETSIZE) CPU_SET(*iter, &set);
+  }
+  return (::sched_setaffinity(0, sizeof(set), &set) == 0);
+#else
+  (void)list;
+  return false;
+#endif
+}
+
+
+void Affinity::PinIoThread() noexcept
+{
+  std::vector<int> cpus = GetIoCpus(GetMode(), GetThreads());
+  if (!cpus.empty()) PinCurrentThread(cpus);
+}
+
+
+const Affinity::Topology& Affinity::GetTopology() noexcept
+{
+  static Topology topo = [] {
+    Topology t;
+    DetectCpus(t);
+    DetectCores(t);
+    t.quota = DetectQuota();
+    return t;
+  }();
+  return topo;
+}
+
+
+void Affinity::DetectCpus(Topology &topo) noexcept
+{
+#if defined(_WIN32)
+  DWORD_PTR procMask = 0, sysMask = 0;
+  if (::GetProcessAffinityMask(::GetCurrentProcess(), &procMask, &sysMask)) {
+    for (int i = 0; i < (int)(sizeof(DWORD_PTR)*8); i++) {
+      if (procMask & ((DWORD_PTR)1 << i)) topo.cpus.push_back(i);
+    }
+  }
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+      if (CPU_ISSET(i, &set)) topo.cpus.push_back(i);
+    }
+  }
+#endif
+  if (topo.cpus.empty()) {
+    unsigned count = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < count; i++) topo.cpus.push_back(i);
+  }
+}
+
+
+void Affinity::DetectCores(Topology &topo) noexcept
+{
+  // physical core of each CPU, CPUs of unknown topology are treated as separate cores
+  std::map<long long, unsigned> coreIndex;
+  for (auto iter = topo.cpus.cbegin(); iter != topo.cpus.cend(); ++iter) {
+    long long key = -1 - *iter;
+#if defined(_WIN32)
+    static std::vector<DWORD_PTR> coreMasks = [] {
+      std::vector<DWORD_PTR> masks;
+      DWORD size = 0;
+      ::GetLogicalProcessorInformation(nullptr, &size);
+      std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+      size = info.size() * sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+      if (::GetLogicalProcessorInformation(info.data(), &size)) {
+        for (DWORD i = 0; i < size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); i++) {
+          if (info[i].Relationship == RelationProcessorCore) masks.push_back(info[i].ProcessorMask);
+        }
+      }
+      return masks;
+    }();
+    for (size_t i = 0; i < coreMasks.size(); i++) {
+      if (*iter < (int)(sizeof(DWORD_PTR)*8) && (coreMasks[i] & ((DWORD_PTR)1 << *iter))) key = i;
+    }
+#elif defined(__linux__)
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(*iter) + "/topology/";
+    std::string package, core;
+    if (ReadLine(path + "physical_package_id", package) && ReadLine(path + "core_id", core)) {
+      key = (std::atoll(package.c_str()) << 32) | (std::atoll(core.c_str()) & 0xffffffffll);
+    }
+#endif
+    auto entry = coreIndex.find(key);
+    if (entry == coreIndex.end()) {
+      entry = coreIndex.insert(std::make_pair(key, (unsigned)topo.cores.size())).first;
+      topo.cores.emplace_back();
+    }
+    topo.cores[entry->second].push_back(*iter);
+  }
+}
+
+
+unsigned Affinity::DetectQuota() noexcept
+{
+  unsigned quota = 0;
+#ifdef __linux__
+  // cgroup paths of the process: "hierarchy-id:controllers:path"
+  std::string pathV1, pathV2;
+  std::FILE *f = std::fopen("/proc/self/cgroup", "r");
+  if (f != nullptr) {
+    char buf[1024];
+    while (std::fgets(buf, sizeof(buf), f) != nullptr) {
+      std::string line(buf);
+      while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+      size_t pos1 = line.find(':');
+      size_t pos2 = (pos1 != std::string::npos) ? line.find(':', pos1 + 1) : std::string::npos;
+      if (pos2 == std::string::npos) continue;
+      std::string controllers = "," + line.substr(pos1 + 1, pos2 - pos1 - 1) + ",";
+      if (controllers == ",,") {
+        pathV2 = line.substr(pos2 + 1);
+      } else if (controllers.find(",cpu,") != std::string::npos) {
+        pathV1 = line.substr(pos2 + 1);
+      }
+    }
+    std::fclose(f);
+  }
+
+  // the quota of any ancestor applies as well; cgroups of containers are often mounted as root
+  struct Hierarchy { const char *mount; const std::string &path; bool v2; };
+  const Hierarchy hierarchies[] = {
+    { "/sys/fs/cgroup", pathV2, true },
+    { "/sys/fs/cgroup/cpu,cpuacct", pathV1, false },
+    { "/sys/fs/cgroup/cpu", pathV1, false },
+  };
+  for (unsigned i = 0; i < sizeof(hierarchies) / sizeof(*hierarchies); i++) {
+    const Hierarchy &h = hierarchies[i];
+    if (h.path.empty()) continue;
+    std::string path = h.path;
+    while (true) {
+      std::string dir = h.mount + ((path == "/") ? std::string() : path);
+      std::string value, period;
+      long long q = -1, p = 0;
+      if (h.v2) {
+        if (ReadLine(dir + "/cpu.max", value) && value.compare(0, 3, "max") != 0) {
+          q = std::atoll(value.c_str());
+          size_t pos = value.find(' ');
+          if (pos != std::string::npos) p = std::atoll(value.c_str() + pos + 1);
+        }
+      } else if (ReadLine(dir + "/cpu.cfs_quota_us", value) && ReadLine(dir + "/cpu.cfs_period_us", period)) {
+        q = std::atoll(value.c_str());
+        p = std::atoll(period.c_str());
+      }
+      if (q > 0 && p > 0) {
+        unsigned cpus = (unsigned)std::max(1ll, (q + p - 1) / p);
+        quota = (quota > 0) ? std::min(quota, cpus) : cpus;
+      }
+      if (path.empty() || path == "/") break;
+      size_t pos = path.find_last_of('/');
+      path = (pos == 0 || pos == std::string::npos) ? "/" : path.substr(0, pos);
+    }
+  }
+#endif
+  return quota;
+}
+
+
+std::vector<int> Affinity::GetOrderedCpus(Mode mode) noexcept
+{
+  const Topology &topo = GetTopology();
+  if (mode != Mode::PHYSICAL) return topo.cpus;
+
+  // first CPU of each physical core, then the second one of each core, ...
+  std::vector<int> cpus;
+  for (size_t rank = 0; cpus.size() < topo.cpus.size(); rank++) {
+    for (auto core = topo.cores.cbegin(); core != topo.cores.cend(); ++core) {
+      if (rank < core->size()) cpus.push_back((*core)[rank]);
+    }
+  }
+  return cpus;
+}
+
+
+bool Affinity::ReadLine(const std::string &fileName, std::string &line) noexcept
+{
+  std::FILE *f = std::fopen(fileName.c_str(), "r");
+  if (f == nullptr) return false;
+  char buf[256];
+  bool retVal = (std::fgets(buf, sizeof(buf), f) != nullptr);
+  std::fclose(f);
+  if (retVal) {
+    line.assign(buf);
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+  }
+  return retVal;
+}
+
+}   // namespace tc
@@ -0,0 +1,106 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _AFFINITY_H_
+#define _AFFINITY_H_
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace tc {
+
+/**
+ * Detection of the CPUs available to the process, respecting the CPU affinity mask and cgroup
+ * CPU quotas, and placement of worker and I/O threads on these CPUs.
+ */
+class Affinity
+{
+public:
+  /** Placement of worker threads. */
+  enum class Mode {
+    NONE,       // threads are not pinned
+    CORES,      // one worker thread per CPU in ascending order
+    PHYSICAL,   // one worker thread per physical core first, SMT siblings last
+  };
+
+  /** Returns the mode of the given name ("none", "cores", "physical"). Returns false on error. */
+  static bool GetModeByName(const std::string &name, Mode &mode) noexcept;
+  /** Returns the name of the given mode. */
+  static const char* GetModeName(Mode mode) noexcept;
+
+  /** Placement and number of worker threads of the current conversion. (Default: Mode::NONE) */
+  static void SetMode(Mode mode, unsigned threads) noexcept;
+  static Mode GetMode() noexcept;
+  static unsigned GetThreads() noexcept;
+
+  /** CPUs the process is allowed to run on, in ascending order. */
+  static const std::vector<int>& GetCpus() noexcept;
+  /** Number of physical cores of the available CPUs. */
+  static unsigned GetPhysicalCores() noexcept;
+  /** Number of CPUs granted by the cgroup CPU quota, rounded up. (0: no quota) */
+  static unsigned GetCpuQuota() noexcept;
+
+  /**
+   * Default number of worker threads for the given mode. Limited by the affinity mask and the CPU
+   * quota. Pinned modes leave a CPU for I/O threads if workers would occupy all CPUs otherwise.
+   */
+  static unsigned GetAutoThreads(Mode mode) noexcept;
+
+  /** CPUs of the given number of worker threads, one per thread. Empty if threads are not pinned. */
+  static std::vector<int> GetWorkerCpus(Mode mode, unsigned threads) noexcept;
+  /**
+   * CPUs of the I/O threads, preferably on physical cores without worker threads. Empty if threads
+   * are not pinned or workers occupy all CPUs.
+   */
+  static std::vector<int> GetIoCpus(Mode mode, unsigned threads) noexcept;
+
+  /** Restricts the current thread to the given CPUs. Returns false if not supported. */
+  static bool PinCurrentThread(const std::vector<int> &cpus) noexcept;
+  /** Pins the current thread to the I/O CPUs of the current placement if threads are pinned. */
+  static void PinIoThread() noexcept;
+
+private:
+  struct Topology
+  {
+    std::vector<int>              cpus;     // allowed CPUs in ascending order
+    std::vector<std::vector<int>> cores;    // allowed CPUs of each physical core
+    unsigned                      quota;    // CPUs granted by the CPU quota (0: none)
+  };
+
+  static std::atomic<int>& GetModeRef() noexcept;
+  static std::atomic<unsigned>& GetThreadsRef() noexcept;
+
+  // Detected once on first use
+  static const Topology& GetTopology() noexcept;
+  static void DetectCpus(Topology &topo) noexcept;
+  static void DetectCores(Topology &topo) noexcept;
+  static unsigned DetectQuota() noexcept;
+
+  // Available CPUs in order of preference for worker threads
+  static std::vector<int> GetOrderedCpus(Mode mode) noexcept;
+
+  // Reads the first line of the given file without line break
+  static bool ReadLine(const std::string &fileName, std::string &line) noexcept;
+};
+
+}   // namespace tc
+
+#endif		// _AFFINITY_H_
@@ -0,0 +1,431 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*
+ * Microbenchmark of the hot conversion primitives in isolation.
+ *
+ * microbench [-r repetitions] [-w warmup] [filter]
+ *   Runs each kernel on tile-sized data (64x64 pixels) and prints median and 95th percentile
+ *   timings per tile as JSON to standard output. Only kernels containing "filter" in their
+ *   name are run if specified. TIZ/MOZ kernels decode a synthetic MOZ made of JPEG compressed
+ *   (TIL2) tiles, which are created with the JPEG encoder of libjpeg-turbo.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include "colorquant.h"
+#include "colors.h"
+#include "compress.h"
+#include "converter.h"
+#include "converter_dxt.h"
+#include "converter_z.h"
+#include "graphics.h"
+#include "jpeg.h"
+#include "options.h"
+#include "types.h"
+
+namespace tc {
+
+/** Runs all kernel benchmarks. Friend of the converter classes to reach their block routines. */
+class MicroBench
+{
+public:
+  MicroBench(int repetitions, int warmupMs, const std::string &filter) noexcept;
+
+  void run() noexcept;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  // Times "func" in batches and records median and 95th percentile per call
+  template<typename Func> void measure(const std::string &name, unsigned bytes, Func func) noexcept;
+
+  void benchReorderColors() noexcept;
+  void benchPadBlock() noexcept;
+  void benchPalToARGB() noexcept;
+  void benchDecodeDxt() noexcept;
+  void benchCompressBlock() noexcept;
+  void benchCompression() noexcept;
+  void benchApplyAlpha() noexcept;
+  void benchDecodeZ() noexcept;
+  void benchQuantize() noexcept;
+
+  // Returns a TIL2 tile (signature, size and JPEG data) of the given pattern, or an empty block on error
+  static std::vector<uint8_t> CreateZTile(uint32_t seed) noexcept;
+
+private:
+  static const int TILE_DIM = 64;
+  static const int TILE_PIXELS = TILE_DIM*TILE_DIM;
+  static const double BATCH_SECONDS;    // min. duration of a single timed batch
+
+  int m_repetitions;
+  int m_warmupMs;
+  std::string m_filter;
+  bool m_first;
+  Options m_options;
+  std::vector<uint8_t> m_palette;   // 256 colors, index 0 = transparent green
+  std::vector<uint8_t> m_indexed;   // paletted tile
+  std::vector<uint8_t> m_pixels;    // tile as 32-bit ARGB pixels
+  std::vector<uint8_t> m_mask;      // TIZ alpha bitmask (1 bit per pixel)
+};
+
+const double MicroBench::BATCH_SECONDS = 0.002;
+
+MicroBench::MicroBench(int repetitions, int warmupMs, const std::string &filter) noexcept
+: m_repetitions(std::max(1, repetitions))
+, m_warmupMs(std::max(0, warmupMs))
+, m_filter(filter)
+, m_first(true)
+, m_options()
+, m_palette(1024)
+, m_indexed(TILE_PIXELS)
+, m_pixels(TILE_PIXELS*4)
+, m_mask(TILE_PIXELS/8)
+{
+  // deterministic test tile: gradients with dithered noise and a transparent area
+  uint32_t seed = 0x12345678;
+  for (int i = 0; i < 256; i++) {
+    m_palette[i*4+0] = i;
+    m_palette[i*4+1] = (i * 7) & 0xff;
+    m_palette[i*4+2] = 255 - i;
+    m_palette[i*4+3] = 0;
+  }
+  m_palette[0] = 0; m_palette[1] = 255; m_palette[2] = 0;
+  for (int y = 0; y < TILE_DIM; y++) {
+    for (int x = 0; x < TILE_DIM; x++) {
+      seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+      bool transparent = (x < 12 && y < 12);
+      m_indexed[y*TILE_DIM+x] = transparent ? 0 : 1 + ((x*2 + y + (seed & 7)) % 255);
+      if (transparent) m_mask[(y*TILE_DIM+x) >> 3] &= ~(0x80 >> (x & 7));
+      else m_mask[(y*TILE_DIM+x) >> 3] |= 0x80 >> (x & 7);
+    }
+  }
+  Colors colors(m_options);
+  colors.palToARGB(m_indexed.data(), m_palette.data(), m_pixels.data(), TILE_PIXELS);
+}
+
+void MicroBench::run() noexcept
+{
+  std::printf("[");
+  benchReorderColors();
+  benchPadBlock();
+  benchPalToARGB();
+  benchDecodeDxt();
+  benchCompressBlock();
+  benchCompression();
+  benchApplyAlpha();
+  benchDecodeZ();
+  benchQuantize();
+  std::printf("\n]\n");
+}
+
+template<typename Func>
+void MicroBench::measure(const std::string &name, unsigned bytes, Func func) noexcept
+{
+  if (!m_filter.empty() && name.find(m_filter) == std::string::npos) return;
+
+  // warmup, also used to calibrate the number of calls per timed batch
+  unsigned batch = 1;
+  Clock::time_point start = Clock::now();
+  for (;;) {
+    Clock::time_point t0 = Clock::now();
+    for (unsigned i = 0; i < batch; i++) func();
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    if (secs < BATCH_SECONDS) {
+      batch <<= 1;
+    } else if (std::chrono::duration<double>(Clock::now() - start).count() * 1000.0 >= m_warmupMs) {
+      break;
+    }
+  }
+
+  std::vector<double> samples;
+  samples.reserve(m_repetitions);
+  for (int r = 0; r < m_repetitions; r++) {
+    Clock::time_point t0 = Clock::now();
+    for (unsigned i = 0; i < batch; i++) func();
+    samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / batch);
+  }
+  std::sort(samples.begin(), samples.end());
+  double median = samples[samples.size() / 2];
+  double p95 = samples[std::min(samples.size() - 1, (size_t)std::ceil(samples.size() * 0.95) - 1)];
+  double mbps = (median > 0.0) ? (double)bytes * 1e9 / median / 1048576.0 : 0.0;
+
+  std::printf("%s\n  {\"name\": \"%s\", \"bytes\": %u, \"batch\": %u, \"repetitions\": %d, "
+              "\"median_ns\": %.1f, \"p95_ns\": %.1f, \"mb_per_sec\": %.2f}",
+              m_first ? "" : ",", name.c_str(), bytes, batch, m_repetitions, median, p95, mbps);
+  std::fflush(stdout);
+  std::fprintf(stderr, "%-28s median %12.1f ns  p95 %12.1f ns  %10.2f MB/s\n",
+               name.c_str(), median, p95, mbps);
+  m_first = false;
+}
+
+void MicroBench::benchReorderColors() noexcept
+{
+  std::vector<uint8_t> buf(m_pixels);
+  measure("ReorderColors ARGB-ABGR", buf.size(), [&]() {
+    Converter::ReorderColors(buf.data(), TILE_PIXELS, Converter::ColorFormat::ARGB, Converter::ColorFormat::ABGR);
+  });
+  measure("ReorderColors ARGB-RGBA", buf.size(), [&]() {
+    Converter::ReorderColors(buf.data(), TILE_PIXELS, Converter::ColorFormat::ARGB, Converter::ColorFormat::RGBA);
+  });
+}
+
+void MicroBench::benchPadBlock() noexcept
+{
+  // partial tiles of MOS files are padded to multiples of 4 pixels for DXTn encoding
+  const int dim = TILE_DIM - 3;
+  std::vector<uint8_t> src(m_pixels), dst(TILE_PIXELS*4);
+  measure("PadBlock", dim*dim*4, [&]() {
+    Converter::PadBlock(src.data(), dst.data(), dim, dim, TILE_DIM, TILE_DIM, true);
+  });
+  measure("UnpadBlock", dim*dim*4, [&]() {
+    Converter::UnpadBlock(src.data(), dst.data(), TILE_DIM, TILE_DIM, dim, dim);
+  });
+}
+
+void MicroBench::benchPalToARGB() noexcept
+{
+  Colors colors(m_options);
+  std::vector<uint8_t> dst(TILE_PIXELS*4);
+  measure("palToARGB", TILE_PIXELS, [&]() {
+    colors.palToARGB(m_indexed.data(), m_palette.data(), dst.data(), TILE_PIXELS);
+  });
+}
+
+void MicroBench::benchDecodeDxt() noexcept
+{
+  static const char *names[] = { "decodeBlockDxt1", "decodeBlockDxt3", "decodeBlockDxt5" };
+  static bool (ConverterDxt::*funcs[])(uint8_t*, uint8_t*) = {
+    &ConverterDxt::decodeBlockDxt1, &ConverterDxt::decodeBlockDxt3, &ConverterDxt::decodeBlockDxt5 };
+
+  for (unsigned type = ENCODE_DXT1; type <= ENCODE_DXT5; type++) {
+    ConverterDxt conv(m_options, type);
+    int blockSize = (type == ENCODE_DXT1) ? 8 : 16;
+    std::vector<uint8_t> encoded(TILE_PIXELS / 16 * blockSize), dst(64);
+    if (conv.encodePixels(m_pixels.data(), encoded.data(), TILE_DIM, TILE_DIM) <= 0) continue;
+    bool (ConverterDxt::*func)(uint8_t*, uint8_t*) = funcs[type - ENCODE_DXT1];
+    measure(names[type - ENCODE_DXT1], encoded.size(), [&]() {
+      for (size_t ofs = 0; ofs < encoded.size(); ofs += blockSize) {
+        (conv.*func)(encoded.data() + ofs, dst.data());
+      }
+    });
+  }
+}
+
+void MicroBench::benchCompressBlock() noexcept
+{
+  // one quality level per squish color fit mode (see ConverterDxt::getFlags())
+  static const int qualities[] = { 0, 3, 5, 9 };
+  static const char *fits[] = { "range", "cluster", "cluster-weighted", "iterative" };
+
+  // tile pixels rearranged into consecutive 4x4 blocks
+  std::vector<uint8_t> blocks(TILE_PIXELS*4);
+  for (int i = 0, ofs = 0; i < TILE_PIXELS / 16; i++) {
+    int bx = (i % (TILE_DIM / 4)) * 4, by = (i / (TILE_DIM / 4)) * 4;
+    for (int y = 0; y < 4; y++, ofs += 16) {
+      std::memcpy(&blocks[ofs], &m_pixels[((by + y)*TILE_DIM + bx)*4], 16);
+    }
+  }
+
+  for (unsigned type = ENCODE_DXT1; type <= ENCODE_DXT5; type++) {
+    for (unsigned q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+      Options options;
+      options.setEncodingQuality(qualities[q]);
+      ConverterDxt conv(options, type);
+      uint8_t dst[16];
+      char name[64];
+      std::snprintf(name, sizeof(name), "compressBlock Dxt%d %s", (type == ENCODE_DXT1) ? 1 : type*2 - 1, fits[q]);
+      measure(name, blocks.size(), [&]() {
+        for (size_t ofs = 0; ofs < blocks.size(); ofs += 64) {
+          conv.compressBlock(&blocks[ofs], dst);
+        }
+      });
+    }
+  }
+}
+
+void MicroBench::benchCompression() noexcept
+{
+  // paletted TIS tile: palette followed by indexed pixels
+  std::vector<uint8_t> tile(m_palette);
+  tile.insert(tile.end(), m_indexed.begin(), m_indexed.end());
+  std::vector<uint8_t> deflated(tile.size() * 2), inflated(tile.size());
+  Compression compression;
+  uint32_t size = compression.deflate(tile.data(), tile.size(), deflated.data(), deflated.size());
+  if (size == 0) return;
+  measure("deflate", tile.size(), [&]() {
+    compression.deflate(tile.data(), tile.size(), deflated.data(), deflated.size());
+  });
+  measure("inflate", tile.size(), [&]() {
+    compression.inflate(deflated.data(), size, inflated.data(), inflated.size());
+  });
+}
+
+void MicroBench::benchApplyAlpha() noexcept
+{
+  ConverterZ conv(m_options, ENCODE_Z);
+  std::vector<uint8_t> indexed(m_indexed), pixels(m_pixels);
+  measure("applyAlpha", TILE_PIXELS, [&]() {
+    conv.applyAlpha(m_mask.data(), indexed.data(), TILE_PIXELS);
+  });
+  measure("applyAlphaPixels", TILE_PIXELS*4, [&]() {
+    conv.applyAlphaPixels(m_mask.data(), pixels.data(), TILE_PIXELS);
+  });
+}
+
+std::vector<uint8_t> MicroBench::CreateZTile(uint32_t seed) noexcept
+{
+  // gradients and a checker pattern that change with the seed
+  std::vector<uint8_t> rgb(TILE_PIXELS*3);
+  for (int y = 0; y < TILE_DIM; y++) {
+    for (int x = 0; x < TILE_DIM; x++) {
+      uint8_t *p = &rgb[(y*TILE_DIM + x)*3];
+      p[0] = (x*4 + seed*17) & 0xff;
+      p[1] = (y*4 + seed*31) & 0xff;
+      p[2] = ((x ^ y) + seed*7) & 0xff;
+    }
+  }
+
+  struct jpeg_compress_struct info;
+  struct jpeg_error_mgr err;
+  unsigned char *jpg = nullptr;
+  unsigned long jpgSize = 0;
+  info.err = jpeg_std_error(&err);
+  jpeg_create_compress(&info);
+  jpeg_mem_dest(&info, &jpg, &jpgSize);
+  info.image_width = TILE_DIM;
+  info.image_height = TILE_DIM;
+  info.input_components = 3;
+  info.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&info);
+  jpeg_set_quality(&info, 85, TRUE);
+  jpeg_start_compress(&info, TRUE);
+  while (info.next_scanline < info.image_height) {
+    JSAMPROW row = &rgb[info.next_scanline*TILE_DIM*3];
+    jpeg_write_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_compress(&info);
+  jpeg_destroy_compress(&info);
+
+  std::vector<uint8_t> tile;
+  if (jpg != nullptr && jpgSize > 0 && jpgSize <= 0xffff) {
+    tile.assign(Graphics::HEADER_TIL2_SIGNATURE, Graphics::HEADER_TIL2_SIGNATURE + 4);
+    tile.push_back((jpgSize >> 8) & 0xff);    // big endian
+    tile.push_back(jpgSize & 0xff);
+    tile.insert(tile.end(), jpg, jpg + jpgSize);
+  }
+  std::free(jpg);
+  return tile;
+}
+
+void MicroBench::benchDecodeZ() noexcept
+{
+  // synthetic MOZ: tiles cycle through a set of distinct JPEG compressed tiles
+  static const unsigned NUM_TILES = 16;
+  std::vector<std::vector<uint8_t>> tiles;
+  for (unsigned i = 0; i < NUM_TILES; i++) {
+    tiles.push_back(CreateZTile(i));
+    if (tiles.back().empty()) return;
+  }
+  std::vector<uint8_t> pixels(MAX_TILE_SIZE_32), palette(1024), indexed(TILE_PIXELS);
+  unsigned next = 0;
+
+  // JPEG data of a TIL2 tile to 32-bit pixels, including the setup of the decompressor
+  measure("jpeg decompress", pixels.size(), [&]() {
+    std::vector<uint8_t> &tile = tiles[next++ % NUM_TILES];
+    Jpeg jpeg(m_options);
+    jpeg.decompress(tile.data() + 6, tile.size() - 6, pixels.data(), pixels.size());
+  });
+
+  // TIL2 decoding to 32-bit pixels (e.g. MOZ -> MBC) and to paletted pixels (MOZ -> MOS)
+  static const int qualities[] = { 0, 4, 9 };
+  for (unsigned q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+    Options options;
+    options.setDecodingQuality(qualities[q]);
+    ConverterZ conv(options, ENCODE_Z);
+    conv.setEncoding(false);
+    char name[64];
+    std::snprintf(name, sizeof(name), "decodeZ pixels q%d", qualities[q]);
+    measure(name, pixels.size(), [&]() {
+      conv.decodePixels(tiles[next++ % NUM_TILES].data(), pixels.data());
+    });
+    std::snprintf(name, sizeof(name), "decodeZ paletted q%d", qualities[q]);
+    measure(name, indexed.size(), [&]() {
+      conv.convert(palette.data(), indexed.data(), tiles[next++ % NUM_TILES].data(), TILE_DIM, TILE_DIM);
+    });
+  }
+}
+
+void MicroBench::benchQuantize() noexcept
+{
+  // true color source with more than 256 colors, as produced by DXTn decoding
+  std::vector<uint8_t> src(m_pixels), dst(TILE_PIXELS), palette(1024);
+  for (int i = 0; i < TILE_PIXELS; i++) {
+    if (src[i*4+3] != 0) src[i*4+1] = (uint8_t)(i * 13);
+  }
+  Converter::ReorderColors(src.data(), TILE_PIXELS, Converter::ColorFormat::ARGB, Converter::ColorFormat::ABGR);
+
+  // speed is defined as "10 - quality" (see Colors::ARGBToPal())
+  static const int qualities[] = { 0, 4, 9 };
+  for (unsigned q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "quantize q%d", qualities[q]);
+    measure(name, src.size(), [&]() {
+      ColorQuant quant;
+      quant.setSource(src.data(), TILE_DIM, TILE_DIM);
+      quant.setTarget(dst.data(), dst.size());
+      quant.setPalette(palette.data(), palette.size());
+      quant.setSpeed(10 - qualities[q]);
+      quant.quantize();
+    });
+  }
+}
+
+}   // namespace tc
+
+
+int main(int argc, char *argv[])
+{
+  int repetitions = 31, warmupMs = 100;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:w:")) != -1) {
+    switch (opt) {
+      case 'r': repetitions = std::atoi(optarg); break;
+      case 'w': warmupMs = std::atoi(optarg); break;
+      default:
+        std::fprintf(stderr, "Usage: %s [-r repetitions] [-w warmup_ms] [filter]\n", argv[0]);
+        return 1;
+    }
+  }
+
+  tc::MicroBench bench(repetitions, warmupMs, (optind < argc) ? argv[optind] : "");
+  bench.run();
+  return 0;
+}
@@ -0,0 +1,1127 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*
+ * Macro benchmark of tileconv conversions.
+ *
+ * tcbench generate <folder>
+ *   Creates a synthetic corpus of paletted TIS and MOS files in the specified folder.
+ *
+ * tcbench run <tileconv> <folder> [quick]
+ *   Runs all conversion directions across pixel encodings, quality levels, tile compression
+ *   and number of jobs on the corpus, and prints the results as JSON to standard output.
+ *
+ * tcbench sweep <tileconv> <folder>
+ *   Sweeps encoding levels 0..9 x BC1/BC3 x tile compression on/off and decoding levels 0..9
+ *   over the TIS files of the corpus. Each cell reports throughput and the round-trip error
+ *   (RMSE/PSNR of palette-expanded pixels, TIS -> TBC -> TIS) as JSON to standard output.
+ *   Cells on the Pareto frontier of throughput versus error are marked and listed on stderr.
+ *
+ * tcbench quota <tileconv> <folder>
+ *   Encodes the TIS files of the corpus under CPU quotas of 1, 2, 4, ... CPUs with autodetected
+ *   jobs (-j 0), one job per online CPU and pinned worker threads (--affinity physical), and
+ *   prints the results as JSON to standard output. Quotas are applied as cgroup CPU quota if
+ *   possible (requires write access to the cgroup hierarchy), as CPU affinity mask otherwise.
+ *
+ * tcbench io <tileconv> <folder>
+ *   Creates a few thousand single tile TIS files in the "io" subfolder of the specified folder,
+ *   converts them TIS -> TBC and TBC -> TIS in a single call each with the batch I/O engine
+ *   (--io-engine auto) and with stdio (--io-engine stdio), and prints the results as JSON to
+ *   standard output.
+ *
+ * tcbench cache <tileconv> <folder>
+ *   Checks results of the conversion cache (-C) in the "cache" subfolder of the specified folder:
+ *   a repeated conversion must restore identical output, and a PVRZ-based TIS must be converted
+ *   again after one of its PVRZ pages has been replaced. Returns a non-zero exit code on failure.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#ifdef __linux__
+# include <sched.h>
+#endif
+
+static const unsigned TILE_DIM = 64;
+
+/** Deterministic pseudo-random numbers, so that each corpus is identical. */
+class Random
+{
+public:
+  explicit Random(uint64_t seed) : m_state(seed ? seed : 1) {}
+  uint32_t next() { m_state ^= m_state << 13; m_state ^= m_state >> 7; m_state ^= m_state << 17; return (uint32_t)m_state; }
+  unsigned range(unsigned n) { return n ? next() % n : 0; }
+private:
+  uint64_t m_state;
+};
+
+/** Paletted image with a 256 color palette (BGRA, index 0 = transparent green). */
+struct Image
+{
+  unsigned width, height;
+  std::vector<uint8_t> pixels;
+  uint8_t palette[1024];
+};
+
+/** Conversion result of a single benchmark run. */
+struct Result
+{
+  std::string name, args;
+  unsigned files;
+  uint64_t tiles, inputBytes, outputBytes;
+  double seconds;
+  long peakRss;       // in KB
+  int status;
+};
+
+/** CPU limit of the tileconv processes started by a benchmark run. */
+struct CpuLimit
+{
+  std::string cgroup; // cgroup folder to join (empty: none)
+  unsigned cpus;      // size of the CPU affinity mask if no cgroup is used (0: unlimited)
+};
+
+/** Single cell of the quality sweep. */
+struct SweepCell
+{
+  std::string stage;  // "encode" or "decode"
+  unsigned type, level;
+  bool deflate;
+  Result result;      // timed conversion of the cell
+  double rmse, psnr;
+  bool pareto;
+};
+
+
+static void Put16(std::vector<uint8_t> &buf, size_t ofs, uint32_t v)
+{
+  buf[ofs] = v & 0xff; buf[ofs+1] = (v >> 8) & 0xff;
+}
+
+static void Put32(std::vector<uint8_t> &buf, size_t ofs, uint32_t v)
+{
+  Put16(buf, ofs, v & 0xffff); Put16(buf, ofs+2, v >> 16);
+}
+
+static uint32_t Get32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+// 8 color ramps of 32 shades each
+static void CreatePalette(uint8_t *palette, unsigned hueShift)
+{
+  static const uint8_t hues[8][3] = { {255,64,32}, {32,200,64}, {48,96,255}, {220,200,80},
+                                      {160,80,200}, {80,200,220}, {200,120,60}, {180,180,180} };
+  for (unsigned i = 0; i < 256; i++) {
+    const uint8_t *hue = hues[((i >> 5) + hueShift) & 7];
+    unsigned shade = i & 31;
+    palette[i*4+0] = hue[2] * shade / 31;
+    palette[i*4+1] = hue[1] * shade / 31;
+    palette[i*4+2] = hue[0] * shade / 31;
+    palette[i*4+3] = 0;
+  }
+  // transparent green
+  palette[0] = 0; palette[1] = 255; palette[2] = 0; palette[3] = 0;
+}
+
+
+// Fills the image with rectangular regions of typical patterns
+static void CreateImage(Image &img, unsigned width, unsigned height, Random &rnd)
+{
+  img.width = width;
+  img.height = height;
+  img.pixels.assign(width*height, 0);
+  CreatePalette(img.palette, rnd.range(8));
+
+  unsigned regions = std::max(4u, width*height / 6000);
+  for (unsigned r = 0; r < regions; r++) {
+    unsigned w = 8 + rnd.range(std::max(1u, width / 2)), h = 8 + rnd.range(std::max(1u, height / 2));
+    unsigned x0 = rnd.range(width), y0 = rnd.range(height);
+    unsigned ramp = rnd.range(8) << 5;
+    unsigned kind = rnd.range(5);
+    for (unsigned y = y0; y < std::min(height, y0 + h); y++) {
+      for (unsigned x = x0; x < std::min(width, x0 + w); x++) {
+        uint8_t &p = img.pixels[y*width + x];
+        switch (kind) {
+          case 0:   // flat region
+            p = ramp + 16;
+            break;
+          case 1:   // gradient
+            p = ramp + 1 + ((x - x0) * 30 / w + (y - y0) * 30 / h) / 2;
+            break;
+          case 2:   // dithered gradient
+            p = ramp + 1 + std::min(30u, ((x - x0) * 28 / w) + (((x ^ y) & 1) ? 2 : 0));
+            break;
+          case 3:   // noise
+            p = ramp + 1 + rnd.range(31);
+            break;
+          default:  // transparent area
+            p = 0;
+            break;
+        }
+      }
+    }
+  }
+}
+
+
+static bool WriteFile(const std::string &fileName, const std::vector<uint8_t> &data)
+{
+  std::FILE *f = std::fopen(fileName.c_str(), "wb");
+  if (f == nullptr) return false;
+  bool retVal = (std::fwrite(data.data(), 1, data.size(), f) == data.size());
+  return (std::fclose(f) == 0) && retVal;
+}
+
+
+static bool WriteTis(const std::string &fileName, const Image &img)
+{
+  unsigned cols = img.width / TILE_DIM, rows = img.height / TILE_DIM;
+  std::vector<uint8_t> buf(24 + cols*rows*(1024 + TILE_DIM*TILE_DIM));
+  std::memcpy(&buf[0], "TIS V1  ", 8);
+  Put32(buf, 8, cols*rows);
+  Put32(buf, 12, 1024 + TILE_DIM*TILE_DIM);
+  Put32(buf, 16, 24);
+  Put32(buf, 20, TILE_DIM);
+  size_t ofs = 24;
+  for (unsigned r = 0; r < rows; r++) {
+    for (unsigned c = 0; c < cols; c++) {
+      std::memcpy(&buf[ofs], img.palette, 1024);
+      ofs += 1024;
+      for (unsigned y = 0; y < TILE_DIM; y++, ofs += TILE_DIM) {
+        std::memcpy(&buf[ofs], &img.pixels[(r*TILE_DIM + y)*img.width + c*TILE_DIM], TILE_DIM);
+      }
+    }
+  }
+  return WriteFile(fileName, buf);
+}
+
+
+static bool WriteMos(const std::string &fileName, const Image &img)
+{
+  unsigned cols = (img.width + TILE_DIM - 1) / TILE_DIM, rows = (img.height + TILE_DIM - 1) / TILE_DIM;
+  unsigned palOfs = 24, tileOfs = palOfs + cols*rows*1024, dataOfs = tileOfs + cols*rows*4;
+  std::vector<uint8_t> buf(dataOfs + img.width*img.height);
+  std::memcpy(&buf[0], "MOS V1  ", 8);
+  Put16(buf, 8, img.width);
+  Put16(buf, 10, img.height);
+  Put16(buf, 12, cols);
+  Put16(buf, 14, rows);
+  Put32(buf, 16, TILE_DIM);
+  Put32(buf, 20, palOfs);
+  size_t ofs = dataOfs;
+  for (unsigned r = 0; r < rows; r++) {
+    for (unsigned c = 0; c < cols; c++) {
+      unsigned tw = std::min(TILE_DIM, img.width - c*TILE_DIM), th = std::min(TILE_DIM, img.height - r*TILE_DIM);
+      std::memcpy(&buf[palOfs], img.palette, 1024);
+      palOfs += 1024;
+      Put32(buf, tileOfs, ofs - dataOfs);
+      tileOfs += 4;
+      for (unsigned y = 0; y < th; y++, ofs += tw) {
+        std::memcpy(&buf[ofs], &img.pixels[(r*TILE_DIM + y)*img.width + c*TILE_DIM], tw);
+      }
+    }
+  }
+  return WriteFile(fileName, buf);
+}
+
+
+static int Generate(const std::string &folder)
+{
+  // tile counts of TIS files (columns x rows) and sizes of MOS files, including odd edges
+  static const unsigned tisSizes[][2] = { {4, 4}, {8, 8}, {15, 10}, {20, 20}, {40, 25} };
+  static const unsigned mosSizes[][2] = { {64, 64}, {317, 211}, {640, 480}, {1000, 769}, {1431, 97}, {77, 1201} };
+
+  ::mkdir(folder.c_str(), 0777);
+  Random rnd(0x7c0de);
+  char name[64];
+  for (unsigned i = 0; i < sizeof(tisSizes) / sizeof(tisSizes[0]); i++) {
+    Image img;
+    CreateImage(img, tisSizes[i][0]*TILE_DIM, tisSizes[i][1]*TILE_DIM, rnd);
+    std::snprintf(name, sizeof(name), "/bench%02u.tis", i);
+    if (!WriteTis(folder + name, img)) return 1;
+  }
+  for (unsigned i = 0; i < sizeof(mosSizes) / sizeof(mosSizes[0]); i++) {
+    Image img;
+    CreateImage(img, mosSizes[i][0], mosSizes[i][1], rnd);
+    std::snprintf(name, sizeof(name), "/bench%02u.mos", i);
+    if (!WriteMos(folder + name, img)) return 1;
+  }
+  return 0;
+}
+
+
+// Returns the full names of all files with the given extension in folder
+static std::vector<std::string> ListFiles(const std::string &folder, const std::string &ext)
+{
+  std::vector<std::string> files;
+  DIR *dir = ::opendir(folder.c_str());
+  if (dir != nullptr) {
+    struct dirent *de;
+    while ((de = ::readdir(dir)) != nullptr) {
+      std::string name(de->d_name);
+      if (name == "." || name == "..") continue;
+      if (name.size() > ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0) {
+        files.push_back(folder + "/" + name);
+      }
+    }
+    ::closedir(dir);
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+
+static uint64_t GetFileSize(const std::string &fileName)
+{
+  struct stat s;
+  return (::stat(fileName.c_str(), &s) == 0) ? (uint64_t)s.st_size : 0;
+}
+
+
+// Returns the total size of all files in folder. Files are removed if requested.
+static uint64_t GetFolderSize(const std::string &folder, bool remove)
+{
+  uint64_t size = 0;
+  std::vector<std::string> files = ListFiles(folder, "");
+  for (auto iter = files.cbegin(); iter != files.cend(); ++iter) {
+    size += GetFileSize(*iter);
+    if (remove) ::unlink(iter->c_str());
+  }
+  return size;
+}
+
+
+// Returns the number of tiles of a TIS, MOS, TBC or MBC file
+static uint64_t GetTileCount(const std::string &fileName)
+{
+  uint8_t hdr[24];
+  std::FILE *f = std::fopen(fileName.c_str(), "rb");
+  if (f == nullptr) return 0;
+  size_t len = std::fread(hdr, 1, sizeof(hdr), f);
+  std::fclose(f);
+  if (len < 20) return 0;
+  if (std::memcmp(hdr, "TIS ", 4) == 0) return Get32(hdr + 8);
+  if (std::memcmp(hdr, "TBC ", 4) == 0) return Get32(hdr + 12);
+  if (std::memcmp(hdr, "MOS ", 4) == 0) return (uint64_t)(hdr[12] | (hdr[13] << 8)) * (hdr[14] | (hdr[15] << 8));
+  if (std::memcmp(hdr, "MBC ", 4) == 0) {
+    return (uint64_t)((Get32(hdr + 12) + TILE_DIM - 1) / TILE_DIM) * ((Get32(hdr + 16) + TILE_DIM - 1) / TILE_DIM);
+  }
+  return 0;
+}
+
+
+static bool WriteText(const std::string &fileName, const std::string &text)
+{
+  std::FILE *f = std::fopen(fileName.c_str(), "w");
+  if (f == nullptr) return false;
+  bool retVal = (std::fputs(text.c_str(), f) >= 0);
+  return (std::fclose(f) == 0) && retVal;
+}
+
+
+// Restricts the current process to the given CPU limit
+static bool ApplyCpuLimit(const CpuLimit &limit)
+{
+  if (!limit.cgroup.empty()) {
+    return WriteText(limit.cgroup + "/cgroup.procs", std::to_string(::getpid()));
+  }
+#ifdef __linux__
+  if (limit.cpus > 0) {
+    cpu_set_t set, mask;
+    CPU_ZERO(&mask);
+    if (::sched_getaffinity(0, sizeof(set), &set) != 0) return false;
+    for (int i = 0, count = 0; i < CPU_SETSIZE && count < (int)limit.cpus; i++) {
+      if (CPU_ISSET(i, &set)) { CPU_SET(i, &mask); count++; }
+    }
+    return (::sched_setaffinity(0, sizeof(mask), &mask) == 0);
+  }
+#endif
+  return (limit.cpus == 0);
+}
+
+
+// Runs tileconv with the given arguments and input files. Output files are written into
+// outFolder and removed afterwards unless keepOutput is set.
+static Result Execute(const std::string &tileconv, const std::string &name, const std::string &args,
+                      const std::vector<std::string> &inputs, const std::string &outFolder,
+                      bool keepOutput, const CpuLimit *limit = nullptr)
+{
+  Result result;
+  result.name = name;
+  result.args = args;
+  result.files = inputs.size();
+  result.tiles = result.inputBytes = result.outputBytes = 0;
+  for (auto iter = inputs.cbegin(); iter != inputs.cend(); ++iter) {
+    result.tiles += GetTileCount(*iter);
+    result.inputBytes += GetFileSize(*iter);
+  }
+  GetFolderSize(outFolder, true);
+
+  std::vector<std::string> argList;
+  argList.push_back(tileconv);
+  argList.push_back("-s");
+  argList.push_back("-e");
+  for (size_t pos = 0; pos < args.size(); ) {
+    size_t end = args.find(' ', pos);
+    if (end == std::string::npos) end = args.size();
+    if (end > pos) argList.push_back(args.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  argList.push_back("-o");
+  argList.push_back(outFolder);
+  argList.insert(argList.end(), inputs.begin(), inputs.end());
+  std::vector<char*> argv;
+  for (auto iter = argList.begin(); iter != argList.end(); ++iter) argv.push_back(&(*iter)[0]);
+  argv.push_back(nullptr);
+
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = ::fork();
+  if (pid == 0) {
+    int fd = ::open("/dev/null", O_WRONLY);
+    if (fd >= 0) { ::dup2(fd, 1); ::close(fd); }
+    if (limit != nullptr && !ApplyCpuLimit(*limit)) ::_exit(126);
+    ::execv(argv[0], argv.data());
+    ::_exit(127);
+  }
+  int status = -1;
+  struct rusage usage;
+  std::memset(&usage, 0, sizeof(usage));
+  if (pid > 0) ::wait4(pid, &status, 0, &usage);
+  auto stop = std::chrono::steady_clock::now();
+
+  result.seconds = std::chrono::duration<double>(stop - start).count();
+#ifdef __APPLE__
+  result.peakRss = usage.ru_maxrss / 1024;    // reported in bytes
+#else
+  result.peakRss = usage.ru_maxrss;
+#endif
+  result.status = (pid > 0 && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+  result.outputBytes = GetFolderSize(outFolder, !keepOutput);
+  return result;
+}
+
+
+static void PrintResult(const Result &r, bool last)
+{
+  double tps = (r.seconds > 0.0) ? r.tiles / r.seconds : 0.0;
+  double mbps = (r.seconds > 0.0) ? r.inputBytes / r.seconds / 1048576.0 : 0.0;
+  std::printf("    {\"name\": \"%s\", \"args\": \"%s\", \"files\": %u, \"tiles\": %llu, "
+              "\"input_bytes\": %llu, \"output_bytes\": %llu, \"seconds\": %.4f, "
+              "\"tiles_per_sec\": %.1f, \"mb_per_sec\": %.3f, \"peak_rss_kb\": %ld, \"status\": %d}%s\n",
+              r.name.c_str(), r.args.c_str(), r.files, (unsigned long long)r.tiles,
+              (unsigned long long)r.inputBytes, (unsigned long long)r.outputBytes, r.seconds,
+              tps, mbps, r.peakRss, r.status, last ? "" : ",");
+  std::fflush(stdout);
+}
+
+
+static int Run(const std::string &tileconv, const std::string &folder, bool quick)
+{
+  std::vector<std::string> tisFiles = ListFiles(folder, ".tis");
+  std::vector<std::string> mosFiles = ListFiles(folder, ".mos");
+  if (tisFiles.empty() || mosFiles.empty()) {
+    std::fprintf(stderr, "No corpus found in \"%s\". Run \"tcbench generate\" first.\n", folder.c_str());
+    return 1;
+  }
+  std::string outFolder = folder + "/out", encFolder = folder + "/enc";
+  ::mkdir(outFolder.c_str(), 0777);
+  ::mkdir(encFolder.c_str(), 0777);
+
+  std::vector<std::string> jobs = { "-j 1", "-j 0" };
+  std::vector<std::string> types = { "-t 0", "-t 1", "-t 2", "-t 3", "-t 4" };
+  std::vector<std::string> encQuality = { "-q -2", "-q -9" };
+  std::vector<std::string> decQuality = { "-q 0", "-q 9" };
+  std::vector<std::string> deflate = { "", "-u " };
+  if (quick) {
+    jobs = { "-j 0" };
+    types = { "-t 1", "-t 4" };
+    encQuality = { "-q -9" };
+    decQuality = { "-q 4" };
+    deflate = { "" };
+  }
+
+  // preparing BC1 encoded input files for the decoding benchmarks
+  std::vector<std::string> sources(tisFiles);
+  sources.insert(sources.end(), mosFiles.begin(), mosFiles.end());
+  if (Execute(tileconv, "prepare", "-t 1", sources, encFolder, true).status != 0) {
+    std::fprintf(stderr, "Error running \"%s\"\n", tileconv.c_str());
+    return 1;
+  }
+  std::vector<std::string> tbcFiles = ListFiles(encFolder, ".tbc");
+  std::vector<std::string> mbcFiles = ListFiles(encFolder, ".mbc");
+
+  std::vector<std::string> names, args;
+  std::vector<const std::vector<std::string>*> inputs;
+
+  // encoding: TIS -> TBC, MOS -> MBC
+  for (auto t = types.cbegin(); t != types.cend(); ++t) {
+    for (auto q = encQuality.cbegin(); q != encQuality.cend(); ++q) {
+      for (auto u = deflate.cbegin(); u != deflate.cend(); ++u) {
+        for (auto j = jobs.cbegin(); j != jobs.cend(); ++j) {
+          std::string a = *t + " " + *q + " " + *u + *j;
+          names.push_back("tis-tbc"); args.push_back(a); inputs.push_back(&tisFiles);
+          names.push_back("mos-mbc"); args.push_back(a); inputs.push_back(&mosFiles);
+        }
+      }
+    }
+  }
+
+  // decoding and transcoding
+  for (auto j = jobs.cbegin(); j != jobs.cend(); ++j) {
+    for (auto q = decQuality.cbegin(); q != decQuality.cend(); ++q) {
+      names.push_back("tbc-tis"); args.push_back(*q + " " + *j); inputs.push_back(&tbcFiles);
+      names.push_back("mbc-mos"); args.push_back(*q + " " + *j); inputs.push_back(&mbcFiles);
+      names.push_back("mbc-mosc"); args.push_back("-z " + *q + " " + *j); inputs.push_back(&mbcFiles);
+    }
+    names.push_back("tbc-bm32"); args.push_back("-b argb " + *j); inputs.push_back(&tbcFiles);
+    names.push_back("mbc-bm32"); args.push_back("-b argb " + *j); inputs.push_back(&mbcFiles);
+    names.push_back("tbc-pvrz"); args.push_back("-p 0 " + *j); inputs.push_back(&tbcFiles);
+    names.push_back("mbc-pvrz"); args.push_back("-p 0 " + *j); inputs.push_back(&mbcFiles);
+  }
+
+  std::printf("{\n  \"tileconv\": \"%s\",\n  \"timestamp\": %lld,\n  \"mode\": \"%s\",\n",
+              tileconv.c_str(), (long long)std::time(nullptr), quick ? "quick" : "full");
+  std::printf("  \"results\": [\n");
+  for (size_t i = 0; i < names.size(); i++) {
+    std::fprintf(stderr, "[%u/%u] %s %s\n", (unsigned)i+1, (unsigned)names.size(), names[i].c_str(), args[i].c_str());
+    PrintResult(Execute(tileconv, names[i], args[i], *inputs[i], outFolder, false), i + 1 == names.size());
+  }
+  std::printf("  ]\n}\n");
+  return 0;
+}
+
+
+static bool ReadFile(const std::string &fileName, std::vector<uint8_t> &data)
+{
+  data.clear();
+  std::FILE *f = std::fopen(fileName.c_str(), "rb");
+  if (f == nullptr) return false;
+  uint8_t buf[65536];
+  size_t len;
+  while ((len = std::fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + len);
+  std::fclose(f);
+  return true;
+}
+
+
+// Expands a paletted pixel into BGRA. Index 0 is transparent if the palette starts with green.
+static void ExpandPixel(const uint8_t *palette, uint8_t index, uint8_t *dst)
+{
+  if (index == 0 && Get32(palette) == 0x0000ff00) {
+    dst[0] = dst[1] = dst[2] = dst[3] = 0;
+  } else {
+    dst[0] = palette[index*4+0]; dst[1] = palette[index*4+1]; dst[2] = palette[index*4+2]; dst[3] = 255;
+  }
+}
+
+
+// Accumulates the squared error of the palette-expanded pixels of two TIS files of equal layout.
+// Returns false if the files can't be compared.
+static bool AddTisError(const std::string &fileName1, const std::string &fileName2, double &sumSq, uint64_t &count)
+{
+  static const size_t TILE_SIZE = 1024 + TILE_DIM*TILE_DIM;
+  std::vector<uint8_t> tis1, tis2;
+  if (!ReadFile(fileName1, tis1) || !ReadFile(fileName2, tis2)) return false;
+  if (tis1.size() < 24 || tis1.size() != tis2.size() || std::memcmp(tis1.data(), "TIS V1  ", 8) != 0 ||
+      std::memcmp(tis2.data(), "TIS V1  ", 8) != 0 || Get32(&tis1[12]) != TILE_SIZE ||
+      Get32(&tis2[12]) != TILE_SIZE) return false;
+  size_t tiles = (tis1.size() - 24) / TILE_SIZE;
+  for (size_t t = 0; t < tiles; t++) {
+    const uint8_t *tile1 = &tis1[24 + t*TILE_SIZE], *tile2 = &tis2[24 + t*TILE_SIZE];
+    for (unsigned i = 0; i < TILE_DIM*TILE_DIM; i++) {
+      uint8_t p1[4], p2[4];
+      ExpandPixel(tile1, tile1[1024+i], p1);
+      ExpandPixel(tile2, tile2[1024+i], p2);
+      for (unsigned c = 0; c < 4; c++) {
+        int d = (int)p1[c] - (int)p2[c];
+        sumSq += d*d;
+      }
+    }
+    count += TILE_DIM*TILE_DIM*4;
+  }
+  return true;
+}
+
+
+// Decodes the TBC files in encFolder with the given decoding level and compares the result with
+// the source TIS files. Returns the round-trip RMSE or a negative value on error.
+static double GetRoundTripError(const std::string &tileconv, const std::vector<std::string> &tisFiles,
+                                const std::string &encFolder, const std::string &outFolder,
+                                unsigned decLevel, Result *decoded)
+{
+  std::vector<std::string> tbcFiles = ListFiles(encFolder, ".tbc");
+  Result r = Execute(tileconv, "tbc-tis", "-q " + std::to_string(decLevel), tbcFiles, outFolder, true);
+  if (decoded != nullptr) *decoded = r;
+  double retVal = -1.0;
+  if (r.status == 0 && tbcFiles.size() == tisFiles.size()) {
+    double sumSq = 0.0;
+    uint64_t count = 0;
+    bool success = true;
+    for (auto iter = tisFiles.cbegin(); success && iter != tisFiles.cend(); ++iter) {
+      std::string name = iter->substr(iter->rfind('/') + 1);
+      success = AddTisError(*iter, outFolder + "/" + name, sumSq, count);
+    }
+    if (success && count > 0) retVal = std::sqrt(sumSq / count);
+  }
+  GetFolderSize(outFolder, true);
+  return retVal;
+}
+
+
+// Marks all cells not dominated by another cell in both throughput and error
+static void MarkPareto(std::vector<SweepCell> &cells)
+{
+  for (auto c = cells.begin(); c != cells.end(); ++c) {
+    c->pareto = (c->result.status == 0 && c->rmse >= 0.0);
+    double tps = c->result.tiles / c->result.seconds;
+    for (auto o = cells.cbegin(); c->pareto && o != cells.cend(); ++o) {
+      if (o->stage != c->stage || o->result.status != 0 || o->rmse < 0.0) continue;
+      double otps = o->result.tiles / o->result.seconds;
+      if (otps >= tps && o->rmse <= c->rmse && (otps > tps || o->rmse < c->rmse)) c->pareto = false;
+    }
+  }
+}
+
+
+static int Sweep(const std::string &tileconv, const std::string &folder)
+{
+  static const unsigned DEFAULT_DEC_LEVEL = 4, DEFAULT_ENC_LEVEL = 9;
+  static const char *typeNames[] = { "", "BC1", "", "BC3" };
+
+  std::vector<std::string> tisFiles = ListFiles(folder, ".tis");
+  if (tisFiles.empty()) {
+    std::fprintf(stderr, "No corpus found in \"%s\". Run \"tcbench generate\" first.\n", folder.c_str());
+    return 1;
+  }
+  std::string outFolder = folder + "/out", encFolder = folder + "/enc";
+  ::mkdir(outFolder.c_str(), 0777);
+  ::mkdir(encFolder.c_str(), 0777);
+  GetFolderSize(encFolder, true);
+
+  std::vector<SweepCell> cells;
+  for (unsigned type = 1; type <= 3; type += 2) {
+    for (unsigned deflate = 0; deflate < 2; deflate++) {
+      for (unsigned level = 0; level < 10; level++) {
+        SweepCell cell = { "encode", type, level, deflate == 0, Result(), -1.0, 0.0, false };
+        cells.push_back(cell);
+      }
+    }
+  }
+  for (unsigned type = 1; type <= 3; type += 2) {
+    for (unsigned level = 0; level < 10; level++) {
+      SweepCell cell = { "decode", type, level, true, Result(), -1.0, 0.0, false };
+      cells.push_back(cell);
+    }
+  }
+
+  // encoding cells: timed TIS -> TBC, error measured with the default decoding level
+  // decoding cells: TIS -> TBC with the default encoding level, timed TBC -> TIS
+  unsigned preparedType = 0;
+  for (size_t i = 0; i < cells.size(); i++) {
+    SweepCell &cell = cells[i];
+    std::fprintf(stderr, "[%u/%u] %s %s level %u%s\n", (unsigned)i+1, (unsigned)cells.size(), cell.stage.c_str(),
+                 typeNames[cell.type], cell.level, cell.deflate ? "" : " uncompressed");
+    if (cell.stage == "encode") {
+      std::string args = "-t " + std::to_string(cell.type) + " -q -" + std::to_string(cell.level) + (cell.deflate ? "" : " -u");
+      cell.result = Execute(tileconv, "tis-tbc", args, tisFiles, encFolder, true);
+      if (cell.result.status == 0) {
+        cell.rmse = GetRoundTripError(tileconv, tisFiles, encFolder, outFolder, DEFAULT_DEC_LEVEL, nullptr);
+      }
+      GetFolderSize(encFolder, true);
+    } else {
+      if (preparedType != cell.type) {
+        GetFolderSize(encFolder, true);
+        std::string args = "-t " + std::to_string(cell.type) + " -q -" + std::to_string(DEFAULT_ENC_LEVEL);
+        if (Execute(tileconv, "prepare", args, tisFiles, encFolder, true).status != 0) {
+          std::fprintf(stderr, "Error running \"%s\"\n", tileconv.c_str());
+          return 1;
+        }
+        preparedType = cell.type;
+      }
+      cell.rmse = GetRoundTripError(tileconv, tisFiles, encFolder, outFolder, cell.level, &cell.result);
+    }
+    if (cell.rmse > 0.0) {
+      cell.psnr = 20.0 * std::log10(255.0 / cell.rmse);
+    }
+  }
+  GetFolderSize(encFolder, true);
+  MarkPareto(cells);
+
+  std::printf("{\n  \"tileconv\": \"%s\",\n  \"timestamp\": %lld,\n  \"mode\": \"sweep\",\n",
+              tileconv.c_str(), (long long)std::time(nullptr));
+  std::printf("  \"results\": [\n");
+  for (size_t i = 0; i < cells.size(); i++) {
+    const SweepCell &c = cells[i];
+    const Result &r = c.result;
+    double tps = (r.seconds > 0.0) ? r.tiles / r.seconds : 0.0;
+    char psnr[32];
+    if (c.rmse > 0.0) {
+      std::snprintf(psnr, sizeof(psnr), "%.3f", c.psnr);
+    } else {
+      std::strcpy(psnr, "null");    // lossless or failed
+    }
+    std::printf("    {\"stage\": \"%s\", \"type\": \"%s\", \"level\": %u, \"deflate\": %s, \"tiles\": %llu, "
+                "\"output_bytes\": %llu, \"seconds\": %.4f, \"tiles_per_sec\": %.1f, \"rmse\": %.4f, "
+                "\"psnr\": %s, \"pareto\": %s, \"status\": %d}%s\n",
+                c.stage.c_str(), typeNames[c.type], c.level, c.deflate ? "true" : "false",
+                (unsigned long long)r.tiles, (unsigned long long)r.outputBytes, r.seconds, tps, c.rmse,
+                psnr, c.pareto ? "true" : "false", r.status, (i + 1 == cells.size()) ? "" : ",");
+  }
+  std::printf("  ]\n}\n");
+
+  // Pareto frontier of each stage, from fastest to most accurate
+  for (unsigned s = 0; s < 2; s++) {
+    const char *stage = s ? "decode" : "encode";
+    std::vector<const SweepCell*> frontier;
+    for (auto iter = cells.cbegin(); iter != cells.cend(); ++iter) {
+      if (iter->pareto && iter->stage == stage) frontier.push_back(&(*iter));
+    }
+    std::sort(frontier.begin(), frontier.end(),
+              [](const SweepCell *a, const SweepCell *b) { return a->rmse > b->rmse; });
+    std::fprintf(stderr, "\nPareto frontier (%s):\n  %-4s %5s %8s %12s %9s %9s\n",
+                 stage, "type", "level", "deflate", "tiles/s", "rmse", "psnr");
+    for (auto iter = frontier.cbegin(); iter != frontier.cend(); ++iter) {
+      const SweepCell &c = **iter;
+      std::fprintf(stderr, "  %-4s %5u %8s %12.1f %9.4f %9.3f\n", typeNames[c.type], c.level,
+                   c.deflate ? "yes" : "no", c.result.tiles / c.result.seconds, c.rmse, c.psnr);
+    }
+  }
+  return 0;
+}
+
+
+// Creates a cgroup below the cgroup of the process for the CPU quota. Returns an empty string on error.
+static std::string CreateQuotaGroup(bool &v2)
+{
+  // "hierarchy-id:controllers:path" of the current process
+  std::string pathV1, pathV2;
+  std::FILE *f = std::fopen("/proc/self/cgroup", "r");
+  if (f != nullptr) {
+    char buf[1024];
+    while (std::fgets(buf, sizeof(buf), f) != nullptr) {
+      std::string line(buf);
+      if (!line.empty() && line.back() == '\n') line.pop_back();
+      size_t pos1 = line.find(':'), pos2 = line.find(':', pos1 + 1);
+      if (pos1 == std::string::npos || pos2 == std::string::npos) continue;
+      std::string controllers = "," + line.substr(pos1 + 1, pos2 - pos1 - 1) + ",";
+      std::string path = line.substr(pos2 + 1);
+      if (path == "/") path.clear();
+      if (controllers == ",,") pathV2 = path;
+      else if (controllers.find(",cpu,") != std::string::npos) pathV1 = path;
+    }
+    std::fclose(f);
+  }
+
+  std::string name = "/tcbench-" + std::to_string(::getpid());
+  struct stat st;
+  if (::stat("/sys/fs/cgroup/cgroup.controllers", &st) == 0) {
+    std::string parent = "/sys/fs/cgroup" + pathV2;
+    WriteText(parent + "/cgroup.subtree_control", "+cpu");
+    if (::mkdir((parent + name).c_str(), 0755) == 0) {
+      if (::stat((parent + name + "/cpu.max").c_str(), &st) == 0) {
+        v2 = true;
+        return parent + name;
+      }
+      ::rmdir((parent + name).c_str());
+    }
+  }
+  static const char *mounts[] = { "/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu" };
+  for (unsigned i = 0; i < sizeof(mounts) / sizeof(*mounts); i++) {
+    std::string parent = mounts[i] + pathV1;
+    if (::stat((parent + "/cpu.cfs_quota_us").c_str(), &st) != 0) parent = mounts[i];
+    if (::mkdir((parent + name).c_str(), 0755) == 0) {
+      if (::stat((parent + name + "/cpu.cfs_quota_us").c_str(), &st) == 0) {
+        v2 = false;
+        return parent + name;
+      }
+      ::rmdir((parent + name).c_str());
+    }
+  }
+  return std::string();
+}
+
+
+// Sets the CPU quota of the cgroup to the given number of CPUs
+static bool SetGroupQuota(const std::string &cgroup, bool v2, unsigned cpus)
+{
+  static const unsigned PERIOD = 100000;
+  if (v2) {
+    return WriteText(cgroup + "/cpu.max", std::to_string(cpus * PERIOD) + " " + std::to_string(PERIOD));
+  }
+  return WriteText(cgroup + "/cpu.cfs_period_us", std::to_string(PERIOD)) &&
+         WriteText(cgroup + "/cpu.cfs_quota_us", std::to_string(cpus * PERIOD));
+}
+
+
+// Returns whether a child process can join the cgroup
+static bool CanJoinGroup(const std::string &cgroup)
+{
+  CpuLimit limit = { cgroup, 0 };
+  pid_t pid = ::fork();
+  if (pid == 0) ::_exit(ApplyCpuLimit(limit) ? 0 : 1);
+  int status = -1;
+  if (pid > 0) ::waitpid(pid, &status, 0);
+  return (pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+
+static int Quota(const std::string &tileconv, const std::string &folder)
+{
+  std::vector<std::string> tisFiles = ListFiles(folder, ".tis");
+  if (tisFiles.empty()) {
+    std::fprintf(stderr, "No corpus found in \"%s\". Run \"tcbench generate\" first.\n", folder.c_str());
+    return 1;
+  }
+  std::string outFolder = folder + "/out";
+  ::mkdir(outFolder.c_str(), 0777);
+
+  // the probe moves a process into the cgroup, which may fail even if the cgroup can be created
+  unsigned online = std::max(1L, ::sysconf(_SC_NPROCESSORS_ONLN));
+  bool v2 = false;
+  CpuLimit limit = { CreateQuotaGroup(v2), 0 };
+  if (!limit.cgroup.empty() && (!SetGroupQuota(limit.cgroup, v2, online) || !CanJoinGroup(limit.cgroup))) {
+    ::rmdir(limit.cgroup.c_str());
+    limit.cgroup.clear();
+  }
+  const char *method = limit.cgroup.empty() ? "affinity" : (v2 ? "cgroup2" : "cgroup1");
+#ifndef __linux__
+  if (limit.cgroup.empty()) {
+    std::fprintf(stderr, "CPU quotas are not supported on this system.\n");
+    return 1;
+  }
+#endif
+
+  std::vector<unsigned> quotas;
+  for (unsigned q = 1; q < online; q <<= 1) quotas.push_back(q);
+  quotas.push_back(online);
+  std::vector<std::string> jobs = { "-j 0", "-j " + std::to_string(online), "-j 0 --affinity physical" };
+
+  std::vector<unsigned> cellQuotas;
+  std::vector<Result> results;
+  for (auto q = quotas.cbegin(); q != quotas.cend(); ++q) {
+    if (!limit.cgroup.empty()) {
+      if (!SetGroupQuota(limit.cgroup, v2, *q)) {
+        std::fprintf(stderr, "Error setting CPU quota of \"%s\"\n", limit.cgroup.c_str());
+        break;
+      }
+    } else {
+      limit.cpus = *q;
+    }
+    for (auto j = jobs.cbegin(); j != jobs.cend(); ++j) {
+      std::fprintf(stderr, "[quota %u/%u] %s\n", *q, online, j->c_str());
+      cellQuotas.push_back(*q);
+      results.push_back(Execute(tileconv, "tis-tbc", "-t 1 " + *j, tisFiles, outFolder, false, &limit));
+    }
+  }
+  if (!limit.cgroup.empty()) ::rmdir(limit.cgroup.c_str());
+
+  std::printf("{\n  \"tileconv\": \"%s\",\n  \"timestamp\": %lld,\n  \"mode\": \"quota\",\n"
+              "  \"online_cpus\": %u,\n  \"method\": \"%s\",\n",
+              tileconv.c_str(), (long long)std::time(nullptr), online, method);
+  std::printf("  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    double tps = (r.seconds > 0.0) ? r.tiles / r.seconds : 0.0;
+    std::printf("    {\"quota\": %u, \"args\": \"%s\", \"tiles\": %llu, \"seconds\": %.4f, "
+                "\"tiles_per_sec\": %.1f, \"peak_rss_kb\": %ld, \"status\": %d}%s\n",
+                cellQuotas[i], r.args.c_str(), (unsigned long long)r.tiles, r.seconds, tps, r.peakRss,
+                r.status, (i + 1 == results.size()) ? "" : ",");
+  }
+  std::printf("  ]\n}\n");
+
+  std::fprintf(stderr, "\nThroughput by CPU quota (%s, tiles/s):\n  %5s", method, "quota");
+  for (auto j = jobs.cbegin(); j != jobs.cend(); ++j) std::fprintf(stderr, " %26s", j->c_str());
+  for (size_t i = 0; i < results.size(); i++) {
+    if (i % jobs.size() == 0) std::fprintf(stderr, "\n  %5u", cellQuotas[i]);
+    const Result &r = results[i];
+    std::fprintf(stderr, " %26.1f", (r.seconds > 0.0) ? r.tiles / r.seconds : 0.0);
+  }
+  std::fprintf(stderr, "\n");
+  return 0;
+}
+
+
+static int Io(const std::string &tileconv, const std::string &folder)
+{
+  static const unsigned NUM_FILES = 3000, REPETITIONS = 3;
+  static const char *engines[] = { "auto", "stdio" };
+
+  // small files, so that opening, reading and writing files dominates
+  std::string ioFolder = folder + "/io", outFolder = folder + "/io-out", encFolder = folder + "/io-enc";
+  ::mkdir(folder.c_str(), 0777);
+  ::mkdir(ioFolder.c_str(), 0777);
+  ::mkdir(outFolder.c_str(), 0777);
+  ::mkdir(encFolder.c_str(), 0777);
+  std::vector<std::string> tisFiles = ListFiles(ioFolder, ".tis");
+  if (tisFiles.size() != NUM_FILES) {
+    GetFolderSize(ioFolder, true);
+    Random rnd(0x10f11e5);
+    char name[64];
+    for (unsigned i = 0; i < NUM_FILES; i++) {
+      Image img;
+      CreateImage(img, TILE_DIM, TILE_DIM, rnd);
+      std::snprintf(name, sizeof(name), "/io%04u.tis", i);
+      if (!WriteTis(ioFolder + name, img)) return 1;
+    }
+    tisFiles = ListFiles(ioFolder, ".tis");
+  }
+
+  GetFolderSize(encFolder, true);
+  if (Execute(tileconv, "prepare", "-t 1 -q -0", tisFiles, encFolder, true).status != 0) {
+    std::fprintf(stderr, "Error running \"%s\"\n", tileconv.c_str());
+    return 1;
+  }
+  std::vector<std::string> tbcFiles = ListFiles(encFolder, ".tbc");
+
+  std::vector<Result> results;
+  for (unsigned r = 0; r < REPETITIONS; r++) {
+    for (unsigned e = 0; e < sizeof(engines) / sizeof(*engines); e++) {
+      std::string engine = std::string("--io-engine ") + engines[e];
+      std::fprintf(stderr, "[%u/%u] %s\n", r+1, REPETITIONS, engine.c_str());
+      results.push_back(Execute(tileconv, "tis-tbc", "-t 1 -q -0 " + engine, tisFiles, outFolder, false));
+      results.push_back(Execute(tileconv, "tbc-tis", "-q 0 " + engine, tbcFiles, outFolder, false));
+    }
+  }
+  GetFolderSize(encFolder, true);
+
+  std::printf("{\n  \"tileconv\": \"%s\",\n  \"timestamp\": %lld,\n  \"mode\": \"io\",\n",
+              tileconv.c_str(), (long long)std::time(nullptr));
+  std::printf("  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    PrintResult(results[i], i + 1 == results.size());
+  }
+  std::printf("  ]\n}\n");
+
+  // best run of each cell
+  std::fprintf(stderr, "\nFiles per second (best of %u runs, %u files):\n  %-8s %12s %12s\n",
+               REPETITIONS, NUM_FILES, "engine", "tis-tbc", "tbc-tis");
+  for (unsigned e = 0; e < sizeof(engines) / sizeof(*engines); e++) {
+    std::fprintf(stderr, "  %-8s", engines[e]);
+    for (unsigned c = 0; c < 2; c++) {
+      double best = 0.0;
+      for (size_t i = e*2 + c; i < results.size(); i += 4) {
+        const Result &r = results[i];
+        if (r.status == 0 && r.seconds > 0.0) best = std::max(best, r.files / r.seconds);
+      }
+      std::fprintf(stderr, " %12.1f", best);
+    }
+    std::fprintf(stderr, "\n");
+  }
+  return 0;
+}
+
+
+// Copies all files of srcFolder into dstFolder
+static bool CopyFiles(const std::string &srcFolder, const std::string &dstFolder)
+{
+  std::vector<std::string> files = ListFiles(srcFolder, "");
+  for (auto iter = files.cbegin(); iter != files.cend(); ++iter) {
+    std::vector<uint8_t> data;
+    if (!ReadFile(*iter, data) || !WriteFile(dstFolder + iter->substr(iter->rfind('/')), data)) return false;
+  }
+  return true;
+}
+
+
+// Converts inFile with the given arguments and returns the content of the output file named outName
+static bool ConvertFile(const std::string &tileconv, const std::string &args, const std::string &inFile,
+                        const std::string &outFolder, const std::string &outName, std::vector<uint8_t> &data)
+{
+  std::vector<std::string> inputs(1, inFile);
+  Result r = Execute(tileconv, "cache", args, inputs, outFolder, true);
+  return (r.status == 0) && ReadFile(outFolder + "/" + outName, data) && !data.empty();
+}
+
+
+static int Cache(const std::string &tileconv, const std::string &folder)
+{
+  // two TIS files of equal layout, converted into PVRZ-based TIS files with equally named pages
+  std::string base = folder + "/cache";
+  std::vector<std::string> folders = { base, base + "/a", base + "/b", base + "/enc", base + "/v2a",
+                                       base + "/v2b", base + "/work", base + "/out", base + "/db" };
+  ::mkdir(folder.c_str(), 0777);
+  for (auto iter = folders.cbegin(); iter != folders.cend(); ++iter) {
+    ::mkdir(iter->c_str(), 0777);
+    if (*iter != base) GetFolderSize(*iter, true);
+  }
+  Random rnd(0xcac4e);
+  for (unsigned i = 0; i < 2; i++) {
+    Image img;
+    CreateImage(img, 4*TILE_DIM, 4*TILE_DIM, rnd);
+    std::string src = base + (i ? "/b" : "/a") + "/ar0100.tis";
+    std::vector<uint8_t> data;
+    if (!WriteTis(src, img) ||
+        !ConvertFile(tileconv, "-t 1", src, base + "/enc", "ar0100.tbc", data) ||
+        !ConvertFile(tileconv, "-p 0", base + "/enc/ar0100.tbc", base + (i ? "/v2b" : "/v2a"), "ar0100.tis", data)) {
+      std::fprintf(stderr, "Error preparing files in \"%s\"\n", base.c_str());
+      return 1;
+    }
+  }
+
+  const std::string cacheArgs = "-t 1 -C " + base + "/db";
+  unsigned failed = 0;
+  std::vector<uint8_t> first, second, reference;
+
+  // unchanged input file is restored from the cache
+  bool pass = ConvertFile(tileconv, cacheArgs, base + "/a/ar0100.tis", base + "/out", "ar0100.tbc", first) &&
+              ConvertFile(tileconv, cacheArgs, base + "/a/ar0100.tis", base + "/out", "ar0100.tbc", second) &&
+              first == second;
+  std::printf("%s: repeated conversion\n", pass ? "PASS" : "FAIL");
+  if (!pass) failed++;
+
+  // PVRZ page replaced, PVRZ-based TIS file unchanged
+  std::string v2File = base + "/work/ar0100.tis";
+  pass = CopyFiles(base + "/v2a", base + "/work") &&
+         ConvertFile(tileconv, cacheArgs, v2File, base + "/out", "ar0100.tbc", first);
+  GetFolderSize(base + "/work", true);
+  pass = pass && CopyFiles(base + "/v2b", base + "/work");
+  if (pass) {
+    // keeping the PVRZ-based TIS file of the first conversion
+    std::vector<uint8_t> data;
+    pass = ReadFile(base + "/v2a/ar0100.tis", data) && WriteFile(v2File, data);
+  }
+  pass = pass && ConvertFile(tileconv, cacheArgs, v2File, base + "/out", "ar0100.tbc", second) &&
+         ConvertFile(tileconv, "-t 1", v2File, base + "/out", "ar0100.tbc", reference) &&
+         first != second && second == reference;
+  std::printf("%s: modified PVRZ page\n", pass ? "PASS" : "FAIL");
+  if (!pass) failed++;
+
+  return failed ? 1 : 0;
+}
+
+
+// Compares palette-expanded TIS tiles with BM32 pixels of the same tiles (argb: {b, g, r, a}).
+// Stores the max. number of unique colors of a tile in maxColors. Returns false if any pixel differs.
+static bool ComparePixels(const std::vector<uint8_t> &tis, const std::vector<uint8_t> &bitmap, unsigned &maxColors)
+{
+  static const size_t TILE_SIZE = 1024 + TILE_DIM*TILE_DIM;
+  maxColors = 0;
+  if (tis.size() < 24 || bitmap.size() < 24 || Get32(&tis[12]) != TILE_SIZE) return false;
+  size_t tiles = (tis.size() - 24) / TILE_SIZE;
+  if (bitmap.size() != 24 + tiles*TILE_DIM*TILE_DIM*4) return false;
+  for (size_t t = 0; t < tiles; t++) {
+    const uint8_t *tile = &tis[24 + t*TILE_SIZE];
+    const uint8_t *pixels = &bitmap[24 + t*TILE_DIM*TILE_DIM*4];
+    std::vector<uint32_t> colors;
+    for (unsigned i = 0; i < TILE_DIM*TILE_DIM; i++) {
+      uint8_t p[4];
+      ExpandPixel(tile, tile[1024+i], p);
+      if (std::memcmp(p, &pixels[i*4], 4) != 0) return false;
+      colors.push_back(Get32(p));
+    }
+    std::sort(colors.begin(), colors.end());
+    maxColors = std::max(maxColors, (unsigned)(std::unique(colors.begin(), colors.end()) - colors.begin()));
+  }
+  return true;
+}
+
+
+static int Exact(const std::string &tileconv, const std::string &folder)
+{
+  // flat regions of a few colors: decoded BC1 tiles keep up to 256 colors
+  std::string base = folder + "/exact";
+  std::vector<std::string> folders = { base, base + "/enc", base + "/out" };
+  ::mkdir(folder.c_str(), 0777);
+  for (auto iter = folders.cbegin(); iter != folders.cend(); ++iter) {
+    ::mkdir(iter->c_str(), 0777);
+    if (*iter != base) GetFolderSize(*iter, true);
+  }
+  Random rnd(0xe8ac7);
+  Image img;
+  img.width = img.height = 8*TILE_DIM;
+  img.pixels.assign(img.width*img.height, 0);
+  CreatePalette(img.palette, 0);
+  for (unsigned r = 0; r < 600; r++) {
+    unsigned w = 4 + rnd.range(24), h = 4 + rnd.range(24);
+    unsigned x0 = rnd.range(img.width), y0 = rnd.range(img.height);
+    uint8_t color = (r % 5 == 0) ? 0 : (uint8_t)(1 + rnd.range(255));
+    for (unsigned y = y0; y < std::min(img.height, y0 + h); y++) {
+      for (unsigned x = x0; x < std::min(img.width, x0 + w); x++) {
+        img.pixels[y*img.width + x] = color;
+      }
+    }
+  }
+  std::string src = base + "/exact.tis";
+  std::vector<uint8_t> data, bitmap;
+  if (!WriteTis(src, img) || !ConvertFile(tileconv, "-t 1", src, base + "/enc", "exact.tbc", data) ||
+      !ConvertFile(tileconv, "-b argb", base + "/enc/exact.tbc", base + "/out", "exact.bm32", bitmap)) {
+    std::fprintf(stderr, "Error preparing files in \"%s\"\n", base.c_str());
+    return 1;
+  }
+
+  // paletted tiles of all decoding levels have to match the decoded 32-bit pixels exactly
+  unsigned failed = 0;
+  for (unsigned level = 0; level <= 9; level++) {
+    unsigned maxColors = 0;
+    bool pass = ConvertFile(tileconv, "-q " + std::to_string(level), base + "/enc/exact.tbc", base + "/out",
+                            "exact.tis", data) &&
+                ComparePixels(data, bitmap, maxColors) && maxColors <= 256;
+    std::printf("%s: decoding level %u (max. %u colors per tile)\n", pass ? "PASS" : "FAIL", level, maxColors);
+    if (!pass) failed++;
+  }
+  return failed ? 1 : 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+  if (argc >= 3 && std::strcmp(argv[1], "generate") == 0) {
+    return Generate(argv[2]);
+  } else if (argc >= 4 && std::strcmp(argv[1], "run") == 0) {
+    return Run(argv[2], argv[3], argc >= 5 && std::strcmp(argv[4], "quick") == 0);
+  } else if (argc >= 4 && std::strcmp(argv[1], "sweep") == 0) {
+    return Sweep(argv[2], argv[3]);
+  } else if (argc >= 4 && std::strcmp(argv[1], "quota") == 0) {
+    return Quota(argv[2], argv[3]);
+  } else if (argc >= 4 && std::strcmp(argv[1], "io") == 0) {
+    return Io(argv[2], argv[3]);
+  } else if (argc >= 4 && std::strcmp(argv[1], "cache") == 0) {
+    return Cache(argv[2], argv[3]);
+  } else if (argc >= 4 && std::strcmp(argv[1], "exact") == 0) {
+    return Exact(argv[2], argv[3]);
+  }
+  std::fprintf(stderr, "Usage: %s generate <folder>\n", argv[0]);
+  std::fprintf(stderr, "       %s run <tileconv> <folder> [quick]\n", argv[0]);
+  std::fprintf(stderr, "       %s sweep <tileconv> <folder>\n", argv[0]);
+  std::fprintf(stderr, "       %s quota <tileconv> <folder>\n", argv[0]);
+  std::fprintf(stderr, "       %s io <tileconv> <folder>\n", argv[0]);
+  std::fprintf(stderr, "       %s cache <tileconv> <folder>\n", argv[0]);
+  std::fprintf(stderr, "       %s exact <tileconv> <folder>\n", argv[0]);
+  return 1;
+}
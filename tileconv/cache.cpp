@@ -0,0 +1,371 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "fileio.h"
+#include "cache.h"
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <dirent.h>
+# include <unistd.h>
+# include <utime.h>
+# include <sys/ioctl.h>
+# ifdef __linux__
+#  include <linux/fs.h>
+# endif
+#endif
+
+namespace tc {
+
+const char ConversionCache::ENTRY_EXT[] = ".tcc";
+const char ConversionCache::TEMP_EXT[]  = ".tmp";
+
+
+ConversionCache::ConversionCache() noexcept
+: m_path()
+, m_maxSize(0)
+, m_curSize(-1)
+, m_hits(0)
+, m_misses(0)
+, m_stored(0)
+, m_evicted(0)
+{
+}
+
+
+ConversionCache::~ConversionCache() noexcept
+{
+}
+
+
+void ConversionCache::setFolder(const std::string &path, uint64_t maxSize) noexcept
+{
+  if (path != m_path) m_curSize = -1;
+  m_path = path;
+  m_maxSize = maxSize;
+}
+
+
+std::string ConversionCache::getEntry(const std::string &inFile, const std::string &params) noexcept
+{
+  static const std::size_t READ_BLOCK = 1 << 20;    // must be a multiple of 8
+
+  if (!isEnabled() || inFile.empty()) return std::string();
+
+  File f(inFile.c_str(), "rb");
+  if (f.error()) return std::string();
+
+  std::vector<uint8_t> buffer(READ_BLOCK);
+  uint64_t hashData = 0, size = 0;
+  std::size_t len;
+  while ((len = f.read(buffer.data(), 1, buffer.size())) > 0) {
+    hashData = Hash(hashData, buffer.data(), len);
+    size += len;
+    if (len < buffer.size()) break;
+  }
+  if (size == 0) return std::string();
+  hashData = HashFinal(hashData, size);
+  uint64_t hashParams = HashFinal(Hash(1, (const uint8_t*)params.data(), params.size()), params.size());
+
+  char name[64];
+  std::snprintf(name, sizeof(name), "%016llx%016llx%s",
+                (unsigned long long)hashData, (unsigned long long)hashParams, ENTRY_EXT);
+  return std::string(name);
+}
+
+
+bool ConversionCache::restore(const std::string &entry, const std::string &outFile) noexcept
+{
+  if (!isEnabled() || entry.empty() || outFile.empty()) return false;
+
+  std::string src = File::CreateFileName(m_path, entry);
+  if (File::GetFileSize(src) < 0) {
+    m_misses++;
+    return false;
+  }
+
+  // discarding previous output, including data queued by the I/O engine
+  if (File::Exists(outFile)) File::RemoveFile(outFile);
+  // entry may be removed by a concurrent process at any time
+  if (!CopyFileContent(src, outFile)) {
+    m_misses++;
+    return false;
+  }
+  TouchFile(src);
+  m_hits++;
+  return true;
+}
+
+
+bool ConversionCache::store(const std::string &entry, const std::string &outFile) noexcept
+{
+  if (!isEnabled() || entry.empty() || outFile.empty()) return false;
+
+  // also writes data queued by the I/O engine to disk
+  long size = File::GetFileSize(outFile);
+  if (size < 0) return false;
+
+  if (m_curSize < 0 && !File::IsDirectory(m_path) && !CreateFolder(m_path)) return false;
+
+  std::string dst = File::CreateFileName(m_path, entry);
+  std::string tmp = dst + GetTempSuffix() + TEMP_EXT;
+  if (!CopyFileContent(outFile, tmp)) return false;
+  if (!CommitFile(tmp, dst)) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  m_stored++;
+
+  if (m_curSize >= 0) m_curSize += size;
+  if (m_maxSize > 0 && (m_curSize < 0 || (uint64_t)m_curSize > m_maxSize)) evict();
+  return true;
+}
+
+
+std::string ConversionCache::getStatistics() const noexcept
+{
+  char buf[128];
+  std::snprintf(buf, sizeof(buf), "%u hits, %u misses, %u stored, %u evicted",
+                m_hits, m_misses, m_stored, m_evicted);
+  return std::string(buf);
+}
+
+
+void ConversionCache::evict() noexcept
+{
+  static const int64_t TEMP_EXPIRATION = 3600;    // in seconds
+
+  std::vector<EntryInfo> entries;
+  if (!ListFolder(m_path, entries)) return;
+
+  // other files in the cache folder are left alone
+  int64_t now = (int64_t)std::time(nullptr);
+  uint64_t total = 0;
+  for (auto iter = entries.begin(); iter != entries.end(); ) {
+    std::string ext = File::ExtractFileExt(iter->name);
+    if (ext == ENTRY_EXT) {
+      total += iter->size;
+      ++iter;
+    } else {
+      // removing leftovers of aborted processes
+      if (ext == TEMP_EXT && now - iter->time > TEMP_EXPIRATION) {
+        std::remove(File::CreateFileName(m_path, iter->name).c_str());
+      }
+      iter = entries.erase(iter);
+    }
+  }
+
+  if (m_maxSize > 0 && total > m_maxSize) {
+    // evicting a few more entries to reduce the number of evictions
+    uint64_t limit = m_maxSize - m_maxSize / 10;
+    std::sort(entries.begin(), entries.end(),
+              [](const EntryInfo &a, const EntryInfo &b) { return a.time < b.time; });
+    for (auto iter = entries.cbegin(); iter != entries.cend() && total > limit; ++iter) {
+      if (std::remove(File::CreateFileName(m_path, iter->name).c_str()) == 0) {
+        total -= iter->size;
+        m_evicted++;
+      }
+    }
+  }
+  m_curSize = (int64_t)total;
+}
+
+
+uint64_t ConversionCache::Hash(uint64_t h, const uint8_t *data, std::size_t size) noexcept
+{
+  static const uint64_t PRIME1 = 0x9e3779b185ebca87ULL;
+  static const uint64_t PRIME2 = 0xc2b2ae3d27d4eb4fULL;
+
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t k;
+    std::memcpy(&k, data + i, 8);
+    k *= PRIME2;
+    k = (k << 31) | (k >> 33);
+    k *= PRIME1;
+    h ^= k;
+    h = ((h << 27) | (h >> 37)) * PRIME1 + 0x85ebca77c2b2ae63ULL;
+  }
+  for (; i < size; i++) {
+    h ^= data[i] * PRIME1;
+    h = ((h << 11) | (h >> 53)) * PRIME2;
+  }
+  return h;
+}
+
+
+uint64_t ConversionCache::HashFinal(uint64_t h, uint64_t totalSize) noexcept
+{
+  h ^= totalSize * 0x9e3779b185ebca87ULL;
+  h ^= h >> 33;
+  h *= 0xc2b2ae3d27d4eb4fULL;
+  h ^= h >> 29;
+  h *= 0x165667b19e3779f9ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+
+bool ConversionCache::CopyFileContent(const std::string &src, const std::string &dst) noexcept
+{
+  std::FILE *fin = std::fopen(src.c_str(), "rb");
+  if (fin == nullptr) return false;
+  std::FILE *fout = std::fopen(dst.c_str(), "wb");
+  if (fout == nullptr) {
+    std::fclose(fin);
+    return false;
+  }
+
+  bool retVal = true;
+#ifdef FICLONE
+  // sharing data blocks is much faster than copying (e.g. btrfs, xfs)
+  if (::ioctl(fileno(fout), FICLONE, fileno(fin)) == 0) {
+    std::fclose(fin);
+    return (std::fclose(fout) == 0);
+  }
+#endif
+  std::vector<char> buffer(1 << 16);
+  std::size_t len;
+  while ((len = std::fread(buffer.data(), 1, buffer.size(), fin)) > 0) {
+    if (std::fwrite(buffer.data(), 1, len, fout) != len) {
+      retVal = false;
+      break;
+    }
+  }
+  if (std::ferror(fin)) retVal = false;
+  std::fclose(fin);
+  if (std::fclose(fout) != 0) retVal = false;
+  if (!retVal) std::remove(dst.c_str());
+  return retVal;
+}
+
+
+std::string ConversionCache::GetTempSuffix() noexcept
+{
+  static std::atomic<unsigned> counter(0);
+#ifdef _WIN32
+  unsigned long pid = ::GetCurrentProcessId();
+#else
+  unsigned long pid = (unsigned long)::getpid();
+#endif
+  return "." + std::to_string(pid) + "." + std::to_string(counter++);
+}
+
+
+#ifdef _WIN32
+
+bool ConversionCache::CreateFolder(const std::string &path) noexcept
+{
+  return ::CreateDirectoryA(path.c_str(), NULL) || ::GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+
+bool ConversionCache::CommitFile(const std::string &src, const std::string &dst) noexcept
+{
+  return ::MoveFileExA(src.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+
+void ConversionCache::TouchFile(const std::string &fileName) noexcept
+{
+  HANDLE h = ::CreateFileA(fileName.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           NULL, OPEN_EXISTING, 0, NULL);
+  if (h != INVALID_HANDLE_VALUE) {
+    FILETIME ft;
+    ::GetSystemTimeAsFileTime(&ft);
+    ::SetFileTime(h, NULL, NULL, &ft);
+    ::CloseHandle(h);
+  }
+}
+
+
+bool ConversionCache::ListFolder(const std::string &path, std::vector<EntryInfo> &entries) noexcept
+{
+  WIN32_FIND_DATAA data;
+  HANDLE h = ::FindFirstFileA(File::CreateFileName(path, "*").c_str(), &data);
+  if (h == INVALID_HANDLE_VALUE) return false;
+  do {
+    if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+      EntryInfo info;
+      info.name = data.cFileName;
+      info.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+      // converting FILETIME into seconds since 1970-01-01
+      uint64_t t = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+      info.time = (int64_t)(t / 10000000ULL) - 11644473600LL;
+      entries.push_back(info);
+    }
+  } while (::FindNextFileA(h, &data));
+  ::FindClose(h);
+  return true;
+}
+
+#else
+
+bool ConversionCache::CreateFolder(const std::string &path) noexcept
+{
+  return ::mkdir(path.c_str(), 0777) == 0 || errno == EEXIST;
+}
+
+
+bool ConversionCache::CommitFile(const std::string &src, const std::string &dst) noexcept
+{
+  // atomic on POSIX systems, concurrent readers see either the old or new entry
+  return std::rename(src.c_str(), dst.c_str()) == 0;
+}
+
+
+void ConversionCache::TouchFile(const std::string &fileName) noexcept
+{
+  ::utime(fileName.c_str(), nullptr);
+}
+
+
+bool ConversionCache::ListFolder(const std::string &path, std::vector<EntryInfo> &entries) noexcept
+{
+  DIR *dir = ::opendir(path.c_str());
+  if (dir == nullptr) return false;
+  struct dirent *de;
+  while ((de = ::readdir(dir)) != nullptr) {
+    struct stat s;
+    std::string fileName = File::CreateFileName(path, de->d_name);
+    if (::stat(fileName.c_str(), &s) == 0 && S_ISREG(s.st_mode)) {
+      EntryInfo info;
+      info.name = de->d_name;
+      info.size = (uint64_t)s.st_size;
+      info.time = (int64_t)s.st_mtime;
+      entries.push_back(info);
+    }
+  }
+  ::closedir(dir);
+  return true;
+}
+
+#endif
+
+}   // namespace tc
@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _CACHE_H_
+#define _CACHE_H_
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tc {
+
+/**
+ * On-disk cache of conversion results. Entries are keyed by a hash of the input file content and
+ * the options of the conversion. Output files are restored from the cache by copies, which are
+ * cloned without copying data on file systems supporting it. Entries are created atomically, so
+ * several processes can share the cache folder. Least recently used entries are removed if the cache exceeds its max. size.
+ */
+class ConversionCache
+{
+public:
+  ConversionCache() noexcept;
+  ~ConversionCache() noexcept;
+
+  /** Cache folder and max. size in bytes (0: unlimited). An empty path disables the cache. */
+  void setFolder(const std::string &path, uint64_t maxSize) noexcept;
+  const std::string& getFolder() const noexcept { return m_path; }
+  bool isEnabled() const noexcept { return !m_path.empty(); }
+
+  /**
+   * Returns the name of the cache entry for inFile converted with the specified parameters.
+   * Returns an empty string on error.
+   */
+  std::string getEntry(const std::string &inFile, const std::string &params) noexcept;
+
+  /** Restores outFile from the specified cache entry. Returns false if the entry doesn't exist. */
+  bool restore(const std::string &entry, const std::string &outFile) noexcept;
+
+  /** Adds outFile to the cache as the specified entry. Removes old entries if needed. */
+  bool store(const std::string &entry, const std::string &outFile) noexcept;
+
+  /** Statistics of all cache operations of this object. */
+  unsigned getHits() const noexcept { return m_hits; }
+  unsigned getMisses() const noexcept { return m_misses; }
+  unsigned getStored() const noexcept { return m_stored; }
+  unsigned getEvicted() const noexcept { return m_evicted; }
+  /** Returns a one-line summary of the statistics. */
+  std::string getStatistics() const noexcept;
+
+private:
+  struct EntryInfo
+  {
+    std::string name;
+    uint64_t    size;
+    int64_t     time;     // time of last modification
+  };
+
+  // Incremental 64-bit hash. size must be a multiple of 8 except for the last call.
+  static uint64_t Hash(uint64_t h, const uint8_t *data, std::size_t size) noexcept;
+  // Final mixing step of Hash()
+  static uint64_t HashFinal(uint64_t h, uint64_t totalSize) noexcept;
+
+  // Platform-specific file system functions
+  static bool CreateFolder(const std::string &path) noexcept;
+  // Copies src to dst. Clones the file content if supported by the file system.
+  static bool CopyFileContent(const std::string &src, const std::string &dst) noexcept;
+  static bool CommitFile(const std::string &src, const std::string &dst) noexcept;
+  static void TouchFile(const std::string &fileName) noexcept;
+  static bool ListFolder(const std::string &path, std::vector<EntryInfo> &entries) noexcept;
+  // Returns a name for temporary files which is unique across processes
+  static std::string GetTempSuffix() noexcept;
+
+  // Removes least recently used entries until the cache fits into its size limit
+  void evict() noexcept;
+
+private:
+  static const char ENTRY_EXT[];    // file extension of cache entries
+  static const char TEMP_EXT[];     // file extension of incomplete cache entries
+
+  std::string m_path;       // cache folder
+  uint64_t    m_maxSize;    // max. size of the cache folder in bytes (0: unlimited)
+  int64_t     m_curSize;    // estimated size of the cache folder (-1: unknown)
+  unsigned    m_hits;
+  unsigned    m_misses;
+  unsigned    m_stored;
+  unsigned    m_evicted;
+};
+
+}   // namespace tc
+
+#endif		// _CACHE_H_
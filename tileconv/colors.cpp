@@ -19,6 +19,7 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+#include <algorithm>
 #include <limits>
 #include <cmath>
 #include <cstring>
@@ -27,9 +28,48 @@ THE SOFTWARE.
 #include "colors.h"
 #include "colorquant.h"
 #include "funcs.h"
+#include "logger.h"
+#include "stats.h"
 
 namespace tc {
 
+const uint16_t ColorTable::EMPTY = 0xffff;
+
+ColorTable::ColorTable() noexcept
+: m_count(0)
+{
+  std::fill(m_values, m_values + HASH_SIZE, EMPTY);
+}
+
+
+int ColorTable::add(uint32_t color) noexcept
+{
+  unsigned slot = getSlot(color);
+  if (m_values[slot] == EMPTY) {
+    if (m_count == MAX_COLORS) return -1;
+    m_keys[slot] = color;
+    m_values[slot] = m_count;
+    m_colors[m_count++] = color;
+  }
+  return m_values[slot];
+}
+
+
+unsigned ColorTable::find(uint32_t color) const noexcept
+{
+  return m_values[getSlot(color)];
+}
+
+
+unsigned ColorTable::getSlot(uint32_t color) const noexcept
+{
+  // open addressing with linear probing, the table is never filled by more than a quarter
+  unsigned slot = (color * 2654435761u) & (HASH_SIZE - 1);
+  while (m_values[slot] != EMPTY && m_keys[slot] != color) slot = (slot + 1) & (HASH_SIZE - 1);
+  return slot;
+}
+
+
 Colors::Colors(const Options &options) noexcept
 : m_options(options)
 {
@@ -42,6 +82,8 @@ Colors::~Colors() noexcept
 int Colors::palToARGB(uint8_t *src, uint8_t *palette, uint8_t *dst, uint32_t size) noexcept
 {
   if (src != nullptr && palette != nullptr && dst != nullptr && size > 0) {
+    Stats::Timer timer(Stats::Stage::EXPAND, size);
+    timer.setBytesOut(size*4);
     for (uint32_t i = 0; i < size; i++, src++, dst += 4) {
       uint32_t ofs = (uint32_t)src[0] << 2;
       if (src[0] || get32u_le((uint32_t*)palette) != 0x0000ff00) {
@@ -58,11 +100,38 @@ int Colors::palToARGB(uint8_t *src, uint8_t *palette, uint8_t *dst, uint32_t siz
   return 0;
 }
 
+bool Colors::hasTransparency(const uint8_t *src, const uint8_t *palette, uint32_t size) const noexcept
+{
+  if (src != nullptr && palette != nullptr &&
+      get32u_le((const uint32_t*)palette) == 0x0000ff00) {
+    for (uint32_t i = 0; i < size; i++) {
+      if (src[i] == 0) return true;
+    }
+  }
+  return false;
+}
+
+bool Colors::hasTransparency(const uint8_t *src, uint32_t size) const noexcept
+{
+  if (src != nullptr) {
+    for (uint32_t i = 0; i < size; i++, src += 4) {
+      if (src[3] != 255) return true;
+    }
+  }
+  return false;
+}
+
+
 int Colors::ARGBToPal(uint8_t *src, uint8_t *dst, uint8_t *palette,
                       uint32_t width, uint32_t height) noexcept
 {
   if (src != nullptr && dst != nullptr && palette != nullptr && width > 0 && height > 0) {
     uint32_t size = width*height;
+    Stats::Timer timer(Stats::Stage::QUANTIZE, size*4);
+    timer.setBytesOut(size + 1024);
+
+    // no need to quantize if colors fit into the palette
+    if (ARGBToPalExact(src, dst, palette, size)) return size;
 
     // preparing source pixels
     Converter::ReorderColors(src, size, Converter::ColorFormat::ARGB, Converter::ColorFormat::ABGR);
@@ -79,15 +148,15 @@ int Colors::ARGBToPal(uint8_t *src, uint8_t *dst, uint8_t *palette,
       double qerr = quant.getQuantizationError();
       if (qerr >= 0.0) {
         if (qerr <= 5.0) {
-          std::printf("Color quantization applied. Error ratio: %.2f (excellent!)\n", qerr);
+          Logger::Print("Color quantization applied. Error ratio: %.2f (excellent!)\n", qerr);
         } else if (qerr <= 10.0) {
-          std::printf("Color quantization applied. Error ratio: %.2f (good)\n", qerr);
+          Logger::Print("Color quantization applied. Error ratio: %.2f (good)\n", qerr);
         } else if (qerr <= 30.0) {
-          std::printf("Color quantization applied. Error ratio: %.2f (average)\n", qerr);
+          Logger::Print("Color quantization applied. Error ratio: %.2f (average)\n", qerr);
         } else if (qerr < 75.0) {
-          std::printf("Color quantization applied. Error ratio: %.2f (bad!)\n", qerr);
+          Logger::Print("Color quantization applied. Error ratio: %.2f (bad!)\n", qerr);
         } else {
-          std::printf("Color quantization applied. Error ratio: %.2f (awful!!!)\n", qerr);
+          Logger::Print("Color quantization applied. Error ratio: %.2f (awful!!!)\n", qerr);
         }
       }
     }
@@ -98,4 +167,51 @@ int Colors::ARGBToPal(uint8_t *src, uint8_t *dst, uint8_t *palette,
   return 0;
 }
 
+
+bool Colors::ARGBToPalExact(const uint8_t *src, uint8_t *dst, uint8_t *palette, uint32_t size) const noexcept
+{
+  static const uint32_t GREEN = 0x0000ff00;   // color of transparent palette index 0
+
+  // unique RGB colors of opaque pixels
+  ColorTable table;
+  bool hasAlpha = false, hasGreen = false;
+  const uint8_t *p = src;
+  for (uint32_t i = 0; i < size; i++, p += 4) {
+    if (p[3] != 255) { hasAlpha = true; continue; }
+    uint32_t color = get32u_le((const uint32_t*)p) & 0x00ffffff;
+    if (table.add(color) < 0) return false;
+    if (color == GREEN) hasGreen = true;
+  }
+  unsigned numColors = table.size();
+
+  // index 0 is reserved for transparent pixels, or to prevent opaque green from being treated as transparent
+  unsigned base = (hasAlpha || hasGreen) ? 1 : 0;
+  if (numColors + base > 256) return false;
+
+  std::memset(palette, 0, 1024);
+  if (hasAlpha) {
+    uint32_t v = get32u_le(&GREEN);
+    std::memcpy(palette, &v, 4);
+  }
+  for (unsigned i = 0; i < numColors; i++) {
+    uint32_t v = table.getColor(i);
+    v = get32u_le(&v);
+    std::memcpy(palette + ((base + i) << 2), &v, 4);
+  }
+
+  p = src;
+  for (uint32_t i = 0; i < size; i++, p += 4) {
+    if (p[3] != 255) {
+      dst[i] = 0;
+    } else {
+      dst[i] = base + table.find(get32u_le((const uint32_t*)p) & 0x00ffffff);
+    }
+  }
+
+  if (getOptions().isVerbose()) {
+    Logger::Print("Color quantization skipped. Unique colors: %d\n", numColors + (hasAlpha ? 1 : 0));
+  }
+  return true;
+}
+
 }   // namespace tc
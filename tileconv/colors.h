@@ -26,6 +26,45 @@ THE SOFTWARE.
 
 namespace tc {
 
+/**
+ * Hash table of up to MAX_COLORS unique 32-bit colors. Colors are numbered in the order they
+ * have been added. Used to count the colors of tiles and to build exact palettes.
+ */
+class ColorTable
+{
+public:
+  static const unsigned MAX_COLORS = 256;
+
+public:
+  ColorTable() noexcept;
+
+  /** Adds color if it is not in the table yet. Returns the number of the color or -1 if the table is full. */
+  int add(uint32_t color) noexcept;
+
+  /** Returns the number of a color that has been added before. */
+  unsigned find(uint32_t color) const noexcept;
+
+  /** Returns the number of unique colors in the table. */
+  unsigned size() const noexcept { return m_count; }
+
+  /** Returns the color with the specified number. */
+  uint32_t getColor(unsigned index) const noexcept { return m_colors[index]; }
+
+private:
+  // Returns the slot containing color or the free slot for color
+  unsigned getSlot(uint32_t color) const noexcept;
+
+private:
+  static const unsigned HASH_SIZE = 1024;   // number of slots, a power of two
+  static const uint16_t EMPTY;              // number of an unused slot
+
+  uint32_t  m_keys[HASH_SIZE];
+  uint16_t  m_values[HASH_SIZE];            // numbers of the colors in m_keys
+  uint32_t  m_colors[MAX_COLORS];
+  unsigned  m_count;
+};
+
+
 /** Provides functions for colorspace reduction and expansion. */
 class Colors
 {
@@ -43,8 +82,25 @@ class Colors
    */
   int palToARGB(uint8_t *src, uint8_t *palette, uint8_t *dst, uint32_t size) noexcept;
 
+  /**
+   * Returns whether the given 8-bit paletted data block contains transparent pixels.
+   * (Transparency is indicated by palette index 0 set to green.)
+   * \param src Data block containing 8-bit color indices.
+   * \param palette A color table of 256 entries using ARGB component order.
+   * \param size Number of pixels in the source block.
+   */
+  bool hasTransparency(const uint8_t *src, const uint8_t *palette, uint32_t size) const noexcept;
+
+  /**
+   * Returns whether the given 32-bit ARGB data block contains pixels that are not fully opaque.
+   * \param src Data block containing 32-bit ARGB pixels. (Note: ARGB = {b, g, r, a, ...})
+   * \param size Number of pixels in the source block.
+   */
+  bool hasTransparency(const uint8_t *src, uint32_t size) const noexcept;
+
   /**
    * Converts a 32-bit ARGB data block into a 8-bit paletted data block.
+   * Blocks with no more than 256 unique colors are converted without color quantization.
    * \param src Data block containing 32-bit ARGB pixels. (Note: ARGB = {b, g, r, a, ...})
    * \param dst Data block to store the resulting 8-bit indices into.
    * \param palette A ARGB color table to store 256 entries into. (Note: ARGB = {b, g, r, a, ...})
@@ -57,6 +113,10 @@ class Colors
   /** Read-only access to Options structure. */
   const Options& getOptions() const noexcept { return m_options; }
 
+private:
+  // Converts pixels without color quantization. Returns false if there are too many unique colors.
+  bool ARGBToPalExact(const uint8_t *src, uint8_t *dst, uint8_t *palette, uint32_t size) const noexcept;
+
 private:
   const Options&    m_options;
 };
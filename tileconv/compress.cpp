@@ -19,10 +19,22 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "funcs.h"
 #include "compress.h"
+#include "stats.h"
+#include "tilethreadpool_base.h"
 
 namespace tc {
 
+const uint32_t Compression::DEFLATE_CHUNK_SIZE  = 131072;
+const uint32_t Compression::DEFLATE_DICT_SIZE   = 32768;
+
+const uint32_t InflateStream::INPUT_SIZE  = 16384;
+const uint32_t InflateStream::WINDOW_SIZE = 65536;
+
 Compression::Compression() noexcept
 : m_defResult(false)
 , m_infResult(false)
@@ -54,12 +66,14 @@ Compression::~Compression() noexcept
 uint32_t Compression::deflate(uint8_t *src, uint32_t srcSize, uint8_t *dst, uint32_t dstSize) noexcept
 {
   if (m_defResult && src != nullptr && dst != nullptr && srcSize > 0 && dstSize > 0) {
+    Stats::Timer timer(Stats::Stage::DEFLATE, srcSize);
     m_defStream.avail_in = srcSize;
     m_defStream.next_in = src;
     m_defStream.avail_out = dstSize;
     m_defStream.next_out = dst;
     m_defResult = (::deflate(&m_defStream, Z_FINISH) != Z_STREAM_ERROR);
     uint32_t retVal = dstSize - m_defStream.avail_out;
+    timer.setBytesOut(retVal);
     deflateReset(&m_defStream);
     return retVal;
   }
@@ -69,16 +83,199 @@ uint32_t Compression::deflate(uint8_t *src, uint32_t srcSize, uint8_t *dst, uint
 uint32_t Compression::inflate(uint8_t *src, uint32_t srcSize, uint8_t *dst, uint32_t dstSize) noexcept
 {
   if (m_infResult && src != nullptr && dst != nullptr && srcSize > 0&& dstSize > 0) {
+    Stats::Timer timer(Stats::Stage::INFLATE, srcSize);
     m_infStream.avail_in = srcSize;
     m_infStream.next_in = src;
     m_infStream.avail_out = dstSize;
     m_infStream.next_out = dst;
     m_defResult = (::inflate(&m_infStream, Z_NO_FLUSH) != Z_STREAM_ERROR);
     uint32_t retVal = dstSize - m_infStream.avail_out;
+    timer.setBytesOut(retVal);
     inflateReset(&m_infStream);
     return retVal;
   }
   return 0;
 }
 
+uint32_t Compression::DeflateParallel(File &fout, const uint8_t *src, uint32_t srcSize, TileThreadPool *pool) noexcept
+{
+  if (src != nullptr && srcSize > 0) {
+    unsigned threads = (pool != nullptr) ? std::max(1u, pool->getThreadCount()) : 1;
+    uint32_t numChunks = (srcSize + DEFLATE_CHUNK_SIZE - 1) / DEFLATE_CHUNK_SIZE;
+    uint32_t outSize = 0;
+
+    // writing zlib header (deflate, 32K window, max. compression)
+    static const uint8_t header[2] = {0x78, 0xda};
+    if (fout.write(header, 1, 2) != 2) return 0;
+    outSize += 2;
+
+    // compressing chunks in batches of "threads" chunks, fewer if the memory budget is exceeded
+    uLong adler = adler32(0L, Z_NULL, 0);
+    std::vector<DeflateChunk> chunks(std::min(threads, numChunks));
+    for (uint32_t chunkIdx = 0; chunkIdx < numChunks; ) {
+      unsigned count = std::min((uint32_t)chunks.size(), numChunks - chunkIdx);
+      while (count > 1 && (uint64_t)count*DEFLATE_CHUNK_SIZE > MemoryBudget::GetAvailable()) {
+        count--;
+      }
+      for (unsigned i = 0; i < count; i++) {
+        uint32_t ofs = (chunkIdx + i) * DEFLATE_CHUNK_SIZE;
+        DeflateChunk &chunk = chunks[i];
+        chunk.src = src + ofs;
+        chunk.srcSize = std::min(DEFLATE_CHUNK_SIZE, srcSize - ofs);
+        chunk.dictSize = std::min(DEFLATE_DICT_SIZE, ofs);
+        chunk.dict = src + ofs - chunk.dictSize;
+        chunk.last = (chunkIdx + i + 1 == numChunks);
+        chunk.result = false;
+      }
+
+      if (pool != nullptr) {
+        pool->runParallel(count, [&chunks](unsigned i) { DeflateChunkMain(&chunks[i]); });
+      } else {
+        DeflateChunkMain(&chunks[0]);
+      }
+
+      // writing chunks in order
+      for (unsigned i = 0; i < count; i++) {
+        DeflateChunk &chunk = chunks[i];
+        if (!chunk.result) return 0;
+        if (fout.write(chunk.dst.get(), 1, chunk.dstSize) != chunk.dstSize) return 0;
+        outSize += chunk.dstSize;
+        adler = adler32_combine(adler, chunk.adler, chunk.srcSize);
+        chunk.dst.reset();
+        chunk.memory.reset(0);
+      }
+      chunkIdx += count;
+    }
+
+    // writing zlib trailer (big endian Adler-32 checksum)
+    uint32_t v32 = (uint32_t)adler;
+    v32 = get32u_be(&v32);
+    if (fout.write(&v32, 4, 1) != 1) return 0;
+    outSize += 4;
+
+    return outSize;
+  }
+  return 0;
+}
+
+
+void Compression::DeflateChunkMain(DeflateChunk *chunk) noexcept
+{
+  z_stream stream;
+  stream.zalloc = Z_NULL;
+  stream.zfree = Z_NULL;
+  stream.opaque = Z_NULL;
+  if (deflateInit2(&stream, 9, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return;
+  Stats::Timer timer(Stats::Stage::DEFLATE, chunk->srcSize);
+
+  if (chunk->dictSize > 0) {
+    deflateSetDictionary(&stream, chunk->dict, chunk->dictSize);
+  }
+
+  // sync flush adds up to two empty blocks to the regular bound
+  uint32_t size = deflateBound(&stream, chunk->srcSize) + 16;
+  chunk->dst.reset(new uint8_t[size], std::default_delete<uint8_t[]>());
+  chunk->memory.reset(size);
+  stream.next_in = (Bytef*)chunk->src;
+  stream.avail_in = chunk->srcSize;
+  stream.next_out = chunk->dst.get();
+  stream.avail_out = size;
+  int ret = ::deflate(&stream, chunk->last ? Z_FINISH : Z_SYNC_FLUSH);
+  if (chunk->last) {
+    chunk->result = (ret == Z_STREAM_END);
+  } else {
+    // chunk ends on a byte boundary without terminating the deflate stream
+    chunk->result = (ret == Z_OK && stream.avail_in == 0 && stream.avail_out > 0);
+  }
+  chunk->dstSize = size - stream.avail_out;
+  timer.setBytesOut(chunk->dstSize);
+  chunk->adler = adler32(adler32(0L, Z_NULL, 0), chunk->src, chunk->srcSize);
+  deflateEnd(&stream);
+}
+
+
+InflateStream::InflateStream(File &file, uint32_t size) noexcept
+: m_file(file)
+, m_result(false)
+, m_finished(false)
+, m_stream()
+, m_input(new uint8_t[INPUT_SIZE], std::default_delete<uint8_t[]>())
+, m_window(new uint8_t[WINDOW_SIZE], std::default_delete<uint8_t[]>())
+, m_windowSize(WINDOW_SIZE)
+, m_size(size)
+, m_base(0)
+, m_start(0)
+, m_end(0)
+, m_memory(INPUT_SIZE + WINDOW_SIZE)
+{
+  m_stream.zalloc = Z_NULL;
+  m_stream.zfree = Z_NULL;
+  m_stream.opaque = Z_NULL;
+  m_stream.avail_in = 0;
+  m_stream.next_in = Z_NULL;
+  m_result = (inflateInit(&m_stream) == Z_OK);
+}
+
+InflateStream::~InflateStream() noexcept
+{
+  inflateEnd(&m_stream);
+}
+
+const uint8_t* InflateStream::getData(uint32_t ofs, uint32_t size) noexcept
+{
+  if (ofs >= m_start && ofs <= m_size && size <= m_size - ofs && fill(ofs + size)) {
+    return m_window.get() + (ofs - m_base);
+  }
+  return nullptr;
+}
+
+void InflateStream::discard(uint32_t ofs) noexcept
+{
+  m_start = std::max(m_start, std::min(ofs, m_end));
+}
+
+bool InflateStream::fill(uint32_t endOfs) noexcept
+{
+  if (endOfs <= m_end) return true;
+
+  if (endOfs - m_base > m_windowSize) {
+    // moving retained data to the start of the window
+    std::memmove(m_window.get(), m_window.get() + (m_start - m_base), m_end - m_start);
+    m_base = m_start;
+    if (endOfs - m_base > m_windowSize) {
+      // window must grow
+      uint32_t size = std::max(endOfs - m_base, m_windowSize*2);
+      BytePtr window(new uint8_t[size], std::default_delete<uint8_t[]>());
+      std::memcpy(window.get(), m_window.get(), m_end - m_base);
+      m_window = window;
+      m_windowSize = size;
+      m_memory.reset(INPUT_SIZE + size);
+    }
+  }
+
+  // decompressing as much data as fits into the window
+  m_stream.next_out = m_window.get() + (m_end - m_base);
+  m_stream.avail_out = m_windowSize - (m_end - m_base);
+  while (m_result && !m_finished && m_end < endOfs) {
+    if (m_stream.avail_in == 0) {
+      uint32_t size = m_file.read(m_input.get(), 1, INPUT_SIZE);
+      if (size == 0) break;
+      m_stream.next_in = m_input.get();
+      m_stream.avail_in = size;
+    }
+    Stats::Timer timer(Stats::Stage::INFLATE);
+    uint32_t avail = m_stream.avail_out, availIn = m_stream.avail_in;
+    int ret = ::inflate(&m_stream, Z_NO_FLUSH);
+    timer.setBytesIn(availIn - m_stream.avail_in);
+    timer.setBytesOut(avail - m_stream.avail_out);
+    if (ret == Z_STREAM_END) {
+      m_finished = true;
+    } else if (ret != Z_OK) {
+      m_result = false;
+    }
+    m_end += avail - m_stream.avail_out;
+  }
+  return m_end >= endOfs;
+}
+
 }   // namespace tc
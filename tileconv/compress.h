@@ -23,10 +23,16 @@ THE SOFTWARE.
 #define COMPRESS_H
 
 #include <cstdint>
+#include <memory>
 #include <zlib.h>
+#include "types.h"
+#include "fileio.h"
+#include "membudget.h"
 
 namespace tc {
 
+class TileThreadPool;
+
 /** Provides zlib compression and decompression routines. */
 class Compression
 {
@@ -54,13 +60,101 @@ class Compression
    */
   uint32_t inflate(uint8_t *src, uint32_t srcSize, uint8_t *dst, uint32_t dstSize) noexcept;
 
+  /**
+   * Applies zlib compression to a source data block in parallel and writes the result to a file.
+   * Data is split into chunks which are compressed independently (using the tail of the preceding
+   * chunk as dictionary) and joined into a single zlib stream.
+   * \param fout The file to write the compressed data to.
+   * \param src The source data block with raw data.
+   * \param srcSize The number of bytes to compress.
+   * \param pool Idle worker threads of this thread pool compress chunks together with the calling
+   *             thread. Chunks are compressed sequentially if null pointer.
+   * \return The size of the compressed data written to the file or 0 on error.
+   */
+  static uint32_t DeflateParallel(File &fout, const uint8_t *src, uint32_t srcSize, TileThreadPool *pool) noexcept;
+
 private:
+  // Compression state of a single chunk used by DeflateParallel()
+  struct DeflateChunk {
+    const uint8_t *src;       // chunk data
+    uint32_t      srcSize;
+    const uint8_t *dict;      // preceding data used as dictionary
+    uint32_t      dictSize;
+    bool          last;       // whether to terminate the deflate stream
+    BytePtr       dst;        // compressed chunk data
+    uint32_t      dstSize;
+    uint32_t      adler;      // Adler-32 checksum of the chunk data
+    bool          result;
+    MemoryBudget::Reservation memory;   // accounted size of dst
+  };
+
+  // Compresses a single chunk into a raw deflate stream
+  static void DeflateChunkMain(DeflateChunk *chunk) noexcept;
+
+  static const uint32_t DEFLATE_CHUNK_SIZE;   // size of chunks compressed by DeflateParallel()
+  static const uint32_t DEFLATE_DICT_SIZE;    // size of the dictionary taken from the preceding chunk
+
   bool      m_defResult;    // stores the current state of the compressor
   bool      m_infResult;    // stores the current state of the decompressor
   z_stream  m_defStream;    // working structure for deflate
   z_stream  m_infStream;    // working structure for inflate
 };
 
+
+/**
+ * Decompresses a zlib compressed data stream from a file on demand. Decompressed data is kept in
+ * a sliding window, so only the requested portions of the stream have to be held in memory.
+ */
+class InflateStream
+{
+public:
+  /**
+   * Compressed data is read from the current position of the specified file.
+   * \param file The file providing compressed data.
+   * \param size Declared size of the decompressed data. Data beyond this size is not made available.
+   */
+  InflateStream(File &file, uint32_t size) noexcept;
+  ~InflateStream() noexcept;
+
+  /**
+   * Returns a pointer to the specified range of decompressed data. Data is decompressed as needed.
+   * \param ofs Offset into the decompressed data stream. Must not be lower than the offset of previously discarded data.
+   * \param size Number of bytes to make available.
+   * \return A pointer to the decompressed data at the specified offset which is valid until the next call
+   *         of getData(), or nullptr on error or if the range exceeds the declared size.
+   */
+  const uint8_t* getData(uint32_t ofs, uint32_t size) noexcept;
+
+  /** Releases all decompressed data below the specified offset. */
+  void discard(uint32_t ofs) noexcept;
+
+  /** Returns whether an error occurred while reading or decompressing data. */
+  bool isError() const noexcept { return !m_result; }
+
+private:
+  // Decompresses data until the window contains all data up to the specified offset
+  bool fill(uint32_t endOfs) noexcept;
+
+private:
+  static const uint32_t INPUT_SIZE;     // size of the compressed data buffer
+  static const uint32_t WINDOW_SIZE;    // initial size of the sliding window
+
+  File     &m_file;
+  bool      m_result;       // stores the current state of the decompressor
+  bool      m_finished;     // end of compressed data stream reached
+  z_stream  m_stream;       // working structure for inflate
+  BytePtr   m_input;        // buffer for compressed data
+  BytePtr   m_window;       // buffer for decompressed data
+  uint32_t  m_windowSize;   // size of m_window
+  uint32_t  m_size;         // declared size of the decompressed data
+  uint32_t  m_base;         // stream offset of the first byte in m_window
+  uint32_t  m_start;        // stream offset of the first byte that has not been discarded
+  uint32_t  m_end;          // stream offset behind the last decompressed byte
+  MemoryBudget::Reservation m_memory;   // accounted size of input buffer and window
+};
+
+typedef std::shared_ptr<InflateStream> InflateStreamPtr;
+
 }   // namespace tc
 
 #endif
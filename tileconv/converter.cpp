@@ -20,7 +20,9 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include <algorithm>
+#include <cstring>
 #include "funcs.h"
+#include "colors.h"
 #include "converter.h"
 
 namespace tc {
@@ -28,6 +30,8 @@ namespace tc {
 Converter::Converter(const Options& options, unsigned type) noexcept
 : m_options(options)
 , m_encoding(true)
+, m_measureError(false)
+, m_encodingError(0.0)
 , m_colorFormat(ColorFormat::ARGB)
 , m_type(type)
 , m_width()
@@ -59,6 +63,52 @@ int Converter::convert(uint8_t *palette, uint8_t *indexed, uint8_t *encoded) noe
 }
 
 
+int Converter::encodePixels(uint8_t *pixels, uint8_t *encoded, int width, int height) noexcept
+{
+  if (isEncoding() && pixels != nullptr && encoded != nullptr && width > 0 && height > 0) {
+    // color reduction modifies the source pixels
+    int numPixels = width*height;
+    BytePtr ptrARGB(new uint8_t[numPixels*4], std::default_delete<uint8_t[]>());
+    std::memcpy(ptrARGB.get(), pixels, numPixels*4);
+    ReorderColors(ptrARGB.get(), numPixels, getColorFormat(), ColorFormat::ARGB);
+
+    BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
+    BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
+    Colors colors(getOptions());
+    if (colors.ARGBToPal(ptrARGB.get(), ptrIndexed.get(), ptrPalette.get(), width, height) == numPixels) {
+      ColorFormat fmt = getColorFormat();
+      setColorFormat(ColorFormat::ARGB);
+      int size = convert(ptrPalette.get(), ptrIndexed.get(), encoded, width, height);
+      setColorFormat(fmt);
+      return size;
+    }
+  }
+  return 0;
+}
+
+
+int Converter::decodePixels(uint8_t *encoded, uint8_t *pixels) noexcept
+{
+  if (!isEncoding() && encoded != nullptr && pixels != nullptr) {
+    BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
+    BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
+    ColorFormat fmt = getColorFormat();
+    setColorFormat(ColorFormat::ARGB);
+    int size = convert(ptrPalette.get(), ptrIndexed.get(), encoded);
+    setColorFormat(fmt);
+    if (size > 0) {
+      Colors colors(getOptions());
+      int numPixels = getWidth()*getHeight();
+      if (colors.palToARGB(ptrIndexed.get(), ptrPalette.get(), pixels, numPixels) == numPixels) {
+        ReorderColors(pixels, numPixels, ColorFormat::ARGB, fmt);
+        return numPixels*4;
+      }
+    }
+  }
+  return 0;
+}
+
+
 unsigned Converter::PadBlock(const uint8_t *src, uint8_t *dst, int srcWidth, int srcHeight,
                              int dstWidth, int dstHeight, bool useCopy) noexcept
 {
@@ -161,9 +211,9 @@ bool Converter::ReorderColors(uint8_t *buffer, unsigned numPixels,
       uint32_t srcPixel = get32u_le(src);
       uint32_t dstPixel = 0;
       dstPixel |= (srcPixel & 0x000000ff) << c0;
-      dstPixel |= (c1 < 0) ? (srcPixel & 0x0000ff00) >> c1 : (srcPixel & 0x0000ff00) << c1;
-      dstPixel |= (c2 < 0) ? (srcPixel & 0x00ff0000) >> c2 : (srcPixel & 0x00ff0000) << c2;
-      dstPixel |= (srcPixel & 0xff000000) >> c3;
+      dstPixel |= (c1 < 0) ? (srcPixel & 0x0000ff00) >> -c1 : (srcPixel & 0x0000ff00) << c1;
+      dstPixel |= (c2 < 0) ? (srcPixel & 0x00ff0000) >> -c2 : (srcPixel & 0x00ff0000) << c2;
+      dstPixel |= (srcPixel & 0xff000000) >> -c3;
       *src = get32u_le(&dstPixel);
     }
 
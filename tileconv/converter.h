@@ -59,6 +59,13 @@ class Converter
   void setColorFormat(ColorFormat fmt) noexcept { m_colorFormat = fmt; }
   ColorFormat getColorFormat() const noexcept { return m_colorFormat; }
 
+  /** Enable to measure the error introduced by lossy pixel encoding. (Default: disabled) */
+  void setMeasureError(bool b) noexcept { m_measureError = b; }
+  bool isMeasureError() const noexcept { return m_measureError; }
+
+  /** Returns the root mean square error per color component of the last measured encoding operation. */
+  double getEncodingError() const noexcept { return m_encodingError; }
+
   /** Returns image dimensions in pixels. (Implementation-specific). */
   int getWidth() const noexcept { return m_width; }
   int getHeight() const noexcept { return m_height; }
@@ -87,6 +94,27 @@ class Converter
   /** Short-hand conversion method for decoding. (Dimensions are retrieved from data.) */
   int convert(uint8_t *palette, uint8_t *indexed, uint8_t *encoded) noexcept;
 
+  /**
+   * Encodes 32-bit pixels of the current color format. (Encoding only)
+   * The default implementation reduces pixels to palette and indexed data first.
+   * \param pixels Source block of 32-bit pixels. Content is left unchanged.
+   * \param encoded Pointer to encoded data.
+   * \param width Block width in pixels.
+   * \param height Block height in pixels.
+   * \return Total size of resulting data or 0 on error.
+   */
+  virtual int encodePixels(uint8_t *pixels, uint8_t *encoded, int width, int height) noexcept;
+
+  /**
+   * Decodes pixel data directly into 32-bit pixels of the current color format without
+   * color reduction. (Dimensions are retrieved from data.)
+   * The default implementation expands the decoded palette and indexed pixel data.
+   * \param encoded Pointer to encoded data.
+   * \param pixels Storage for the resulting 32-bit pixels. Must have room for a full tile.
+   * \return Size of resulting pixel data in bytes or 0 on error.
+   */
+  virtual int decodePixels(uint8_t *encoded, uint8_t *pixels) noexcept;
+
   /**
    * Dimensions of a pixel data block will be expanded to the specified dimensions.
    * \param src Source block containing 32-bit pixels.
@@ -135,9 +163,14 @@ class Converter
   void setWidth(int w) noexcept;
   void setHeight(int h) noexcept;
 
+  // Set error of the last encoding operation
+  void setEncodingError(double v) noexcept { m_encodingError = v; }
+
 private:
   const Options&  m_options;      // read-only access to options
   bool            m_encoding;     // indicates conversion type (encoding to or decoding from)
+  bool            m_measureError; // indicates whether to measure the encoding error
+  double          m_encodingError;// RMS error of last encoding operation
   ColorFormat     m_colorFormat;  // color format for input/output pixel data
   int             m_type;         // encoding type
   int             m_width;
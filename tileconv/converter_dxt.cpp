@@ -19,11 +19,15 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+#include <cmath>
 #include <cstring>
+#include <vector>
 #include <squish.h>
 #include "funcs.h"
 #include "colors.h"
 #include "converter_dxt.h"
+#include "stats.h"
+#include "tilethreadpool_base.h"
 
 namespace tc {
 
@@ -92,6 +96,30 @@ int ConverterDxt::convert(uint8_t *palette, uint8_t *indexed, uint8_t *encoded,
 }
 
 
+int ConverterDxt::encodePixels(uint8_t *pixels, uint8_t *encoded, int width, int height) noexcept
+{
+  if (isEncoding() && pixels != nullptr && encoded != nullptr && width > 0 && height > 0) {
+    setWidth(width); setHeight(height);
+    return encodeTile(pixels, encoded, getWidth(), getHeight());
+  }
+  return 0;
+}
+
+
+int ConverterDxt::decodePixels(uint8_t *encoded, uint8_t *pixels) noexcept
+{
+  if (!isEncoding() && encoded != nullptr && pixels != nullptr) {
+    setWidth(get16u_le((uint16_t*)encoded));
+    setHeight(get16u_le((uint16_t*)(encoded+2)));
+    if (getWidth() > 0 && getHeight() > 0 &&
+        getWidth() <= (int)TILE_DIMENSION && getHeight() <= (int)TILE_DIMENSION) {
+      return decodeTile(encoded+4, pixels, getWidth(), getHeight());
+    }
+  }
+  return 0;
+}
+
+
 bool ConverterDxt::isTypeValid() const noexcept
 {
   switch (Options::GetEncodingType(getType())) {
@@ -109,44 +137,83 @@ bool ConverterDxt::isTypeValid() const noexcept
 int ConverterDxt::encodeTile(uint8_t *src, uint8_t *dst, int width, int height) noexcept
 {
   if (isEncoding() && src != nullptr && dst != nullptr && width > 0 && height > 0) {
-    uint8_t  block[64];
-    uint8_t  paddedBlock[64];
-    int blockSize = getRequiredSpace(4, 4);
-    int stride;
-    int srcOfs = 0;
-    int dstOfs = 0;
+    Stats::Timer timer(Stats::Stage::ENCODE, width*height*4);
+    timer.setBytesOut(getRequiredSpace(width, height));
     uint16_t v16;
 
     // initializing pixel encoding header
     v16 = (uint16_t)width; *((uint16_t*)dst) = get16u_le(&v16); dst += 2;
     v16 = (uint16_t)height; *((uint16_t*)dst) = get16u_le(&v16); dst += 2;
 
-    // encoding graphics
-    stride = getWidth() << 2;
-    for (int y = 0; y < getHeight(); y += 4) {
-      int bh = std::min(4, getHeight()-y);
-      for (int x = 0; x < getWidth(); x += 4) {
-        int bw = std::min(4, getWidth()-x);
-        for (int by = 0, bofs = 0, sofs = srcOfs; by < bh; by++, bofs += bw << 2, sofs += stride) {
-          std::memcpy(&block[bofs], src+sofs, bw << 2);
-        }
-        PadBlock(block, paddedBlock, bw, bh, 4, 4, false);
-        if (!compressBlock(paddedBlock, dst+dstOfs)) return false;
-
-        srcOfs += bw << 2;
-        dstOfs += blockSize;
-      }
-      srcOfs += 3*stride;
+    // encoding graphics: block rows are independent and shared with idle worker threads
+    int rows = (getHeight() + 3) >> 2;
+    std::vector<double> rowErrors(rows, 0.0);
+    std::vector<char> rowResults(rows, 0);
+    TileThreadPool::RunParallel(rows, [&](unsigned row) {
+      rowResults[row] = encodeBlockRow(src, dst, row << 2, rowErrors[row]);
+    });
+
+    // summed in row order: the result doesn't depend on the threads involved
+    double errorSum = 0.0;
+    for (int row = 0; row < rows; row++) {
+      if (!rowResults[row]) return false;
+      errorSum += rowErrors[row];
     }
+    setEncodingError(isMeasureError() ? std::sqrt(errorSum / (getWidth()*getHeight()*4.0)) : 0.0);
     return getRequiredSpace(getWidth(), getHeight()) + HEADER_TILE_ENCODED_SIZE;
   }
   return 0;
 }
 
 
+bool ConverterDxt::encodeBlockRow(const uint8_t *src, uint8_t *dst, int y, double &error) noexcept
+{
+  uint8_t  block[64];
+  uint8_t  paddedBlock[64];
+  int blockSize = getRequiredSpace(4, 4);
+  int stride = getWidth() << 2;
+  int alphaOfs = (getColorFormat() == ColorFormat::ARGB || getColorFormat() == ColorFormat::ABGR) ? 3 : 0;
+  int bh = std::min(4, getHeight()-y);
+  int srcOfs = y*stride;
+  int dstOfs = (y >> 2) * (getPaddedValue(getWidth()) >> 2) * blockSize;
+
+  error = 0.0;
+  for (int x = 0; x < getWidth(); x += 4) {
+    int bw = std::min(4, getWidth()-x);
+    for (int by = 0, bofs = 0, sofs = srcOfs; by < bh; by++, bofs += bw << 2, sofs += stride) {
+      std::memcpy(&block[bofs], src+sofs, bw << 2);
+    }
+    PadBlock(block, paddedBlock, bw, bh, 4, 4, false);
+    if (!compressBlock(paddedBlock, dst+dstOfs)) return false;
+
+    if (isMeasureError()) {
+      // comparing visible pixels with the decoded block
+      uint8_t decodedBlock[64];
+      if (!decompressBlock(dst+dstOfs, decodedBlock)) return false;
+      for (int by = 0; by < bh; by++) {
+        for (int bx = 0, ofs = by << 4; bx < bw; bx++, ofs += 4) {
+          if (paddedBlock[ofs+alphaOfs] != 0 || decodedBlock[ofs+alphaOfs] != 0) {
+            for (int i = 0; i < 4; i++) {
+              int d = (int)paddedBlock[ofs+i] - (int)decodedBlock[ofs+i];
+              error += d*d;
+            }
+          }
+        }
+      }
+    }
+
+    srcOfs += bw << 2;
+    dstOfs += blockSize;
+  }
+  return true;
+}
+
+
 int ConverterDxt::decodeTile(uint8_t *src, uint8_t *dst, int width, int height) noexcept
 {
   if (!isEncoding() && src != nullptr && dst != nullptr && width > 0 && height > 0) {
+    Stats::Timer timer(Stats::Stage::DECODE, getRequiredSpace(width, height));
+    timer.setBytesOut(width*height*4);
     uint8_t  block[64];
     uint8_t  paddedBlock[64];
     int blockSize = getRequiredSpace(4, 4);
@@ -28,6 +28,9 @@ namespace tc {
 /** Implements a DXTn encoder and decoder. */
 class ConverterDxt : public Converter
 {
+  // grants access to block routines for microbenchmarks
+  friend class MicroBench;
+
 public:
   ConverterDxt(const Options& options, unsigned type) noexcept;
   ~ConverterDxt() noexcept;
@@ -45,6 +48,12 @@ class ConverterDxt : public Converter
   /** See Converter::convert() */
   int convert(uint8_t *palette, uint8_t *indexed, uint8_t *encoded, int width, int height) noexcept;
 
+  /** See Converter::encodePixels(). Skips color reduction entirely. */
+  int encodePixels(uint8_t *pixels, uint8_t *encoded, int width, int height) noexcept;
+
+  /** See Converter::decodePixels(). Skips color reduction entirely. */
+  int decodePixels(uint8_t *encoded, uint8_t *pixels) noexcept;
+
 protected:
   // See Converter::isTypeValid()
   bool isTypeValid() const noexcept;
@@ -55,6 +64,10 @@ class ConverterDxt : public Converter
   int encodeTile(uint8_t *src, uint8_t *dst, int width, int height) noexcept;
   int decodeTile(uint8_t *src, uint8_t *dst, int width, int height) noexcept;
 
+  // Encodes the blocks of the block row starting at pixel row y of the tile into dst (without header).
+  // Stores the sum of squared errors of visible pixels in error if the encoding error is measured.
+  bool encodeBlockRow(const uint8_t *src, uint8_t *dst, int y, double &error) noexcept;
+
   // Returns squish flags based on type and quality.
   int getFlags() const noexcept;
 
@@ -21,6 +21,7 @@ THE SOFTWARE.
 */
 #include <cstring>
 #include "jpeg.h"
+#include "colors.h"
 #include "funcs.h"
 #include "compress.h"
 #include "graphics.h"
@@ -74,6 +75,27 @@ int ConverterZ::convert(uint8_t *palette, uint8_t *indexed, uint8_t *encoded, in
 }
 
 
+int ConverterZ::decodePixels(uint8_t *encoded, uint8_t *pixels) noexcept
+{
+  if (!isEncoding() && encoded != nullptr && pixels != nullptr) {
+    int size = 0;
+    if (std::strncmp((char*)encoded, Graphics::HEADER_TIL1_SIGNATURE, 4) == 0) {
+      size = decodePixels1(encoded+4, pixels);
+    } else if (std::strncmp((char*)encoded, Graphics::HEADER_TIL2_SIGNATURE, 4) == 0) {
+      size = decodePixels2(encoded+4, pixels);
+    } else {
+      // paletted tile
+      return Converter::decodePixels(encoded, pixels);
+    }
+    if (size > 0) {
+      ReorderColors(pixels, size >> 2, ColorFormat::ARGB, getColorFormat());
+    }
+    return size;
+  }
+  return 0;
+}
+
+
 int ConverterZ::decodeTile0(uint8_t *palette, uint8_t *indexed, uint8_t *encoded) noexcept
 {
   static const unsigned TILE_SIZE = 5120;
@@ -133,6 +155,18 @@ int ConverterZ::decodeTile1(uint8_t *palette, uint8_t *indexed, uint8_t *encoded
 int ConverterZ::decodeTile2(uint8_t *palette, uint8_t *indexed, uint8_t *encoded) noexcept
 {
   if (palette != nullptr && indexed != nullptr && encoded != nullptr) {
+    if (getOptions().isQuantizeZ()) {
+      // truecolor decoding and color quantization by tileconv
+      BytePtr ptrPixels(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+      if (decodePixels2(encoded, ptrPixels.get()) > 0) {
+        Colors colors(getOptions());
+        if (colors.ARGBToPal(ptrPixels.get(), indexed, palette, getWidth(), getHeight()) == getWidth()*getHeight()) {
+          return PALETTE_SIZE + getWidth()*getHeight();
+        }
+      }
+      return 0;
+    }
+
     int imgSize = get16u_be((uint16_t*)encoded); encoded += 2;
     Jpeg jpeg(getOptions());
     unsigned size = jpeg.decompress(encoded, imgSize, nullptr, palette, indexed);
@@ -145,6 +179,61 @@ int ConverterZ::decodeTile2(uint8_t *palette, uint8_t *indexed, uint8_t *encoded
 }
 
 
+int ConverterZ::decodePixels1(uint8_t *encoded, uint8_t *pixels) noexcept
+{
+  if (encoded != nullptr && pixels != nullptr) {
+    int tileSize = get16u_be((uint16_t*)encoded); encoded += 2;
+    int dataSize = get16u_be((uint16_t*)encoded); encoded += 2;
+    int imgSize = tileSize - dataSize - 2;
+    if (dataSize > 0 && imgSize > 0) {
+      Compression compression;
+      // palette is not needed, only the 512 byte alpha bitmask
+      BytePtr ptrInflated(new uint8_t[768+512], std::default_delete<uint8_t[]>());
+      if (compression.inflate(encoded, dataSize, ptrInflated.get(), 1280) == 1280) {
+        Jpeg jpeg(getOptions());
+        int size = jpeg.decompress(encoded + dataSize, imgSize, pixels, MAX_TILE_SIZE_32);
+        if (size > 0) {
+          setWidth(jpeg.getWidth()); setHeight(jpeg.getHeight());
+          applyAlphaPixels(ptrInflated.get() + 768, pixels, size >> 2);
+          return size;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+
+int ConverterZ::decodePixels2(uint8_t *encoded, uint8_t *pixels) noexcept
+{
+  if (encoded != nullptr && pixels != nullptr) {
+    int imgSize = get16u_be((uint16_t*)encoded); encoded += 2;
+    Jpeg jpeg(getOptions());
+    int size = jpeg.decompress(encoded, imgSize, pixels, MAX_TILE_SIZE_32);
+    if (size > 0) {
+      setWidth(jpeg.getWidth()); setHeight(jpeg.getHeight());
+      return size;
+    }
+  }
+  return 0;
+}
+
+
+void ConverterZ::applyAlphaPixels(uint8_t *alpha, uint8_t *pixels, int size) noexcept
+{
+  if (alpha != nullptr && pixels != nullptr && size > 0) {
+    for (int i = 0; i < size; i++, pixels += 4) {
+      int mofs = i >> 3;        // mask byte offset
+      int mbit = 7 - (i & 7);   // counting from MSB
+      if (((alpha[mofs] >> mbit) & 1) == 0) {
+        // transparent pixel found
+        pixels[0] = pixels[1] = pixels[2] = pixels[3] = 0;
+      }
+    }
+  }
+}
+
+
 void ConverterZ::applyAlpha(uint8_t *alpha, uint8_t *indexed, int size) noexcept
 {
   if (alpha != nullptr && indexed != nullptr && size > 0) {
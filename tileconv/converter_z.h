@@ -28,6 +28,9 @@ namespace tc {
 /** Implements a TIZ/MOZ decoder. */
 class ConverterZ: public Converter
 {
+  // grants access to block routines for microbenchmarks
+  friend class MicroBench;
+
 public:
   ConverterZ(const Options& options, unsigned type) noexcept;
   ~ConverterZ() noexcept;
@@ -42,14 +45,23 @@ class ConverterZ: public Converter
   /** See Converter::convert() */
   int convert(uint8_t *palette, uint8_t *indexed, uint8_t *encoded, int width, int height) noexcept;
 
+  /** See Converter::decodePixels(). JPEG compressed tiles are decoded without color reduction. */
+  int decodePixels(uint8_t *encoded, uint8_t *pixels) noexcept;
+
 protected:
   // Decoding methods for each tile type
   int decodeTile0(uint8_t *palette, uint8_t *indexed, uint8_t *encoded) noexcept;
   int decodeTile1(uint8_t *palette, uint8_t *indexed, uint8_t *encoded) noexcept;
   int decodeTile2(uint8_t *palette, uint8_t *indexed, uint8_t *encoded) noexcept;
 
+  // Decoding methods for JPEG compressed tile types into 32-bit pixels
+  int decodePixels1(uint8_t *encoded, uint8_t *pixels) noexcept;
+  int decodePixels2(uint8_t *encoded, uint8_t *pixels) noexcept;
+
   // Apply Tile1 alpha bitmask to indexed pixels
   void applyAlpha(uint8_t *alpha, uint8_t *indexed, int size) noexcept;
+  // Apply Tile1 alpha bitmask to 32-bit pixels
+  void applyAlphaPixels(uint8_t *alpha, uint8_t *pixels, int size) noexcept;
 
   // See Converter::isTypeValid()
   bool isTypeValid() const noexcept;
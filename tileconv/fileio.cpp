@@ -19,7 +19,11 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
+#include <cstdlib>
 #include "fileio.h"
+#include "filestage.h"
+#include "ioengine.h"
+#include "stats.h"
 #ifdef _WIN32
 # include <windows.h>
 #else
@@ -160,6 +164,13 @@ bool File::Exists(const std::string &path) noexcept
 {
   bool retVal = false;
   if (!path.empty()) {
+    IOEngine *engine = IOEngine::GetActiveInstance();
+    if (engine != nullptr && engine->isMemoryFile(path)) {
+      BytePtr data;
+      std::size_t size;
+      return engine->getMemoryFile(path, data, size);
+    }
+    SyncEngine(path);
 #ifdef _WIN32
     retVal = (::GetFileAttributes(path.c_str()) != INVALID_FILE_ATTRIBUTES);
 #else
@@ -173,6 +184,13 @@ bool File::Exists(const std::string &path) noexcept
 long File::GetFileSize(const std::string &fileName) noexcept
 {
   if (!fileName.empty()) {
+    IOEngine *engine = IOEngine::GetActiveInstance();
+    if (engine != nullptr && engine->isMemoryFile(fileName)) {
+      BytePtr data;
+      std::size_t size;
+      return engine->getMemoryFile(fileName, data, size) ? (long)size : -1L;
+    }
+    SyncEngine(fileName);
 #ifdef _WIN32
     HANDLE h = ::CreateFile(fileName.c_str(), 0, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
                             0, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, 0);
@@ -196,6 +214,9 @@ long File::GetFileSize(const std::string &fileName) noexcept
 bool File::RemoveFile(const std::string &fileName) noexcept
 {
   if (!fileName.empty()) {
+    IOEngine *engine = IOEngine::GetActiveInstance();
+    if (engine != nullptr && engine->isMemoryFile(fileName)) return engine->removeMemoryFile(fileName);
+    SyncEngine(fileName);
     return (std::remove(fileName.c_str()) == 0);
   }
   return false;
@@ -204,6 +225,8 @@ bool File::RemoveFile(const std::string &fileName) noexcept
 bool File::RenameFile(const std::string &oldFileName, const std::string &newFileName) noexcept
 {
   if (!oldFileName.empty() && !newFileName.empty()) {
+    SyncEngine(oldFileName);
+    SyncEngine(newFileName);
     return (std::rename(oldFileName.c_str(), newFileName.c_str()) == 0);
   }
   return false;
@@ -211,8 +234,15 @@ bool File::RenameFile(const std::string &oldFileName, const std::string &newFile
 
 bool File::IsEqual(const std::string &path1, const std::string &path2) noexcept
 {
+  SyncEngine(path1);
+  SyncEngine(path2);
   bool retVal = false;
 
+  IOEngine *engine = IOEngine::GetActiveInstance();
+  if (engine != nullptr && (engine->isMemoryFile(path1) || engine->isMemoryFile(path2))) {
+    return (path1 == path2);
+  }
+
   if (!path1.empty() && !path2.empty()) {
 #ifdef _WIN32
     HANDLE h2 = ::CreateFile(path2.c_str(), 0, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE,
@@ -270,9 +300,14 @@ File::File(const char *fileName, const char *mode) noexcept
 , m_fileName()
 , m_mode()
 , m_buffer(0)
+, m_stage()
+, m_data()
+, m_memBuffer(0)
+, m_memSize(0)
+, m_isMemory(false)
 , m_deleteOnClose(false)
 {
-  m_file = std::fopen(fileName, mode);
+  m_file = openFile(fileName, mode);
   if (m_file != nullptr) {
     m_fileName.assign(fileName);
     m_mode.assign(mode);
@@ -285,10 +320,15 @@ File::File(const char *fileName, const char *mode, int bufferSize) noexcept
 , m_fileName()
 , m_mode()
 , m_buffer(0)
+, m_stage()
+, m_data()
+, m_memBuffer(0)
+, m_memSize(0)
+, m_isMemory(false)
 , m_deleteOnClose(false)
 {
-  m_file = std::fopen(fileName, mode);
-  if (m_file != nullptr) {
+  m_file = openFile(fileName, mode);
+  if (m_file != nullptr && !m_isMemory) {
     m_fileName.assign(fileName);
     m_mode.assign(mode);
     if (bufferSize < 0) bufferSize = 0;
@@ -302,8 +342,8 @@ File::~File() noexcept
 {
   if (m_file != nullptr) {
     flush();
-    std::fclose(m_file);
-    m_file = nullptr;
+    m_stage.reset();
+    closeFile(!isDeleteOnClose());
   }
   if (m_buffer != nullptr) {
     delete[] m_buffer;
@@ -318,7 +358,14 @@ File::~File() noexcept
 bool File::reopen(const char *fileName, const char *mode) noexcept
 {
   if (m_file) {
-    m_file = std::freopen(fileName, mode, m_file);
+    stopStage();
+    if (m_isMemory) {
+      closeFile(true);
+      m_file = openFile(fileName, mode);
+    } else {
+      SyncEngine(fileName);
+      m_file = std::freopen(fileName, mode, m_file);
+    }
     if (m_file) {
       m_fileName.assign(fileName);
       m_mode.assign(mode);
@@ -335,7 +382,8 @@ bool File::reopen(const char *fileName, const char *mode) noexcept
 bool File::flush() noexcept
 {
   if (m_file) {
-    return (std::fflush(m_file) != EOF);
+    bool retVal = stopStage();
+    return (std::fflush(m_file) != EOF) && retVal;
   }
   return false;
 }
@@ -344,7 +392,16 @@ bool File::flush() noexcept
 std::size_t File::read(void *buffer, std::size_t size, std::size_t count) noexcept
 {
   if (m_file) {
-    return std::fread(buffer, size, count, m_file);
+    Stats::Timer timer(Stats::Stage::READ);
+    std::size_t retVal;
+    if (m_stage != nullptr && m_stage->isActive() && !m_stage->isWriter()) {
+      retVal = (size > 0) ? m_stage->read(buffer, size*count) / size : 0;
+    } else {
+      stopStage();
+      retVal = std::fread(buffer, size, count, m_file);
+    }
+    timer.setBytesOut(retVal*size);
+    return retVal;
   }
   return 0;
 }
@@ -353,7 +410,16 @@ std::size_t File::read(void *buffer, std::size_t size, std::size_t count) noexce
 std::size_t File::write(const void *buffer, std::size_t size, std::size_t count) noexcept
 {
   if (m_file) {
-    return std::fwrite(buffer, size, count, m_file);
+    Stats::Timer timer(Stats::Stage::WRITE, size*count);
+    std::size_t retVal;
+    if (m_stage != nullptr && m_stage->isActive() && m_stage->isWriter()) {
+      retVal = (size > 0) ? m_stage->write(buffer, size*count) / size : 0;
+    } else {
+      stopStage();
+      retVal = std::fwrite(buffer, size, count, m_file);
+    }
+    timer.setBytesOut(retVal*size);
+    return retVal;
   }
   return 0;
 }
@@ -362,6 +428,7 @@ std::size_t File::write(const void *buffer, std::size_t size, std::size_t count)
 int File::getc() noexcept
 {
   if (m_file) {
+    stopStage();
     return std::fgetc(m_file);
   }
   return EOF;
@@ -371,6 +438,7 @@ int File::getc() noexcept
 char* File::gets(char *str, int count) noexcept
 {
   if (m_file) {
+    stopStage();
     return std::fgets(str, count, m_file);
   }
   return NULL;
@@ -380,6 +448,7 @@ char* File::gets(char *str, int count) noexcept
 int File::putc(int ch) noexcept
 {
   if (m_file) {
+    stopStage();
     return std::fputc(ch, m_file);
   }
   return EOF;
@@ -389,6 +458,7 @@ int File::putc(int ch) noexcept
 int File::puts(const char *str) noexcept
 {
   if (m_file) {
+    stopStage();
     return std::fputs(str, m_file);
   }
   return EOF;
@@ -398,6 +468,7 @@ int File::puts(const char *str) noexcept
 int File::ungetc(int ch) noexcept
 {
   if (m_file) {
+    stopStage();
     return std::ungetc(ch, m_file);
   }
   return EOF;
@@ -407,6 +478,7 @@ int File::ungetc(int ch) noexcept
 long File::tell() noexcept
 {
   if (m_file) {
+    stopStage();
     return std::ftell(m_file);
   }
   return -1L;
@@ -416,6 +488,7 @@ long File::tell() noexcept
 bool File::getpos(std::fpos_t *pos) noexcept
 {
   if (m_file) {
+    stopStage();
     return (std::fgetpos(m_file, pos) == 0);
   }
   return false;
@@ -425,6 +498,7 @@ bool File::getpos(std::fpos_t *pos) noexcept
 bool File::seek(long offset, int origin) noexcept
 {
   if (m_file) {
+    stopStage();
     return (std::fseek(m_file, offset, origin) == 0);
   }
   return false;
@@ -434,6 +508,7 @@ bool File::seek(long offset, int origin) noexcept
 bool File::setpos(const std::fpos_t *pos) noexcept
 {
   if (m_file) {
+    stopStage();
     return (std::fsetpos(m_file, pos) == 0);
   }
   return false;
@@ -443,6 +518,7 @@ bool File::setpos(const std::fpos_t *pos) noexcept
 void File::rewind() noexcept
 {
   if (m_file) {
+    stopStage();
     std::rewind(m_file);
   }
 }
@@ -451,6 +527,7 @@ void File::rewind() noexcept
 void File::clearerr() noexcept
 {
   if (m_file) {
+    stopStage();
     std::clearerr(m_file);
   }
 }
@@ -459,6 +536,7 @@ void File::clearerr() noexcept
 bool File::eof() noexcept
 {
   if (m_file) {
+    stopStage();
     return (std::feof(m_file) != 0);
   }
   return true;
@@ -468,6 +546,7 @@ bool File::eof() noexcept
 bool File::error() noexcept
 {
   if (m_file) {
+    stopStage();
     return (std::ferror(m_file) != 0);
   }
   return true;
@@ -494,6 +573,92 @@ long File::getsize() noexcept
 }
 
 
+bool File::startReadAhead(unsigned blockSize, unsigned numBlocks) noexcept
+{
+#ifndef USE_WINTHREADS
+  if (m_file && isReadEnabled() && stopStage()) {
+    m_stage.reset(new FileStage(m_file, false, blockSize, numBlocks));
+    return true;
+  }
+#endif
+  return false;
+}
+
+
+bool File::startWriteBehind(unsigned blockSize, unsigned numBlocks) noexcept
+{
+#ifndef USE_WINTHREADS
+  if (m_file && isWriteEnabled() && stopStage()) {
+    m_stage.reset(new FileStage(m_file, true, blockSize, numBlocks));
+    return true;
+  }
+#endif
+  return false;
+}
+
+
+bool File::stopStage() noexcept
+{
+  if (m_stage != nullptr && m_stage->isActive()) {
+    bool retVal = m_stage->stop();
+    if (!m_stage->isWriter()) {
+      // moving file position back to the data consumed by the main thread
+      if (m_stage->getPending() > 0) {
+        if (std::fseek(m_file, -m_stage->getPending(), SEEK_CUR) != 0) retVal = false;
+      }
+    }
+    return retVal;
+  }
+  return true;
+}
+
+
+std::FILE* File::openFile(const char *fileName, const char *mode) noexcept
+{
+  std::FILE *file = nullptr;
+  IOEngine *engine = IOEngine::GetActiveInstance();
+  if (engine != nullptr && fileName != nullptr) {
+    file = engine->openMemory(fileName, mode, m_data, &m_memBuffer, &m_memSize);
+    m_isMemory = (file != nullptr);
+    if (engine->isMemoryFile(fileName)) return file;
+    if (file == nullptr) engine->sync(fileName);
+  }
+  if (file == nullptr) file = std::fopen(fileName, mode);
+  return file;
+}
+
+
+void File::closeFile(bool commit) noexcept
+{
+  if (m_isMemory) {
+    IOEngine *engine = IOEngine::GetActiveInstance();
+    if (engine != nullptr) {
+      // buffer is only used by write streams
+      bool isWrite = isWriteEnabled();
+      engine->closeMemory(m_fileName, m_file, isWrite ? &m_memBuffer : nullptr,
+                          isWrite ? &m_memSize : nullptr, commit);
+    } else {
+      std::fclose(m_file);
+      std::free(m_memBuffer);
+    }
+    m_data.reset();
+    m_memBuffer = nullptr;
+    m_memSize = 0;
+    m_isMemory = false;
+  } else {
+    std::fclose(m_file);
+  }
+  m_file = nullptr;
+}
+
+
+void File::SyncEngine(const std::string &fileName) noexcept
+{
+  IOEngine *engine = IOEngine::GetBatchInstance();
+  if (engine != nullptr) engine->sync(fileName);
+}
+
+
 bool File::isReadEnabled() const noexcept
 {
   for (auto iter = m_mode.cbegin(); iter != m_mode.cend(); ++iter) {
@@ -24,9 +24,12 @@ THE SOFTWARE.
 
 #include <cstdio>
 #include <string>
+#include <memory>
 
 namespace tc {
 
+class FileStage;
+
 /**
  * A simple wrapper around C-style I/O routines.
  */
@@ -156,12 +159,43 @@ class File
   void setDeleteOnClose(bool b) noexcept { m_deleteOnClose = b; }
   bool isDeleteOnClose() const noexcept { return m_deleteOnClose; }
 
+  /**
+   * Starts reading ahead of the current position in a separate thread, using a queue of
+   * numBlocks blocks of blockSize bytes. Only read() makes use of the queued data. Any other
+   * operation stops the read-ahead stage first. Returns false if not supported.
+   */
+  bool startReadAhead(unsigned blockSize, unsigned numBlocks) noexcept;
+
+  /**
+   * Coalesces data passed to write() into blocks of blockSize bytes which are written to disk
+   * by a separate thread. At most numBlocks blocks are queued. Any other operation stops the
+   * write-behind stage first. Returns false if not supported.
+   */
+  bool startWriteBehind(unsigned blockSize, unsigned numBlocks) noexcept;
+
+  /**
+   * Stops an active read-ahead or write-behind stage. Returns false if pending data could not
+   * be written.
+   */
+  bool stopStage() noexcept;
+
+  /** Provides access to statistics of the most recently used stage. Returns nullptr if not available. */
+  const FileStage* getStage() const noexcept { return m_stage.get(); }
+
   /** Returns whether current file is readable. */
   bool isReadEnabled() const noexcept;
   /** Returns whether current file is writable. */
   bool isWriteEnabled() const noexcept;
 
 private:
+  // Opens the file, using memory streams of the I/O engine if available
+  std::FILE* openFile(const char *fileName, const char *mode) noexcept;
+  // Closes the file. Memory streams are written to disk only if commit is true.
+  void closeFile(bool commit) noexcept;
+
+  // Writes data of fileName queued by the I/O engine to disk
+  static void SyncEngine(const std::string &fileName) noexcept;
+
   /** Not copyable. */
   File(const File &) = delete;
 
@@ -175,6 +209,11 @@ class File
   std::string   m_fileName;       // filename
   std::string   m_mode;           // current file mode
   char          *m_buffer;        // internal buffer (if used)
+  std::unique_ptr<FileStage> m_stage; // asynchronous read-ahead or write-behind stage (if used)
+  std::shared_ptr<uint8_t> m_data;  // file content of a memory stream in read mode
+  char          *m_memBuffer;     // file content of a memory stream in write mode
+  std::size_t   m_memSize;
+  bool          m_isMemory;       // whether the file is a memory stream provided by the I/O engine
   bool          m_deleteOnClose;
 };
 
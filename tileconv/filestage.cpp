@@ -0,0 +1,241 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <algorithm>
+#include <cstring>
+#ifndef _WIN32
+# include <fcntl.h>
+#endif
+#include "affinity.h"
+#include "filestage.h"
+
+namespace tc {
+
+double FileStage::getAverageBlocks() const noexcept
+{
+  return (m_samples > 0) ? m_blockSum / (double)m_samples : 0.0;
+}
+
+#ifndef USE_WINTHREADS
+
+FileStage::FileStage(std::FILE *file, bool isWriter, unsigned blockSize, unsigned numBlocks) noexcept
+: m_file(file)
+, m_isWriter(isWriter)
+, m_blockSize(std::max(1u, blockSize))
+, m_maxBlocks(std::max(1u, numBlocks))
+, m_active(true)
+, m_terminate(false)
+, m_eof(false)
+, m_error(false)
+, m_pending(0)
+, m_blocks()
+, m_blockPos(0)
+, m_current()
+, m_blockSum(0.0)
+, m_samples(0)
+, m_stalls(0)
+, m_memory((uint64_t)(m_maxBlocks + 1) * m_blockSize)
+, m_mutex()
+, m_cond()
+, m_thread()
+{
+  if (m_isWriter) {
+    m_current.data.reset(new uint8_t[m_blockSize], std::default_delete<uint8_t[]>());
+    m_current.size = 0;
+    // writer thread is started with the first completed block
+  } else {
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+    // data is consumed strictly sequentially
+    posix_fadvise(fileno(m_file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    m_thread = std::thread(&FileStage::readerMain, this);
+  }
+}
+
+
+FileStage::~FileStage() noexcept
+{
+  stop();
+}
+
+
+std::size_t FileStage::read(void *buffer, std::size_t size) noexcept
+{
+  if (!m_active || m_isWriter || buffer == nullptr) return 0;
+
+  uint8_t *dst = (uint8_t*)buffer;
+  std::size_t total = 0;
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_blockSum += m_blocks.size();
+  m_samples++;
+  if (m_blocks.empty() && !m_eof) m_stalls++;
+  while (total < size) {
+    m_cond.wait(lock, [this] { return !m_blocks.empty() || m_eof; });
+    if (m_blocks.empty()) break;
+
+    Block &block = m_blocks.front();
+    std::size_t len = std::min(size - total, block.size - m_blockPos);
+    std::memcpy(dst + total, block.data.get() + m_blockPos, len);
+    total += len;
+    m_blockPos += len;
+    if (m_blockPos >= block.size) {
+      m_blocks.pop_front();
+      m_blockPos = 0;
+      m_cond.notify_all();
+    }
+  }
+  return total;
+}
+
+
+std::size_t FileStage::write(const void *buffer, std::size_t size) noexcept
+{
+  if (!m_active || !m_isWriter || buffer == nullptr) return 0;
+
+  const uint8_t *src = (const uint8_t*)buffer;
+  std::size_t total = 0;
+  while (total < size) {
+    std::size_t len = std::min(size - total, m_blockSize - m_current.size);
+    std::memcpy(m_current.data.get() + m_current.size, src + total, len);
+    m_current.size += len;
+    total += len;
+    if (m_current.size == m_blockSize) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      pushBlock(lock);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_error ? 0 : total;
+}
+
+
+bool FileStage::stop() noexcept
+{
+  if (m_active) {
+    if (m_isWriter && !m_thread.joinable()) {
+      // data fits into a single block
+      if (m_current.size > 0 && std::fwrite(m_current.data.get(), 1, m_current.size, m_file) != m_current.size) {
+        m_error = true;
+      }
+    } else {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_isWriter && m_current.size > 0) pushBlock(lock);
+        m_terminate = true;
+        m_cond.notify_all();
+      }
+      m_thread.join();
+    }
+    m_active = false;
+
+    if (!m_isWriter) {
+      for (auto iter = m_blocks.cbegin(); iter != m_blocks.cend(); ++iter) {
+        m_pending += iter->size;
+      }
+      m_pending -= m_blockPos;
+      m_blocks.clear();
+      m_blockPos = 0;
+    }
+    m_current.data.reset();
+    m_memory.reset(0);
+  }
+  return !m_error;
+}
+
+
+void FileStage::pushBlock(std::unique_lock<std::mutex> &lock) noexcept
+{
+  m_blockSum += m_blocks.size();
+  m_samples++;
+  if (m_blocks.size() >= m_maxBlocks) {
+    m_stalls++;
+    m_cond.wait(lock, [this] { return m_blocks.size() < m_maxBlocks; });
+  }
+  m_blocks.push_back(m_current);
+  m_cond.notify_all();
+  if (!m_thread.joinable()) m_thread = std::thread(&FileStage::writerMain, this);
+
+  m_current.data.reset(new uint8_t[m_blockSize], std::default_delete<uint8_t[]>());
+  m_current.size = 0;
+}
+
+
+void FileStage::readerMain() noexcept
+{
+  Affinity::PinIoThread();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (!m_terminate && !m_eof) {
+    m_cond.wait(lock, [this] { return m_terminate || m_blocks.size() < m_maxBlocks; });
+    if (m_terminate) break;
+    lock.unlock();
+
+    Block block;
+    block.data.reset(new uint8_t[m_blockSize], std::default_delete<uint8_t[]>());
+    block.size = std::fread(block.data.get(), 1, m_blockSize, m_file);
+    bool error = (std::ferror(m_file) != 0);
+
+    lock.lock();
+    if (block.size > 0) m_blocks.push_back(block);
+    if (block.size < m_blockSize) {
+      m_eof = true;
+      m_error = error;
+    }
+    m_cond.notify_all();
+  }
+}
+
+
+void FileStage::writerMain() noexcept
+{
+  Affinity::PinIoThread();
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_cond.wait(lock, [this] { return m_terminate || !m_blocks.empty(); });
+    if (m_blocks.empty()) break;   // terminated and nothing left to write
+
+    Block block = m_blocks.front();
+    lock.unlock();
+    bool error = (std::fwrite(block.data.get(), 1, block.size, m_file) != block.size);
+    lock.lock();
+    m_blocks.pop_front();
+    if (error) m_error = true;
+    m_cond.notify_all();
+  }
+}
+
+#else   // USE_WINTHREADS
+
+FileStage::FileStage(std::FILE *file, bool isWriter, unsigned blockSize, unsigned numBlocks) noexcept
+: m_file(file), m_isWriter(isWriter), m_blockSize(blockSize), m_maxBlocks(numBlocks), m_active(false)
+, m_terminate(false), m_eof(false), m_error(false), m_pending(0), m_blocks(), m_blockPos(0)
+, m_current(), m_blockSum(0.0), m_samples(0), m_stalls(0)
+{
+}
+
+FileStage::~FileStage() noexcept {}
+std::size_t FileStage::read(void *buffer, std::size_t size) noexcept { return 0; }
+std::size_t FileStage::write(const void *buffer, std::size_t size) noexcept { return 0; }
+bool FileStage::stop() noexcept { return true; }
+
+#endif  // USE_WINTHREADS
+
+}   // namespace tc
@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _FILESTAGE_H_
+#define _FILESTAGE_H_
+
+#include <cstdio>
+#include <deque>
+#ifndef USE_WINTHREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+#include "types.h"
+#include "membudget.h"
+
+namespace tc {
+
+/**
+ * Asynchronous I/O stage of a file. Reads ahead or writes behind the main thread in large blocks,
+ * using a dedicated thread and a bounded block queue. Owned and controlled by File.
+ * (Not available for Windows threads. File operates synchronously in this case.)
+ */
+class FileStage
+{
+public:
+  /** Starts a read-ahead stage (isWriter = false) or a write-behind stage (isWriter = true). */
+  FileStage(std::FILE *file, bool isWriter, unsigned blockSize, unsigned numBlocks) noexcept;
+  ~FileStage() noexcept;
+
+  /** Returns whether the stage thread is still running. */
+  bool isActive() const noexcept { return m_active; }
+  bool isWriter() const noexcept { return m_isWriter; }
+
+  /** Reads up to size bytes from the block queue. Returns number of bytes read. */
+  std::size_t read(void *buffer, std::size_t size) noexcept;
+  /** Adds size bytes to the block queue. Returns number of bytes written or 0 on error. */
+  std::size_t write(const void *buffer, std::size_t size) noexcept;
+
+  /**
+   * Terminates the stage thread. Pending blocks are written to disk first.
+   * Returns false if an I/O error occurred.
+   */
+  bool stop() noexcept;
+
+  /** Number of bytes read ahead, but not consumed (available after stop()). */
+  long getPending() const noexcept { return m_pending; }
+
+  /** Returns queue statistics: average and max. number of queued blocks and number of stalls. */
+  double getAverageBlocks() const noexcept;
+  unsigned getMaxBlocks() const noexcept { return m_maxBlocks; }
+  unsigned getStalls() const noexcept { return m_stalls; }
+
+private:
+  struct Block
+  {
+    BytePtr     data;
+    std::size_t size;
+  };
+
+#ifndef USE_WINTHREADS
+  // Executed by the stage thread.
+  void readerMain() noexcept;
+  void writerMain() noexcept;
+
+  // Adds the current write block to the queue and starts the writer thread if needed.
+  // Blocks as long as the queue is full.
+  void pushBlock(std::unique_lock<std::mutex> &lock) noexcept;
+#endif
+
+private:
+  std::FILE               *m_file;
+  const bool              m_isWriter;
+  const std::size_t       m_blockSize;
+  const unsigned          m_maxBlocks;
+  bool                    m_active;
+  bool                    m_terminate;
+  bool                    m_eof;          // reader: no more blocks will be added
+  bool                    m_error;
+  long                    m_pending;
+  std::deque<Block>       m_blocks;
+  std::size_t             m_blockPos;     // reader: consumed bytes of front block
+  Block                   m_current;      // writer: block currently filled by the main thread
+  double                  m_blockSum;     // sum of queue sizes, sampled on each access
+  unsigned                m_samples;
+  unsigned                m_stalls;       // number of times the main thread had to wait
+  MemoryBudget::Reservation m_memory;     // accounted size of all blocks while active
+#ifndef USE_WINTHREADS
+  std::mutex              m_mutex;
+  std::condition_variable m_cond;
+  std::thread             m_thread;
+#endif
+};
+
+}   // namespace tc
+
+#endif		// _FILESTAGE_H_
@@ -23,10 +23,17 @@ THE SOFTWARE.
 #include <cstring>
 #include <cstdio>
 #include <algorithm>
+#include <cctype>
+#include <new>
 #include "funcs.h"
 #include "colors.h"
 #include "compress.h"
 #include "tilethreadpool.h"
+#include "filestage.h"
+#include "logger.h"
+#include "stats.h"
+#include "membudget.h"
+#include "affinity.h"
 #include "graphics.h"
 
 namespace tc {
@@ -37,6 +44,7 @@ const char Graphics::HEADER_MOSC_SIGNATURE[4] = {'M', 'O', 'S', 'C'};
 
 const char Graphics::HEADER_TBC_SIGNATURE[4]  = {'T', 'B', 'C', ' '};
 const char Graphics::HEADER_MBC_SIGNATURE[4]  = {'M', 'B', 'C', ' '};
+const char Graphics::HEADER_BM32_SIGNATURE[4] = {'B', 'M', '3', '2'};
 
 const char Graphics::HEADER_TIZ_SIGNATURE[4]  = {'T', 'I', 'Z', '0'};
 const char Graphics::HEADER_MOZ_SIGNATURE[4]  = {'M', 'O', 'Z', '0'};
@@ -47,13 +55,22 @@ const char Graphics::HEADER_TIL2_SIGNATURE[4] = {'T', 'I', 'L', '2'};
 const char Graphics::HEADER_VERSION_V1[4]     = {'V', '1', ' ', ' '};
 const char Graphics::HEADER_VERSION_V2[4]     = {'V', '2', ' ', ' '};
 const char Graphics::HEADER_VERSION_V1_0[4]   = {'V', '1', '.', '0'};
+const char Graphics::HEADER_VERSION_V1_1[4]   = {'V', '1', '.', '1'};
 
 const unsigned Graphics::MAX_PROGRESS         = 69;
-const unsigned Graphics::MAX_POOL_TILES       = 64;
+const unsigned Graphics::STAGE_BLOCK_SIZE     = 262144;
+const unsigned Graphics::STAGE_BLOCKS         = 8;
+const unsigned Graphics::PVRZ_PAGE_COLS       = 16;
+const unsigned Graphics::PVRZ_PAGE_TILES      = 256;
+const unsigned Graphics::MAX_PVRZ_PAGES_TIS   = 100;
 
 
 Graphics::Graphics(const Options &options) noexcept
 : m_options(options)
+, m_threadPool()
+, m_poolThreads(0)
+, m_sharedPool(false)
+, m_error(Error::NONE)
 {
 }
 
@@ -65,13 +82,15 @@ Graphics::~Graphics() noexcept
 
 bool Graphics::tisToTBC(const std::string &inFile, const std::string &outFile) noexcept
 {
+  m_error = Error::NONE;
   if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
     File fin(inFile.c_str(), "rb");
     if (!fin.error()) {
       uint32_t tileCount;
+      bool isPvrz;
 
       // parsing TIS header
-      if (!readTIS(fin, tileCount)) return false;
+      if (!readTIS(fin, tileCount, isPvrz)) return false;
 
       File fout(outFile.c_str(), "wb");
       fout.setDeleteOnClose(true);
@@ -80,42 +99,70 @@ bool Graphics::tisToTBC(const std::string &inFile, const std::string &outFile) n
         uint32_t tileSizeIndexed = TILE_DIMENSION*TILE_DIMENSION;   // indexed size of the tile
 
         // writing TBC header
-        if (fout.write(HEADER_TBC_SIGNATURE, 1, sizeof(HEADER_TBC_SIGNATURE)) != sizeof(HEADER_TBC_SIGNATURE)) return false;
-        if (fout.write(HEADER_VERSION_V1_0, 1, sizeof(HEADER_VERSION_V1_0)) != sizeof(HEADER_VERSION_V1_0)) return false;
+        if (fout.write(HEADER_TBC_SIGNATURE, 1, sizeof(HEADER_TBC_SIGNATURE)) != sizeof(HEADER_TBC_SIGNATURE)) return setError(Error::WRITE);
+        if (fout.write(getEncodedVersion(), 1, 4) != 4) return setError(Error::WRITE);
         v32 = Options::GetEncodingCode(getOptions().getEncoding(), getOptions().isDeflate());
         v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing encoding type
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing encoding type
         v32 = get32u_le(&tileCount);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing tile count
-        if (!getOptions().isSilent()) std::printf("Tile count: %d\n", tileCount);
-        if (getOptions().getVerbosity() == 1) std::printf("Converting");
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile count
+        if (!getOptions().isSilent()) {
+          Logger::Print("Tile count: %d%s\n", tileCount, isPvrz ? " (PVRZ-based)" : "");
+        }
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
 
         // converting tiles
-        ThreadPoolPtr pool = createThreadPool(getOptions().getThreads(), MAX_POOL_TILES);
+        std::map<unsigned, PvrzPtr> pages;    // PVRZ pages are loaded on demand
+        startPipeline(&fin, &fout);
+        ThreadPoolPtr pool = getThreadPool();
         double ratioCount = 0.0;    // counts the compression ratios of all tiles
+        unsigned typeCount[4] = {0, 0, 0, 0};   // counts the selected pixel encoding types
         unsigned tileIdx = 0, nextTileIdx = 0, curProgress = 0;
         while (tileIdx < tileCount || !pool->finished()) {
           // creating new tile data object
           if (tileIdx < tileCount) {
-            if (getOptions().isVerbose()) std::printf("Converting tile #%d\n", tileIdx);
-            BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
-            BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
+            if (getOptions().isVerbose()) Logger::Print("Converting tile #%d\n", tileIdx);
             BytePtr ptrDeflated(new uint8_t[MAX_TILE_SIZE_32*2], std::default_delete<uint8_t[]>());
             TileDataPtr tileData(new TileData(getOptions()));
             tileData->setEncoding(true);
             tileData->setIndex(tileIdx);
             tileData->setType(Options::GetEncodingCode(getOptions().getEncoding(), getOptions().isDeflate()));
-            tileData->setPaletteData(ptrPalette);
-            tileData->setIndexedData(ptrIndexed);
             tileData->setDeflatedData(ptrDeflated);
             tileData->setWidth(TILE_DIMENSION);
             tileData->setHeight(TILE_DIMENSION);
-            // reading paletted tile
-            if (fin.read(tileData->getPaletteData().get(), 1, PALETTE_SIZE) != PALETTE_SIZE) {
-              return false;
-            }
-            if (fin.read(tileData->getIndexedData().get(), 1, tileSizeIndexed) != tileSizeIndexed) {
-              return false;
+            if (isPvrz) {
+              // tile is extracted from the PVRZ page by the worker thread
+              uint32_t entry[3];
+              if (fin.read(entry, 4, 3) != 3) return setReadError(fin);
+              unsigned page = get32u_le(&entry[0]);
+              if (page == 0xffffffff) {
+                // tile without page is solid black
+                BytePtr ptrPixels(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+                uint32_t black = 0xff000000; black = get32u_le(&black);
+                std::fill((uint32_t*)ptrPixels.get(), (uint32_t*)ptrPixels.get() + MAX_TILE_SIZE_8, black);
+                tileData->setPixelData(ptrPixels);
+              } else {
+                PvrzRegion region;
+                region.page = getPvrzPage(pages, inFile, true, page);
+                if (region.page == nullptr) return false;
+                region.srcX = get32u_le(&entry[1]);
+                region.srcY = get32u_le(&entry[2]);
+                region.dstX = region.dstY = 0;
+                region.width = region.height = TILE_DIMENSION;
+                tileData->addPvrzRegion(region);
+              }
+            } else {
+              BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
+              BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
+              tileData->setPaletteData(ptrPalette);
+              tileData->setIndexedData(ptrIndexed);
+              // reading paletted tile
+              if (fin.read(tileData->getPaletteData().get(), 1, PALETTE_SIZE) != PALETTE_SIZE) {
+                return setReadError(fin);
+              }
+              if (fin.read(tileData->getIndexedData().get(), 1, tileSizeIndexed) != tileSizeIndexed) {
+                return setReadError(fin);
+              }
             }
             pool->addTileData(tileData);
             tileIdx++;
@@ -124,10 +171,11 @@ bool Graphics::tisToTBC(const std::string &inFile, const std::string &outFile) n
           // processing converted tiles
           while (pool->hasResult() && pool->peekResult() != nullptr &&
                  (unsigned)pool->peekResult()->getIndex() == nextTileIdx) {
+            Stats::Timer timer(Stats::Stage::DRAIN);
             TileDataPtr retVal = pool->getResult();
             if (retVal == nullptr || retVal->isError()) {
               if (retVal != nullptr && !retVal->getErrorMsg().empty()) {
-                std::printf("\n%s", retVal->getErrorMsg().c_str());
+                Logger::Print("\n%s", retVal->getErrorMsg().c_str());
               }
               return false;
             }
@@ -139,30 +187,38 @@ bool Graphics::tisToTBC(const std::string &inFile, const std::string &outFile) n
               curProgress = showProgress(nextTileIdx, tileCount, curProgress, MAX_PROGRESS, '.');
             }
             ratioCount += ratio;
+            typeCount[retVal->getTileType() & 3]++;
             nextTileIdx++;
           }
           if (tileIdx >= tileCount) {
-            pool->waitForResult();
+            pool->waitForResult(nextTileIdx);
           }
         }
-        if (getOptions().getVerbosity() == 1) std::printf("\n");
+        if (getOptions().getVerbosity() == 1) Logger::Print("\n");
 
         if (nextTileIdx < tileCount) {
-          std::printf("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
+          Logger::Print("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
           return false;
         }
 
+        if (!finishPipeline(&fin, &fout, pool)) return false;
+
         // displaying summary
         if (!getOptions().isSilent()) {
-          std::printf("TIS file converted successfully. Total compression ratio: %.2f%%.\n",
-                      ratioCount / (double)tileCount);
+          Logger::Print("TIS file converted successfully. Total compression ratio: %.2f%%.\n",
+                        ratioCount / (double)tileCount);
+          if (getOptions().getEncoding() == Encoding::AUTO) showTileDistribution(typeCount, tileCount);
         }
 
         fout.setDeleteOnClose(false);
         return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
       }
     } else {
-      std::printf("Error opening file \"%s\"\n", inFile.c_str());
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
     }
   }
   return false;
@@ -171,6 +227,7 @@ bool Graphics::tisToTBC(const std::string &inFile, const std::string &outFile) n
 
 bool Graphics::tbcToTIS(const std::string &inFile, const std::string &outFile) noexcept
 {
+  m_error = Error::NONE;
   if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
     File fin(inFile.c_str(), "rb");
     if (!fin.error()) {
@@ -185,39 +242,40 @@ bool Graphics::tbcToTIS(const std::string &inFile, const std::string &outFile) n
         uint32_t v32;
 
         // writing TIS header
-        if (fout.write(HEADER_TIS_SIGNATURE, 1, sizeof(HEADER_TIS_SIGNATURE)) != sizeof(HEADER_TIS_SIGNATURE)) return false;
-        if (fout.write(HEADER_VERSION_V1, 1, sizeof(HEADER_VERSION_V1)) != sizeof(HEADER_VERSION_V1)) return false;
+        if (fout.write(HEADER_TIS_SIGNATURE, 1, sizeof(HEADER_TIS_SIGNATURE)) != sizeof(HEADER_TIS_SIGNATURE)) return setError(Error::WRITE);
+        if (fout.write(HEADER_VERSION_V1, 1, sizeof(HEADER_VERSION_V1)) != sizeof(HEADER_VERSION_V1)) return setError(Error::WRITE);
         v32 = get32u_le(&tileCount);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing tile count
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile count
         v32 = 0x1400; v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing tile size
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile size
         v32 = 0x18; v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing header size
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing header size
         v32 = 0x40; v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing tile dimension
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile dimension
 
         if (getOptions().isVerbose()) {
-          std::printf("Tile count: %d, encoding: %d - %s\n",
-                      tileCount, compType, Options::GetEncodingName(compType).c_str());
+          Logger::Print("Tile count: %d, encoding: %d - %s\n",
+                        tileCount, compType, Options::GetEncodingName(compType).c_str());
         }
-        if (getOptions().getVerbosity() == 1) std::printf("Converting");
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
 
-        ThreadPoolPtr pool = createThreadPool(getOptions().getThreads(), MAX_POOL_TILES);
+        startPipeline(&fin, &fout);
+        ThreadPoolPtr pool = getThreadPool();
         unsigned tileIdx = 0, nextTileIdx = 0, curProgress = 0;
         while (tileIdx < tileCount || !pool->finished()) {
           // creating new tile data object
           if (tileIdx < tileCount) {
             uint32_t chunkSize;
-            if (fin.read(&v32, 4, 1) != 1) return false;
+            if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
             chunkSize = get32u_le(&v32);
             if (chunkSize == 0) {
-              std::printf("\nInvalid block size found for tile #%d\n", tileIdx);
-              return false;
+              Logger::Print("\nInvalid block size found for tile #%d\n", tileIdx);
+              return setError(Error::DATA);
             }
             BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
             BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
             BytePtr ptrDeflated(new uint8_t[chunkSize], std::default_delete<uint8_t[]>());
-            if (fin.read(ptrDeflated.get(), 1, chunkSize) != chunkSize) return false;
+            if (fin.read(ptrDeflated.get(), 1, chunkSize) != chunkSize) return setReadError(fin);
             TileDataPtr tileData(new TileData(getOptions()));
             tileData->setEncoding(false);
             tileData->setIndex(tileIdx);
@@ -233,10 +291,11 @@ bool Graphics::tbcToTIS(const std::string &inFile, const std::string &outFile) n
           // writing converted tiles to disk
           while (pool->hasResult() && pool->peekResult() != nullptr &&
                  (unsigned)pool->peekResult()->getIndex() == nextTileIdx) {
+            Stats::Timer timer(Stats::Stage::DRAIN);
             TileDataPtr retVal = pool->getResult();
             if (retVal == nullptr || retVal->isError()) {
               if (retVal != nullptr && !retVal->getErrorMsg().empty()) {
-                std::printf("\n%s", retVal->getErrorMsg().c_str());
+                Logger::Print("\n%s", retVal->getErrorMsg().c_str());
               }
               return false;
             }
@@ -249,26 +308,32 @@ bool Graphics::tbcToTIS(const std::string &inFile, const std::string &outFile) n
             nextTileIdx++;
           }
           if (tileIdx >= tileCount) {
-            pool->waitForResult();
+            pool->waitForResult(nextTileIdx);
           }
         }
-        if (getOptions().getVerbosity() == 1) std::printf("\n");
+        if (getOptions().getVerbosity() == 1) Logger::Print("\n");
 
         if (nextTileIdx < tileCount) {
-          std::printf("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
+          Logger::Print("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
           return false;
         }
 
+        if (!finishPipeline(&fin, &fout, pool)) return false;
+
         // displaying summary
         if (!getOptions().isSilent()) {
-          std::printf("TBC file converted successfully.\n");
+          Logger::Print("TBC file converted successfully.\n");
         }
 
         fout.setDeleteOnClose(false);
         return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
       }
     } else {
-      std::printf("Error opening file \"%s\"\n", inFile.c_str());
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
     }
   }
   return false;
@@ -277,16 +342,20 @@ bool Graphics::tbcToTIS(const std::string &inFile, const std::string &outFile) n
 
 bool Graphics::mosToMBC(const std::string &inFile, const std::string &outFile) noexcept
 {
+  m_error = Error::NONE;
   if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
     File fin(inFile.c_str(), "rb");
     if (!fin.error()) {
-      unsigned mosWidth, mosHeight, mosCols, mosRows, palOfs;
+      unsigned mosWidth, mosHeight, mosCols, mosRows, palOfs, numBlocks;
       BytePtr mosData(nullptr);
+      InflateStreamPtr stream;    // provides tile data of MOSC input
 
       // loading MOS/MOSC input data
-      if (!readMOS(fin, mosData, mosWidth, mosHeight, palOfs)) return false;
+      if (!readMOS(fin, mosData, stream, mosWidth, mosHeight, palOfs, numBlocks)) return false;
       mosCols = (mosWidth+63) >> 6;
       mosRows = (mosHeight+63) >> 6;
+      // MOSC: only header, palettes and tile offsets are decompressed
+      MemoryBudget::Reservation mosMemory((stream != nullptr) ? palOfs + mosCols*mosRows*(PALETTE_SIZE+4) : fin.getsize());
 
       File fout(outFile.c_str(), "wb");
       fout.setDeleteOnClose(true);
@@ -297,22 +366,39 @@ bool Graphics::mosToMBC(const std::string &inFile, const std::string &outFile) n
         uint32_t dataOfs = tileOfs + tileCount*4;             // start offset of tile data
 
         // writing MBC header
-        if (fout.write(HEADER_MBC_SIGNATURE, 1, sizeof(HEADER_MBC_SIGNATURE)) != sizeof(HEADER_MBC_SIGNATURE)) return false;
-        if (fout.write(HEADER_VERSION_V1_0, 1, sizeof(HEADER_VERSION_V1_0)) != sizeof(HEADER_VERSION_V1_0)) return false;
+        if (fout.write(HEADER_MBC_SIGNATURE, 1, sizeof(HEADER_MBC_SIGNATURE)) != sizeof(HEADER_MBC_SIGNATURE)) return setError(Error::WRITE);
+        if (fout.write(getEncodedVersion(), 1, 4) != 4) return setError(Error::WRITE);
         v32 = Options::GetEncodingCode(getOptions().getEncoding(), getOptions().isDeflate());
         v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing encoding type
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing encoding type
         v32 = mosWidth; v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing MOS width
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing MOS width
         v32 = mosHeight; v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing MOS height
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing MOS height
+
+        if (getOptions().isVerbose()) {
+          Logger::Print("Tile count: %d%s\n", tileCount, (numBlocks > 0) ? " (PVRZ-based)" : "");
+        }
 
-        if (getOptions().isVerbose()) std::printf("Tile count: %d\n", tileCount);
-        if (getOptions().getVerbosity() == 1) std::printf("Converting");
+        // MOSC: lowest tile data offset of all remaining tiles, decompressed data below can be discarded
+        std::vector<uint32_t> minTileOfs;
+        if (stream != nullptr) {
+          minTileOfs.resize(tileCount + 1);
+          minTileOfs[tileCount] = mosWidth*mosHeight;
+          for (unsigned i = tileCount; i > 0; i--) {
+            minTileOfs[i-1] = std::min(minTileOfs[i], (uint32_t)get32u_le((uint32_t*)(mosData.get()+tileOfs+(i-1)*4)));
+          }
+        }
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
 
         // processing tiles
-        ThreadPoolPtr pool = createThreadPool(getOptions().getThreads(), MAX_POOL_TILES);
+        std::map<unsigned, PvrzPtr> pages;    // PVRZ pages are loaded on demand
+        std::vector<std::vector<unsigned>> tileBlocks;  // data blocks overlapping each tile
+        if (numBlocks > 0) indexPvrzMosBlocks(mosData.get()+palOfs, numBlocks, mosWidth, mosHeight, tileBlocks);
+        startPipeline(&fin, &fout);
+        ThreadPoolPtr pool = getThreadPool();
         double ratioCount = 0.0;              // counts the compression ratios of all tiles
+        unsigned typeCount[4] = {0, 0, 0, 0}; // counts the selected pixel encoding types
         unsigned tileIdx = 0, nextTileIdx = 0, curProgress = 0;
         while (tileIdx < tileCount || !pool->finished()) {
           // creating new tile data object
@@ -321,25 +407,44 @@ bool Graphics::mosToMBC(const std::string &inFile, const std::string &outFile) n
             int col = tileIdx % mosCols;
             int tileWidth = std::min(TILE_DIMENSION, mosWidth - col*TILE_DIMENSION);
             int tileHeight = std::min(TILE_DIMENSION, mosHeight - row*TILE_DIMENSION);
-            BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
-            BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
             BytePtr ptrDeflated(new uint8_t[MAX_TILE_SIZE_32*2], std::default_delete<uint8_t[]>());
             TileDataPtr tileData(new TileData(getOptions()));
             tileData->setEncoding(true);
             tileData->setIndex(tileIdx);
             tileData->setType(Options::GetEncodingCode(getOptions().getEncoding(), getOptions().isDeflate()));
-            tileData->setPaletteData(ptrPalette);
-            tileData->setIndexedData(ptrIndexed);
             tileData->setDeflatedData(ptrDeflated);
             tileData->setWidth(tileWidth);
             tileData->setHeight(tileHeight);
-            // reading paletted tile
-            std::memcpy(tileData->getPaletteData().get(), mosData.get()+palOfs, PALETTE_SIZE);
-            palOfs += PALETTE_SIZE;
-            // reading tile data
-            v32 = get32u_le((uint32_t*)(mosData.get()+tileOfs));
-            tileOfs += 4;
-            std::memcpy(tileData->getIndexedData().get(), mosData.get()+dataOfs+v32, tileWidth*tileHeight);
+            if (numBlocks > 0) {
+              // tile is composed from PVRZ pages by the worker thread
+              if (!addPvrzMosRegions(tileData, mosData.get()+palOfs, tileBlocks[tileIdx],
+                                     col*TILE_DIMENSION, row*TILE_DIMENSION, pages, inFile)) {
+                return false;
+              }
+            } else {
+              BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
+              BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
+              tileData->setPaletteData(ptrPalette);
+              tileData->setIndexedData(ptrIndexed);
+              // reading paletted tile
+              std::memcpy(tileData->getPaletteData().get(), mosData.get()+palOfs, PALETTE_SIZE);
+              palOfs += PALETTE_SIZE;
+              // reading tile data
+              v32 = get32u_le((uint32_t*)(mosData.get()+tileOfs));
+              tileOfs += 4;
+              if (stream != nullptr) {
+                // tile is dispatched as soon as its data has been decompressed
+                const uint8_t *data = stream->getData(dataOfs+v32, tileWidth*tileHeight);
+                if (data == nullptr) {
+                  Logger::Print("\nError while decompressing MOSC input file\n");
+                  return setError(Error::DATA);
+                }
+                std::memcpy(tileData->getIndexedData().get(), data, tileWidth*tileHeight);
+                stream->discard(dataOfs+minTileOfs[tileIdx+1]);
+              } else {
+                std::memcpy(tileData->getIndexedData().get(), mosData.get()+dataOfs+v32, tileWidth*tileHeight);
+              }
+            }
             pool->addTileData(tileData);
             tileIdx++;
           }
@@ -347,10 +452,11 @@ bool Graphics::mosToMBC(const std::string &inFile, const std::string &outFile) n
           // writing converted tiles to disk
           while (pool->hasResult() && pool->peekResult() != nullptr &&
                  (unsigned)pool->peekResult()->getIndex() == nextTileIdx) {
+            Stats::Timer timer(Stats::Stage::DRAIN);
             TileDataPtr retVal = pool->getResult();
             if (retVal == nullptr || retVal->isError()) {
               if (retVal != nullptr && !retVal->getErrorMsg().empty()) {
-                std::printf("\n%s", retVal->getErrorMsg().c_str());
+                Logger::Print("\n%s", retVal->getErrorMsg().c_str());
               }
               return false;
             }
@@ -362,30 +468,38 @@ bool Graphics::mosToMBC(const std::string &inFile, const std::string &outFile) n
               curProgress = showProgress(nextTileIdx, tileCount, curProgress, MAX_PROGRESS, '.');
             }
             ratioCount += ratio;
+            typeCount[retVal->getTileType() & 3]++;
             nextTileIdx++;
           }
           if (tileIdx >= tileCount) {
-            pool->waitForResult();
+            pool->waitForResult(nextTileIdx);
           }
         }
-        if (getOptions().getVerbosity() == 1) std::printf("\n");
+        if (getOptions().getVerbosity() == 1) Logger::Print("\n");
 
         if (nextTileIdx < tileCount) {
-          std::printf("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
+          Logger::Print("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
           return false;
         }
 
+        if (!finishPipeline(&fin, &fout, pool)) return false;
+
         // displaying summary
         if (!getOptions().isSilent()) {
-          std::printf("MOS file converted successfully. Total compression ratio: %.2f%%.\n",
-                      ratioCount / (double)tileCount);
+          Logger::Print("MOS file converted successfully. Total compression ratio: %.2f%%.\n",
+                        ratioCount / (double)tileCount);
+          if (getOptions().getEncoding() == Encoding::AUTO) showTileDistribution(typeCount, tileCount);
         }
 
         fout.setDeleteOnClose(false);
         return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
       }
     } else {
-      std::printf("Error opening file \"%s\"\n", inFile.c_str());
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
     }
   }
   return false;
@@ -394,6 +508,7 @@ bool Graphics::mosToMBC(const std::string &inFile, const std::string &outFile) n
 
 bool Graphics::mbcToMOS(const std::string &inFile, const std::string &outFile) noexcept
 {
+  m_error = Error::NONE;
   if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
     File fin(inFile.c_str(), "rb");
     if (!fin.error()) {
@@ -415,7 +530,12 @@ bool Graphics::mbcToMOS(const std::string &inFile, const std::string &outFile) n
         uint32_t tileOfs = palOfs + mosCols*mosRows*PALETTE_SIZE;           // offset to tile offset array
         uint32_t dataOfsBase = tileOfs + mosCols*mosRows*4, dataOfsRel = 0;     // abs. and rel. offsets to data blocks
         uint32_t mosSize = dataOfsBase + mosWidth*mosHeight;
-        BytePtr mosData(new uint8_t[mosSize], std::default_delete<uint8_t[]>());
+        BytePtr mosData(new(std::nothrow) uint8_t[mosSize], std::default_delete<uint8_t[]>());
+        if (mosData == nullptr) {
+          Logger::Print("Not enough memory for MOS data\n");
+          return setError(Error::MEMORY);
+        }
+        MemoryBudget::Reservation mosMemory(mosSize);
 
         // writing MOS header
         std::memcpy(mosData.get(), HEADER_MOS_SIGNATURE, 4);
@@ -434,29 +554,30 @@ bool Graphics::mbcToMOS(const std::string &inFile, const std::string &outFile) n
         *(uint32_t*)(mosData.get()+20) = get32u_le(&v32);   // writing offset to palettes
 
         if (getOptions().isVerbose()) {
-          std::printf("Width: %d, height: %d, columns: %d, rows: %d, encoding: %d - %s\n",
-                      mosWidth, mosHeight, mosCols, mosRows, compType, Options::GetEncodingName(compType).c_str());
+          Logger::Print("Width: %d, height: %d, columns: %d, rows: %d, encoding: %d - %s\n",
+                        mosWidth, mosHeight, mosCols, mosRows, compType, Options::GetEncodingName(compType).c_str());
         }
-        if (getOptions().getVerbosity() == 1) std::printf("Converting");
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
 
         // processing tiles
-        ThreadPoolPtr pool = createThreadPool(getOptions().getThreads(), MAX_POOL_TILES);
+        startPipeline(&fin, nullptr);
+        ThreadPoolPtr pool = getThreadPool();
         uint32_t tileCount = mosCols * mosRows;
         uint32_t tileIdx = 0, nextTileIdx = 0, curProgress = 0;
         while (tileIdx < tileCount || !pool->finished()) {
           // creating new tile data object
           if (tileIdx < tileCount) {
             unsigned chunkSize;
-            if (fin.read(&v32, 4, 1) != 1) return false;
+            if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
             chunkSize = get32u_le(&v32);
             if (chunkSize == 0) {
-              std::printf("\nInvalid block size found for tile #%d\n", tileIdx);
-              return false;
+              Logger::Print("\nInvalid block size found for tile #%d\n", tileIdx);
+              return setError(Error::DATA);
             }
             BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
             BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
             BytePtr ptrDeflated(new uint8_t[chunkSize], std::default_delete<uint8_t[]>());
-            if (fin.read(ptrDeflated.get(), 1, chunkSize) != chunkSize) return false;
+            if (fin.read(ptrDeflated.get(), 1, chunkSize) != chunkSize) return setReadError(fin);
             TileDataPtr tileData(new TileData(getOptions()));
             tileData->setEncoding(false);
             tileData->setIndex(tileIdx);
@@ -472,10 +593,11 @@ bool Graphics::mbcToMOS(const std::string &inFile, const std::string &outFile) n
           // writing converted tiles to disk
           while (pool->hasResult() && pool->peekResult() != nullptr &&
                  (unsigned)pool->peekResult()->getIndex() == nextTileIdx) {
+            Stats::Timer timer(Stats::Stage::DRAIN);
             TileDataPtr retVal = pool->getResult();
             if (retVal == nullptr || retVal->isError()) {
               if (retVal != nullptr && !retVal->getErrorMsg().empty()) {
-                std::printf("\n%s", retVal->getErrorMsg().c_str());
+                Logger::Print("\n%s", retVal->getErrorMsg().c_str());
               }
               return false;
             }
@@ -488,29 +610,346 @@ bool Graphics::mbcToMOS(const std::string &inFile, const std::string &outFile) n
             nextTileIdx++;
           }
           if (tileIdx >= tileCount) {
-            pool->waitForResult();
+            pool->waitForResult(nextTileIdx);
           }
         }
-        if (getOptions().getVerbosity() == 1) std::printf("\n");
+        if (getOptions().getVerbosity() == 1) Logger::Print("\n");
 
         if (nextTileIdx < tileCount) {
-          std::printf("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
+          Logger::Print("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
           return false;
         }
 
+        if (!finishPipeline(&fin, nullptr, pool)) return false;
+
         // writing MOS/MOSC to disk
         if (!writeMos(fout, mosData, mosSize)) return false;
 
         // displaying summary
         if (!getOptions().isSilent()) {
-          std::printf("MBC file converted successfully.\n");
+          Logger::Print("MBC file converted successfully.\n");
+        }
+
+        fout.setDeleteOnClose(false);
+        return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
+      }
+    } else {
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
+    }
+  }
+  return false;
+}
+
+
+bool Graphics::tbcToBitmap(const std::string &inFile, const std::string &outFile) noexcept
+{
+  m_error = Error::NONE;
+  if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
+    File fin(inFile.c_str(), "rb");
+    if (!fin.error()) {
+      unsigned compType, tileCount;
+
+      // parsing TBC header
+      if (!readTBC(fin, compType, tileCount)) return false;
+
+      File fout(outFile.c_str(), "wb");
+      fout.setDeleteOnClose(true);
+      if (!fout.error()) {
+        uint32_t v32;
+
+        // writing BM32 header (tiles are stacked vertically)
+        if (!writeBitmapHeader(fout, TILE_DIMENSION, TILE_DIMENSION*tileCount, tileCount)) return false;
+
+        if (getOptions().isVerbose()) {
+          Logger::Print("Tile count: %d, encoding: %d - %s\n",
+                        tileCount, compType, Options::GetEncodingName(compType).c_str());
+        }
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
+
+        startPipeline(&fin, &fout);
+        ThreadPoolPtr pool = getThreadPool();
+        bool success = processTiles(pool, tileCount,
+          [&](unsigned tileIdx) -> TileDataPtr {
+            if (fin.read(&v32, 4, 1) != 1) return nullptr;
+            uint32_t chunkSize = get32u_le(&v32);
+            if (chunkSize == 0) {
+              Logger::Print("\nInvalid block size found for tile #%d\n", tileIdx);
+              return nullptr;
+            }
+            BytePtr ptrPixels(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+            BytePtr ptrDeflated(new uint8_t[chunkSize], std::default_delete<uint8_t[]>());
+            if (fin.read(ptrDeflated.get(), 1, chunkSize) != chunkSize) return nullptr;
+            TileDataPtr tileData(new TileData(getOptions()));
+            tileData->setEncoding(false);
+            tileData->setIndex(tileIdx);
+            tileData->setType(compType);
+            tileData->setPixelData(ptrPixels);
+            tileData->setColorFormat((Converter::ColorFormat)getOptions().getBitmapFormat());
+            tileData->setDeflatedData(ptrDeflated);
+            tileData->setSize(chunkSize);
+            return tileData;
+          },
+          [&](TileDataPtr tileData) {
+            return writeDecodedBitmapTile(tileData, fout);
+          });
+        if (!success) return false;
+
+        if (!finishPipeline(&fin, &fout, pool)) return false;
+
+        // displaying summary
+        if (!getOptions().isSilent()) {
+          Logger::Print("TBC file converted successfully.\n");
+        }
+
+        fout.setDeleteOnClose(false);
+        return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
+      }
+    } else {
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
+    }
+  }
+  return false;
+}
+
+
+bool Graphics::mbcToBitmap(const std::string &inFile, const std::string &outFile) noexcept
+{
+  m_error = Error::NONE;
+  if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
+    File fin(inFile.c_str(), "rb");
+    if (!fin.error()) {
+      unsigned compType, mosWidth, mosHeight;
+
+      // parsing MBC header
+      if (!readMBC(fin, compType, mosWidth, mosHeight)) return false;
+
+      File fout(outFile.c_str(), "wb");
+      fout.setDeleteOnClose(true);
+      if (!fout.error()) {
+        uint32_t v32;
+        uint32_t mosCols = (mosWidth + 63) >> 6;
+        uint32_t mosRows = (mosHeight + 63) >> 6;
+
+        // writing BM32 header
+        if (!writeBitmapHeader(fout, mosWidth, mosHeight, 0)) return false;
+
+        // storage for a single row of tiles
+        BytePtr rowData(new(std::nothrow) uint8_t[mosWidth*TILE_DIMENSION*4], std::default_delete<uint8_t[]>());
+        if (rowData == nullptr) {
+          Logger::Print("Not enough memory for bitmap data\n");
+          return setError(Error::MEMORY);
+        }
+        MemoryBudget::Reservation rowMemory(mosWidth*TILE_DIMENSION*4);
+
+        if (getOptions().isVerbose()) {
+          Logger::Print("Width: %d, height: %d, columns: %d, rows: %d, encoding: %d - %s\n",
+                        mosWidth, mosHeight, mosCols, mosRows, compType, Options::GetEncodingName(compType).c_str());
+        }
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
+
+        // processing tiles
+        startPipeline(&fin, &fout);
+        ThreadPoolPtr pool = getThreadPool();
+        bool success = processTiles(pool, mosCols * mosRows,
+          [&](unsigned tileIdx) -> TileDataPtr {
+            if (fin.read(&v32, 4, 1) != 1) return nullptr;
+            uint32_t chunkSize = get32u_le(&v32);
+            if (chunkSize == 0) {
+              Logger::Print("\nInvalid block size found for tile #%d\n", tileIdx);
+              return nullptr;
+            }
+            BytePtr ptrPixels(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+            BytePtr ptrDeflated(new uint8_t[chunkSize], std::default_delete<uint8_t[]>());
+            if (fin.read(ptrDeflated.get(), 1, chunkSize) != chunkSize) return nullptr;
+            TileDataPtr tileData(new TileData(getOptions()));
+            tileData->setEncoding(false);
+            tileData->setIndex(tileIdx);
+            tileData->setType(compType);
+            tileData->setPixelData(ptrPixels);
+            tileData->setColorFormat((Converter::ColorFormat)getOptions().getBitmapFormat());
+            tileData->setDeflatedData(ptrDeflated);
+            tileData->setSize(chunkSize);
+            return tileData;
+          },
+          [&](TileDataPtr tileData) {
+            return writeDecodedBitmapTile(tileData, fout, rowData, mosWidth, mosHeight, mosCols);
+          });
+        if (!success) return false;
+
+        if (!finishPipeline(&fin, &fout, pool)) return false;
+
+        // displaying summary
+        if (!getOptions().isSilent()) {
+          Logger::Print("MBC file converted successfully.\n");
+        }
+
+        fout.setDeleteOnClose(false);
+        return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
+      }
+    } else {
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
+    }
+  }
+  return false;
+}
+
+
+bool Graphics::tbcToPvrz(const std::string &inFile, const std::string &outFile) noexcept
+{
+  m_error = Error::NONE;
+  if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
+    File fin(inFile.c_str(), "rb");
+    if (!fin.error()) {
+      unsigned compType, tileCount;
+
+      // parsing TBC header
+      if (!readTBC(fin, compType, tileCount)) return false;
+      if (!isPvrzCompatible(compType)) return false;
+
+      unsigned pageCount = (tileCount + PVRZ_PAGE_TILES - 1) / PVRZ_PAGE_TILES;
+      if (pageCount > MAX_PVRZ_PAGES_TIS) {
+        Logger::Print("Too many tiles for PVRZ-based TIS: %d (max. %d)\n",
+                      tileCount, MAX_PVRZ_PAGES_TIS*PVRZ_PAGE_TILES);
+        return false;
+      }
+
+      File fout(outFile.c_str(), "wb");
+      fout.setDeleteOnClose(true);
+      if (!fout.error()) {
+        uint32_t v32;
+
+        // writing TIS V2 header
+        if (fout.write(HEADER_TIS_SIGNATURE, 1, sizeof(HEADER_TIS_SIGNATURE)) != sizeof(HEADER_TIS_SIGNATURE)) return setError(Error::WRITE);
+        if (fout.write(HEADER_VERSION_V1, 1, sizeof(HEADER_VERSION_V1)) != sizeof(HEADER_VERSION_V1)) return setError(Error::WRITE);
+        v32 = tileCount; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile count
+        v32 = 0x0c; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile size
+        v32 = HEADER_TIS_V2_SIZE; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing header size
+        v32 = TILE_DIMENSION; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile dimension
+
+        if (getOptions().isVerbose()) {
+          Logger::Print("Tile count: %d, encoding: %d - %s, PVRZ pages: %d\n",
+                        tileCount, compType, Options::GetEncodingName(compType).c_str(), pageCount);
+        }
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
+
+        // PVRZ pages are created alongside the output file
+        bool success = writePvrzPages(fin, compType, tileCount, outFile, true, 0,
+          [&](unsigned, unsigned page, int x, int y, int, int) {
+            // writing tile entry: page, x, y
+            uint32_t entry[3] = { page, (uint32_t)x, (uint32_t)y };
+            for (int i = 0; i < 3; i++) entry[i] = get32u_le(&entry[i]);
+            return (fout.write(entry, 4, 3) == 3);
+          });
+        if (!success) return false;
+
+        // displaying summary
+        if (!getOptions().isSilent()) {
+          Logger::Print("TBC file transcoded successfully. PVRZ pages: %d\n", pageCount);
+        }
+
+        fout.setDeleteOnClose(false);
+        return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
+      }
+    } else {
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
+    }
+  }
+  return false;
+}
+
+
+bool Graphics::mbcToPvrz(const std::string &inFile, const std::string &outFile) noexcept
+{
+  m_error = Error::NONE;
+  if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
+    File fin(inFile.c_str(), "rb");
+    if (!fin.error()) {
+      unsigned compType, mosWidth, mosHeight;
+
+      // parsing MBC header
+      if (!readMBC(fin, compType, mosWidth, mosHeight)) return false;
+      if (!isPvrzCompatible(compType)) return false;
+
+      uint32_t mosCols = (mosWidth + 63) >> 6;
+      uint32_t mosRows = (mosHeight + 63) >> 6;
+      uint32_t tileCount = mosCols * mosRows;
+      unsigned pageCount = (tileCount + PVRZ_PAGE_TILES - 1) / PVRZ_PAGE_TILES;
+      if (pageCount > (unsigned)(Options::MAX_PVRZ_INDEX - getOptions().getPvrzIndex()) + 1) {
+        Logger::Print("PVRZ page index out of range: %d (max. %d)\n",
+                      getOptions().getPvrzIndex() + pageCount - 1, Options::MAX_PVRZ_INDEX);
+        return false;
+      }
+
+      File fout(outFile.c_str(), "wb");
+      fout.setDeleteOnClose(true);
+      if (!fout.error()) {
+        uint32_t v32;
+
+        // writing MOS V2 header
+        if (fout.write(HEADER_MOS_SIGNATURE, 1, sizeof(HEADER_MOS_SIGNATURE)) != sizeof(HEADER_MOS_SIGNATURE)) return setError(Error::WRITE);
+        if (fout.write(HEADER_VERSION_V2, 1, sizeof(HEADER_VERSION_V2)) != sizeof(HEADER_VERSION_V2)) return setError(Error::WRITE);
+        v32 = mosWidth; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing width
+        v32 = mosHeight; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing height
+        v32 = tileCount; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing number of data blocks
+        v32 = HEADER_MOS_V2_SIZE; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing offset to data blocks
+
+        if (getOptions().isVerbose()) {
+          Logger::Print("Width: %d, height: %d, columns: %d, rows: %d, encoding: %d - %s, PVRZ pages: %d\n",
+                        mosWidth, mosHeight, mosCols, mosRows, compType,
+                        Options::GetEncodingName(compType).c_str(), pageCount);
+        }
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
+
+        // PVRZ pages are created alongside the output file
+        bool success = writePvrzPages(fin, compType, tileCount, outFile, false, getOptions().getPvrzIndex(),
+          [&](unsigned tileIdx, unsigned page, int x, int y, int width, int height) {
+            // writing data block: page, source x/y, width, height, target x/y
+            uint32_t block[7] = { page, (uint32_t)x, (uint32_t)y, (uint32_t)width, (uint32_t)height,
+                                  (tileIdx % mosCols) * TILE_DIMENSION, (tileIdx / mosCols) * TILE_DIMENSION };
+            for (int i = 0; i < 7; i++) block[i] = get32u_le(&block[i]);
+            return (fout.write(block, 4, 7) == 7);
+          });
+        if (!success) return false;
+
+        // displaying summary
+        if (!getOptions().isSilent()) {
+          Logger::Print("MBC file transcoded successfully. PVRZ pages: mos%04d.pvrz to mos%04d.pvrz\n",
+                        getOptions().getPvrzIndex(), getOptions().getPvrzIndex() + pageCount - 1);
         }
 
         fout.setDeleteOnClose(false);
         return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
       }
     } else {
-      std::printf("Error opening file \"%s\"\n", inFile.c_str());
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
     }
   }
   return false;
@@ -519,10 +958,10 @@ bool Graphics::mbcToMOS(const std::string &inFile, const std::string &outFile) n
 
 bool Graphics::tizToTIS(const std::string &inFile, const std::string &outFile) noexcept
 {
+  m_error = Error::NONE;
   if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
     File fin(inFile.c_str(), "rb");
     if (!fin.error()) {
-      char tsig[4];
       unsigned compType, tileCount;
 
       // parsing TIZ header
@@ -534,25 +973,26 @@ bool Graphics::tizToTIS(const std::string &inFile, const std::string &outFile) n
         uint32_t v32;
 
         // writing TIS header
-        if (fout.write(HEADER_TIS_SIGNATURE, 1, sizeof(HEADER_TIS_SIGNATURE)) != sizeof(HEADER_TIS_SIGNATURE)) return false;
-        if (fout.write(HEADER_VERSION_V1, 1, sizeof(HEADER_VERSION_V1)) != sizeof(HEADER_VERSION_V1)) return false;
+        if (fout.write(HEADER_TIS_SIGNATURE, 1, sizeof(HEADER_TIS_SIGNATURE)) != sizeof(HEADER_TIS_SIGNATURE)) return setError(Error::WRITE);
+        if (fout.write(HEADER_VERSION_V1, 1, sizeof(HEADER_VERSION_V1)) != sizeof(HEADER_VERSION_V1)) return setError(Error::WRITE);
         v32 = get32u_le(&tileCount);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing tile count
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile count
         v32 = 0x1400; v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing tile size
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile size
         v32 = 0x18; v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing header size
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing header size
         v32 = 0x40; v32 = get32u_le(&v32);
-        if (fout.write(&v32, 4, 1) != 1) return false;    // writing tile dimension
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile dimension
 
         if (getOptions().isVerbose()) {
-          std::printf("Tile count: %d, encoding: %d - %s\n",
-                      tileCount, compType, Options::GetEncodingName(compType).c_str());
+          Logger::Print("Tile count: %d, encoding: %d - %s\n",
+                        tileCount, compType, Options::GetEncodingName(compType).c_str());
         }
-        if (getOptions().getVerbosity() == 1) std::printf("Converting");
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
 
         // processing tiles
-        ThreadPoolPtr pool = createThreadPool(getOptions().getThreads(), MAX_POOL_TILES);
+        startPipeline(&fin, &fout);
+        ThreadPoolPtr pool = getThreadPool();
         unsigned tileIdx = 0, nextTileIdx = 0, curProgress = 0;
         while (tileIdx < tileCount || !pool->finished()) {
           if (tileIdx < tileCount) {
@@ -561,23 +1001,7 @@ bool Graphics::tizToTIS(const std::string &inFile, const std::string &outFile) n
             BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
             BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
             BytePtr ptrDeflated;
-
-            if (fin.read(tsig, 1, 4) != 4) return false;
-            if (std::strncmp(tsig, HEADER_TIL0_SIGNATURE, 4) == 0 ||
-                std::strncmp(tsig, HEADER_TIL1_SIGNATURE, 4) == 0 ||
-                std::strncmp(tsig, HEADER_TIL2_SIGNATURE, 4) == 0) {
-              uint16_t tileSize;
-              if (fin.read(&tileSize, 2, 1) != 1) return false;
-              chunkSize = get16u_be(&tileSize);
-              ptrDeflated.reset(new uint8_t[chunkSize+6], std::default_delete<uint8_t[]>());
-              std::memcpy(ptrDeflated.get(), tsig, 4);
-              std::memcpy(ptrDeflated.get()+4, &tileSize, 2);
-              if (fin.read(ptrDeflated.get()+6, 1, chunkSize) != chunkSize) return false;
-              chunkSize += 6;
-            } else {
-              std::printf("\nInvalid header found in tile #%d\n", tileIdx);
-              return false;
-            }
+            if (!readZTile(fin, tileIdx, true, ptrDeflated, chunkSize)) return false;
             TileDataPtr tileData(new TileData(getOptions()));
             tileData->setEncoding(false);
             tileData->setIndex(tileIdx);
@@ -593,10 +1017,11 @@ bool Graphics::tizToTIS(const std::string &inFile, const std::string &outFile) n
           // writing converted tiles to disk
           while (pool->hasResult() && pool->peekResult() != nullptr &&
                  (unsigned)pool->peekResult()->getIndex() == nextTileIdx) {
+            Stats::Timer timer(Stats::Stage::DRAIN);
             TileDataPtr retVal = pool->getResult();
             if (retVal == nullptr || retVal->isError()) {
               if (retVal != nullptr && !retVal->getErrorMsg().empty()) {
-                std::printf("\n%s", retVal->getErrorMsg().c_str());
+                Logger::Print("\n%s", retVal->getErrorMsg().c_str());
               }
               return false;
             }
@@ -609,26 +1034,32 @@ bool Graphics::tizToTIS(const std::string &inFile, const std::string &outFile) n
             nextTileIdx++;
           }
           if (tileIdx >= tileCount) {
-            pool->waitForResult();
+            pool->waitForResult(nextTileIdx);
           }
         }
-        if (getOptions().getVerbosity() == 1) std::printf("\n");
+        if (getOptions().getVerbosity() == 1) Logger::Print("\n");
 
         if (nextTileIdx < tileCount) {
-          std::printf("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
+          Logger::Print("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
           return false;
         }
 
+        if (!finishPipeline(&fin, &fout, pool)) return false;
+
         // displaying summary
         if (!getOptions().isSilent()) {
-          std::printf("TIZ file converted successfully.\n");
+          Logger::Print("TIZ file converted successfully.\n");
         }
 
         fout.setDeleteOnClose(false);
         return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
       }
     } else {
-      std::printf("Error opening file \"%s\"\n", inFile.c_str());
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
     }
   }
   return false;
@@ -637,10 +1068,10 @@ bool Graphics::tizToTIS(const std::string &inFile, const std::string &outFile) n
 
 bool Graphics::mozToMOS(const std::string &inFile, const std::string &outFile) noexcept
 {
+  m_error = Error::NONE;
   if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
     File fin(inFile.c_str(), "rb");
     if (!fin.error()) {
-      char tsig[4];
       unsigned compType, mosWidth, mosHeight;
 
       // parsing TIZ header
@@ -659,7 +1090,12 @@ bool Graphics::mozToMOS(const std::string &inFile, const std::string &outFile) n
         uint32_t tileOfs = palOfs + mosCols*mosRows*PALETTE_SIZE;           // offset to tile offset array
         uint32_t dataOfsBase = tileOfs + mosCols*mosRows*4, dataOfsRel = 0;     // abs. and rel. offsets to data blocks
         uint32_t mosSize = dataOfsBase + mosWidth*mosHeight;
-        BytePtr mosData(new uint8_t[mosSize], std::default_delete<uint8_t[]>());
+        BytePtr mosData(new(std::nothrow) uint8_t[mosSize], std::default_delete<uint8_t[]>());
+        if (mosData == nullptr) {
+          Logger::Print("Not enough memory for MOS data\n");
+          return setError(Error::MEMORY);
+        }
+        MemoryBudget::Reservation mosMemory(mosSize);
 
         // writing MOS header
         std::memcpy(mosData.get(), HEADER_MOS_SIGNATURE, 4);
@@ -678,13 +1114,14 @@ bool Graphics::mozToMOS(const std::string &inFile, const std::string &outFile) n
         *(uint32_t*)(mosData.get()+20) = get32u_le(&v32);   // writing offset to palettes
 
         if (getOptions().isVerbose()) {
-          std::printf("Width: %d, height: %d, columns: %d, rows: %d, encoding: %d - %s\n",
-                      mosWidth, mosHeight, mosCols, mosRows, compType, Options::GetEncodingName(compType).c_str());
+          Logger::Print("Width: %d, height: %d, columns: %d, rows: %d, encoding: %d - %s\n",
+                        mosWidth, mosHeight, mosCols, mosRows, compType, Options::GetEncodingName(compType).c_str());
         }
-        if (getOptions().getVerbosity() == 1) std::printf("Converting");
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
 
         // processing tiles
-        ThreadPoolPtr pool = createThreadPool(getOptions().getThreads(), MAX_POOL_TILES);
+        startPipeline(&fin, nullptr);
+        ThreadPoolPtr pool = getThreadPool();
         uint32_t tileCount = mosCols * mosRows;
         uint32_t tileIdx = 0, nextTileIdx = 0, curProgress = 0;
         while (tileIdx < tileCount || !pool->finished()) {
@@ -694,22 +1131,7 @@ bool Graphics::mozToMOS(const std::string &inFile, const std::string &outFile) n
             BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
             BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
             BytePtr ptrDeflated;
-
-            if (fin.read(tsig, 1, 4) != 4) return false;
-            if (std::strncmp(tsig, HEADER_TIL2_SIGNATURE, 4) == 0) {
-              // jpeg compressed tile
-              uint16_t tileSize;
-              if (fin.read(&tileSize, 2, 1) != 1) return false;
-              chunkSize = get16u_be(&tileSize);
-              ptrDeflated.reset(new uint8_t[chunkSize+6], std::default_delete<uint8_t[]>());
-              std::memcpy(ptrDeflated.get(), tsig, 4);
-              std::memcpy(ptrDeflated.get()+4, &tileSize, 2);
-              if (fin.read(ptrDeflated.get()+6, 1, chunkSize) != chunkSize) return false;
-              chunkSize += 6;
-            } else {
-              std::printf("\nInvalid header found in tile #%d\n", tileIdx);
-              return false;
-            }
+            if (!readZTile(fin, tileIdx, false, ptrDeflated, chunkSize)) return false;
             TileDataPtr tileData(new TileData(getOptions()));
             tileData->setEncoding(false);
             tileData->setIndex(tileIdx);
@@ -725,10 +1147,11 @@ bool Graphics::mozToMOS(const std::string &inFile, const std::string &outFile) n
           // writing converted tiles to disk
           while (pool->hasResult() && pool->peekResult() != nullptr &&
                  (unsigned)pool->peekResult()->getIndex() == nextTileIdx) {
+            Stats::Timer timer(Stats::Stage::DRAIN);
             TileDataPtr retVal = pool->getResult();
             if (retVal == nullptr || retVal->isError()) {
               if (retVal != nullptr && !retVal->getErrorMsg().empty()) {
-                std::printf("\n%s", retVal->getErrorMsg().c_str());
+                Logger::Print("\n%s", retVal->getErrorMsg().c_str());
               }
               return false;
             }
@@ -741,104 +1164,434 @@ bool Graphics::mozToMOS(const std::string &inFile, const std::string &outFile) n
             nextTileIdx++;
           }
           if (tileIdx >= tileCount) {
-            pool->waitForResult();
+            pool->waitForResult(nextTileIdx);
           }
         }
-        if (getOptions().getVerbosity() == 1) std::printf("\n");
+        if (getOptions().getVerbosity() == 1) Logger::Print("\n");
 
         if (nextTileIdx < tileCount) {
-          std::printf("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
+          Logger::Print("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
           return false;
         }
 
+        if (!finishPipeline(&fin, nullptr, pool)) return false;
+
         // writing MOS/MOSC to disk
         if (!writeMos(fout, mosData, mosSize)) return false;
 
         // displaying summary
         if (!getOptions().isSilent()) {
-          std::printf("MOZ file converted successfully.\n");
+          Logger::Print("MOZ file converted successfully.\n");
         }
 
         fout.setDeleteOnClose(false);
         return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
       }
     } else {
-      std::printf("Error opening file \"%s\"\n", inFile.c_str());
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
     }
   }
   return false;
 }
 
 
-bool Graphics::readTIS(File &fin, unsigned &numTiles) noexcept
+bool Graphics::tizToTBC(const std::string &inFile, const std::string &outFile) noexcept
 {
-  char id[4];
-  bool isHeaderless = false;
-  uint32_t v32;
-
-  if (fin.read(id, 1, 4) != 4) return false;
-  if (std::strncmp(id, HEADER_TIS_SIGNATURE, 4) != 0) {
-    if (getOptions().assumeTis()) {
-      isHeaderless = true;
-    } else {
-      std::printf("Invalid TIS signature\n");
-      return false;
-    }
-  }
+  m_error = Error::NONE;
+  if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
+    File fin(inFile.c_str(), "rb");
+    if (!fin.error()) {
+      unsigned compType, tileCount;
 
-  if (!isHeaderless) {
-    if (fin.read(id, 1, 4) != 4) return false;
-    if (std::strncmp(id, HEADER_VERSION_V2, 4) == 0) {
-      if (!getOptions().isSilent()) {
-        std::printf("Warning: Incorrect TIS version 2 found. Converting anyway.\n");
-      }
-    } else if (std::strncmp(id, HEADER_VERSION_V1, 4) != 0) {
-      std::printf("Invalid TIS version\n");
-      return false;
-    }
+      // parsing TIZ header
+      if (!readTIZ(fin, compType, tileCount)) return false;
 
-    if (fin.read(&v32, 4, 1) != 1) return false;
-    numTiles = get32u_le(&v32);
-    if (numTiles == 0) {
-      std::printf("No tiles found\n");
-      return false;
-    }
+      File fout(outFile.c_str(), "wb");
+      fout.setDeleteOnClose(true);
+      if (!fout.error()) {
+        uint32_t v32;
 
-    if (fin.read(&v32, 4, 1) != 1) return false;
-    v32 = get32u_le(&v32);
-    if (v32 != 0x1400) {
-      if (v32 == 0x000c) {
-        std::printf("PVRZ-based TIS files are not supported\n");
-      } else {
-        std::printf("Invalid tile size\n");
-      }
-      return false;
-    }
+        // writing TBC header
+        if (fout.write(HEADER_TBC_SIGNATURE, 1, sizeof(HEADER_TBC_SIGNATURE)) != sizeof(HEADER_TBC_SIGNATURE)) return setError(Error::WRITE);
+        if (fout.write(getEncodedVersion(), 1, 4) != 4) return setError(Error::WRITE);
+        v32 = Options::GetEncodingCode(getOptions().getEncoding(), getOptions().isDeflate());
+        v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing encoding type
+        v32 = get32u_le(&tileCount);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile count
+        if (!getOptions().isSilent()) Logger::Print("Tile count: %d\n", tileCount);
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
 
-    if (fin.read(&v32, 4, 1) != 1) return false;
-    v32 = get32u_le(&v32);
-    if (v32 < 0x18) {
-      std::printf("Invalid header size\n");
-      return false;
+        // converting tiles (each worker decodes and encodes a single tile)
+        startPipeline(&fin, &fout);
+        ThreadPoolPtr pool = getThreadPool();
+        double ratioCount = 0.0;    // counts the compression ratios of all tiles
+        unsigned typeCount[4] = {0, 0, 0, 0};   // counts the selected pixel encoding types
+        bool success = processTiles(pool, tileCount,
+          [&](unsigned tileIdx) -> TileDataPtr {
+            uint32_t chunkSize;
+            BytePtr ptrSource;
+            if (!readZTile(fin, tileIdx, true, ptrSource, chunkSize)) return nullptr;
+            BytePtr ptrDeflated(new uint8_t[MAX_TILE_SIZE_32*2], std::default_delete<uint8_t[]>());
+            TileDataPtr tileData(new TileData(getOptions()));
+            tileData->setEncoding(true);
+            tileData->setIndex(tileIdx);
+            tileData->setType(Options::GetEncodingCode(getOptions().getEncoding(), getOptions().isDeflate()));
+            tileData->setSourceData(ptrSource, compType);
+            tileData->setDeflatedData(ptrDeflated);
+            tileData->setWidth(TILE_DIMENSION);
+            tileData->setHeight(TILE_DIMENSION);
+            return tileData;
+          },
+          [&](TileDataPtr tileData) {
+            double ratio = 0.0;
+            if (!writeEncodedTile(tileData, fout, ratio)) return false;
+            ratioCount += ratio;
+            typeCount[tileData->getTileType() & 3]++;
+            return true;
+          });
+        if (!success) return false;
+
+        if (!finishPipeline(&fin, &fout, pool)) return false;
+
+        // displaying summary
+        if (!getOptions().isSilent()) {
+          Logger::Print("TIZ file converted successfully. Total compression ratio: %.2f%%.\n",
+                        ratioCount / (double)tileCount);
+          if (getOptions().getEncoding() == Encoding::AUTO) showTileDistribution(typeCount, tileCount);
+        }
+
+        fout.setDeleteOnClose(false);
+        return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
+      }
+    } else {
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
+    }
+  }
+  return false;
+}
+
+
+bool Graphics::mozToMBC(const std::string &inFile, const std::string &outFile) noexcept
+{
+  m_error = Error::NONE;
+  if (!inFile.empty() && !outFile.empty() && inFile != outFile) {
+    File fin(inFile.c_str(), "rb");
+    if (!fin.error()) {
+      unsigned compType, mosWidth, mosHeight;
+
+      // parsing MOZ header
+      if (!readMOZ(fin, compType, mosWidth, mosHeight)) return false;
+
+      File fout(outFile.c_str(), "wb");
+      fout.setDeleteOnClose(true);
+      if (!fout.error()) {
+        uint32_t v32;
+        uint32_t mosCols = (mosWidth + 63) >> 6;
+        uint32_t mosRows = (mosHeight + 63) >> 6;
+        uint32_t tileCount = mosCols * mosRows;
+
+        // writing MBC header
+        if (fout.write(HEADER_MBC_SIGNATURE, 1, sizeof(HEADER_MBC_SIGNATURE)) != sizeof(HEADER_MBC_SIGNATURE)) return setError(Error::WRITE);
+        if (fout.write(getEncodedVersion(), 1, 4) != 4) return setError(Error::WRITE);
+        v32 = Options::GetEncodingCode(getOptions().getEncoding(), getOptions().isDeflate());
+        v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing encoding type
+        v32 = mosWidth; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing MOS width
+        v32 = mosHeight; v32 = get32u_le(&v32);
+        if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing MOS height
+
+        if (getOptions().isVerbose()) {
+          Logger::Print("Width: %d, height: %d, columns: %d, rows: %d, encoding: %d - %s\n",
+                        mosWidth, mosHeight, mosCols, mosRows, compType, Options::GetEncodingName(compType).c_str());
+        }
+        if (getOptions().getVerbosity() == 1) Logger::Print("Converting");
+
+        // processing tiles (each worker decodes and encodes a single tile)
+        startPipeline(&fin, &fout);
+        ThreadPoolPtr pool = getThreadPool();
+        double ratioCount = 0.0;              // counts the compression ratios of all tiles
+        unsigned typeCount[4] = {0, 0, 0, 0}; // counts the selected pixel encoding types
+        bool success = processTiles(pool, tileCount,
+          [&](unsigned tileIdx) -> TileDataPtr {
+            int row = tileIdx / mosCols;
+            int col = tileIdx % mosCols;
+            int tileWidth = std::min(TILE_DIMENSION, mosWidth - col*TILE_DIMENSION);
+            int tileHeight = std::min(TILE_DIMENSION, mosHeight - row*TILE_DIMENSION);
+            uint32_t chunkSize;
+            BytePtr ptrSource;
+            if (!readZTile(fin, tileIdx, false, ptrSource, chunkSize)) return nullptr;
+            BytePtr ptrDeflated(new uint8_t[MAX_TILE_SIZE_32*2], std::default_delete<uint8_t[]>());
+            TileDataPtr tileData(new TileData(getOptions()));
+            tileData->setEncoding(true);
+            tileData->setIndex(tileIdx);
+            tileData->setType(Options::GetEncodingCode(getOptions().getEncoding(), getOptions().isDeflate()));
+            tileData->setSourceData(ptrSource, compType);
+            tileData->setDeflatedData(ptrDeflated);
+            tileData->setWidth(tileWidth);
+            tileData->setHeight(tileHeight);
+            return tileData;
+          },
+          [&](TileDataPtr tileData) {
+            double ratio = 0.0;
+            if (!writeEncodedTile(tileData, fout, ratio)) return false;
+            ratioCount += ratio;
+            typeCount[tileData->getTileType() & 3]++;
+            return true;
+          });
+        if (!success) return false;
+
+        if (!finishPipeline(&fin, &fout, pool)) return false;
+
+        // displaying summary
+        if (!getOptions().isSilent()) {
+          Logger::Print("MOZ file converted successfully. Total compression ratio: %.2f%%.\n",
+                        ratioCount / (double)tileCount);
+          if (getOptions().getEncoding() == Encoding::AUTO) showTileDistribution(typeCount, tileCount);
+        }
+
+        fout.setDeleteOnClose(false);
+        return true;
+      } else {
+        Logger::Print("Error creating file \"%s\"\n", outFile.c_str());
+        setError(Error::WRITE);
+      }
+    } else {
+      Logger::Print("Error opening file \"%s\"\n", inFile.c_str());
+      setError(Error::READ);
+    }
+  }
+  return false;
+}
+
+
+void Graphics::setThreadPool(ThreadPoolPtr pool) noexcept
+{
+  m_threadPool = pool;
+  m_sharedPool = (pool != nullptr);
+}
+
+
+ThreadPoolPtr Graphics::getThreadPool() noexcept
+{
+  if (m_sharedPool) {
+    // discarding pending tiles of a failed conversion
+    while (!m_threadPool->finished()) {
+      m_threadPool->waitForResult();
+      m_threadPool->getResult();
+    }
+  } else if (m_threadPool == nullptr || !m_threadPool->finished() ||
+             m_poolThreads != getOptions().getThreads()) {
+    // a pool left with pending tiles by a failed conversion can't be reused
+    m_threadPool.reset();
+    m_poolThreads = getOptions().getThreads();
+    m_threadPool = createThreadPool(m_poolThreads, 1);
+  }
+  // input queue is sized from the tile latencies of the current file
+  m_threadPool->setAdaptiveTiles();
+  m_threadPool->setCostOrdered(getOptions().isCostOrder());
+  m_threadPool->setThreadAffinity(Affinity::GetWorkerCpus(getOptions().getAffinity(), m_threadPool->getThreadCount()));
+  m_threadPool->resetStatistics();
+  return m_threadPool;
+}
+
+
+void Graphics::startPipeline(File *fin, File *fout) noexcept
+{
+  // fewer queued blocks if the memory budget is tight: each stage may use a quarter of the remaining memory
+  unsigned numBlocks = STAGE_BLOCKS;
+  if (MemoryBudget::IsLimited()) {
+    uint64_t blocks = MemoryBudget::GetAvailable() / 4 / STAGE_BLOCK_SIZE;
+    numBlocks = (unsigned)std::max((uint64_t)1, std::min((uint64_t)STAGE_BLOCKS, blocks));
+  }
+  if (fin != nullptr) {
+    // a separate reader doesn't pay off for data that fits into a single block
+    long pos = fin->tell();
+    long size = fin->getsize();
+    if (pos >= 0 && size - pos > (long)STAGE_BLOCK_SIZE) fin->startReadAhead(STAGE_BLOCK_SIZE, numBlocks);
+  }
+  if (fout != nullptr) fout->startWriteBehind(STAGE_BLOCK_SIZE, numBlocks);
+}
+
+
+bool Graphics::finishPipeline(File *fin, File *fout, ThreadPoolPtr pool) noexcept
+{
+  if (fin != nullptr) fin->stopStage();
+  if (fout != nullptr && !fout->stopStage()) {
+    Logger::Print("Error writing output file\n");
+    return setError(Error::WRITE);
+  }
+
+  if (getOptions().isVerbose()) {
+    const FileStage *reader = (fin != nullptr) ? fin->getStage() : nullptr;
+    const FileStage *writer = (fout != nullptr) ? fout->getStage() : nullptr;
+    Logger::Print("Pipeline queue occupancy:");
+    if (reader != nullptr) {
+      Logger::Print(" reader %.1f/%d blocks (%d stalls),",
+                    reader->getAverageBlocks(), reader->getMaxBlocks(), reader->getStalls());
+    }
+    Logger::Print(" workers %.1f/%d-%d tiles (%d stalls)",
+                  pool->getAverageTiles(), pool->getMinTilesUsed(), pool->getMaxTilesUsed(), pool->getStalls());
+    if (writer != nullptr) {
+      Logger::Print(", writer %.1f/%d blocks (%d stalls)",
+                    writer->getAverageBlocks(), writer->getMaxBlocks(), writer->getStalls());
+    }
+    Logger::Print("\n");
+  }
+
+  // worker threads running out of tiles at the end of the file
+  uint64_t tail = pool->getTailTime();
+  if (tail > 0) {
+    uint64_t idle = pool->getTailIdleTime();
+    if (Stats::IsEnabled()) Stats::AddTail(tail, idle, pool->getThreadCount());
+    if (getOptions().isVerbose()) {
+      Logger::Print("Tail after last tile: %.2f ms, workers idle %.1f%%\n",
+                    tail / 1e6, 100.0 * idle / ((double)tail * pool->getThreadCount()));
+    }
+  }
+  return true;
+}
+
+
+bool Graphics::processTiles(ThreadPoolPtr pool, unsigned tileCount,
+                            const std::function<TileDataPtr(unsigned)> &createTile,
+                            const std::function<bool(TileDataPtr)> &storeTile) noexcept
+{
+  unsigned tileIdx = 0, nextTileIdx = 0, curProgress = 0;
+  while (tileIdx < tileCount || !pool->finished()) {
+    // creating new tile data object
+    if (tileIdx < tileCount) {
+      TileDataPtr tileData = createTile(tileIdx);
+      if (tileData == nullptr) return false;
+      pool->addTileData(tileData);
+      tileIdx++;
+    }
+
+    // storing converted tiles in order
+    while (pool->hasResult() && pool->peekResult() != nullptr &&
+           (unsigned)pool->peekResult()->getIndex() == nextTileIdx) {
+      Stats::Timer timer(Stats::Stage::DRAIN);
+      TileDataPtr retVal = pool->getResult();
+      if (retVal == nullptr || retVal->isError()) {
+        if (retVal != nullptr && !retVal->getErrorMsg().empty()) {
+          Logger::Print("\n%s", retVal->getErrorMsg().c_str());
+        }
+        return false;
+      }
+      if (!storeTile(retVal)) return false;
+      if (getOptions().getVerbosity() == 1) {
+        curProgress = showProgress(nextTileIdx, tileCount, curProgress, MAX_PROGRESS, '.');
+      }
+      nextTileIdx++;
+    }
+    if (tileIdx >= tileCount) {
+      pool->waitForResult(nextTileIdx);
+    }
+  }
+  if (getOptions().getVerbosity() == 1) Logger::Print("\n");
+
+  if (nextTileIdx < tileCount) {
+    Logger::Print("Missing tiles. Only %d of %d tiles converted.\n", nextTileIdx, tileCount);
+    return false;
+  }
+  return true;
+}
+
+
+bool Graphics::setError(Error error) const noexcept
+{
+  if (m_error == Error::NONE) m_error = error;
+  return false;
+}
+
+
+bool Graphics::setReadError(File &fin) const noexcept
+{
+  return setError(fin.error() ? Error::READ : Error::DATA);
+}
+
+
+bool Graphics::readTIS(File &fin, unsigned &numTiles, bool &isPvrz) noexcept
+{
+  char id[4];
+  bool isHeaderless = false;
+  uint32_t v32;
+
+  isPvrz = false;
+
+  if (fin.read(id, 1, 4) != 4) return setReadError(fin);
+  if (std::strncmp(id, HEADER_TIS_SIGNATURE, 4) != 0) {
+    if (getOptions().assumeTis()) {
+      isHeaderless = true;
+    } else {
+      Logger::Print("Invalid TIS signature\n");
+      return setError(Error::DATA);
+    }
+  }
+
+  if (!isHeaderless) {
+    if (fin.read(id, 1, 4) != 4) return setReadError(fin);
+    if (std::strncmp(id, HEADER_VERSION_V2, 4) == 0) {
+      if (!getOptions().isSilent()) {
+        Logger::Print("Warning: Incorrect TIS version 2 found. Converting anyway.\n");
+      }
+    } else if (std::strncmp(id, HEADER_VERSION_V1, 4) != 0) {
+      Logger::Print("Invalid TIS version\n");
+      return setError(Error::DATA);
+    }
+
+    if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
+    numTiles = get32u_le(&v32);
+    if (numTiles == 0) {
+      Logger::Print("No tiles found\n");
+      return setError(Error::DATA);
     }
 
-    if (fin.read(&v32, 4, 1) != 1) return false;
+    if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
+    v32 = get32u_le(&v32);
+    if (v32 == 0x000c) {
+      isPvrz = true;
+    } else if (v32 != 0x1400) {
+      Logger::Print("Invalid tile size\n");
+      return setError(Error::DATA);
+    }
+
+    uint32_t headerSize;
+    if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
+    headerSize = get32u_le(&v32);
+    if (headerSize < 0x18) {
+      Logger::Print("Invalid header size\n");
+      return setError(Error::DATA);
+    }
+
+    if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
     v32 = get32u_le(&v32);
     if (v32 != 0x40) {
-      std::printf("Invalid tile dimensions\n");
-      return false;
+      Logger::Print("Invalid tile dimensions\n");
+      return setError(Error::DATA);
     }
+
+    if (isPvrz && !fin.seek(headerSize, SEEK_SET)) return setError(Error::READ);
   } else {
     long size = fin.getsize();
     fin.seek(0L, SEEK_SET);
     if (size < 0L) {
-      std::printf("Error reading input file\n");
-      return false;
+      Logger::Print("Error reading input file\n");
+      return setError(Error::READ);
     } else if ((size % 5120) != 0) {
-      std::printf("Headerless TIS has wrong file size\n");
-      return false;
+      Logger::Print("Headerless TIS has wrong file size\n");
+      return setError(Error::DATA);
     } else {
-      if (!getOptions().isSilent()) std::printf("Warning: Headerless TIS file detected\n");
+      if (!getOptions().isSilent()) Logger::Print("Warning: Headerless TIS file detected\n");
       numTiles = (unsigned)size / 0x1400;
     }
   }
@@ -847,114 +1600,134 @@ bool Graphics::readTIS(File &fin, unsigned &numTiles) noexcept
 }
 
 
-bool Graphics::readMOS(File &fin, BytePtr &mos, unsigned &width, unsigned &height,
-                       unsigned &palOfs) noexcept
+bool Graphics::readMOS(File &fin, BytePtr &mos, InflateStreamPtr &stream, unsigned &width, unsigned &height,
+                       unsigned &palOfs, unsigned &numBlocks) noexcept
 {
+  numBlocks = 0;
+  stream.reset();
+
   char id[4];
-  uint32_t v32, mosSize;
+  uint32_t v32, mosSize, mosLoaded;
 
   // loading MOS/MOSC input file
-  if (fin.read(id, 1, 4) != 4) return false;;
+  if (fin.read(id, 1, 4) != 4) return setReadError(fin);
   if (std::strncmp(id, HEADER_MOSC_SIGNATURE, 4) == 0) {    // decompressing MOSC
-    uint32_t moscSize;
-    Compression compression;
-
     // getting MOSC file size
-    moscSize = fin.getsize();
-    if (moscSize <= 12) {
-      std::printf("Invalid MOSC size\n");
-      return false;
+    if (fin.getsize() <= 12) {
+      Logger::Print("Invalid MOSC size\n");
+      return setError(Error::DATA);
     }
-    moscSize -= 12;    // removing header size
 
-    if (fin.read(&id, 1, 4) != 4) return false;
+    if (fin.read(&id, 1, 4) != 4) return setReadError(fin);
     if (std::strncmp(id, HEADER_VERSION_V1, 4) != 0) {
-      std::printf("Invalid MOSC version\n");
-      return false;
+      Logger::Print("Invalid MOSC version\n");
+      return setError(Error::DATA);
     }
 
-    if (fin.read(&v32, 4, 1) != 1) return false;
+    if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
     mosSize = get32u_le(&v32);
     if (mosSize < 24) {
-      std::printf("MOS size too small\n");
-      return false;
-    }
-    BytePtr moscData(new uint8_t[moscSize], std::default_delete<uint8_t[]>());
-    if (fin.read(moscData.get(), 1, moscSize) < moscSize) {
-      std::printf("Incomplete or corrupted MOSC file\n");
-      return false;
+      Logger::Print("MOS size too small\n");
+      return setError(Error::DATA);
     }
 
-    mos.reset(new uint8_t[mosSize], std::default_delete<uint8_t[]>());
-    unsigned size = compression.inflate(moscData.get(), moscSize, mos.get(), mosSize);
-    if (size != mosSize) {
-      std::printf("Error while decompressing MOSC input file\n");
-      return false;
-    }
+    // MOS data is decompressed on demand
+    stream.reset(new InflateStream(fin, mosSize));
+    mosLoaded = 0;
+    if (!inflateMosData(stream, mos, mosLoaded, 24)) return false;
   } else if (std::strncmp(id, HEADER_MOS_SIGNATURE, 4) == 0) {   // loading MOS data
     mosSize = fin.getsize();
     if (mosSize < 24) {
-      std::printf("MOS size too small\n");
-      return false;
+      Logger::Print("MOS size too small\n");
+      return setError(Error::DATA);
     }
     fin.seek(0, SEEK_SET);
-    mos.reset(new uint8_t[mosSize], std::default_delete<uint8_t[]>());
-    if (fin.read(mos.get(), 1, mosSize) != mosSize) return false;
+    mos.reset(new(std::nothrow) uint8_t[mosSize], std::default_delete<uint8_t[]>());
+    if (mos == nullptr) {
+      Logger::Print("Not enough memory for MOS data\n");
+      return setError(Error::MEMORY);
+    }
+    if (fin.read(mos.get(), 1, mosSize) != mosSize) return setReadError(fin);
+    mosLoaded = mosSize;
   } else {
-    std::printf("Invalid MOS signature\n");
-    return false;
+    Logger::Print("Invalid MOS signature\n");
+    return setError(Error::DATA);
   }
 
   // parsing MOS header
   uint32_t inOfs = 0;
   if (std::memcmp(mos.get()+inOfs, HEADER_MOS_SIGNATURE, 4) != 0) {
-    std::printf("Invalid MOS signature\n");
-    return false;
+    Logger::Print("Invalid MOS signature\n");
+    return setError(Error::DATA);
   }
   inOfs += 4;
 
-  if (std::memcmp(mos.get()+inOfs, HEADER_VERSION_V1, 4) != 0) {
-    std::printf("Unsupported MOS version\n");
-    return false;
+  if (std::memcmp(mos.get()+inOfs, HEADER_VERSION_V2, 4) == 0) {
+    // PVRZ-based MOS
+    if (stream != nullptr) {
+      if (!inflateMosData(stream, mos, mosLoaded, mosSize)) return false;
+      stream.reset();
+    }
+    inOfs += 4;
+    width = get32u_le((uint32_t*)(mos.get()+inOfs));
+    height = get32u_le((uint32_t*)(mos.get()+inOfs+4));
+    if (width == 0 || height == 0) {
+      Logger::Print("Invalid MOS dimensions\n");
+      return setError(Error::DATA);
+    }
+    numBlocks = get32u_le((uint32_t*)(mos.get()+inOfs+8));
+    if (numBlocks == 0) {
+      Logger::Print("Invalid number of data blocks\n");
+      return setError(Error::DATA);
+    }
+    palOfs = get32u_le((uint32_t*)(mos.get()+inOfs+12));
+    if (palOfs < HEADER_MOS_V2_SIZE || palOfs > mosSize || (mosSize - palOfs) / 28 < numBlocks) {
+      Logger::Print("Incomplete or corrupted MOS file\n");
+      return setError(Error::DATA);
+    }
+    return true;
+  } else if (std::memcmp(mos.get()+inOfs, HEADER_VERSION_V1, 4) != 0) {
+    Logger::Print("Unsupported MOS version\n");
+    return setError(Error::DATA);
   }
   inOfs += 4;
 
   width = get16u_le((uint16_t*)(mos.get()+inOfs));
   if (width == 0) {
-    std::printf("Invalid MOS width\n");
-    return false;
+    Logger::Print("Invalid MOS width\n");
+    return setError(Error::DATA);
   }
   inOfs += 2;
 
   height = get16u_le((uint16_t*)(mos.get()+inOfs));
   if (height == 0) {
-    std::printf("Invalid MOS height\n");
-    return false;
+    Logger::Print("Invalid MOS height\n");
+    return setError(Error::DATA);
   }
   inOfs += 2;
 
   if (get16u_le((uint16_t*)(mos.get()+inOfs)) == 0) {
-    std::printf("Invalid number of tiles\n");
-    return false;
+    Logger::Print("Invalid number of tiles\n");
+    return setError(Error::DATA);
   }
   inOfs += 2;
 
   if (get16u_le((uint16_t*)(mos.get()+inOfs)) == 0) {
-    std::printf("Invalid number of tiles\n");
-    return false;
+    Logger::Print("Invalid number of tiles\n");
+    return setError(Error::DATA);
   }
   inOfs += 2;
 
   if (get32u_le((uint32_t*)(mos.get()+inOfs)) != 0x40) {
-    std::printf("Invalid tile dimensions\n");
-    return false;
+    Logger::Print("Invalid tile dimensions\n");
+    return setError(Error::DATA);
   }
   inOfs += 4;
 
   palOfs = get32u_le((uint32_t*)(mos.get()+inOfs));
   if (palOfs < 24) {
-    std::printf("MOS header too small\n");
-    return false;
+    Logger::Print("MOS header too small\n");
+    return setError(Error::DATA);
   }
   inOfs = palOfs;
 
@@ -964,7 +1737,11 @@ bool Graphics::readMOS(File &fin, BytePtr &mos, unsigned &width, unsigned &heigh
     // comparing calculated size with actual input file length
     uint32_t size = palOfs + cols*rows*PALETTE_SIZE + cols*rows*4 + width*height;
     if (mosSize < size) {
-      std::printf("Incomplete or corrupted MOS file\n");
+      Logger::Print("Incomplete or corrupted MOS file\n");
+      return setError(Error::DATA);
+    }
+    // MOSC: only palettes and tile offsets are decompressed in advance
+    if (stream != nullptr && !inflateMosData(stream, mos, mosLoaded, palOfs + cols*rows*(PALETTE_SIZE+4))) {
       return false;
     }
   }
@@ -973,32 +1750,60 @@ bool Graphics::readMOS(File &fin, BytePtr &mos, unsigned &width, unsigned &heigh
 }
 
 
+bool Graphics::inflateMosData(InflateStreamPtr &stream, BytePtr &mos, uint32_t &loaded, uint32_t size) noexcept
+{
+  if (stream != nullptr && size > loaded) {
+    const uint8_t *data = stream->getData(loaded, size - loaded);
+    if (data == nullptr) {
+      Logger::Print("Error while decompressing MOSC input file\n");
+      return setError(Error::DATA);
+    }
+    BytePtr buffer(new(std::nothrow) uint8_t[size], std::default_delete<uint8_t[]>());
+    if (buffer == nullptr) {
+      Logger::Print("Not enough memory for MOS data\n");
+      return setError(Error::MEMORY);
+    }
+    if (loaded > 0) std::memcpy(buffer.get(), mos.get(), loaded);
+    std::memcpy(buffer.get()+loaded, data, size - loaded);
+    stream->discard(size);
+    mos = buffer;
+    loaded = size;
+  }
+  return true;
+}
+
+
 bool Graphics::readTBC(File &fin, unsigned &type, unsigned &numTiles) noexcept
 {
   char id[4];
   uint32_t v32;
 
   // parsing TBC header
-  if (fin.read(id, 1, 4) != 4) return false;;
+  if (fin.read(id, 1, 4) != 4) return setReadError(fin);
   if (std::strncmp(id, HEADER_TBC_SIGNATURE, 4) != 0) {
-    std::printf("Invalid TBC signature\n");
-    return false;
+    Logger::Print("Invalid TBC signature\n");
+    return setError(Error::DATA);
   }
 
-  if (fin.read(id, 1, 4) != 4) return false;
-  if (std::strncmp(id, HEADER_VERSION_V1_0, 4) != 0) {
-    std::printf("Unsupported TBC version\n");
-    return false;
+  if (fin.read(id, 1, 4) != 4) return setReadError(fin);
+  bool isV1_1 = (std::strncmp(id, HEADER_VERSION_V1_1, 4) == 0);
+  if (!isV1_1 && std::strncmp(id, HEADER_VERSION_V1_0, 4) != 0) {
+    Logger::Print("Unsupported TBC version\n");
+    return setError(Error::DATA);
   }
 
-  if (fin.read(&v32, 4, 1) != 1) return false;
+  if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
   type = get32u_le(&v32);
+  if (!isV1_1 && Options::GetEncodingType(type) == Encoding::AUTO) {
+    Logger::Print("Per-tile encoding requires TBC version 1.1\n");
+    return setError(Error::DATA);
+  }
 
-  if (fin.read(&v32, 4, 1) != 1) return false;
+  if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
   numTiles = get32u_le(&v32);
   if (numTiles == 0) {
-    std::printf("No tiles found\n");
-    return false;
+    Logger::Print("No tiles found\n");
+    return setError(Error::DATA);
   }
 
   return true;
@@ -1011,33 +1816,38 @@ bool Graphics::readMBC(File &fin, unsigned &type, unsigned &width, unsigned &hei
   uint32_t v32;
 
   // parsing TBC header
-  if (fin.read(id, 1, 4) != 4) return false;;
+  if (fin.read(id, 1, 4) != 4) return setReadError(fin);
   if (std::strncmp(id, HEADER_MBC_SIGNATURE, 4) != 0) {
-    std::printf("Invalid MBC signature\n");
-    return false;
+    Logger::Print("Invalid MBC signature\n");
+    return setError(Error::DATA);
   }
 
-  if (fin.read(id, 1, 4) != 4) return false;
-  if (std::strncmp(id, HEADER_VERSION_V1_0, 4) != 0) {
-    std::printf("Invalid MBC version\n");
-    return false;
+  if (fin.read(id, 1, 4) != 4) return setReadError(fin);
+  bool isV1_1 = (std::strncmp(id, HEADER_VERSION_V1_1, 4) == 0);
+  if (!isV1_1 && std::strncmp(id, HEADER_VERSION_V1_0, 4) != 0) {
+    Logger::Print("Invalid MBC version\n");
+    return setError(Error::DATA);
   }
 
-  if (fin.read(&v32, 4, 1) != 1) return false;
+  if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
   type = get32u_le(&v32);
+  if (!isV1_1 && Options::GetEncodingType(type) == Encoding::AUTO) {
+    Logger::Print("Per-tile encoding requires MBC version 1.1\n");
+    return setError(Error::DATA);
+  }
 
-  if (fin.read(&v32, 4, 1) != 1) return false;
+  if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
   width = get32u_le(&v32);
   if (width == 0) {
-    std::printf("Invalid MBC width\n");
-    return false;
+    Logger::Print("Invalid MBC width\n");
+    return setError(Error::DATA);
   }
 
-  if (fin.read(&v32, 4, 1) != 1) return false;
+  if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
   height = get32u_le(&v32);
   if (height == 0) {
-    std::printf("Invalid MBC height\n");
-    return false;
+    Logger::Print("Invalid MBC height\n");
+    return setError(Error::DATA);
   }
 
   return true;
@@ -1052,21 +1862,21 @@ bool Graphics::readTIZ(File &fin, unsigned &type, unsigned &numTiles) noexcept
   type = Options::GetEncodingCode(Encoding::Z, false);
 
   // parsing TIZ header
-  if (fin.read(id, 1, 4) != 4) return false;;
+  if (fin.read(id, 1, 4) != 4) return setReadError(fin);
   if (std::strncmp(id, HEADER_TIZ_SIGNATURE, 4) != 0) {
-    std::printf("Invalid TIZ signature\n");
-    return false;
+    Logger::Print("Invalid TIZ signature\n");
+    return setError(Error::DATA);
   }
 
-  if (fin.read(&v16, 2, 1) != 1) return false;
+  if (fin.read(&v16, 2, 1) != 1) return setReadError(fin);
   numTiles = get16u_be(&v16);
   if (numTiles == 0) {
-    std::printf("No tiles found\n");
-    return false;
+    Logger::Print("No tiles found\n");
+    return setError(Error::DATA);
   }
 
   // skipping 2 bytes
-  if (fin.read(&v16, 2, 1) != 1) return false;
+  if (fin.read(&v16, 2, 1) != 1) return setReadError(fin);
 
   return true;
 }
@@ -1080,58 +1890,366 @@ bool Graphics::readMOZ(File &fin, unsigned &type, unsigned &width, unsigned &hei
   type = Options::GetEncodingCode(Encoding::Z, false);
 
   // parsing TIZ header
-  if (fin.read(id, 1, 4) != 4) return false;;
+  if (fin.read(id, 1, 4) != 4) return setReadError(fin);
   if (std::strncmp(id, HEADER_MOZ_SIGNATURE, 4) != 0) {
-    std::printf("Invalid MOZ signature\n");
-    return false;
+    Logger::Print("Invalid MOZ signature\n");
+    return setError(Error::DATA);
   }
 
-  if (fin.read(&v16, 2, 1) != 1) return false;
+  if (fin.read(&v16, 2, 1) != 1) return setReadError(fin);
   width = get16u_be(&v16);
   if (width == 0) {
-    std::printf("Invalid MOZ width\n");
-    return false;
+    Logger::Print("Invalid MOZ width\n");
+    return setError(Error::DATA);
   }
 
-  if (fin.read(&v16, 2, 1) != 1) return false;
+  if (fin.read(&v16, 2, 1) != 1) return setReadError(fin);
   height = get16u_be(&v16);
   if (height == 0) {
-    std::printf("Invalid MOZ height\n");
-    return false;
+    Logger::Print("Invalid MOZ height\n");
+    return setError(Error::DATA);
   }
 
   return true;
 }
 
 
+bool Graphics::readZTile(File &fin, unsigned tileIdx, bool isTiz, BytePtr &data, uint32_t &size) noexcept
+{
+  char tsig[4];
+  if (fin.read(tsig, 1, 4) != 4) return setReadError(fin);
+  // MOZ supports jpeg compressed tiles only
+  if ((isTiz && (std::strncmp(tsig, HEADER_TIL0_SIGNATURE, 4) == 0 ||
+                 std::strncmp(tsig, HEADER_TIL1_SIGNATURE, 4) == 0)) ||
+      std::strncmp(tsig, HEADER_TIL2_SIGNATURE, 4) == 0) {
+    uint16_t tileSize;
+    if (fin.read(&tileSize, 2, 1) != 1) return setReadError(fin);
+    size = get16u_be(&tileSize);
+    data.reset(new uint8_t[size+6], std::default_delete<uint8_t[]>());
+    std::memcpy(data.get(), tsig, 4);
+    std::memcpy(data.get()+4, &tileSize, 2);
+    if (fin.read(data.get()+6, 1, size) != size) return setReadError(fin);
+    size += 6;
+    return true;
+  } else {
+    Logger::Print("\nInvalid header found in tile #%d\n", tileIdx);
+    return setError(Error::DATA);
+  }
+}
+
+
 bool Graphics::writeMos(File &fout, BytePtr &mos, unsigned size) noexcept
 {
   if (mos != nullptr && size > 0) {
     if (getOptions().isMosc()) {
       // compressing mos -> mosc
-      uint32_t moscSize = size*2;
       uint32_t v32;
-      Compression compression;
-      BytePtr moscData(new uint8_t[moscSize], std::default_delete<uint8_t[]>());
 
       // writing MOSC header
-      std::memcpy(moscData.get(), HEADER_MOSC_SIGNATURE, 4);
-      std::memcpy(moscData.get()+4, HEADER_VERSION_V1, 4);
-      v32 = size;
-      *(uint32_t*)(moscData.get()+8) = get32u_le(&v32);
-
-      // compressing data
-      moscSize = compression.deflate(mos.get(), size, moscData.get()+12, moscSize-12);
-      moscSize += 12;
+      if (fout.write(HEADER_MOSC_SIGNATURE, 1, 4) != 4) return setError(Error::WRITE);
+      if (fout.write(HEADER_VERSION_V1, 1, 4) != 4) return setError(Error::WRITE);
+      v32 = size; v32 = get32u_le(&v32);
+      if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);
 
-      // writing cmos data to file
-      if (fout.write(moscData.get(), 1, moscSize) == moscSize) return true;
+      // compressing data in parallel with the thread pool of the conversion
+      if (Compression::DeflateParallel(fout, mos.get(), size, m_threadPool.get()) > 0) return true;
     } else {
       // writing mos data to file
       if (fout.write(mos.get(), 1, size) == size) return true;
     }
   }
-  return false;
+  return setError(Error::WRITE);
+}
+
+
+bool Graphics::writeBitmapHeader(File &fout, unsigned width, unsigned height, unsigned tileCount) noexcept
+{
+  uint32_t v32;
+  if (fout.write(HEADER_BM32_SIGNATURE, 1, sizeof(HEADER_BM32_SIGNATURE)) != sizeof(HEADER_BM32_SIGNATURE)) return setError(Error::WRITE);
+  if (fout.write(HEADER_VERSION_V1_0, 1, sizeof(HEADER_VERSION_V1_0)) != sizeof(HEADER_VERSION_V1_0)) return setError(Error::WRITE);
+  v32 = getOptions().getBitmapFormat(); v32 = get32u_le(&v32);
+  if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing color format
+  v32 = width; v32 = get32u_le(&v32);
+  if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing width
+  v32 = height; v32 = get32u_le(&v32);
+  if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing height
+  v32 = tileCount; v32 = get32u_le(&v32);
+  if (fout.write(&v32, 4, 1) != 1) return setError(Error::WRITE);    // writing tile count
+  return true;
+}
+
+
+bool Graphics::isPvrzCompatible(unsigned type) const noexcept
+{
+  switch (Options::GetEncodingType(type)) {
+    case Encoding::BC1:
+    case Encoding::BC3:
+      return true;
+    default:
+      Logger::Print("Pixel encoding not supported by PVRZ: %d - %s\n", type, Options::GetEncodingName(type).c_str());
+      return setError(Error::DATA);
+  }
+}
+
+
+PvrzPtr Graphics::createPvrzPage(unsigned type, unsigned tileCount) const noexcept
+{
+  // last page is shrunk to the smallest power of two dimensions that fit the remaining tiles
+  unsigned cols = std::min(tileCount, PVRZ_PAGE_COLS);
+  unsigned rows = (tileCount + PVRZ_PAGE_COLS - 1) / PVRZ_PAGE_COLS;
+  PvrzPtr page(new Pvrz(type, Pvrz::GetPageDimension(cols*TILE_DIMENSION),
+                        Pvrz::GetPageDimension(rows*TILE_DIMENSION)));
+  if (!page->isValid()) {
+    Logger::Print("\nError while creating PVRZ page\n");
+    return PvrzPtr(nullptr);
+  }
+  return page;
+}
+
+
+std::string Graphics::getPvrzFileName(const std::string &outFile, bool isTis, unsigned index) const noexcept
+{
+  char name[16];
+  std::string base;
+  if (isTis) {
+    // TIS: first character and map number of the tileset name (e.g. AR2600.TIS -> A260000.PVRZ)
+    base = File::ExtractFileBase(outFile);
+    if (base.size() > 2) base = base.substr(0, 1) + base.substr(2);
+    std::snprintf(name, sizeof(name), "%02d.pvrz", index);
+  } else {
+    base = "mos";
+    std::snprintf(name, sizeof(name), "%04d.pvrz", index);
+  }
+  return File::CreateFileName(File::ExtractFilePath(outFile), base + name);
+}
+
+
+bool Graphics::writePvrzPages(File &fin, unsigned type, unsigned tileCount, const std::string &outFile, bool isTis,
+                              unsigned firstPage,
+                              const std::function<bool(unsigned tileIdx, unsigned page, int x, int y,
+                                                       int width, int height)> &writeEntry) noexcept
+{
+  std::list<std::string> pvrzFiles;
+  Compression compression;
+  BytePtr ptrBlocks(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+  PvrzPtr page;
+  unsigned curProgress = 0;
+  for (unsigned tileIdx = 0; tileIdx < tileCount; tileIdx++) {
+    unsigned pageIdx = tileIdx / PVRZ_PAGE_TILES;
+    unsigned cellIdx = tileIdx % PVRZ_PAGE_TILES;
+    if (cellIdx == 0) {
+      page = createPvrzPage(type, std::min(tileCount - tileIdx, PVRZ_PAGE_TILES));
+      if (page == nullptr) {
+        removeFiles(pvrzFiles);
+        return false;
+      }
+    }
+
+    int width, height;
+    if (!readEncodedBlocks(fin, type, tileIdx, compression, ptrBlocks, width, height)) {
+      removeFiles(pvrzFiles);
+      return false;
+    }
+    int x = (cellIdx % PVRZ_PAGE_COLS) * TILE_DIMENSION;
+    int y = (cellIdx / PVRZ_PAGE_COLS) * TILE_DIMENSION;
+    if (!page->putBlocks(ptrBlocks.get() + HEADER_TILE_ENCODED_SIZE, width, height, x, y)) {
+      Logger::Print("\nError while copying tile #%d\n", tileIdx);
+      removeFiles(pvrzFiles);
+      return false;
+    }
+    if (!writeEntry(tileIdx, firstPage + pageIdx, x, y, width, height)) {
+      removeFiles(pvrzFiles);
+      return setError(Error::WRITE);
+    }
+
+    // writing completed page to disk
+    if (cellIdx + 1 == PVRZ_PAGE_TILES || tileIdx + 1 == tileCount) {
+      std::string pvrzFile = getPvrzFileName(outFile, isTis, firstPage + pageIdx);
+      if (!page->save(pvrzFile)) {
+        removeFiles(pvrzFiles);
+        return setError(Error::WRITE);
+      }
+      pvrzFiles.push_back(pvrzFile);
+    }
+
+    if (getOptions().getVerbosity() == 1) {
+      curProgress = showProgress(tileIdx, tileCount, curProgress, MAX_PROGRESS, '.');
+    }
+  }
+  if (getOptions().getVerbosity() == 1) Logger::Print("\n");
+  return true;
+}
+
+
+bool Graphics::readEncodedBlocks(File &fin, unsigned type, unsigned tileIdx, Compression &compression,
+                                 BytePtr data, int &width, int &height) noexcept
+{
+  uint32_t v32, chunkSize;
+  if (fin.read(&v32, 4, 1) != 1) return setReadError(fin);
+  chunkSize = get32u_le(&v32);
+  if (chunkSize <= HEADER_TILE_ENCODED_SIZE || (Options::IsTileDeflated(type) && chunkSize > MAX_TILE_SIZE_32*2) ||
+      (!Options::IsTileDeflated(type) && chunkSize > MAX_TILE_SIZE_32)) {
+    Logger::Print("\nInvalid block size found for tile #%d\n", tileIdx);
+    return setError(Error::DATA);
+  }
+
+  if (Options::IsTileDeflated(type)) {
+    BytePtr ptrDeflated(new uint8_t[chunkSize], std::default_delete<uint8_t[]>());
+    if (fin.read(ptrDeflated.get(), 1, chunkSize) != chunkSize) return setReadError(fin);
+    if (compression.inflate(ptrDeflated.get(), chunkSize, data.get(), MAX_TILE_SIZE_32) <= HEADER_TILE_ENCODED_SIZE) {
+      Logger::Print("\nError while inflating tile #%d\n", tileIdx);
+      return setError(Error::DATA);
+    }
+  } else {
+    if (fin.read(data.get(), 1, chunkSize) != chunkSize) return setReadError(fin);
+  }
+
+  width = get16u_le((uint16_t*)data.get());
+  height = get16u_le((uint16_t*)(data.get()+2));
+  if (width <= 0 || height <= 0 || width > (int)TILE_DIMENSION || height > (int)TILE_DIMENSION) {
+    Logger::Print("\nInvalid dimensions found for tile #%d\n", tileIdx);
+    return setError(Error::DATA);
+  }
+  return true;
+}
+
+
+bool Graphics::isPvrzBased(const std::string &inFile) const noexcept
+{
+  File fin(inFile.c_str(), "rb");
+  uint8_t header[16];
+  if (fin.error() || fin.read(header, 1, sizeof(header)) != sizeof(header)) return false;
+
+  // PVRZ-based TIS is identified by the tile size, its version is not reliable
+  if (std::memcmp(header, HEADER_TIS_SIGNATURE, 4) == 0) {
+    return (get32u_le((uint32_t*)(header+12)) == 0x000c);
+  }
+
+  const uint8_t *mos = header;
+  InflateStreamPtr stream;
+  if (std::memcmp(header, HEADER_MOSC_SIGNATURE, 4) == 0) {
+    if (!fin.seek(12, SEEK_SET)) return false;
+    stream.reset(new InflateStream(fin, get32u_le((uint32_t*)(header+8))));
+    mos = stream->getData(0, 8);
+    if (mos == nullptr) return false;
+  }
+  return (std::memcmp(mos, HEADER_MOS_SIGNATURE, 4) == 0 && std::memcmp(mos+4, HEADER_VERSION_V2, 4) == 0);
+}
+
+
+PvrzPtr Graphics::getPvrzPage(std::map<unsigned, PvrzPtr> &pages, const std::string &inFile,
+                              bool isTis, unsigned index) const noexcept
+{
+  auto iter = pages.find(index);
+  if (iter != pages.end()) return iter->second;
+
+  if ((isTis && index >= MAX_PVRZ_PAGES_TIS) || (!isTis && index > (unsigned)Options::MAX_PVRZ_INDEX)) {
+    Logger::Print("\nInvalid PVRZ page index: %d\n", index);
+    setError(Error::DATA);
+    return PvrzPtr(nullptr);
+  }
+
+  // PVRZ files of the games are often stored in upper case
+  std::string fileName = getPvrzFileName(inFile, isTis, index);
+  if (!File::Exists(fileName)) {
+    std::string path = File::ExtractFilePath(fileName);
+    std::string name = File::ExtractFileName(fileName);
+    for (auto ch = name.begin(); ch != name.end(); ++ch) *ch = std::toupper(*ch);
+    if (File::Exists(File::CreateFileName(path, name))) {
+      fileName = File::CreateFileName(path, name);
+    } else {
+      for (auto ch = name.begin(); ch != name.end(); ++ch) *ch = std::tolower(*ch);
+      fileName = File::CreateFileName(path, name);
+    }
+  }
+
+  PvrzPtr page(new Pvrz(fileName));
+  if (!page->isValid()) {
+    setError(File::Exists(fileName) ? Error::DATA : Error::READ);
+    return PvrzPtr(nullptr);
+  }
+  if (getOptions().isVerbose()) {
+    Logger::Print("Loaded PVRZ page \"%s\" (%dx%d, encoding: %s)\n", fileName.c_str(),
+                  page->getWidth(), page->getHeight(), Options::GetEncodingName(page->getType()).c_str());
+  }
+  pages[index] = page;
+  return page;
+}
+
+
+void Graphics::indexPvrzMosBlocks(const uint8_t *blocks, unsigned numBlocks, int mosWidth, int mosHeight,
+                                  std::vector<std::vector<unsigned>> &tileBlocks) const noexcept
+{
+  int mosCols = (mosWidth + TILE_DIMENSION - 1) / TILE_DIMENSION;
+  int mosRows = (mosHeight + TILE_DIMENSION - 1) / TILE_DIMENSION;
+  tileBlocks.assign(mosCols*mosRows, std::vector<unsigned>());
+
+  // data block: page, source x/y, width, height, target x/y
+  for (unsigned i = 0; i < numBlocks; i++, blocks += 28) {
+    int64_t width = (int32_t)get32u_le((uint32_t*)(blocks+12));
+    int64_t height = (int32_t)get32u_le((uint32_t*)(blocks+16));
+    int64_t x = (int32_t)get32u_le((uint32_t*)(blocks+20));
+    int64_t y = (int32_t)get32u_le((uint32_t*)(blocks+24));
+    if (width <= 0 || height <= 0 || x >= mosWidth || y >= mosHeight || x + width <= 0 || y + height <= 0) continue;
+    int col0 = (int)(std::max((int64_t)0, x) / TILE_DIMENSION);
+    int col1 = (int)((std::min((int64_t)mosWidth, x + width) - 1) / TILE_DIMENSION);
+    int row0 = (int)(std::max((int64_t)0, y) / TILE_DIMENSION);
+    int row1 = (int)((std::min((int64_t)mosHeight, y + height) - 1) / TILE_DIMENSION);
+    for (int row = row0; row <= row1; row++) {
+      for (int col = col0; col <= col1; col++) {
+        tileBlocks[row*mosCols + col].push_back(i);
+      }
+    }
+  }
+}
+
+
+bool Graphics::addPvrzMosRegions(TileDataPtr tileData, const uint8_t *blocks, const std::vector<unsigned> &blockList,
+                                 int tileX, int tileY, std::map<unsigned, PvrzPtr> &pages,
+                                 const std::string &inFile) const noexcept
+{
+  // data block: page, source x/y, width, height, target x/y
+  for (auto iter = blockList.cbegin(); iter != blockList.cend(); ++iter) {
+    const uint8_t *block = blocks + (*iter)*28;
+    unsigned i = *iter;
+    PvrzRegion region;
+    uint32_t page = get32u_le((uint32_t*)block);
+    region.width = (int)get32u_le((uint32_t*)(block+12));
+    region.height = (int)get32u_le((uint32_t*)(block+16));
+    region.dstX = (int)get32u_le((uint32_t*)(block+20)) - tileX;
+    region.dstY = (int)get32u_le((uint32_t*)(block+24)) - tileY;
+    if (region.dstX < tileData->getWidth() && region.dstX + region.width > 0 &&
+        region.dstY < tileData->getHeight() && region.dstY + region.height > 0) {
+      region.srcX = (int)get32u_le((uint32_t*)(block+4));
+      region.srcY = (int)get32u_le((uint32_t*)(block+8));
+      region.page = getPvrzPage(pages, inFile, false, page);
+      if (region.page == nullptr) return false;
+      if (region.srcX < 0 || region.srcY < 0 || region.width <= 0 || region.height <= 0 ||
+          region.srcX + region.width > region.page->getWidth() ||
+          region.srcY + region.height > region.page->getHeight()) {
+        Logger::Print("\nInvalid data block #%d\n", i);
+        return setError(Error::DATA);
+      }
+      tileData->addPvrzRegion(region);
+    }
+  }
+
+  if (tileData->getPvrzRegions().empty()) {
+    // uncovered tile is solid black
+    BytePtr ptrPixels(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+    uint32_t black = 0xff000000; black = get32u_le(&black);
+    std::fill((uint32_t*)ptrPixels.get(), (uint32_t*)ptrPixels.get() + MAX_TILE_SIZE_8, black);
+    tileData->setPixelData(ptrPixels);
+  }
+  return true;
+}
+
+
+void Graphics::removeFiles(const std::list<std::string> &files) const noexcept
+{
+  for (auto iter = files.cbegin(); iter != files.cend(); ++iter) {
+    File::RemoveFile(*iter);
+  }
 }
 
 
@@ -1141,24 +2259,24 @@ bool Graphics::writeEncodedTile(TileDataPtr tileData, File &file, double &ratio)
     if (tileData->getSize() > 0 && !tileData->isError()) {
       uint32_t v32 = tileData->getSize(); v32 = get32u_le(&v32);  // compressed tile size in ready-to-write format
       if (file.write(&v32, 4, 1) != 1) {
-        std::printf("Error while writing tile data\n");
-        return false;
+        Logger::Print("Error while writing tile data\n");
+        return setError(Error::WRITE);
       }
       if (file.write(tileData->getDeflatedData().get(), 1, tileData->getSize()) != (unsigned)tileData->getSize()) {
-        std::printf("Error while writing tile data\n");
-        return false;
+        Logger::Print("Error while writing tile data\n");
+        return setError(Error::WRITE);
       }
 
       // displaying statistical information
       int tileSizeIndexed = tileData->getWidth() * tileData->getHeight();
       ratio = ((double)(tileData->getSize()+HEADER_TILE_COMPRESSED_SIZE)*100.0) / (double)(tileSizeIndexed+PALETTE_SIZE);
       if (getOptions().isVerbose()) {
-        std::printf("Tile #%d finished. Original size = %d bytes. Compressed size = %d bytes. Compression ratio: %.2f%%.\n",
-                    tileData->getIndex(), tileSizeIndexed+PALETTE_SIZE, tileData->getSize()+HEADER_TILE_COMPRESSED_SIZE, ratio);
+        Logger::Print("Tile #%d finished. Original size = %d bytes. Compressed size = %d bytes. Compression ratio: %.2f%%.\n",
+                      tileData->getIndex(), tileSizeIndexed+PALETTE_SIZE, tileData->getSize()+HEADER_TILE_COMPRESSED_SIZE, ratio);
       }
       return true;
     } else {
-      std::printf("%s", tileData->getErrorMsg().c_str());
+      Logger::Print("%s", tileData->getErrorMsg().c_str());
     }
   }
   return false;
@@ -1170,20 +2288,89 @@ bool Graphics::writeDecodedTisTile(TileDataPtr tileData, File &file) noexcept
   if (tileData != nullptr) {
     if (tileData->getSize() > 0 && !tileData->isError()) {
       if (file.write(tileData->getPaletteData().get(), 1, PALETTE_SIZE) != PALETTE_SIZE) {
-        std::printf("Error while writing tile data\n");
-        return false;
+        Logger::Print("Error while writing tile data\n");
+        return setError(Error::WRITE);
       }
       if (file.write(tileData->getIndexedData().get(), 1, MAX_TILE_SIZE_8) != MAX_TILE_SIZE_8) {
-        std::printf("Error while writing tile data\n");
-        return false;
+        Logger::Print("Error while writing tile data\n");
+        return setError(Error::WRITE);
+      }
+
+      if (getOptions().isVerbose()) {
+        Logger::Print("Tile #%d decoded successfully\n", tileData->getIndex());
+      }
+      return true;
+    } else {
+      Logger::Print("%s", tileData->getErrorMsg().c_str());
+    }
+  }
+  return false;
+}
+
+
+bool Graphics::writeDecodedBitmapTile(TileDataPtr tileData, File &file) noexcept
+{
+  if (tileData != nullptr) {
+    if (tileData->getSize() > 0 && !tileData->isError()) {
+      if (tileData->getWidth() != (int)TILE_DIMENSION || tileData->getHeight() != (int)TILE_DIMENSION) {
+        Logger::Print("\nInvalid dimensions found for tile #%d\n", tileData->getIndex());
+        return setError(Error::DATA);
+      }
+      if (file.write(tileData->getPixelData().get(), 1, MAX_TILE_SIZE_32) != MAX_TILE_SIZE_32) {
+        Logger::Print("Error while writing tile data\n");
+        return setError(Error::WRITE);
       }
 
       if (getOptions().isVerbose()) {
-        std::printf("Tile #%d decoded successfully\n", tileData->getIndex());
+        Logger::Print("Tile #%d decoded successfully\n", tileData->getIndex());
       }
       return true;
     } else {
-      std::printf("%s", tileData->getErrorMsg().c_str());
+      Logger::Print("%s", tileData->getErrorMsg().c_str());
+    }
+  }
+  return false;
+}
+
+
+bool Graphics::writeDecodedBitmapTile(TileDataPtr tileData, File &file, BytePtr rowData,
+                                      unsigned width, unsigned height, unsigned cols) noexcept
+{
+  if (tileData != nullptr && rowData != nullptr) {
+    if (tileData->getSize() > 0 && !tileData->isError()) {
+      unsigned row = tileData->getIndex() / cols;
+      unsigned col = tileData->getIndex() % cols;
+      unsigned tileWidth = tileData->getWidth();
+      unsigned tileHeight = tileData->getHeight();
+      unsigned stride = width*4;
+      // all tiles of a row have to match the row height, tiles of the last row and column may be smaller
+      if (tileWidth != std::min(TILE_DIMENSION, width - col*TILE_DIMENSION) ||
+          tileHeight != std::min(TILE_DIMENSION, height - row*TILE_DIMENSION)) {
+        Logger::Print("\nInvalid dimensions found for tile #%d\n", tileData->getIndex());
+        return setError(Error::DATA);
+      }
+
+      // placing tile into current row of tiles
+      const uint8_t *src = tileData->getPixelData().get();
+      uint8_t *dst = rowData.get() + col*TILE_DIMENSION*4;
+      for (unsigned y = 0; y < tileHeight; y++, src += tileWidth*4, dst += stride) {
+        std::memcpy(dst, src, tileWidth*4);
+      }
+
+      // writing completed row of tiles
+      if (col+1 == cols) {
+        if (file.write(rowData.get(), 1, stride*tileHeight) != stride*tileHeight) {
+          Logger::Print("Error while writing tile data\n");
+          return setError(Error::WRITE);
+        }
+      }
+
+      if (getOptions().isVerbose()) {
+        Logger::Print("Tile #%d decoded successfully\n", tileData->getIndex());
+      }
+      return true;
+    } else {
+      Logger::Print("%s", tileData->getErrorMsg().c_str());
     }
   }
   return false;
@@ -1211,17 +2398,39 @@ bool Graphics::writeDecodedMosTile(TileDataPtr tileData, BytePtr mosData, uint32
       dataOfsRel += tileSizeIndexed;
 
       if (getOptions().isVerbose()) {
-        std::printf("Tile #%d decoded successfully\n", tileData->getIndex());
+        Logger::Print("Tile #%d decoded successfully\n", tileData->getIndex());
       }
       return true;
     } else {
-      std::printf("%s", tileData->getErrorMsg().c_str());
+      Logger::Print("%s", tileData->getErrorMsg().c_str());
     }
   }
   return false;
 }
 
 
+const char* Graphics::getEncodedVersion() const noexcept
+{
+  // only files with per-tile pixel encoding need the newer format revision
+  if (getOptions().getEncoding() == Encoding::AUTO) {
+    return HEADER_VERSION_V1_1;
+  } else {
+    return HEADER_VERSION_V1_0;
+  }
+}
+
+
+void Graphics::showTileDistribution(const unsigned *typeCount, unsigned tileCount) const noexcept
+{
+  if (typeCount != nullptr && tileCount > 0) {
+    Logger::Print("Tile encoding distribution: RAW: %d (%.2f%%), BC1: %d (%.2f%%), BC3: %d (%.2f%%).\n",
+                  typeCount[ENCODE_RAW], (double)typeCount[ENCODE_RAW]*100.0 / (double)tileCount,
+                  typeCount[ENCODE_DXT1], (double)typeCount[ENCODE_DXT1]*100.0 / (double)tileCount,
+                  typeCount[ENCODE_DXT5], (double)typeCount[ENCODE_DXT5]*100.0 / (double)tileCount);
+  }
+}
+
+
 unsigned Graphics::showProgress(unsigned curTile, unsigned maxTiles,
                                 unsigned curProgress, unsigned maxProgress,
                                 char symbol) const noexcept
@@ -1231,9 +2440,9 @@ unsigned Graphics::showProgress(unsigned curTile, unsigned maxTiles,
   if (curProgress > maxProgress) curProgress = maxProgress;
   unsigned v = curTile*maxProgress / maxTiles;
   while (curProgress < v) {
-    std::printf("%c", symbol);
+    Logger::Print("%c", symbol);
 #ifndef WIN32
-    std::fflush(stdout);
+    Logger::Flush();
 #endif
     curProgress++;
   }
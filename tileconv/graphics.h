@@ -21,11 +21,18 @@ THE SOFTWARE.
 */
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
+#include <functional>
 #include <string>
+#include <list>
+#include <map>
+#include <vector>
 #include "types.h"
 #include "options.h"
 #include "fileio.h"
 #include "tiledata.h"
+#include "compress.h"
+#include "pvrz.h"
+#include "tilethreadpool.h"
 
 
 namespace tc {
@@ -33,10 +40,26 @@ namespace tc {
 /** Provides functions for converting between TIS/MOS <-> TBC/MBC */
 class Graphics
 {
+public:
+  /** Cause of a failed conversion. */
+  enum class Error {
+    NONE,       // no error or error while converting tiles
+    READ,       // input file could not be opened or read
+    WRITE,      // output file could not be created or written
+    DATA,       // input data is invalid, truncated or not supported by the conversion
+    MEMORY,     // not enough memory for the input data
+  };
+
 public:
   Graphics(const Options &options) noexcept;
   ~Graphics() noexcept;
 
+  /**
+   * Uses the specified thread pool for all conversions instead of an internally managed one.
+   * Specify nullptr to return to an internally managed thread pool.
+   */
+  void setThreadPool(ThreadPoolPtr pool) noexcept;
+
   /** TIS->TBC conversion */
   bool tisToTBC(const std::string &inFile, const std::string &outFile) noexcept;
   /** TBC->TIS conversion */
@@ -45,19 +68,47 @@ class Graphics
   bool mosToMBC(const std::string &inFile, const std::string &outFile) noexcept;
   /** MBC->MOS conversion */
   bool mbcToMOS(const std::string &inFile, const std::string &outFile) noexcept;
+  /** TBC->BM32 conversion (32-bit pixels without color reduction) */
+  bool tbcToBitmap(const std::string &inFile, const std::string &outFile) noexcept;
+  /** MBC->BM32 conversion (32-bit pixels without color reduction) */
+  bool mbcToBitmap(const std::string &inFile, const std::string &outFile) noexcept;
+  /** TBC->TIS V2 conversion (BC1/BC3 blocks are copied into PVRZ pages) */
+  bool tbcToPvrz(const std::string &inFile, const std::string &outFile) noexcept;
+  /** MBC->MOS V2 conversion (BC1/BC3 blocks are copied into PVRZ pages) */
+  bool mbcToPvrz(const std::string &inFile, const std::string &outFile) noexcept;
   /** TIZ->TIS conversion */
   bool tizToTIS(const std::string &inFile, const std::string &outFile) noexcept;
-  /** TIZ->TIS conversion */
+  /** MOZ->MOS conversion */
   bool mozToMOS(const std::string &inFile, const std::string &outFile) noexcept;
+  /** TIZ->TBC conversion (tiles are decoded and encoded in a single pass) */
+  bool tizToTBC(const std::string &inFile, const std::string &outFile) noexcept;
+  /** MOZ->MBC conversion (tiles are decoded and encoded in a single pass) */
+  bool mozToMBC(const std::string &inFile, const std::string &outFile) noexcept;
+
+  /** Returns whether inFile is a TIS or MOS/MOSC file referring to separate PVRZ pages. */
+  bool isPvrzBased(const std::string &inFile) const noexcept;
+
+  /** Returns the cause of the last failed conversion. Reset by each conversion function. */
+  Error getError() const noexcept { return m_error; }
 
   /** Read-only access to Options structure. */
   const Options& getOptions() const noexcept { return m_options; }
 
 private:
-  // Read TIS header data. File points to start of tile data afterwards.
-  bool readTIS(File &fin, unsigned &numTiles) noexcept;
+  // Stores the cause of a failed conversion unless an earlier cause is known. Returns false.
+  bool setError(Error error) const noexcept;
+  // Stores READ for I/O errors and DATA for truncated input after a failed read from fin. Returns false.
+  bool setReadError(File &fin) const noexcept;
+
+  // Read TIS header data. File points to start of tile data (or PVRZ tile entries) afterwards.
+  bool readTIS(File &fin, unsigned &numTiles, bool &isPvrz) noexcept;
   // Reads MOS file. mos contains uncompressed MOS data.
-  bool readMOS(File &fin, BytePtr &mos, unsigned &width, unsigned &height, unsigned &palOfs) noexcept;
+  // MOSC: mos contains only data up to the tile data, which is provided by stream on demand. stream is null otherwise.
+  // PVRZ-based MOS: palOfs points to numBlocks data blocks, numBlocks is 0 otherwise.
+  bool readMOS(File &fin, BytePtr &mos, InflateStreamPtr &stream, unsigned &width, unsigned &height,
+               unsigned &palOfs, unsigned &numBlocks) noexcept;
+  // Extends mos by decompressed data from stream until it contains size bytes.
+  bool inflateMosData(InflateStreamPtr &stream, BytePtr &mos, uint32_t &loaded, uint32_t size) noexcept;
   // Reads TBC header data. File points to start of tile data afterwards.
   bool readTBC(File &fin, unsigned &type, unsigned &numTiles) noexcept;
   // Reads MBC header data. File points to start of tile data afterwards.
@@ -67,6 +118,40 @@ class Graphics
   // Reads MOZ header data. File points to start of tile data afterwards.
   bool readMOZ(File &fin, unsigned &type, unsigned &width, unsigned &height) noexcept;
 
+  // Writes the BM32 header, using the color format specified in Options
+  bool writeBitmapHeader(File &fout, unsigned width, unsigned height, unsigned tileCount) noexcept;
+
+  // Returns whether the specified encoding type can be stored in PVRZ pages. Prints an error message otherwise.
+  bool isPvrzCompatible(unsigned type) const noexcept;
+  // Creates an empty PVRZ page that is large enough for the given number of tiles
+  PvrzPtr createPvrzPage(unsigned type, unsigned tileCount) const noexcept;
+  // Returns the full path of a PVRZ page associated with the given TIS/MOS output file
+  std::string getPvrzFileName(const std::string &outFile, bool isTis, unsigned index) const noexcept;
+  // Copies the blocks of all tiles of a TBC/MBC file into PVRZ pages, starting with page index firstPage,
+  // and calls writeEntry() with the page and location of each tile. Removes written pages on error.
+  bool writePvrzPages(File &fin, unsigned type, unsigned tileCount, const std::string &outFile, bool isTis,
+                      unsigned firstPage,
+                      const std::function<bool(unsigned tileIdx, unsigned page, int x, int y,
+                                               int width, int height)> &writeEntry) noexcept;
+  // Reads an encoded TBC/MBC tile into data (inflated if needed), including the tile dimensions header
+  bool readEncodedBlocks(File &fin, unsigned type, unsigned tileIdx, Compression &compression,
+                         BytePtr data, int &width, int &height) noexcept;
+  // Returns the specified PVRZ page associated with the TIS/MOS input file. Pages are loaded on demand.
+  PvrzPtr getPvrzPage(std::map<unsigned, PvrzPtr> &pages, const std::string &inFile,
+                      bool isTis, unsigned index) const noexcept;
+  // Lists the MOS V2 data blocks overlapping each tile of a MOS of the given dimensions
+  void indexPvrzMosBlocks(const uint8_t *blocks, unsigned numBlocks, int mosWidth, int mosHeight,
+                          std::vector<std::vector<unsigned>> &tileBlocks) const noexcept;
+  // Adds the listed MOS V2 data blocks overlapping the tile at the given position to the tile data
+  bool addPvrzMosRegions(TileDataPtr tileData, const uint8_t *blocks, const std::vector<unsigned> &blockList,
+                         int tileX, int tileY, std::map<unsigned, PvrzPtr> &pages,
+                         const std::string &inFile) const noexcept;
+  // Removes the listed files from disk
+  void removeFiles(const std::list<std::string> &files) const noexcept;
+
+  // Reads a TIZ/MOZ tile including tile header into data. size contains the total tile size afterwards.
+  bool readZTile(File &fin, unsigned tileIdx, bool isTiz, BytePtr &data, uint32_t &size) noexcept;
+
   // write data as MOS or MOSC to disk
   bool writeMos(File &fout, BytePtr &mos, unsigned size) noexcept;
 
@@ -76,10 +161,37 @@ class Graphics
   // Called by tbcToTIS() to write a decoded tile to the output file
   bool writeDecodedTisTile(TileDataPtr tileData, File &file) noexcept;
 
+  // Called by tbcToBitmap() to write a decoded tile to the output file
+  bool writeDecodedBitmapTile(TileDataPtr tileData, File &file) noexcept;
+
+  // Called by mbcToBitmap() to write a decoded tile into rowData. Completed rows are written to the output file
+  bool writeDecodedBitmapTile(TileDataPtr tileData, File &file, BytePtr rowData,
+                              unsigned width, unsigned height, unsigned cols) noexcept;
+
   /// Called by mbcToMOS() to write a decoded tile to the output file
   bool writeDecodedMosTile(TileDataPtr tileData, BytePtr mosData, uint32_t &palOfs,
                            uint32_t &tileOfs, uint32_t &dataOfsRel, uint32_t dataOfsBase) noexcept;
 
+  // Returns the idle thread pool of a previous conversion or creates a new one
+  ThreadPoolPtr getThreadPool() noexcept;
+
+  // Moves reading of fin and writing of fout into separate threads. Both parameters are optional.
+  void startPipeline(File *fin, File *fout) noexcept;
+  // Stops the threads started by startPipeline() and prints queue statistics in verbose mode
+  bool finishPipeline(File *fin, File *fout, ThreadPoolPtr pool) noexcept;
+  // Adds the tiles returned by createTile(index) to the thread pool and passes the results in order to
+  // storeTile(). Shows the progress. Returns false if createTile() returns null, a tile fails or
+  // storeTile() returns false.
+  bool processTiles(ThreadPoolPtr pool, unsigned tileCount,
+                    const std::function<TileDataPtr(unsigned)> &createTile,
+                    const std::function<bool(TileDataPtr)> &storeTile) noexcept;
+
+  // Returns the TBC/MBC file version required by the current encoding type
+  const char* getEncodedVersion() const noexcept;
+
+  // Prints the number of tiles for each pixel encoding type (indexed by ENCODE_xxx)
+  void showTileDistribution(const unsigned *typeCount, unsigned tileCount) const noexcept;
+
   // Update the progression of a progress bar. Returns updated curProgress.
   unsigned showProgress(unsigned curTile, unsigned maxTiles,
                         unsigned curProgress, unsigned maxProgress,
@@ -91,6 +203,7 @@ class Graphics
   static const char HEADER_MOSC_SIGNATURE[4];         // MOSC signature
   static const char HEADER_TBC_SIGNATURE[4];          // TBC signature
   static const char HEADER_MBC_SIGNATURE[4];          // MBC signature
+  static const char HEADER_BM32_SIGNATURE[4];         // BM32 signature
 
   static const char HEADER_TIZ_SIGNATURE[4];          // TIZ signature
   static const char HEADER_MOZ_SIGNATURE[4];          // MOZ signature
@@ -101,12 +214,21 @@ class Graphics
   static const char HEADER_VERSION_V1[4];             // TIS/MOS file version
   static const char HEADER_VERSION_V2[4];             // TIS/MOS file version
   static const char HEADER_VERSION_V1_0[4];           // TBC/MBC file version
+  static const char HEADER_VERSION_V1_1[4];           // TBC/MBC file version (per-tile encoding)
 
 private:
   static const unsigned MAX_PROGRESS;                 // Available space for a progress bar
-  static const unsigned MAX_POOL_TILES;               // Max. storage of tiles in thread pool
+  static const unsigned STAGE_BLOCK_SIZE;             // Block size of reader and writer threads
+  static const unsigned STAGE_BLOCKS;                 // Max. number of queued blocks of reader and writer threads
+  static const unsigned PVRZ_PAGE_COLS;               // Number of tile columns in a PVRZ page
+  static const unsigned PVRZ_PAGE_TILES;              // Max. number of tiles in a PVRZ page
+  static const unsigned MAX_PVRZ_PAGES_TIS;           // Max. number of PVRZ pages per TIS
 
   const Options&  m_options;
+  ThreadPoolPtr   m_threadPool;     // reused by consecutive conversions
+  int             m_poolThreads;    // number of threads of m_threadPool
+  bool            m_sharedPool;     // m_threadPool has been provided by setThreadPool()
+  mutable Error   m_error;          // cause of the last failed conversion
 };
 
 }   // namespace tc
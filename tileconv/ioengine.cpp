@@ -0,0 +1,423 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "ioengine_uring.h"
+#include "logger.h"
+#include "ioengine.h"
+
+namespace tc {
+
+const unsigned    IOEngine::MAX_BATCH_FILES = 64;
+const std::size_t IOEngine::MAX_BATCH_SIZE  = 4*1024*1024;
+
+IOEngine& IOEngine::GetInstance() noexcept
+{
+  std::unique_ptr<IOEngine> &instance = Instance();
+  if (instance == nullptr) {
+#ifdef USE_IO_URING
+    IOEngineUring *engine = new IOEngineUring();
+    if (engine->isAvailable()) {
+      instance.reset(engine);
+    } else {
+      delete engine;
+    }
+#endif
+    if (instance == nullptr) instance.reset(new IOEngine());
+  }
+  return *instance;
+}
+
+
+IOEngine* IOEngine::GetBatchInstance() noexcept
+{
+  IOEngine *engine = Instance().get();
+  return (engine != nullptr && engine->isBatchMode()) ? engine : nullptr;
+}
+
+
+IOEngine* IOEngine::GetActiveInstance() noexcept
+{
+  IOEngine *engine = Instance().get();
+  return (engine != nullptr && (engine->isBatchMode() || !engine->getMemoryPath().empty())) ? engine : nullptr;
+}
+
+
+std::unique_ptr<IOEngine>& IOEngine::Instance() noexcept
+{
+  static std::unique_ptr<IOEngine> instance;
+  return instance;
+}
+
+
+IOEngine::IOEngine() noexcept
+: m_batchMode(false)
+, m_error(false)
+, m_readList()
+, m_readIndex(0)
+, m_cache()
+, m_writes()
+, m_writeSize(0)
+, m_source()
+, m_memPath()
+, m_memFiles()
+, m_memory()
+{
+}
+
+
+IOEngine::~IOEngine() noexcept
+{
+  flush();
+}
+
+
+void IOEngine::setReadList(const std::vector<std::string> &files) noexcept
+{
+  m_readList = files;
+  m_readIndex = 0;
+  m_cache.clear();
+  updateMemory();
+  m_batchMode = supportsBatch() && !m_readList.empty();
+}
+
+
+std::FILE* IOEngine::openMemory(const std::string &fileName, const char *mode, BytePtr &data,
+                                char **buffer, std::size_t *size) noexcept
+{
+  if (mode == nullptr) return nullptr;
+
+  if (isMemoryFile(fileName)) {
+    if (std::strcmp(mode, "rb") == 0) {
+      std::size_t dataSize = 0;
+      if (getMemoryFile(fileName, data, dataSize)) return OpenReadStream(data.get(), dataSize);
+    } else if (std::strcmp(mode, "wb") == 0 && buffer != nullptr && size != nullptr) {
+      return OpenWriteStream(buffer, size);
+    }
+    return nullptr;
+  }
+
+#ifdef USE_IO_URING
+  if (isBatchMode()) {
+    if (std::strcmp(mode, "rb") == 0) {
+      sync(fileName);
+      auto iter = m_cache.find(fileName);
+      if (iter == m_cache.end()) {
+        auto pos = std::find(m_readList.cbegin() + m_readIndex, m_readList.cend(), fileName);
+        if (pos != m_readList.cend()) {
+          loadBatch(pos - m_readList.cbegin());
+          iter = m_cache.find(fileName);
+        }
+      }
+      if (iter != m_cache.end() && iter->second.size > 0) {
+        data = iter->second.data;
+        return OpenReadStream(data.get(), iter->second.size);
+      }
+    } else if (std::strcmp(mode, "wb") == 0 && buffer != nullptr && size != nullptr) {
+      // queued writes of the same file must not overlap
+      sync(fileName);
+      m_cache.erase(fileName);
+      updateMemory();
+      return OpenWriteStream(buffer, size);
+    }
+  }
+#endif
+  return nullptr;
+}
+
+
+void IOEngine::closeMemory(const std::string &fileName, std::FILE *file, char **buffer,
+                           std::size_t *size, bool commit) noexcept
+{
+  if (buffer != nullptr && size != nullptr) {
+    CloseWriteStream(file, buffer, size);
+  } else if (file != nullptr) {
+    std::fclose(file);
+  }
+  if (buffer != nullptr && *buffer != nullptr) {
+    if (commit) {
+      Entry entry;
+      entry.name = fileName;
+      entry.source = m_source;
+      entry.data.reset((uint8_t*)*buffer, std::free);
+      entry.size = *size;
+      entry.success = false;
+      if (isMemoryFile(fileName)) {
+        setMemoryFile(fileName, entry.data, entry.size);
+      } else {
+        m_writes.push_back(entry);
+        m_writeSize += entry.size;
+        updateMemory();
+        if (m_writes.size() >= MAX_BATCH_FILES || m_writeSize >= getBatchSize()) flush();
+      }
+    } else {
+      std::free(*buffer);
+    }
+    *buffer = nullptr;
+    *size = 0;
+  }
+}
+
+
+bool IOEngine::sync(const std::string &fileName) noexcept
+{
+  for (auto iter = m_writes.cbegin(); iter != m_writes.cend(); ++iter) {
+    if (iter->name == fileName) return flush();
+  }
+  return true;
+}
+
+
+bool IOEngine::flush() noexcept
+{
+  bool retVal = true;
+  if (!m_writes.empty()) {
+    writeFiles(m_writes);
+    for (auto iter = m_writes.cbegin(); iter != m_writes.cend(); ++iter) {
+      if (!iter->success) {
+        if (iter->source.empty()) {
+          Logger::Print("Error writing file \"%s\"\n", iter->name.c_str());
+        } else {
+          Logger::Print("Error writing file \"%s\" converted from \"%s\"\n", iter->name.c_str(), iter->source.c_str());
+        }
+        // incomplete output files are removed, as with failed conversions
+        std::remove(iter->name.c_str());
+        m_error = true;
+        retVal = false;
+      }
+    }
+    m_writes.clear();
+    m_writeSize = 0;
+    updateMemory();
+  }
+  return retVal;
+}
+
+
+void IOEngine::setMemoryPath(const std::string &path) noexcept
+{
+  m_memPath = path;
+  m_memFiles.clear();
+  updateMemory();
+}
+
+
+bool IOEngine::isMemoryFile(const std::string &fileName) const noexcept
+{
+  return (!m_memPath.empty() && fileName.compare(0, m_memPath.size(), m_memPath) == 0);
+}
+
+
+void IOEngine::setMemoryFile(const std::string &fileName, BytePtr data, std::size_t size) noexcept
+{
+  removeMemoryFile(fileName);
+  Entry entry;
+  entry.name = fileName;
+  entry.data = data;
+  entry.size = size;
+  entry.success = true;
+  m_memFiles.push_back(entry);
+  updateMemory();
+}
+
+
+bool IOEngine::getMemoryFile(const std::string &fileName, BytePtr &data, std::size_t &size) const noexcept
+{
+  for (auto iter = m_memFiles.cbegin(); iter != m_memFiles.cend(); ++iter) {
+    if (iter->name == fileName) {
+      data = iter->data;
+      size = iter->size;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool IOEngine::removeMemoryFile(const std::string &fileName) noexcept
+{
+  for (auto iter = m_memFiles.begin(); iter != m_memFiles.end(); ++iter) {
+    if (iter->name == fileName) {
+      m_memFiles.erase(iter);
+      updateMemory();
+      return true;
+    }
+  }
+  return false;
+}
+
+
+std::vector<std::string> IOEngine::getMemoryFiles() const noexcept
+{
+  std::vector<std::string> names;
+  for (auto iter = m_memFiles.cbegin(); iter != m_memFiles.cend(); ++iter) {
+    names.push_back(iter->name);
+  }
+  return names;
+}
+
+
+void IOEngine::readFiles(std::vector<Entry> &entries) noexcept
+{
+  std::size_t total = 0;
+  for (auto iter = entries.begin(); iter != entries.end(); ++iter) {
+    iter->success = false;
+    std::FILE *f = std::fopen(iter->name.c_str(), "rb");
+    if (f != nullptr) {
+      if (std::fseek(f, 0, SEEK_END) == 0) {
+        long size = std::ftell(f);
+        if (size > 0 && total + size <= getBatchSize() && std::fseek(f, 0, SEEK_SET) == 0) {
+          iter->data.reset(new uint8_t[size], std::default_delete<uint8_t[]>());
+          iter->size = std::fread(iter->data.get(), 1, size, f);
+          iter->success = (iter->size == (std::size_t)size);
+          total += size;
+        }
+      }
+      std::fclose(f);
+    }
+  }
+}
+
+
+void IOEngine::writeFiles(std::vector<Entry> &entries) noexcept
+{
+  for (auto iter = entries.begin(); iter != entries.end(); ++iter) {
+    iter->success = false;
+    std::FILE *f = std::fopen(iter->name.c_str(), "wb");
+    if (f != nullptr) {
+      iter->success = (std::fwrite(iter->data.get(), 1, iter->size, f) == iter->size);
+      if (std::fclose(f) != 0) iter->success = false;
+    }
+  }
+}
+
+
+void IOEngine::loadBatch(std::size_t index) noexcept
+{
+  // files of the batch may be waiting to be written
+  flush();
+  m_cache.clear();
+  std::vector<Entry> entries;
+  for (; index < m_readList.size() && entries.size() < MAX_BATCH_FILES; index++) {
+    // skipping duplicate entries
+    bool found = false;
+    for (auto iter = entries.cbegin(); iter != entries.cend() && !found; ++iter) {
+      found = (iter->name == m_readList[index]);
+    }
+    if (!found) {
+      Entry entry;
+      entry.name = m_readList[index];
+      entry.size = 0;
+      entry.success = false;
+      entries.push_back(entry);
+    }
+  }
+  m_readIndex = index;
+
+  readFiles(entries);
+  for (auto iter = entries.cbegin(); iter != entries.cend(); ++iter) {
+    if (iter->success) m_cache[iter->name] = *iter;
+  }
+  updateMemory();
+}
+
+
+std::size_t IOEngine::getBatchSize() const noexcept
+{
+  // a batch may use half of the memory not held by the engine itself
+  if (!MemoryBudget::IsLimited()) return MAX_BATCH_SIZE;
+  uint64_t available = (MemoryBudget::GetAvailable() + m_memory.getSize()) / 2;
+  return (std::size_t)std::min((uint64_t)MAX_BATCH_SIZE, available);
+}
+
+
+void IOEngine::updateMemory() noexcept
+{
+  uint64_t size = m_writeSize;
+  for (auto iter = m_cache.cbegin(); iter != m_cache.cend(); ++iter) size += iter->second.size;
+  for (auto iter = m_memFiles.cbegin(); iter != m_memFiles.cend(); ++iter) size += iter->size;
+  m_memory.reset(size);
+}
+
+
+std::FILE* IOEngine::OpenReadStream(uint8_t *data, std::size_t size) noexcept
+{
+#ifndef _WIN32
+  if (size > 0) return fmemopen(data, size, "rb");
+#endif
+  // temporary file as fallback
+  std::FILE *file = std::tmpfile();
+  if (file != nullptr) {
+    if ((size > 0 && std::fwrite(data, 1, size, file) != size) || std::fseek(file, 0, SEEK_SET) != 0) {
+      std::fclose(file);
+      file = nullptr;
+    }
+  }
+  return file;
+}
+
+
+std::FILE* IOEngine::OpenWriteStream(char **buffer, std::size_t *size) noexcept
+{
+  *buffer = nullptr;
+  *size = 0;
+#ifndef _WIN32
+  return open_memstream(buffer, size);
+#else
+  return std::tmpfile();
+#endif
+}
+
+
+void IOEngine::CloseWriteStream(std::FILE *file, char **buffer, std::size_t *size) noexcept
+{
+  if (file == nullptr) return;
+#ifndef _WIN32
+  if (std::fclose(file) != 0) {
+    std::free(*buffer);
+    *buffer = nullptr;
+    *size = 0;
+  }
+#else
+  // reading back content of the temporary file
+  *buffer = nullptr;
+  *size = 0;
+  if (std::fflush(file) == 0 && std::fseek(file, 0, SEEK_END) == 0) {
+    long fileSize = std::ftell(file);
+    if (fileSize > 0 && std::fseek(file, 0, SEEK_SET) == 0) {
+      *buffer = (char*)std::malloc(fileSize);
+      if (*buffer != nullptr) {
+        if (std::fread(*buffer, 1, fileSize, file) == (std::size_t)fileSize) {
+          *size = fileSize;
+        } else {
+          std::free(*buffer);
+          *buffer = nullptr;
+        }
+      }
+    }
+  }
+  std::fclose(file);
+#endif
+}
+
+}   // namespace tc
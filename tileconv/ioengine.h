@@ -0,0 +1,171 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _IOENGINE_H_
+#define _IOENGINE_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+#include "types.h"
+#include "membudget.h"
+
+namespace tc {
+
+/**
+ * Batch I/O engine underneath File. While a list of input files is set, the engine reads whole
+ * input files ahead in batches and collects output files in memory to write them to disk in
+ * batches. File accesses the data through memory streams. Queued output files are written by
+ * flush(), which has to be called before a conversion is reported as successful.
+ * The default engine uses stdio and is used if no better implementation is available at runtime.
+ * Batch mode is not available for the default engine.
+ * Files below the memory path are not stored on disk at all, but kept by the engine until removed.
+ * Not thread-safe.
+ */
+class IOEngine
+{
+public:
+  /** Returns the best I/O engine available on the current system. */
+  static IOEngine& GetInstance() noexcept;
+  /** Returns the I/O engine if it has been created and is in batch mode, nullptr otherwise. */
+  static IOEngine* GetBatchInstance() noexcept;
+  /** Returns the I/O engine if it is in batch mode or manages memory files, nullptr otherwise. */
+  static IOEngine* GetActiveInstance() noexcept;
+
+  virtual ~IOEngine() noexcept;
+
+  /** Name of the I/O engine implementation. */
+  virtual const char* getName() const noexcept { return "stdio"; }
+
+  /**
+   * Sets the files expected to be read in the given order and enables batch mode.
+   * Has no effect for the stdio engine. An empty list disables batch mode.
+   */
+  void setReadList(const std::vector<std::string> &files) noexcept;
+  bool isBatchMode() const noexcept { return m_batchMode; }
+
+  /**
+   * Opens a memory stream for fileName if it is managed by the engine. Read mode provides the
+   * file content in data. Write mode initializes buffer and size for use with closeMemory().
+   * Returns nullptr if the file has to be opened by stdio.
+   */
+  std::FILE* openMemory(const std::string &fileName, const char *mode, BytePtr &data,
+                        char **buffer, std::size_t *size) noexcept;
+  /**
+   * Closes a memory stream opened by openMemory(). Write mode: buffer content is queued for
+   * writing to disk if commit is true, and discarded otherwise.
+   */
+  void closeMemory(const std::string &fileName, std::FILE *file, char **buffer,
+                   std::size_t *size, bool commit) noexcept;
+
+  /**
+   * Writes queued data of fileName to disk. Should be called before accessing the file by other means.
+   * Returns false if any of the written files could not be written.
+   */
+  bool sync(const std::string &fileName) noexcept;
+
+  /** Writes all queued data to disk. Returns false if any of the queued files could not be written. */
+  bool flush() noexcept;
+  /** Returns whether writing a queued file has failed so far. */
+  bool isError() const noexcept { return m_error; }
+
+  /** Input file of the output files committed from now on. Write errors are reported against it. */
+  void setSource(const std::string &inputFile) noexcept { m_source = inputFile; }
+
+  /**
+   * Files below the specified path are kept in memory instead of the file system.
+   * An empty path disables memory files and removes all of them.
+   */
+  void setMemoryPath(const std::string &path) noexcept;
+  const std::string& getMemoryPath() const noexcept { return m_memPath; }
+  /** Returns whether fileName is located below the memory path. */
+  bool isMemoryFile(const std::string &fileName) const noexcept;
+
+  /** Adds or replaces a memory file. */
+  void setMemoryFile(const std::string &fileName, BytePtr data, std::size_t size) noexcept;
+  /** Provides data and size of a memory file. Returns false if the file doesn't exist. */
+  bool getMemoryFile(const std::string &fileName, BytePtr &data, std::size_t &size) const noexcept;
+  /** Removes a memory file. Returns false if the file doesn't exist. */
+  bool removeMemoryFile(const std::string &fileName) noexcept;
+  /** Returns the names of all memory files in order of creation. */
+  std::vector<std::string> getMemoryFiles() const noexcept;
+
+protected:
+  struct Entry
+  {
+    std::string name;
+    std::string source;   // input file converted into this file (empty: unknown)
+    BytePtr     data;
+    std::size_t size;
+    bool        success;
+  };
+
+  static const unsigned    MAX_BATCH_FILES;   // Max. number of files per batch
+  static const std::size_t MAX_BATCH_SIZE;    // Max. accumulated file size per batch
+
+  IOEngine() noexcept;
+
+  // Returns whether the engine supports batch mode
+  virtual bool supportsBatch() const noexcept { return false; }
+
+  // Reads whole files into data. Sets success of each entry.
+  virtual void readFiles(std::vector<Entry> &entries) noexcept;
+  // Writes data of each entry to disk. Sets success of each entry.
+  virtual void writeFiles(std::vector<Entry> &entries) noexcept;
+
+  // Returns the max. accumulated file size of a batch, reduced to fit into the memory budget
+  std::size_t getBatchSize() const noexcept;
+
+private:
+  // Storage of the global engine instance
+  static std::unique_ptr<IOEngine>& Instance() noexcept;
+
+  // Loads the next batch of files from the read list, starting at the specified index
+  void loadBatch(std::size_t index) noexcept;
+
+  // Updates the accounted size of read batch, queued writes and memory files
+  void updateMemory() noexcept;
+
+  // Opens a read-only stream of the given data
+  static std::FILE* OpenReadStream(uint8_t *data, std::size_t size) noexcept;
+  // Opens a stream writing into memory. Call CloseWriteStream() to retrieve buffer and size.
+  static std::FILE* OpenWriteStream(char **buffer, std::size_t *size) noexcept;
+  // Closes a stream opened by OpenWriteStream(). buffer must be released by std::free().
+  static void CloseWriteStream(std::FILE *file, char **buffer, std::size_t *size) noexcept;
+
+private:
+  bool                            m_batchMode;
+  bool                            m_error;
+  std::vector<std::string>        m_readList;   // input files in expected order
+  std::size_t                     m_readIndex;  // next unread file of m_readList
+  std::map<std::string, Entry>    m_cache;      // content of the current read batch
+  std::vector<Entry>              m_writes;     // queued output files
+  std::size_t                     m_writeSize;
+  std::string                     m_source;     // input file of newly committed output files
+  std::string                     m_memPath;    // location of memory files
+  std::vector<Entry>              m_memFiles;
+  MemoryBudget::Reservation       m_memory;     // accounted size of all file data held by the engine
+};
+
+}   // namespace tc
+
+#endif		// _IOENGINE_H_
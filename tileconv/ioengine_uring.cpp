@@ -0,0 +1,367 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include "ioengine_uring.h"
+
+#ifdef USE_IO_URING
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+namespace tc {
+
+const unsigned    IOEngineUring::RING_ENTRIES = 64;
+const std::size_t IOEngineUring::SLOT_SIZE    = 65536;
+
+IOEngineUring::IOEngineUring() noexcept
+: IOEngine()
+, m_ringFd(-1)
+, m_entries(0)
+, m_sqRing(nullptr)
+, m_sqRingSize(0)
+, m_cqRing(nullptr)
+, m_cqRingSize(0)
+, m_sqes(nullptr)
+, m_sqesSize(0)
+, m_sqTail(nullptr)
+, m_sqMask(nullptr)
+, m_sqArray(nullptr)
+, m_cqHead(nullptr)
+, m_cqTail(nullptr)
+, m_cqMask(nullptr)
+, m_cqes(nullptr)
+, m_buffer(nullptr)
+, m_fixedBuffer(false)
+{
+  if (!init()) close();
+}
+
+
+IOEngineUring::~IOEngineUring() noexcept
+{
+  // queued data must be written while the ring is still available
+  flush();
+  close();
+}
+
+
+void IOEngineUring::readFiles(std::vector<Entry> &entries) noexcept
+{
+  std::vector<io_uring_sqe> sqes;
+  std::vector<int> fds, results;
+
+  // opening files
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    entries[i].success = false;
+    io_uring_sqe sqe = CreateRequest(IORING_OP_OPENAT, AT_FDCWD);
+    sqe.addr = (uint64_t)entries[i].name.c_str();
+    sqe.open_flags = O_RDONLY | O_CLOEXEC;
+    sqes.push_back(sqe);
+  }
+  if (!submit(sqes, fds)) {
+    CloseFiles(fds);
+    return;
+  }
+
+  // reading file content into fixed slots of the staging buffer
+  std::vector<std::size_t> opened;
+  sqes.clear();
+  for (std::size_t i = 0; i < entries.size() && i < MAX_BATCH_FILES; i++) {
+    if (fds[i] >= 0) {
+      opened.push_back(i);
+      io_uring_sqe sqe = CreateRequest(m_fixedBuffer ? IORING_OP_READ_FIXED : IORING_OP_READ, fds[i]);
+      sqe.addr = (uint64_t)(m_buffer + i*SLOT_SIZE);
+      sqe.len = SLOT_SIZE;
+      sqe.off = 0;
+      sqe.buf_index = 0;
+      sqes.push_back(sqe);
+    }
+  }
+  std::vector<int> readResults;
+  bool retVal = !sqes.empty() && submit(sqes, readResults);
+
+  // closing files
+  sqes.clear();
+  for (std::size_t i = 0; i < fds.size(); i++) {
+    if (fds[i] >= 0) sqes.push_back(CreateRequest(IORING_OP_CLOSE, fds[i]));
+  }
+  if (!sqes.empty() && !submit(sqes, results)) {
+    // files are closed synchronously unless closed by a completed request
+    for (std::size_t i = 0, j = 0; i < fds.size(); i++) {
+      if (fds[i] >= 0 && results[j++] == -ECANCELED) ::close(fds[i]);
+    }
+  }
+  if (!retVal) return;
+
+  // a full slot indicates that the file is too big (read by stdio later)
+  std::size_t total = 0, maxTotal = getBatchSize();
+  for (std::size_t j = 0; j < opened.size(); j++) {
+    Entry &entry = entries[opened[j]];
+    if (readResults[j] > 0 && (std::size_t)readResults[j] < SLOT_SIZE &&
+        total + readResults[j] <= maxTotal) {
+      total += readResults[j];
+      entry.size = readResults[j];
+      entry.data.reset(new uint8_t[entry.size], std::default_delete<uint8_t[]>());
+      std::memcpy(entry.data.get(), m_buffer + opened[j]*SLOT_SIZE, entry.size);
+      entry.success = true;
+    }
+  }
+}
+
+
+void IOEngineUring::writeFiles(std::vector<Entry> &entries) noexcept
+{
+  std::vector<io_uring_sqe> sqes;
+  std::vector<int> fds, results;
+
+  // creating files
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    entries[i].success = false;
+    io_uring_sqe sqe = CreateRequest(IORING_OP_OPENAT, AT_FDCWD);
+    sqe.addr = (uint64_t)entries[i].name.c_str();
+    sqe.len = 0666;
+    sqe.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    sqes.push_back(sqe);
+  }
+  if (!submit(sqes, fds)) {
+    CloseFiles(fds);
+    IOEngine::writeFiles(entries);
+    return;
+  }
+
+  // writing data at offset 0
+  std::vector<std::size_t> opened;
+  sqes.clear();
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    if (fds[i] >= 0) {
+      opened.push_back(i);
+      io_uring_sqe sqe = CreateRequest(IORING_OP_WRITE, fds[i]);
+      sqe.addr = (uint64_t)entries[i].data.get();
+      sqe.len = std::min(entries[i].size, (std::size_t)0x40000000);
+      sqe.off = 0;
+      sqes.push_back(sqe);
+    }
+  }
+  std::vector<int> writeResults;
+  bool submitted = !sqes.empty() && submit(sqes, writeResults);
+  if (submitted) {
+    for (std::size_t j = 0; j < opened.size(); j++) {
+      Entry &entry = entries[opened[j]];
+      if (writeResults[j] >= 0) {
+        // completing short writes synchronously
+        std::size_t ofs = writeResults[j];
+        while (ofs < entry.size) {
+          ssize_t n = ::pwrite(fds[opened[j]], entry.data.get() + ofs, entry.size - ofs, ofs);
+          if (n <= 0) break;
+          ofs += n;
+        }
+        entry.success = (ofs == entry.size);
+      }
+    }
+  }
+
+  // closing files
+  sqes.clear();
+  for (std::size_t j = 0; j < opened.size(); j++) {
+    sqes.push_back(CreateRequest(IORING_OP_CLOSE, fds[opened[j]]));
+  }
+  if (!sqes.empty()) {
+    if (submit(sqes, results)) {
+      for (std::size_t j = 0; j < opened.size(); j++) {
+        if (results[j] < 0) entries[opened[j]].success = false;
+      }
+    } else {
+      for (std::size_t j = 0; j < opened.size(); j++) {
+        if (results[j] == -ECANCELED) ::close(fds[opened[j]]);
+      }
+    }
+  }
+
+  // files of a failed batch are written again via stdio
+  if (!submitted && !opened.empty()) IOEngine::writeFiles(entries);
+}
+
+
+void IOEngineUring::CloseFiles(const std::vector<int> &fds) noexcept
+{
+  for (auto iter = fds.cbegin(); iter != fds.cend(); ++iter) {
+    if (*iter >= 0) ::close(*iter);
+  }
+}
+
+
+bool IOEngineUring::init() noexcept
+{
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  m_ringFd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+  if (m_ringFd < 0) return false;
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0) return false;
+  m_entries = params.sq_entries;
+
+  // mapping submission and completion rings
+  m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+  m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  m_ringFd, IORING_OFF_SQ_RING);
+  if (m_sqRing == MAP_FAILED) { m_sqRing = nullptr; return false; }
+  m_cqRing = m_sqRing;
+  m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+  m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               m_ringFd, IORING_OFF_SQES);
+  if (m_sqes == MAP_FAILED) { m_sqes = nullptr; return false; }
+
+  uint8_t *sq = (uint8_t*)m_sqRing;
+  uint8_t *cq = (uint8_t*)m_cqRing;
+  m_sqTail  = (unsigned*)(sq + params.sq_off.tail);
+  m_sqMask  = (unsigned*)(sq + params.sq_off.ring_mask);
+  m_sqArray = (unsigned*)(sq + params.sq_off.array);
+  m_cqHead  = (unsigned*)(cq + params.cq_off.head);
+  m_cqTail  = (unsigned*)(cq + params.cq_off.tail);
+  m_cqMask  = (unsigned*)(cq + params.cq_off.ring_mask);
+  m_cqes    = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+  // checking for required operations
+  static const unsigned MAX_OPS = 256;
+  std::vector<uint8_t> probeBuf(sizeof(io_uring_probe) + MAX_OPS * sizeof(io_uring_probe_op), 0);
+  io_uring_probe *probe = (io_uring_probe*)probeBuf.data();
+  if (syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_PROBE, probe, MAX_OPS) < 0) return false;
+  static const unsigned ops[] = { IORING_OP_OPENAT, IORING_OP_READ,
+                                  IORING_OP_READ_FIXED, IORING_OP_WRITE, IORING_OP_CLOSE };
+  for (unsigned op : ops) {
+    if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) return false;
+  }
+
+  // registering staging buffer (may fail because of memory lock limits)
+  m_buffer = (uint8_t*)mmap(nullptr, MAX_BATCH_FILES*SLOT_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (m_buffer == MAP_FAILED) { m_buffer = nullptr; return false; }
+  iovec iov;
+  iov.iov_base = m_buffer;
+  iov.iov_len = MAX_BATCH_FILES*SLOT_SIZE;
+  m_fixedBuffer = (syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+
+  return true;
+}
+
+
+void IOEngineUring::close() noexcept
+{
+  if (m_buffer != nullptr) {
+    munmap(m_buffer, MAX_BATCH_FILES*SLOT_SIZE);
+    m_buffer = nullptr;
+  }
+  if (m_sqes != nullptr) {
+    munmap(m_sqes, m_sqesSize);
+    m_sqes = nullptr;
+  }
+  if (m_sqRing != nullptr) {
+    munmap(m_sqRing, m_sqRingSize);
+    m_sqRing = m_cqRing = nullptr;
+  }
+  if (m_ringFd >= 0) {
+    ::close(m_ringFd);   // also unregisters the staging buffer
+    m_ringFd = -1;
+  }
+  m_fixedBuffer = false;
+}
+
+
+bool IOEngineUring::submit(std::vector<io_uring_sqe> &sqes, std::vector<int> &results) noexcept
+{
+  results.assign(sqes.size(), -ECANCELED);
+  if (!isAvailable()) return false;
+
+  for (std::size_t start = 0; start < sqes.size(); start += m_entries) {
+    unsigned count = (unsigned)std::min((std::size_t)m_entries, sqes.size() - start);
+
+    // queueing requests
+    unsigned tail = *m_sqTail;
+    unsigned mask = *m_sqMask;
+    for (unsigned i = 0; i < count; i++, tail++) {
+      unsigned idx = tail & mask;
+      m_sqes[idx] = sqes[start + i];
+      m_sqes[idx].user_data = start + i;
+      m_sqArray[idx] = idx;
+    }
+    __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+    // submitting and collecting results
+    unsigned toSubmit = count, completed = 0;
+    while (completed < count) {
+      int ret = (int)syscall(__NR_io_uring_enter, m_ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret < 0) {
+        if (errno == EINTR) continue;
+        // unsubmitted requests are withdrawn, submitted requests still refer to the caller's data
+        __atomic_store_n(m_sqTail, tail - toSubmit, __ATOMIC_RELEASE);
+        if (!drain(count - toSubmit - completed, results)) close();
+        return false;
+      }
+      toSubmit -= std::min(toSubmit, (unsigned)ret);
+      completed += reap(results);
+    }
+  }
+  return true;
+}
+
+
+unsigned IOEngineUring::reap(std::vector<int> &results) noexcept
+{
+  unsigned head = *m_cqHead, completed = 0;
+  unsigned cqTail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+  for (; head != cqTail; head++, completed++) {
+    const io_uring_cqe &cqe = m_cqes[head & *m_cqMask];
+    if (cqe.user_data < results.size()) results[cqe.user_data] = cqe.res;
+  }
+  __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+  return completed;
+}
+
+
+bool IOEngineUring::drain(unsigned pending, std::vector<int> &results) noexcept
+{
+  while (pending > 0) {
+    int ret = (int)syscall(__NR_io_uring_enter, m_ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (ret < 0 && errno != EINTR) return false;
+    pending -= std::min(pending, reap(results));
+  }
+  return true;
+}
+
+
+io_uring_sqe IOEngineUring::CreateRequest(unsigned opcode, int fd) noexcept
+{
+  io_uring_sqe sqe;
+  std::memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = opcode;
+  sqe.fd = fd;
+  return sqe;
+}
+
+}   // namespace tc
+
+#endif    // USE_IO_URING
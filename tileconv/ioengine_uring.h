@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _IOENGINE_URING_H_
+#define _IOENGINE_URING_H_
+
+// io_uring is detected at runtime, but needs Linux kernel headers 5.6 or later
+#if !defined(NO_IO_URING) && defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  if defined(IO_URING_OP_SUPPORTED) && defined(IORING_FEAT_SINGLE_MMAP)
+#   define USE_IO_URING 1
+#  endif
+# endif
+#endif
+
+#ifdef USE_IO_URING
+#include <vector>
+#include "ioengine.h"
+
+namespace tc {
+
+/** I/O engine based on the Linux io_uring interface, using raw system calls. */
+class IOEngineUring : public IOEngine
+{
+public:
+  IOEngineUring() noexcept;
+  ~IOEngineUring() noexcept;
+
+  /** Returns whether io_uring and all required operations are supported by the kernel. */
+  bool isAvailable() const noexcept { return m_ringFd >= 0; }
+
+  const char* getName() const noexcept { return "io_uring"; }
+
+protected:
+  bool supportsBatch() const noexcept { return true; }
+
+  /** Submits batched open, read and close requests for all entries. Files must fit into a slot of the staging buffer. */
+  void readFiles(std::vector<Entry> &entries) noexcept;
+  /** Submits batched open, write and close requests for all entries. */
+  void writeFiles(std::vector<Entry> &entries) noexcept;
+
+private:
+  // Sets up the submission and completion rings. Returns false if io_uring is not usable.
+  bool init() noexcept;
+  void close() noexcept;
+
+  // Submits the given requests and waits for completion. results[i] contains the result of sqes[i].
+  // On error, results of requests which have not completed are -ECANCELED.
+  bool submit(std::vector<io_uring_sqe> &sqes, std::vector<int> &results) noexcept;
+  // Stores the results of all available completions. Returns the number of completions.
+  unsigned reap(std::vector<int> &results) noexcept;
+  // Waits for the given number of submitted requests to complete. Returns false on error.
+  bool drain(unsigned pending, std::vector<int> &results) noexcept;
+
+  // Closes all valid file descriptors synchronously
+  static void CloseFiles(const std::vector<int> &fds) noexcept;
+
+  // Returns an initialized request of the given operation type
+  static io_uring_sqe CreateRequest(unsigned opcode, int fd) noexcept;
+
+private:
+  static const unsigned    RING_ENTRIES;
+  static const std::size_t SLOT_SIZE;     // max. file size for batched reads
+
+  int           m_ringFd;
+  unsigned      m_entries;
+  void          *m_sqRing;
+  std::size_t   m_sqRingSize;
+  void          *m_cqRing;
+  std::size_t   m_cqRingSize;
+  io_uring_sqe  *m_sqes;
+  std::size_t   m_sqesSize;
+  unsigned      *m_sqTail;
+  unsigned      *m_sqMask;
+  unsigned      *m_sqArray;
+  unsigned      *m_cqHead;
+  unsigned      *m_cqTail;
+  unsigned      *m_cqMask;
+  io_uring_cqe  *m_cqes;
+  uint8_t       *m_buffer;      // registered staging buffer for batched reads
+  bool          m_fixedBuffer;  // whether m_buffer could be registered
+};
+
+}   // namespace tc
+
+#endif    // USE_IO_URING
+
+#endif		// _IOENGINE_URING_H_
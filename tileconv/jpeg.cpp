@@ -19,11 +19,14 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
-#include <cstring>
+#include <algorithm>
 #include "jpeg.h"
+#include "stats.h"
 
 namespace tc {
 
+const unsigned Jpeg::MAX_SCANLINES = 16;
+
 Jpeg::Jpeg(const Options& options) noexcept
 : m_options(options)
 , m_info()
@@ -52,13 +55,16 @@ int Jpeg::decompress(uint8_t *srcBuf, size_t srcBufSize, JSAMPARRAY srcPal,
 {
   setError(false);
   if (srcBuf != nullptr && srcBufSize > 0 && dstPal != nullptr && dstBuf != nullptr) {
+    Stats::Timer timer(Stats::Stage::JPEG, srcBufSize);
     JSAMPLE *jpgPal[3];
 
     // initializing decompression
     jpeg_mem_src(&m_info, srcBuf, srcBufSize);
     jpeg_read_header(&m_info, TRUE);
+    if (isError()) return abort();
     m_width = m_info.image_width;
     m_height = m_info.image_height;
+    setDecodingMethod();
 
     // setting 8-bit mode
     m_info.quantize_colors = TRUE;
@@ -83,14 +89,9 @@ int Jpeg::decompress(uint8_t *srcBuf, size_t srcBufSize, JSAMPARRAY srcPal,
 
     // start decompressing
     jpeg_start_decompress(&m_info);
+    if (isError()) return abort();
     int tileSize = m_info.output_width*m_info.output_height;
-    int len = 0;
-    JSAMPARRAY buffer = (*m_info.mem->alloc_sarray)((j_common_ptr)&m_info, JPOOL_IMAGE, tileSize, 1);
-    while (m_info.output_scanline < m_info.output_height) {
-      jpeg_read_scanlines(&m_info, buffer, 1);
-      std::memcpy(dstBuf + len, buffer[0], m_info.output_width);
-      len += m_info.output_width;
-    }
+    if (!readScanlines(dstBuf, m_info.output_width)) return abort();
 
     if (srcPal != nullptr) {
       // storing predefined palette
@@ -110,8 +111,7 @@ int Jpeg::decompress(uint8_t *srcBuf, size_t srcBufSize, JSAMPARRAY srcPal,
         if (m_info.colormap[0] == nullptr ||
             m_info.colormap[1] == nullptr ||
             m_info.colormap[2] == nullptr) {
-            jpeg_abort_decompress(&m_info);
-            return 0;
+          return abort();
         }
         // storing generated palette
         for (int i = 0; i < 256; i++) {
@@ -121,8 +121,7 @@ int Jpeg::decompress(uint8_t *srcBuf, size_t srcBufSize, JSAMPARRAY srcPal,
           dstPal[(i << 2) + 3] = 0;
         }
       } else {
-        jpeg_abort_decompress(&m_info);
-        return 0;
+        return abort();
       }
     }
 
@@ -130,8 +129,61 @@ int Jpeg::decompress(uint8_t *srcBuf, size_t srcBufSize, JSAMPARRAY srcPal,
     jpeg_finish_decompress(&m_info);
 
     if (!isError()) {
-      return 1024 + len;
+      return 1024 + tileSize;
+    }
+    abort();
+  }
+  return 0;
+}
+
+
+int Jpeg::decompress(uint8_t *srcBuf, size_t srcBufSize, uint8_t *dstBuf, size_t dstBufSize) noexcept
+{
+  setError(false);
+  if (srcBuf != nullptr && srcBufSize > 0 && dstBuf != nullptr) {
+    Stats::Timer timer(Stats::Stage::JPEG, srcBufSize);
+    // initializing decompression
+    jpeg_mem_src(&m_info, srcBuf, srcBufSize);
+    jpeg_read_header(&m_info, TRUE);
+    if (isError()) return abort();
+    m_width = m_info.image_width;
+    m_height = m_info.image_height;
+    if ((size_t)m_width*(size_t)m_height*4 > dstBufSize) return abort();
+    setDecodingMethod();
+#ifdef JCS_ALPHA_EXTENSIONS
+    // libjpeg-turbo fills in the alpha component
+    m_info.out_color_space = JCS_EXT_RGBA;
+#else
+    m_info.out_color_space = JCS_RGB;
+#endif
+
+    // start decompressing
+    jpeg_start_decompress(&m_info);
+    if (isError()) return abort();
+    int len = m_info.output_width*m_info.output_height*4;
+#ifdef JCS_ALPHA_EXTENSIONS
+    if (m_info.output_components != 4) return abort();
+    if (!readScanlines(dstBuf, m_info.output_width*4)) return abort();
+#else
+    if (m_info.output_components != 3) return abort();
+    // decoding into the upper part of dstBuf and expanding pixels in place
+    uint8_t *src = dstBuf + m_info.output_width*m_info.output_height;
+    if (!readScanlines(src, m_info.output_width*3)) return abort();
+    for (int i = 0; i < len; i += 4, src += 3) {
+      dstBuf[i]   = src[0];
+      dstBuf[i+1] = src[1];
+      dstBuf[i+2] = src[2];
+      dstBuf[i+3] = 255;
+    }
+#endif
+
+    // finished decompressing
+    jpeg_finish_decompress(&m_info);
+
+    if (!isError()) {
+      return len;
     }
+    abort();
   }
   return 0;
 }
@@ -154,6 +206,40 @@ bool Jpeg::updateInformation(uint8_t *buf, size_t bufSize) noexcept
 }
 
 
+void Jpeg::setDecodingMethod() noexcept
+{
+  if (getOptions().getDecodingQuality() <= 2) {
+    // fast integer DCT and simple pixel replication for chroma channels
+    m_info.dct_method = JDCT_IFAST;
+    m_info.do_fancy_upsampling = FALSE;
+  } else {
+    m_info.dct_method = JDCT_ISLOW;
+    m_info.do_fancy_upsampling = TRUE;
+  }
+}
+
+
+bool Jpeg::readScanlines(uint8_t *dstBuf, unsigned stride) noexcept
+{
+  JSAMPROW rows[MAX_SCANLINES];
+  while (m_info.output_scanline < m_info.output_height) {
+    unsigned count = std::min(MAX_SCANLINES, m_info.output_height - m_info.output_scanline);
+    for (unsigned i = 0; i < count; i++) {
+      rows[i] = dstBuf + (m_info.output_scanline + i)*stride;
+    }
+    if (jpeg_read_scanlines(&m_info, rows, count) == 0 || isError()) return false;
+  }
+  return true;
+}
+
+
+int Jpeg::abort() noexcept
+{
+  jpeg_abort_decompress(&m_info);
+  return 0;
+}
+
+
 void Jpeg::MyErrorExit(j_common_ptr cinfo)
 {
   Jpeg *instance = (Jpeg*)cinfo->client_data;
@@ -49,6 +49,17 @@ class Jpeg
   int decompress(uint8_t *srcBuf, size_t srcBufSize, JSAMPARRAY srcPal,
                  uint8_t *dstPal, uint8_t *dstBuf) noexcept;
 
+  /**
+   * Decompress a JPEG image to 32-bit pixels without color reduction.
+   * Color components are stored in the same order as palette entries of decompress().
+   * \param srcBuf Buffer containing JPEG image data.
+   * \param srcBufSize Size of the JPEG image in bytes.
+   * \param dstBuf Storage for decompressed 32-bit pixels.
+   * \param dstBufSize Available space in dstBuf in bytes.
+   * \return Size of decoded pixel data or 0 on error.
+   */
+  int decompress(uint8_t *srcBuf, size_t srcBufSize, uint8_t *dstBuf, size_t dstBufSize) noexcept;
+
   /**
    * Attempts to retrieve information about the JPEG image specfied in the given buffer.
    * Information can be queried with getWidth(), getHeight() and getSubSampling() afterwards.
@@ -69,7 +80,18 @@ class Jpeg
   bool isError() const noexcept { return m_error; }
   void setError(bool b) noexcept { m_error = b; }
 
+  // Applies decoding quality dependent settings after reading the JPEG header
+  void setDecodingMethod() noexcept;
+
+  // Reads all remaining scanlines directly into dstBuf, using stride bytes per scanline
+  bool readScanlines(uint8_t *dstBuf, unsigned stride) noexcept;
+
+  // Returns the decompressor to its idle state after an error
+  int abort() noexcept;
+
 private:
+  static const unsigned MAX_SCANLINES;    // max. number of scanlines to read per call
+
   const Options&                m_options;
   struct jpeg_decompress_struct m_info;
   struct jpeg_error_mgr         m_err;
@@ -0,0 +1,450 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#ifndef USE_WINTHREADS
+#include <map>
+#include <condition_variable>
+#endif
+#include "version.h"
+#include "fileio.h"
+#include "ioengine.h"
+#include "logger.h"
+#include "membudget.h"
+#include "affinity.h"
+#include "library.h"
+
+namespace tc {
+
+const char Library::MEMORY_PATH[] = "::memory::";
+
+
+const char* Library::GetResultName(Result result) noexcept
+{
+  switch (result) {
+    case Result::OK:                  return "OK";
+    case Result::INVALID_ARGUMENT:    return "Invalid argument";
+    case Result::UNSUPPORTED_FORMAT:  return "Unsupported format";
+    case Result::READ_ERROR:          return "Read error";
+    case Result::WRITE_ERROR:         return "Write error";
+    case Result::CONVERSION_ERROR:    return "Conversion error";
+    case Result::INVALID_DATA:        return "Invalid data";
+    case Result::OUT_OF_MEMORY:       return "Out of memory";
+    default:                          return "Unknown";
+  }
+}
+
+
+Library::Library() noexcept
+: m_options()
+, m_graphics(m_options)
+, m_cache()
+, m_capture(false)
+, m_messages()
+{
+}
+
+
+Library::Library(const Options &options) noexcept
+: m_options()
+, m_graphics(m_options)
+, m_cache()
+, m_capture(false)
+, m_messages()
+{
+  setOptions(options);
+}
+
+
+Library::~Library() noexcept
+{
+}
+
+
+void Library::setOptions(const Options &options) noexcept
+{
+  // graphics object refers to m_options
+  m_options = options;
+  m_options.clearInput();
+  m_options.clearJobs();
+}
+
+
+void Library::setThreadPool(ThreadPoolPtr pool) noexcept
+{
+#ifndef USE_WINTHREADS
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_poolMutex = (pool != nullptr) ? GetPoolMutex(pool.get()) : nullptr;
+#endif
+  m_graphics.setThreadPool(pool);
+}
+
+
+Library::Result Library::setOptions(const std::string &args) noexcept
+{
+  std::vector<std::string> list = Options::SplitArguments(args);
+  std::vector<char*> argv;
+  argv.push_back(prog_name);
+  for (auto iter = list.begin(); iter != list.end(); ++iter) {
+    argv.push_back(&(*iter)[0]);
+  }
+  argv.push_back(nullptr);
+
+  m_messages.clear();
+  if (isCaptureMessages()) Logger::SetHandler(CaptureMessage, this);
+  Options options;
+  bool success = options.init((int)argv.size() - 1, argv.data(), false) &&
+                 !options.isServer() && options.getInputCount() == 0 && options.getJobCount() == 0;
+  if (isCaptureMessages()) Logger::SetHandler(nullptr, nullptr);
+
+  if (!success) return Result::INVALID_ARGUMENT;
+  setOptions(options);
+  return Result::OK;
+}
+
+
+Library::Result Library::convertFile(const std::string &inFile) noexcept
+{
+#ifndef USE_WINTHREADS
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> poolLock;
+  if (m_poolMutex != nullptr) poolLock = std::unique_lock<std::mutex>(*m_poolMutex);
+  // batch I/O queues output files of all conversions
+  EngineLock engineLock(IOEngine::GetBatchInstance() != nullptr);
+#endif
+
+  m_messages.clear();
+  if (isCaptureMessages()) Logger::SetHandler(CaptureMessage, this);
+  Result retVal = convertFileInternal(inFile);
+
+  // output files queued by the batch I/O engine have to be on disk before the conversion succeeds
+  IOEngine *engine = IOEngine::GetBatchInstance();
+  if (engine != nullptr && !engine->flush() && retVal == Result::OK) retVal = Result::WRITE_ERROR;
+  if (isCaptureMessages()) Logger::SetHandler(nullptr, nullptr);
+  return retVal;
+}
+
+
+Library::Result Library::convert(const uint8_t *data, std::size_t size, const std::string &name,
+                                 OutputSink &sink) noexcept
+{
+  if (data == nullptr || size == 0 || File::ExtractFileName(name).empty()) return Result::INVALID_ARGUMENT;
+
+#ifndef USE_WINTHREADS
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> poolLock;
+  if (m_poolMutex != nullptr) poolLock = std::unique_lock<std::mutex>(*m_poolMutex);
+  // memory files are managed by the global I/O engine
+  EngineLock engineLock(true);
+#endif
+
+  m_messages.clear();
+  if (isCaptureMessages()) Logger::SetHandler(CaptureMessage, this);
+
+  // input and output files are located in the memory path
+  IOEngine &engine = IOEngine::GetInstance();
+  const std::string memPath = File::CreateFileName(MEMORY_PATH, std::string());
+  const std::string inFile = File::CreateFileName(memPath, File::ExtractFileName(name));
+  engine.setMemoryPath(memPath);
+  BytePtr inData(new uint8_t[size], std::default_delete<uint8_t[]>());
+  std::memcpy(inData.get(), data, size);
+  engine.setMemoryFile(inFile, inData, size);
+  inData.reset();
+
+  const Options options(m_options);
+  m_options.resetOutput();
+  Result retVal = convertFileInternal(inFile);
+  m_options = options;
+
+  if (retVal == Result::OK) {
+    std::vector<std::string> files = engine.getMemoryFiles();
+    for (auto iter = files.begin(); iter != files.end() && retVal == Result::OK; ++iter) {
+      if (*iter == inFile) continue;
+      BytePtr outData;
+      std::size_t outSize = 0;
+      if (!engine.getMemoryFile(*iter, outData, outSize) ||
+          !sink.write(File::ExtractFileName(*iter), outData.get(), outSize)) {
+        retVal = Result::WRITE_ERROR;
+      }
+    }
+  }
+  engine.setMemoryPath(std::string());
+
+  if (isCaptureMessages()) Logger::SetHandler(nullptr, nullptr);
+  return retVal;
+}
+
+
+#ifndef USE_WINTHREADS
+struct Library::EngineLock::State
+{
+  std::mutex mutex;
+  std::condition_variable released;
+  int shared;       // number of conversions sharing the engine
+  bool exclusive;   // engine is used by a single conversion
+};
+
+
+Library::EngineLock::EngineLock(bool exclusive) noexcept
+: m_exclusive(exclusive)
+{
+  State &state = GetState();
+  std::unique_lock<std::mutex> lock(state.mutex);
+  if (m_exclusive) {
+    state.released.wait(lock, [&state] { return !state.exclusive && state.shared == 0; });
+    state.exclusive = true;
+  } else {
+    state.released.wait(lock, [&state] { return !state.exclusive; });
+    state.shared++;
+  }
+}
+
+
+Library::EngineLock::~EngineLock() noexcept
+{
+  State &state = GetState();
+  std::lock_guard<std::mutex> lock(state.mutex);
+  if (m_exclusive) {
+    state.exclusive = false;
+  } else {
+    state.shared--;
+  }
+  state.released.notify_all();
+}
+
+
+Library::EngineLock::State& Library::EngineLock::GetState() noexcept
+{
+  static State state = { {}, {}, 0, false };
+  return state;
+}
+
+
+std::shared_ptr<std::mutex> Library::GetPoolMutex(const TileThreadPool *pool) noexcept
+{
+  static std::mutex mutex;
+  static std::map<const TileThreadPool*, std::weak_ptr<std::mutex>> poolMutexes;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  // removing mutexes of released thread pools
+  for (auto iter = poolMutexes.begin(); iter != poolMutexes.end(); ) {
+    if (iter->second.expired()) {
+      iter = poolMutexes.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  std::shared_ptr<std::mutex> retVal = poolMutexes[pool].lock();
+  if (retVal == nullptr) {
+    retVal.reset(new std::mutex);
+    poolMutexes[pool] = retVal;
+  }
+  return retVal;
+}
+#endif
+
+
+Library::Result Library::GetResult(Graphics::Error error) noexcept
+{
+  switch (error) {
+    case Graphics::Error::READ:   return Result::READ_ERROR;
+    case Graphics::Error::WRITE:  return Result::WRITE_ERROR;
+    case Graphics::Error::DATA:   return Result::INVALID_DATA;
+    case Graphics::Error::MEMORY: return Result::OUT_OF_MEMORY;
+    default:                      return Result::CONVERSION_ERROR;
+  }
+}
+
+
+void Library::CaptureMessage(const char *msg, void *context) noexcept
+{
+  if (msg != nullptr && context != nullptr) {
+    static_cast<Library*>(context)->m_messages.append(msg);
+  }
+}
+
+
+std::string Library::getOutputFileName(const std::string &inFile, FileType fileType) const noexcept
+{
+  if (getOptions().isOutFile()) {
+    return File::CreateFileName(getOptions().getOutPath(), getOptions().getOutFile());
+  }
+
+  FileType outType = FileType::UNKNOWN;
+  switch (fileType) {
+    case FileType::TIS:
+      outType = FileType::TBC;
+      break;
+    case FileType::MOS:
+      outType = FileType::MBC;
+      break;
+    case FileType::TBC:
+    case FileType::MBC:
+      if (getOptions().isBitmapOutput()) {
+        outType = FileType::BM32;
+      } else {
+        outType = (fileType == FileType::TBC) ? FileType::TIS : FileType::MOS;
+      }
+      break;
+    case FileType::TIZ:
+      outType = getOptions().isEncodeZ() ? FileType::TBC : FileType::TIS;
+      break;
+    case FileType::MOZ:
+      outType = getOptions().isEncodeZ() ? FileType::MBC : FileType::MOS;
+      break;
+    default:
+      return std::string();
+  }
+  return Options::GetOutputFileName(getOptions().getOutPath(), inFile, outType, false);
+}
+
+
+bool Library::isCacheable(const std::string &inFile, const std::string &outFile) const noexcept
+{
+  if (!getOptions().isCache() || getOptions().isPvrzOutput()) return false;
+  // the cache key covers the input file only, not the PVRZ pages it refers to
+  if (m_graphics.isPvrzBased(inFile)) return false;
+  IOEngine *engine = IOEngine::GetActiveInstance();
+  return (engine == nullptr || (!engine->isMemoryFile(inFile) && !engine->isMemoryFile(outFile)));
+}
+
+
+Library::Result Library::convertFileInternal(const std::string &inFile) noexcept
+{
+  if (inFile.empty()) return Result::INVALID_ARGUMENT;
+  MemoryBudget::SetLimit((uint64_t)getOptions().getMaxMemory() << 20);
+  Affinity::SetMode(getOptions().getAffinity(), getOptions().getThreads());
+  if (!File::Exists(inFile)) {
+    Logger::Print("File does not exist: \"%s\"\n", inFile.c_str());
+    return Result::READ_ERROR;
+  }
+
+  FileType fileType = Options::GetFileType(inFile, getOptions().assumeTis());
+  if (fileType == FileType::UNKNOWN || fileType == FileType::BM32) {
+    Logger::Print("Unsupported file type: \"%s\"\n", inFile.c_str());
+    return Result::UNSUPPORTED_FORMAT;
+  }
+
+  std::string outFile = getOutputFileName(inFile, fileType);
+  if (outFile.empty()) {
+    Logger::Print("Error creating output filename\n");
+    return Result::INVALID_ARGUMENT;
+  } else if (File::IsEqual(inFile, outFile)) {
+    Logger::Print("Error: Input file and output file are equal: %s\n", inFile.c_str());
+    return Result::INVALID_ARGUMENT;
+  }
+
+  // output files are queued for writing in batches, write errors name the input file
+  IOEngine *engine = IOEngine::GetBatchInstance();
+  if (engine != nullptr) engine->setSource(inFile);
+
+  // selecting conversion
+  const char *desc = nullptr;
+  bool (Graphics::*func)(const std::string&, const std::string&) = nullptr;
+  switch (fileType) {
+    case FileType::TIS:
+      desc = "Converting TIS -> TBC";
+      func = &Graphics::tisToTBC;
+      break;
+    case FileType::MOS:
+      desc = "Converting MOS -> MBC";
+      func = &Graphics::mosToMBC;
+      break;
+    case FileType::TBC:
+      if (getOptions().isBitmapOutput()) {
+        desc = "Converting TBC -> BM32";
+        func = &Graphics::tbcToBitmap;
+      } else if (getOptions().isPvrzOutput()) {
+        desc = "Transcoding TBC -> TIS V2 + PVRZ";
+        func = &Graphics::tbcToPvrz;
+      } else {
+        desc = "Converting TBC -> TIS";
+        func = &Graphics::tbcToTIS;
+      }
+      break;
+    case FileType::MBC:
+      if (getOptions().isBitmapOutput()) {
+        desc = "Converting MBC -> BM32";
+        func = &Graphics::mbcToBitmap;
+      } else if (getOptions().isPvrzOutput()) {
+        desc = "Transcoding MBC -> MOS V2 + PVRZ";
+        func = &Graphics::mbcToPvrz;
+      } else {
+        desc = "Converting MBC -> MOS";
+        func = &Graphics::mbcToMOS;
+      }
+      break;
+    case FileType::TIZ:
+      if (getOptions().isEncodeZ()) {
+        desc = "Converting TIZ -> TBC";
+        func = &Graphics::tizToTBC;
+      } else {
+        desc = "Converting TIZ -> TIS";
+        func = &Graphics::tizToTIS;
+      }
+      break;
+    case FileType::MOZ:
+      if (getOptions().isEncodeZ()) {
+        desc = "Converting MOZ -> MBC";
+        func = &Graphics::mozToMBC;
+      } else {
+        desc = "Converting MOZ -> MOS";
+        func = &Graphics::mozToMOS;
+      }
+      break;
+    default:
+      return Result::UNSUPPORTED_FORMAT;
+  }
+
+  // restoring results of unchanged input files from the cache
+  std::string cacheEntry;
+  if (isCacheable(inFile, outFile)) {
+    char version[32];
+    std::snprintf(version, sizeof(version), "%d.%d.%d", vers_major, vers_minor, vers_patch);
+    m_cache.setFolder(getOptions().getCachePath(), (uint64_t)getOptions().getCacheSize() << 20);
+    cacheEntry = m_cache.getEntry(inFile, std::string(desc) + " " + getOptions().getCacheKey() + " " + version);
+    if (m_cache.restore(cacheEntry, outFile)) {
+      if (!getOptions().isSilent()) {
+        Logger::Print("%s (cached)\n", desc);
+        Logger::Print("Input: \"%s\", output: \"%s\"\n", inFile.c_str(), outFile.c_str());
+      }
+      return Result::OK;
+    }
+  }
+
+  if (!getOptions().isSilent()) {
+    Logger::Print("%s\n", desc);
+    Logger::Print("Input: \"%s\", output: \"%s\"\n", inFile.c_str(), outFile.c_str());
+  }
+  if (!(m_graphics.*func)(inFile, outFile)) {
+    Logger::Print("Error while converting \"%s\"\n", inFile.c_str());
+    return GetResult(m_graphics.getError());
+  }
+
+  if (!cacheEntry.empty() && !m_cache.store(cacheEntry, outFile) && getOptions().isVerbose()) {
+    Logger::Print("Warning: Could not add \"%s\" to cache\n", outFile.c_str());
+  }
+  return Result::OK;
+}
+
+}   // namespace tc
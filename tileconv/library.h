@@ -0,0 +1,163 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _LIBRARY_H_
+#define _LIBRARY_H_
+#include <cstddef>
+#include <string>
+#ifndef USE_WINTHREADS
+#include <memory>
+#include <mutex>
+#endif
+#include "types.h"
+#include "options.h"
+#include "graphics.h"
+#include "cache.h"
+
+namespace tc {
+
+/** Receives the files produced by a conversion of memory buffers. */
+class OutputSink
+{
+public:
+  virtual ~OutputSink() noexcept {}
+
+  /**
+   * Called once for each output file. name is the file name without path (e.g. PVRZ pages are
+   * passed as separate files). Return false to signal an error.
+   */
+  virtual bool write(const std::string &name, const uint8_t *data, std::size_t size) noexcept = 0;
+};
+
+
+/**
+ * Conversion interface for applications embedding tileconv. Files are converted either on disk
+ * or from a memory buffer into an OutputSink. Instances convert files concurrently unless they share
+ * a thread pool. Conversions of memory buffers are serialized, since they use the global I/O engine.
+ * Messages are captured per instance.
+ */
+class Library
+{
+public:
+  /** Result codes of the conversion functions. */
+  enum class Result {
+    OK,                   // conversion successful
+    INVALID_ARGUMENT,     // invalid options or parameters
+    UNSUPPORTED_FORMAT,   // unsupported or unrecognized input format
+    READ_ERROR,           // input file not available or could not be read
+    WRITE_ERROR,          // output sink reported an error or an output file could not be written
+    CONVERSION_ERROR,     // error while converting input data (see getMessages())
+    INVALID_DATA,         // input data is invalid, truncated or not supported by the conversion
+    OUT_OF_MEMORY,        // not enough memory for the input data
+  };
+
+  /** Returns a short description of the specified result code. */
+  static const char* GetResultName(Result result) noexcept;
+
+public:
+  Library() noexcept;
+  explicit Library(const Options &options) noexcept;
+  ~Library() noexcept;
+
+  /** Conversion options. Input files and jobs of the options are ignored. */
+  void setOptions(const Options &options) noexcept;
+  /** Parses options from a command line string without input files (e.g. "-s -t 2 -q 49"). */
+  Result setOptions(const std::string &args) noexcept;
+  const Options& getOptions() const noexcept { return m_options; }
+
+  /** Uses the specified thread pool instead of an internally managed one (nullptr: internal pool). */
+  void setThreadPool(ThreadPoolPtr pool) noexcept;
+
+  /** Converts inFile into the output file or path defined by the current options. */
+  Result convertFile(const std::string &inFile) noexcept;
+
+  /**
+   * Converts the memory buffer data into the format defined by the current options. name is the
+   * file name of the input data, which determines input file type and names of output files.
+   * Output files are passed to sink. Output file names specified in the options are ignored.
+   */
+  Result convert(const uint8_t *data, std::size_t size, const std::string &name,
+                 OutputSink &sink) noexcept;
+
+  /**
+   * Collects messages of conversions and option parsing in this object instead of printing
+   * them to stdout. Messages are cleared at the start of each operation.
+   */
+  void setCaptureMessages(bool b) noexcept { m_capture = b; }
+  bool isCaptureMessages() const noexcept { return m_capture; }
+  const std::string& getMessages() const noexcept { return m_messages; }
+
+  /** Provides access to the conversion cache and its statistics (see options -C and -c). */
+  const ConversionCache& getCache() const noexcept { return m_cache; }
+
+private:
+#ifndef USE_WINTHREADS
+  // Grants a conversion access to the global I/O engine. Conversions of files share the engine,
+  // conversions of memory buffers or with batch I/O use it exclusively.
+  class EngineLock
+  {
+  public:
+    explicit EngineLock(bool exclusive) noexcept;
+    ~EngineLock() noexcept;
+
+  private:
+    struct State;
+    static State& GetState() noexcept;
+
+    bool m_exclusive;
+  };
+
+  // Returns the mutex serializing conversions of all instances using the thread pool pool
+  static std::shared_ptr<std::mutex> GetPoolMutex(const TileThreadPool *pool) noexcept;
+#endif
+
+  // Returns the result code of a failed conversion with the specified cause
+  static Result GetResult(Graphics::Error error) noexcept;
+
+  // Logger handler for captured messages
+  static void CaptureMessage(const char *msg, void *context) noexcept;
+
+  // Returns the output filename for inFile, or an empty string on error
+  std::string getOutputFileName(const std::string &inFile, FileType fileType) const noexcept;
+
+  // Returns whether conversion results of inFile can be cached with the current options
+  bool isCacheable(const std::string &inFile, const std::string &outFile) const noexcept;
+
+  // Conversion of convertFile() and convert() without message handling
+  Result convertFileInternal(const std::string &inFile) noexcept;
+
+private:
+  static const char MEMORY_PATH[];    // location of memory files of convert()
+
+  Options     m_options;
+  Graphics    m_graphics;     // refers to m_options
+  ConversionCache m_cache;
+  bool        m_capture;      // collect messages in m_messages
+  std::string m_messages;
+#ifndef USE_WINTHREADS
+  std::mutex  m_mutex;        // serializes conversions of this instance
+  std::shared_ptr<std::mutex> m_poolMutex;  // serializes conversions using a shared thread pool
+#endif
+};
+
+}   // namespace tc
+
+#endif		// _LIBRARY_H_
@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <new>
+#include <string>
+#include "tilethreadpool.h"
+#include "library.h"
+#include "tileconv_c.h"
+
+/** Wrappers of the C interface. */
+struct tc_library
+{
+  tc::Library lib;
+};
+
+struct tc_thread_pool
+{
+  tc::ThreadPoolPtr pool;
+};
+
+
+namespace tc {
+
+/** Passes output files to the sink function of the C interface. */
+class CallbackSink : public OutputSink
+{
+public:
+  CallbackSink(tc_sink sink, void *context) noexcept : m_sink(sink), m_context(context) {}
+
+  bool write(const std::string &name, const uint8_t *data, std::size_t size) noexcept
+  {
+    return m_sink(m_context, name.c_str(), data, size) != 0;
+  }
+
+private:
+  tc_sink   m_sink;
+  void     *m_context;
+};
+
+}   // namespace tc
+
+
+tc_library* tc_create(void)
+{
+  tc_library *lib = new(std::nothrow) tc_library;
+  if (lib != nullptr) {
+    lib->lib.setCaptureMessages(true);
+  }
+  return lib;
+}
+
+
+void tc_destroy(tc_library *lib)
+{
+  delete lib;
+}
+
+
+int tc_set_options(tc_library *lib, const char *args)
+{
+  if (lib == nullptr || args == nullptr) return TC_INVALID_ARGUMENT;
+  return (int)lib->lib.setOptions(std::string(args));
+}
+
+
+int tc_convert_file(tc_library *lib, const char *inFile)
+{
+  if (lib == nullptr || inFile == nullptr) return TC_INVALID_ARGUMENT;
+  return (int)lib->lib.convertFile(std::string(inFile));
+}
+
+
+int tc_convert(tc_library *lib, const void *data, size_t size, const char *name,
+               tc_sink sink, void *context)
+{
+  if (lib == nullptr || name == nullptr || sink == nullptr) return TC_INVALID_ARGUMENT;
+  tc::CallbackSink callback(sink, context);
+  return (int)lib->lib.convert((const uint8_t*)data, size, std::string(name), callback);
+}
+
+
+const char* tc_get_messages(const tc_library *lib)
+{
+  return (lib != nullptr) ? lib->lib.getMessages().c_str() : "";
+}
+
+
+const char* tc_get_result_name(int result)
+{
+  return tc::Library::GetResultName((tc::Library::Result)result);
+}
+
+
+tc_thread_pool* tc_create_thread_pool(int threads)
+{
+  if (threads <= 0) threads = tc::getThreadPoolAutoThreads();
+  tc_thread_pool *pool = new(std::nothrow) tc_thread_pool;
+  if (pool != nullptr) {
+    pool->pool = tc::createThreadPool(threads, 1);
+    if (pool->pool == nullptr) {
+      delete pool;
+      pool = nullptr;
+    }
+  }
+  return pool;
+}
+
+
+void tc_destroy_thread_pool(tc_thread_pool *pool)
+{
+  delete pool;
+}
+
+
+void tc_set_thread_pool(tc_library *lib, tc_thread_pool *pool)
+{
+  if (lib != nullptr) {
+    lib->lib.setThreadPool((pool != nullptr) ? pool->pool : tc::ThreadPoolPtr());
+  }
+}
@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <cstdio>
+#include <cstdarg>
+#include <vector>
+#include "logger.h"
+
+namespace tc {
+
+Logger::Target& Logger::GetTargetRef() noexcept
+{
+  static thread_local Target target = { nullptr, nullptr };
+  return target;
+}
+
+
+#ifndef USE_WINTHREADS
+std::mutex& Logger::GetMutex() noexcept
+{
+  static std::mutex mutex;
+  return mutex;
+}
+#endif
+
+
+void Logger::SetHandler(Handler handler, void *context) noexcept
+{
+  Target &target = GetTargetRef();
+  target.handler = handler;
+  target.context = context;
+}
+
+
+int Logger::Print(const char *format, ...) noexcept
+{
+  const Target &target = GetTargetRef();
+  int retVal = 0;
+  va_list args;
+  va_start(args, format);
+  if (target.handler == nullptr) {
+    retVal = std::vprintf(format, args);
+  } else {
+    char buf[512];
+    va_list args2;
+    va_copy(args2, args);
+    retVal = std::vsnprintf(buf, sizeof(buf), format, args);
+    if (retVal >= 0) {
+      std::vector<char> msg;
+      if (retVal >= (int)sizeof(buf)) {
+        msg.resize(retVal + 1);
+        std::vsnprintf(msg.data(), msg.size(), format, args2);
+      }
+#ifndef USE_WINTHREADS
+      std::lock_guard<std::mutex> lock(GetMutex());
+#endif
+      target.handler(msg.empty() ? buf : msg.data(), target.context);
+    }
+    va_end(args2);
+  }
+  va_end(args);
+  return retVal;
+}
+
+
+void Logger::Flush() noexcept
+{
+  if (GetTargetRef().handler == nullptr) std::fflush(stdout);
+}
+
+}   // namespace tc
@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _LOGGER_H_
+#define _LOGGER_H_
+
+#ifndef USE_WINTHREADS
+#include <mutex>
+#endif
+
+namespace tc {
+
+/**
+ * Text output of the conversion routines. Messages are printed to stdout by default, or passed
+ * to a custom handler if installed (e.g. to capture messages when used as a library).
+ * Handlers are installed per thread. Worker threads use the handler of the thread which
+ * created the processed tile (see TileData).
+ */
+class Logger
+{
+public:
+  /** Receives a formatted message. context is the value passed to SetHandler(). */
+  typedef void (*Handler)(const char *msg, void *context);
+
+  /** Message handler of a thread. */
+  struct Target
+  {
+    Handler     handler;
+    void       *context;
+  };
+
+  /** Installs a message handler for the current thread. Specify nullptr to print to stdout. */
+  static void SetHandler(Handler handler, void *context) noexcept;
+
+  /** Get/set the message handler of the current thread. */
+  static Target GetTarget() noexcept { return GetTargetRef(); }
+  static void SetTarget(const Target &target) noexcept { GetTargetRef() = target; }
+
+  /** Formats and outputs a message in the manner of printf. Returns the number of characters. */
+  static int Print(const char *format, ...) noexcept;
+
+  /** Flushes pending output to stdout. Has no effect for custom handlers. */
+  static void Flush() noexcept;
+
+private:
+  // Storage of the handler of the current thread
+  static Target& GetTargetRef() noexcept;
+#ifndef USE_WINTHREADS
+  // Serializes handler calls, since several threads may use the same handler
+  static std::mutex& GetMutex() noexcept;
+#endif
+};
+
+}   // namespace tc
+
+#endif		// _LOGGER_H_
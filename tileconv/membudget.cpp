@@ -0,0 +1,94 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifdef _WIN32
+# include <windows.h>
+# include <psapi.h>
+#else
+# include <sys/resource.h>
+#endif
+#include "membudget.h"
+
+namespace tc {
+
+std::atomic<uint64_t>& MemoryBudget::GetLimitRef() noexcept
+{
+  static std::atomic<uint64_t> limit(0);
+  return limit;
+}
+
+
+std::atomic<uint64_t>& MemoryBudget::GetUsageRef() noexcept
+{
+  static std::atomic<uint64_t> usage(0);
+  return usage;
+}
+
+
+std::atomic<uint64_t>& MemoryBudget::GetPeakRef() noexcept
+{
+  static std::atomic<uint64_t> peak(0);
+  return peak;
+}
+
+
+void MemoryBudget::Acquire(uint64_t size) noexcept
+{
+  if (size > 0) {
+    uint64_t usage = GetUsageRef().fetch_add(size) + size;
+    uint64_t peak = GetPeakRef().load(std::memory_order_relaxed);
+    while (usage > peak && !GetPeakRef().compare_exchange_weak(peak, usage)) {}
+  }
+}
+
+
+void MemoryBudget::Release(uint64_t size) noexcept
+{
+  if (size > 0) GetUsageRef().fetch_sub(size);
+}
+
+
+uint64_t MemoryBudget::GetAvailable() noexcept
+{
+  if (!IsLimited()) return UINT64_MAX;
+  uint64_t limit = GetLimit(), usage = GetUsage();
+  return (usage < limit) ? limit - usage : 0;
+}
+
+
+uint64_t MemoryBudget::GetPeakRss() noexcept
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return pmc.PeakWorkingSetSize;
+  return 0;
+#else
+  struct rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+# ifdef __APPLE__
+  return (uint64_t)usage.ru_maxrss;           // reported in bytes
+# else
+  return (uint64_t)usage.ru_maxrss * 1024;    // reported in KB
+# endif
+#endif
+}
+
+}   // namespace tc
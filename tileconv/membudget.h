@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _MEMBUDGET_H_
+#define _MEMBUDGET_H_
+#include <atomic>
+#include <cstdint>
+
+namespace tc {
+
+/**
+ * Process-wide accounting of memory held by in-flight tiles, file buffers and caches. Producers
+ * query the budget to throttle themselves if a limit has been set. Thread-safe.
+ */
+class MemoryBudget
+{
+public:
+  /** Accounts the given number of bytes for the lifetime of the object. */
+  class Reservation
+  {
+  public:
+    explicit Reservation(uint64_t size = 0) noexcept : m_size(0) { reset(size); }
+    ~Reservation() noexcept { reset(0); }
+
+    /** Replaces the accounted number of bytes. */
+    void reset(uint64_t size) noexcept { Release(m_size); m_size = size; Acquire(m_size); }
+    uint64_t getSize() const noexcept { return m_size; }
+
+  private:
+    Reservation(const Reservation&) = delete;
+    Reservation& operator=(const Reservation&) = delete;
+
+    uint64_t  m_size;
+  };
+
+  /** Max. number of bytes held by all producers. (0: unlimited, default) */
+  static void SetLimit(uint64_t limit) noexcept { GetLimitRef().store(limit); }
+  static uint64_t GetLimit() noexcept { return GetLimitRef().load(std::memory_order_relaxed); }
+  static bool IsLimited() noexcept { return GetLimit() != 0; }
+
+  /** Adds or removes bytes to or from the current usage. */
+  static void Acquire(uint64_t size) noexcept;
+  static void Release(uint64_t size) noexcept;
+
+  /** Returns the number of bytes currently accounted. */
+  static uint64_t GetUsage() noexcept { return GetUsageRef().load(std::memory_order_relaxed); }
+  /** Returns the max. number of bytes accounted since the last call of ResetPeak(). */
+  static uint64_t GetPeakUsage() noexcept { return GetPeakRef().load(std::memory_order_relaxed); }
+  static void ResetPeak() noexcept { GetPeakRef().store(GetUsage()); }
+
+  /** Returns the number of bytes left until the limit is reached. (UINT64_MAX if unlimited) */
+  static uint64_t GetAvailable() noexcept;
+  /** Returns whether the current usage exceeds the limit. */
+  static bool IsExceeded() noexcept { return IsLimited() && GetUsage() > GetLimit(); }
+
+  /** Returns the peak resident set size of the process in bytes, or 0 if not available. */
+  static uint64_t GetPeakRss() noexcept;
+
+private:
+  static std::atomic<uint64_t>& GetLimitRef() noexcept;
+  static std::atomic<uint64_t>& GetUsageRef() noexcept;
+  static std::atomic<uint64_t>& GetPeakRef() noexcept;
+};
+
+}   // namespace tc
+
+#endif		// _MEMBUDGET_H_
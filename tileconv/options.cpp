@@ -20,32 +20,48 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <cctype>
 #include <unistd.h>
+#include <getopt.h>
 #include "fileio.h"
 #include "tilethreadpool.h"
 #include "version.h"
 #include "converterfactory.h"
+#include "logger.h"
 #include "options.h"
 
 namespace tc {
 
 const int Options::MAX_THREADS          = 64;
 const int Options::DEFLATE              = 256;
+const int Options::MAX_PVRZ_INDEX       = 9999;
 
 const bool Options::DEF_HALT_ON_ERROR   = true;
 const bool Options::DEF_MOSC            = false;
 const bool Options::DEF_DEFLATE         = true;
 const bool Options::DEF_SHOWINFO        = false;
 const bool Options::DEF_ASSUMETIS       = false;
+const bool Options::DEF_ENCODE_Z        = false;
+const bool Options::DEF_QUANTIZE_Z      = false;
+const bool Options::DEF_COST_ORDER      = false;
+const bool Options::DEF_BATCH_IO        = false;
 const int Options::DEF_VERBOSITY        = 1;
 const int Options::DEF_QUALITY_DECODING = 4;
 const int Options::DEF_QUALITY_ENCODING = 9;
 const int Options::DEF_THREADS          = 0;    // autodetect
+const int Options::DEF_BITMAP_FORMAT    = -1;   // paletted output
+const int Options::DEF_PVRZ_INDEX       = -1;   // no PVRZ output
+const int Options::DEF_CACHE_SIZE       = 1024; // in MB
+const int Options::MAX_CACHE_SIZE       = 1 << 24;
+const int Options::DEF_MAX_MEMORY       = 0;    // unlimited
+const int Options::MAX_MAX_MEMORY       = 1 << 24;
+const Affinity::Mode Options::DEF_AFFINITY = Affinity::Mode::NONE;
 const Encoding Options::DEF_ENCODING    = Encoding::BC1;
 
 // Supported parameter names
-const char Options::ParamNames[] = "esvt:uo:zdq:j:TIV";
+const char Options::ParamNames[] = "esvt:uo:zb:p:xQdq:j:TIS:C:c:V";
 
 
 Options::Options() noexcept
@@ -54,14 +70,28 @@ Options::Options() noexcept
 , m_deflate(DEF_DEFLATE)
 , m_showInfo(DEF_SHOWINFO)
 , m_assumeTis(DEF_ASSUMETIS)
+, m_encodeZ(DEF_ENCODE_Z)
+, m_quantizeZ(DEF_QUANTIZE_Z)
+, m_costOrder(DEF_COST_ORDER)
+, m_batchIO(DEF_BATCH_IO)
 , m_verbosity(DEF_VERBOSITY)
 , m_qualityDecoding(DEF_QUALITY_DECODING)
 , m_qualityEncoding(DEF_QUALITY_ENCODING)
 , m_threads(DEF_THREADS)
+, m_bitmapFormat(DEF_BITMAP_FORMAT)
+, m_pvrzIndex(DEF_PVRZ_INDEX)
+, m_cacheSize(DEF_CACHE_SIZE)
+, m_maxMemory(DEF_MAX_MEMORY)
+, m_affinity(DEF_AFFINITY)
 , m_encoding(DEF_ENCODING)
 , m_inFiles()
+, m_jobs()
 , m_outPath()
 , m_outFile()
+, m_server()
+, m_cachePath()
+, m_statsFile()
+, m_traceFile()
 {
 }
 
@@ -72,16 +102,32 @@ Options::~Options() noexcept
 }
 
 
-bool Options::init(int argc, char *argv[]) noexcept
+bool Options::init(int argc, char *argv[], bool inputRequired) noexcept
 {
-  if (argc <= 1) {
+  if (argc <= 1 && inputRequired) {
     showHelp();
     return false;
   }
 
+  static const struct option longParams[] = {
+    { "stats", required_argument, nullptr, PARAM_STATS },
+    { "trace", required_argument, nullptr, PARAM_TRACE },
+    { "max-memory", required_argument, nullptr, PARAM_MAX_MEMORY },
+    { "affinity", required_argument, nullptr, PARAM_AFFINITY },
+    { "tile-order", required_argument, nullptr, PARAM_TILE_ORDER },
+    { "io-engine", required_argument, nullptr, PARAM_IO_ENGINE },
+    { nullptr, 0, nullptr, 0 }
+  };
+
   int c = 0;
   opterr = 0;
-  while ((c = getopt(argc, argv, ParamNames)) != -1) {
+  // options may be initialized more than once in server mode
+#ifdef __GLIBC__
+  optind = 0;   // forces full reinitialization
+#else
+  optind = 1;
+#endif
+  while ((c = getopt_long(argc, argv, ParamNames, longParams, nullptr)) != -1) {
     switch (c) {
       case 'e':
         setHaltOnError(false);
@@ -96,10 +142,12 @@ bool Options::init(int argc, char *argv[]) noexcept
         if (optarg != nullptr) {
           int type = std::atoi(optarg);
           ConverterPtr converter = ConverterFactory::GetConverter(*this, type);
-          if (converter != nullptr && converter->canEncode()) {
+          if (type == ENCODE_AUTO) {
+            setEncoding(Encoding::AUTO);
+          } else if (converter != nullptr && converter->canEncode()) {
             setEncoding(GetEncodingType(type));
           } else {
-            std::printf("Unsupported pixel encoding type: %d\n", type);
+            Logger::Print("Unsupported pixel encoding type: %d\n", type);
             showHelp();
             return false;
           }
@@ -115,7 +163,7 @@ bool Options::init(int argc, char *argv[]) noexcept
         if (optarg != nullptr) {
           setOutput(std::string(optarg));
         } else {
-          std::printf("Missing output file for -o\n");
+          Logger::Print("Missing output file for -o\n");
           showHelp();
           return false;
         }
@@ -123,8 +171,32 @@ bool Options::init(int argc, char *argv[]) noexcept
       case 'z':
         setMosc(true);
         break;
+      case 'b':
+        if (optarg != nullptr && GetColorFormatCode(std::string(optarg)) >= 0) {
+          setBitmapFormat(GetColorFormatCode(std::string(optarg)));
+        } else {
+          Logger::Print("Unsupported color format: %s\n", (optarg != nullptr) ? optarg : "");
+          showHelp();
+          return false;
+        }
+        break;
+      case 'p':
+        if (optarg != nullptr && optarg[0] >= '0' && optarg[0] <= '9') {
+          setPvrzIndex(std::atoi(optarg));
+        } else {
+          Logger::Print("Invalid PVRZ start index: %s\n", (optarg != nullptr) ? optarg : "");
+          showHelp();
+          return false;
+        }
+        break;
+      case 'x':
+        setEncodeZ(true);
+        break;
+      case 'Q':
+        setQuantizeZ(true);
+        break;
       case 'd':
-        std::printf("Warning: Parameter -d is deprecated. Use -q instead!\n");
+        Logger::Print("Warning: Parameter -d is deprecated. Use -q instead!\n");
         break;
       case 'q':
         if (optarg != nullptr) {
@@ -133,14 +205,14 @@ bool Options::init(int argc, char *argv[]) noexcept
           if (optarg[0] >= '0' && optarg[0] <= '9') {
             levelD = optarg[0] - '0';
           } else if (optarg[0] != '-') {
-            std::printf("Error: Unrecognized decoding quality level or placeholder.\n");
+            Logger::Print("Error: Unrecognized decoding quality level or placeholder.\n");
             showHelp();
             return false;
           }
           if (optarg[1] >= '0' && optarg[1] <= '9') {
             levelE = optarg[1] - '0';
           } else if (optarg[1] != '-' && optarg[1] != 0) {
-            std::printf("Error: Unrecognized encoding quality level or placeholder.\n");
+            Logger::Print("Error: Unrecognized encoding quality level or placeholder.\n");
             showHelp();
             return false;
           }
@@ -165,19 +237,113 @@ bool Options::init(int argc, char *argv[]) noexcept
       case 'I':
         setShowInfo(true);
         break;
+      case 'S':
+        if (optarg != nullptr && optarg[0] != 0) {
+          setServer(std::string(optarg));
+        } else {
+          Logger::Print("Missing job source for -S\n");
+          showHelp();
+          return false;
+        }
+        break;
+      case 'C':
+        if (optarg != nullptr && optarg[0] != 0) {
+          setCachePath(std::string(optarg));
+        } else {
+          Logger::Print("Missing cache folder for -C\n");
+          showHelp();
+          return false;
+        }
+        break;
+      case 'c':
+        if (optarg != nullptr && optarg[0] >= '0' && optarg[0] <= '9') {
+          setCacheSize(std::atoi(optarg));
+        } else {
+          Logger::Print("Invalid cache size: %s\n", (optarg != nullptr) ? optarg : "");
+          showHelp();
+          return false;
+        }
+        break;
+      case PARAM_STATS:
+        if (optarg != nullptr && optarg[0] != 0) {
+          setStatsFile(std::string(optarg));
+        } else {
+          Logger::Print("Missing output file for --stats\n");
+          showHelp();
+          return false;
+        }
+        break;
+      case PARAM_TRACE:
+        if (optarg != nullptr && optarg[0] != 0) {
+          setTraceFile(std::string(optarg));
+        } else {
+          Logger::Print("Missing output file for --trace\n");
+          showHelp();
+          return false;
+        }
+        break;
+      case PARAM_MAX_MEMORY:
+        if (optarg != nullptr && optarg[0] >= '0' && optarg[0] <= '9') {
+          setMaxMemory(std::atoi(optarg));
+        } else {
+          Logger::Print("Invalid memory size: %s\n", (optarg != nullptr) ? optarg : "");
+          showHelp();
+          return false;
+        }
+        break;
+      case PARAM_AFFINITY:
+      {
+        Affinity::Mode mode;
+        if (optarg != nullptr && Affinity::GetModeByName(std::string(optarg), mode)) {
+          setAffinity(mode);
+        } else {
+          Logger::Print("Unsupported thread placement: %s\n", (optarg != nullptr) ? optarg : "");
+          showHelp();
+          return false;
+        }
+        break;
+      }
+      case PARAM_TILE_ORDER:
+        if (optarg != nullptr && std::strcmp(optarg, "cost") == 0) {
+          setCostOrder(true);
+        } else if (optarg != nullptr && std::strcmp(optarg, "index") == 0) {
+          setCostOrder(false);
+        } else {
+          Logger::Print("Unsupported tile order: %s\n", (optarg != nullptr) ? optarg : "");
+          showHelp();
+          return false;
+        }
+        break;
+      case PARAM_IO_ENGINE:
+        if (optarg != nullptr && std::strcmp(optarg, "auto") == 0) {
+          setBatchIO(true);
+        } else if (optarg != nullptr && std::strcmp(optarg, "stdio") == 0) {
+          setBatchIO(false);
+        } else {
+          Logger::Print("Unsupported I/O engine: %s\n", (optarg != nullptr) ? optarg : "");
+          showHelp();
+          return false;
+        }
+        break;
       case 'V':
         if (std::strlen(vers_suffix)) {
-          std::printf("%s %d.%d.%d (%s) by %s\n", prog_name, vers_major, vers_minor, vers_patch, vers_suffix, author);
+          Logger::Print("%s %d.%d.%d (%s) by %s\n", prog_name, vers_major, vers_minor, vers_patch, vers_suffix, author);
         } else {
           if (vers_patch != 0) {
-            std::printf("%s %d.%d.%d by %s\n", prog_name, vers_major, vers_minor, vers_patch, author);
+            Logger::Print("%s %d.%d.%d by %s\n", prog_name, vers_major, vers_minor, vers_patch, author);
           } else {
-            std::printf("%s %d.%d by %s\n", prog_name, vers_major, vers_minor, author);
+            Logger::Print("%s %d.%d by %s\n", prog_name, vers_major, vers_minor, author);
           }
         }
         return false;
       default:
-        std::printf("Unrecognized parameter \"-%c\"\n", optopt);
+        if (optopt >= PARAM_STATS) {
+          Logger::Print("Missing argument for \"%s\"\n", argv[optind-1]);
+        } else if (optopt != 0) {
+          Logger::Print("Unrecognized parameter \"-%c\"\n", optopt);
+        } else {
+          Logger::Print("Unrecognized parameter \"%s\"\n", argv[optind-1]);
+        }
         showHelp();
         return false;
     }
@@ -198,19 +364,36 @@ bool Options::init(int argc, char *argv[]) noexcept
     if (argv[optind][0] == '-') {
       showHelp();
       return false;
+    } else if (argv[optind][0] == '@') {
+      if (!addManifest(std::string(&argv[optind][1]))) {
+        Logger::Print("Error reading job manifest \"%s\"\n", &argv[optind][1]);
+        return false;
+      }
     } else if (!addInput(std::string(argv[optind]))) {
-      std::printf("Error opening file \"%s\"\n", argv[optind]);
+      Logger::Print("Error opening file \"%s\"\n", argv[optind]);
       return false;
     }
   }
 
   // checking special conditions
-  if (getInputCount() == 0) {
-    std::printf("No input filename specified\n");
+  if (getInputCount() == 0 && getJobCount() == 0 && !isServer() && inputRequired) {
+    Logger::Print("No input filename specified\n");
+    showHelp();
+    return false;
+  } else if ((getInputCount() > 0 || getJobCount() > 0) && isServer()) {
+    Logger::Print("You cannot specify input files in server mode\n");
+    showHelp();
+    return false;
+  } else if (getJobCount() > 0 && isOutFile()) {
+    Logger::Print("You cannot specify output file with a job manifest\n");
     showHelp();
     return false;
   } else if (getInputCount() > 1 && isOutFile()) {
-    std::printf("You cannot specify output file with multiple input files\n");
+    Logger::Print("You cannot specify output file with multiple input files\n");
+    showHelp();
+    return false;
+  } else if (isBitmapOutput() && isPvrzOutput()) {
+    Logger::Print("You cannot combine bitmap output (-b) with PVRZ output (-p)\n");
     showHelp();
     return false;
   }
@@ -221,48 +404,129 @@ bool Options::init(int argc, char *argv[]) noexcept
 
 void Options::showHelp() noexcept
 {
-  std::printf("\nUsage: %s [options] infile [infile2 [...]]\n", prog_name);
-  std::printf("\nOptions:\n");
-  std::printf("  -e          Do not halt on errors.\n");
-  std::printf("  -s          Be silent.\n");
-  std::printf("  -v          Be verbose.\n");
-  std::printf("  -t type     Select pixel encoding type.\n");
-  std::printf("              Supported types:\n");
-  std::printf("                0: No pixel encoding\n");
-  std::printf("                1: BC1/DXT1 (Default)\n");
-  std::printf("                2: BC2/DXT3\n");
-  std::printf("                3: BC3/DXT5\n");
-  std::printf("  -u          Do not apply tile compression.\n");
-  std::printf("  -o output   Select output file or folder.\n");
-  std::printf("              (Note: Output file works only with single input file!)\n");
-  std::printf("  -z          Decode MBC/MOZ into compressed MOS (MOSC).\n");
-  std::printf("  -q Dec[Enc] Set quality levels for decoding and, optionally, encoding.\n");
-  std::printf("              Supported levels: 0..9 (Defaults: 4 for decoding, 9 for encoding)\n");
-  std::printf("              (0=fast and lower quality, 9=slow and higher quality)\n");
-  std::printf("              Specify both levels as a single argument. First digit indicates\n");
-  std::printf("              decoding quality and second digit indicates encoding quality.\n");
-  std::printf("              Specify '-' as placeholder for default levels.\n");
-  std::printf("              Example 1: -q 27 (decoding level: 2, encoding level: 7)\n");
-  std::printf("              Example 2: -q -7 (default decoding level, encoding level: 7)\n");
-  std::printf("              Example 3: -q 2  (decoding level: 2, default encoding level)\n");
-  std::printf("              Applied level-dependent features for encoding (DXTn only):\n");
-  std::printf("                  Iterative cluster fit:   levels 7 to 9\n");
-  std::printf("                  Single cluster fit:      levels 3 to 6\n");
-  std::printf("                  Range fit:               levels 0 to 2\n");
-  std::printf("                  Weight color by alpha:   levels 5 to 9\n");
-  std::printf("              Applied level-dependent features for decoding:\n");
-  std::printf("                  Dithering:               levels 5 to 9\n");
-  std::printf("                  Posterization:           levels 0 to 2\n");
-  std::printf("                  Additional techniques:   levels 4 to 9\n");
-  std::printf("  -j num      Number of parallel jobs to speed up the conversion process.\n");
-  std::printf("              Valid numbers: 0 (autodetect), 1..%d (Default: 0)\n", TileThreadPool::MAX_THREADS);
-  std::printf("  -T          Treat unrecognized input files as headerless TIS.\n");
-  std::printf("  -I          Show file information and exit.\n");
-  std::printf("  -V          Print version number and exit.\n\n");
-  std::printf("Supported input file types: TIS, MOS, TBC, MBC, TIZ, MOZ\n");
-  std::printf("Note: You can mix and match input files of each supported type.\n\n");
+  Logger::Print("\nUsage: %s [options] infile|@manifest [infile2|@manifest2 [...]]\n", prog_name);
+  Logger::Print("       %s [options] -S source\n", prog_name);
+  Logger::Print("\nOptions:\n");
+  Logger::Print("  -e          Do not halt on errors.\n");
+  Logger::Print("  -s          Be silent.\n");
+  Logger::Print("  -v          Be verbose.\n");
+  Logger::Print("  -t type     Select pixel encoding type.\n");
+  Logger::Print("              Supported types:\n");
+  Logger::Print("                0: No pixel encoding\n");
+  Logger::Print("                1: BC1/DXT1 (Default)\n");
+  Logger::Print("                2: BC2/DXT3\n");
+  Logger::Print("                3: BC3/DXT5\n");
+  Logger::Print("                4: Auto-select RAW, BC1 or BC3 for each tile\n");
+  Logger::Print("  -u          Do not apply tile compression.\n");
+  Logger::Print("  -o output   Select output file or folder.\n");
+  Logger::Print("              (Note: Output file works only with single input file!)\n");
+  Logger::Print("  -z          Decode MBC/MOZ into compressed MOS (MOSC).\n");
+  Logger::Print("  -b format   Decode TBC/MBC into 32-bit bitmaps (BM32) without color reduction.\n");
+  Logger::Print("              Supported color formats (component order in memory):\n");
+  Logger::Print("                argb: {b, g, r, a}, abgr: {r, g, b, a},\n");
+  Logger::Print("                bgra: {a, r, g, b}, rgba: {a, b, g, r}\n");
+  Logger::Print("  -p index    Transcode BC1/BC3 encoded TBC/MBC into PVRZ-based TIS/MOS V2\n");
+  Logger::Print("              without decoding pixels. PVRZ pages are stored in the output folder.\n");
+  Logger::Print("              MOS: index of the first PVRZ page (mosXXXX.pvrz). Range: 0..%d\n", MAX_PVRZ_INDEX);
+  Logger::Print("              TIS: pages are named after the TIS file. Index is ignored.\n");
+  Logger::Print("              Cannot be combined with -b.\n");
+  Logger::Print("  -x          Convert TIZ/MOZ directly into TBC/MBC (single pass).\n");
+  Logger::Print("  -Q          Decode JPEG tiles of TIZ/MOZ (TIL2) to truecolor and apply the same\n");
+  Logger::Print("              color quantization as for TBC/MBC instead of libjpeg's.\n");
+  Logger::Print("  -q Dec[Enc] Set quality levels for decoding and, optionally, encoding.\n");
+  Logger::Print("              Supported levels: 0..9 (Defaults: 4 for decoding, 9 for encoding)\n");
+  Logger::Print("              (0=fast and lower quality, 9=slow and higher quality)\n");
+  Logger::Print("              Specify both levels as a single argument. First digit indicates\n");
+  Logger::Print("              decoding quality and second digit indicates encoding quality.\n");
+  Logger::Print("              Specify '-' as placeholder for default levels.\n");
+  Logger::Print("              Example 1: -q 27 (decoding level: 2, encoding level: 7)\n");
+  Logger::Print("              Example 2: -q -7 (default decoding level, encoding level: 7)\n");
+  Logger::Print("              Example 3: -q 2  (decoding level: 2, default encoding level)\n");
+  Logger::Print("              Applied level-dependent features for encoding (DXTn only):\n");
+  Logger::Print("                  Iterative cluster fit:   levels 7 to 9\n");
+  Logger::Print("                  Single cluster fit:      levels 3 to 6\n");
+  Logger::Print("                  Range fit:               levels 0 to 2\n");
+  Logger::Print("                  Weight color by alpha:   levels 5 to 9\n");
+  Logger::Print("              Applied level-dependent features for decoding:\n");
+  Logger::Print("                  Dithering:               levels 5 to 9\n");
+  Logger::Print("                  Posterization:           levels 0 to 2\n");
+  Logger::Print("                  Additional techniques:   levels 4 to 9\n");
+  Logger::Print("                  Fast JPEG decoding:      levels 0 to 2 (TIZ/MOZ only)\n");
+  Logger::Print("  -j num      Number of parallel jobs to speed up the conversion process.\n");
+  Logger::Print("              Valid numbers: 0 (autodetect), 1..%d (Default: 0)\n", TileThreadPool::MAX_THREADS);
+  Logger::Print("  -T          Treat unrecognized input files as headerless TIS.\n");
+  Logger::Print("  -I          Show file information and exit.\n");
+  Logger::Print("  -S source   Run as server and read conversion jobs from source, one per line.\n");
+  Logger::Print("              Specify '-' to read from standard input or a path to listen on\n");
+  Logger::Print("              a local (Unix domain) socket. Each job uses the same syntax as\n");
+  Logger::Print("              the command line. A status line is written for each job.\n");
+  Logger::Print("              With '-' standard output is reserved for status lines, other\n");
+  Logger::Print("              messages are written to standard error.\n");
+  Logger::Print("  -C folder   Cache conversion results in the specified folder. Unchanged input\n");
+  Logger::Print("              files are restored from the cache instead of being converted again.\n");
+  Logger::Print("              The folder can be shared by several tileconv instances.\n");
+  Logger::Print("  -c size     Max. size of the cache folder in MB. (Default: %d, 0: unlimited)\n", DEF_CACHE_SIZE);
+  Logger::Print("              Least recently used results are removed first.\n");
+  Logger::Print("  --stats file\n");
+  Logger::Print("              Write timings of all conversion stages as JSON to the specified file.\n");
+  Logger::Print("              Specify '-' to write to standard output.\n");
+  Logger::Print("  --trace file\n");
+  Logger::Print("              Write a timeline of all stages and tiles to the specified file.\n");
+  Logger::Print("              The file can be opened in chrome://tracing or ui.perfetto.dev.\n");
+  Logger::Print("  --max-memory size\n");
+  Logger::Print("              Max. memory in MB held by queued tiles, file buffers and caches.\n");
+  Logger::Print("              Fewer tiles and files are processed ahead to stay within the\n");
+  Logger::Print("              limit. Peak usage is shown at the end. (Default: 0, unlimited)\n");
+  Logger::Print("  --affinity mode\n");
+  Logger::Print("              Pin worker threads to CPUs. Reader and writer threads are kept on\n");
+  Logger::Print("              CPUs without worker threads. Supported modes:\n");
+  Logger::Print("                none:     threads are not pinned (default)\n");
+  Logger::Print("                cores:    one worker thread per CPU\n");
+  Logger::Print("                physical: one worker thread per physical core, SMT siblings last\n");
+  Logger::Print("              Autodetected jobs respect CPU affinity and cgroup CPU quotas.\n");
+  Logger::Print("  --tile-order order\n");
+  Logger::Print("              Order of processing tiles by worker threads. Supported orders:\n");
+  Logger::Print("                index: tiles in file order (default)\n");
+  Logger::Print("                cost:  experimental, tiles with more colors or compressed data first\n");
+  Logger::Print("              Tiles are always written in file order.\n");
+  Logger::Print("  --io-engine engine\n");
+  Logger::Print("              I/O engine for reading and writing files. Supported engines:\n");
+  Logger::Print("                stdio: each file is read and written separately via stdio (default)\n");
+  Logger::Print("                auto:  experimental, batched reads and writes of multiple input\n");
+  Logger::Print("                       files via io_uring if available, stdio otherwise\n");
+  Logger::Print("  -V          Print version number and exit.\n\n");
+  Logger::Print("Supported input file types: TIS, MOS, TBC, MBC, TIZ, MOZ\n");
+  Logger::Print("Note: You can mix and match input files of each supported type.\n");
+  Logger::Print("A manifest file (@manifest) defines one job per line, each consisting of options and\n");
+  Logger::Print("input files. Options of a job override the global options for this job only.\n\n");
+}
+
+bool Options::addManifest(const std::string &fileName) noexcept
+{
+  File f(fileName.c_str(), "rb");
+  if (f.error()) return false;
+  long size = f.getsize();
+  if (size < 0) return false;
+
+  std::string data(size, 0);
+  if (size > 0 && f.read(&data[0], 1, size) != (std::size_t)size) return false;
+
+  // skipping empty lines and comments
+  std::size_t pos = 0;
+  while (pos < data.size()) {
+    std::size_t end = data.find_first_of("\r\n", pos);
+    if (end == std::string::npos) end = data.size();
+    std::string line = data.substr(pos, end - pos);
+    std::size_t start = line.find_first_not_of(" \t");
+    if (start != std::string::npos && line[start] != '#') {
+      m_jobs.emplace_back(line);
+    }
+    pos = end + 1;
+  }
+  return true;
 }
 
+
 bool Options::addInput(const std::string &inFile) noexcept
 {
   if (!inFile.empty()) {
@@ -317,6 +581,37 @@ bool Options::setOutput(const std::string &outFile) noexcept
 }
 
 
+void Options::resetOutput() noexcept
+{
+  m_outPath.clear();
+  m_outFile.clear();
+}
+
+
+void Options::setCacheSize(int size) noexcept
+{
+  m_cacheSize = std::max(0, std::min(MAX_CACHE_SIZE, size));
+}
+
+
+void Options::setMaxMemory(int size) noexcept
+{
+  m_maxMemory = std::max(0, std::min(MAX_MAX_MEMORY, size));
+}
+
+
+std::string Options::getCacheKey() const noexcept
+{
+  // options affecting the content of output files
+  char buf[128];
+  std::snprintf(buf, sizeof(buf), "t%d d%d q%d%d z%d b%d x%d Q%d T%d",
+                GetEncodingCode(getEncoding(), isDeflate()), isDeflate() ? 1 : 0,
+                getDecodingQuality(), getEncodingQuality(), isMosc() ? 1 : 0, getBitmapFormat(),
+                isEncodeZ() ? 1 : 0, isQuantizeZ() ? 1 : 0, assumeTis() ? 1 : 0);
+  return std::string(buf);
+}
+
+
 void Options::setVerbosity(int level) noexcept
 {
   m_verbosity = std::max(0, std::min(2, level));
@@ -342,6 +637,18 @@ void Options::setEncodingQuality(int v) noexcept
 }
 
 
+void Options::setBitmapFormat(int fmt) noexcept
+{
+  m_bitmapFormat = std::max(-1, std::min(3, fmt));
+}
+
+
+void Options::setPvrzIndex(int index) noexcept
+{
+  m_pvrzIndex = std::max(-1, std::min(MAX_PVRZ_INDEX, index));
+}
+
+
 void Options::setThreads(int  v) noexcept
 {
   // limiting threads to a sane number
@@ -351,7 +658,8 @@ void Options::setThreads(int  v) noexcept
 
 int Options::getThreads() const noexcept
 {
-  return m_threads ? m_threads : getThreadPoolAutoThreads();
+  if (m_threads) return m_threads;
+  return std::max(1, std::min((int)TileThreadPool::MAX_THREADS, (int)Affinity::GetAutoThreads(getAffinity())));
 }
 
 
@@ -412,6 +720,7 @@ std::string Options::GetFileExt(FileType type) noexcept
     case FileType::MBC: return std::string(".mbc");
     case FileType::TIZ: return std::string(".tiz");
     case FileType::MOZ: return std::string(".moz");
+    case FileType::BM32: return std::string(".bm32");
     default:            return std::string();
   }
 }
@@ -455,6 +764,7 @@ Encoding Options::GetEncodingType(int code) noexcept
     case ENCODE_DXT1: return Encoding::BC1;
     case ENCODE_DXT3: return Encoding::BC2;
     case ENCODE_DXT5: return Encoding::BC3;
+    case ENCODE_AUTO: return Encoding::AUTO;
 //    case ENCODE_WEBP: return Encoding::WEBP;
     case ENCODE_Z:    return Encoding::Z;
     default:          return Encoding::UNKNOWN;
@@ -482,6 +792,9 @@ unsigned Options::GetEncodingCode(Encoding type, bool deflate) noexcept
     case Encoding::BC3:
       retVal |= ENCODE_DXT5;
       break;
+    case Encoding::AUTO:
+      retVal |= ENCODE_AUTO;
+      break;
     case Encoding::Z:
       retVal |= ENCODE_Z;
       break;
@@ -499,27 +812,89 @@ const std::string& Options::GetEncodingName(int code) noexcept
   static const std::string descDxt1Def("BC1/DXT1 (zlib-compressed)");
   static const std::string descDxt3Def("BC2/DXT3 (zlib-compressed)");
   static const std::string descDxt5Def("BC3/DXT5 (zlib-compressed)");
+  static const std::string descAutoDef("Auto-selected per tile (zlib-compressed)");
   static const std::string descZ("JPEG compressed TIZ/MOZ");
   static const std::string descRaw("Not encoded (uncompressed)");
   static const std::string descDxt1("BC1/DXT1 (uncompressed)");
   static const std::string descDxt3("BC2/DXT3 (uncompressed)");
   static const std::string descDxt5("BC3/DXT5 (uncompressed)");
+  static const std::string descAuto("Auto-selected per tile (uncompressed)");
 
   switch (code) {
     case ENCODE_RAW: return descRawDef;
     case ENCODE_DXT1: return descDxt1Def;
     case ENCODE_DXT3: return descDxt3Def;
     case ENCODE_DXT5: return descDxt5Def;
+    case ENCODE_AUTO: return descAutoDef;
     case ENCODE_Z: return descZ;
     case ENCODE_RAW | 256: return descRaw;
     case ENCODE_DXT1 | 256: return descDxt1;
     case ENCODE_DXT3 | 256: return descDxt3;
     case ENCODE_DXT5 | 256: return descDxt5;
+    case ENCODE_AUTO | 256: return descAuto;
     case ENCODE_Z | 256: return descZ;
     default: return descUnk;
   }
 }
 
+int Options::GetColorFormatCode(const std::string &name) noexcept
+{
+  static const char *names[] = { "argb", "abgr", "bgra", "rgba" };   // order of Converter::ColorFormat
+
+  std::string s(name);
+  for (auto iter = s.begin(); iter != s.end(); ++iter) {
+    *iter = std::tolower(*iter);
+  }
+  for (int i = 0; i < 4; i++) {
+    if (s == names[i]) return i;
+  }
+  return -1;
+}
+
+std::string Options::GetColorFormatName(int code) noexcept
+{
+  switch (code) {
+    case 0: return std::string("ARGB");
+    case 1: return std::string("ABGR");
+    case 2: return std::string("BGRA");
+    case 3: return std::string("RGBA");
+    default: return std::string();
+  }
+}
+
+std::vector<std::string> Options::SplitArguments(const std::string &line) noexcept
+{
+  std::vector<std::string> args;
+  std::string arg;
+  bool isArg = false;
+  char quote = 0;
+  for (auto iter = line.cbegin(); iter != line.cend(); ++iter) {
+    char ch = *iter;
+    if (quote != 0) {
+      if (ch == quote) {
+        quote = 0;
+      } else {
+        arg.push_back(ch);
+      }
+    } else if (ch == '"' || ch == '\'') {
+      quote = ch;
+      isArg = true;
+    } else if (std::isspace((unsigned char)ch)) {
+      if (isArg) {
+        args.push_back(arg);
+        arg.clear();
+        isArg = false;
+      }
+    } else {
+      arg.push_back(ch);
+      isArg = true;
+    }
+  }
+  if (isArg) args.push_back(arg);
+  return args;
+}
+
+
 std::string Options::getOptionsSummary(bool complete) const noexcept
 {
   std::string sum;
@@ -562,12 +937,66 @@ std::string Options::getOptionsSummary(bool complete) const noexcept
     else sum += "convert MBC to MOS";
   }
 
+  if (complete || getBitmapFormat() != DEF_BITMAP_FORMAT) {
+    if (!sum.empty()) sum += ", ";
+    if (isBitmapOutput()) sum += "convert TBC/MBC to 32-bit bitmap (" + GetColorFormatName(getBitmapFormat()) + ")";
+    else sum += "convert TBC/MBC to paletted TIS/MOS";
+  }
+
+  if (complete || getPvrzIndex() != DEF_PVRZ_INDEX) {
+    if (!sum.empty()) sum += ", ";
+    if (isPvrzOutput()) sum += "transcode TBC/MBC to PVRZ-based TIS/MOS (start index = " + std::to_string(getPvrzIndex()) + ")";
+    else sum += "no PVRZ output";
+  }
+
+  if (complete || isEncodeZ() != DEF_ENCODE_Z) {
+    if (!sum.empty()) sum += ", ";
+    if (isEncodeZ()) sum += "convert TIZ/MOZ to TBC/MBC";
+    else sum += "convert TIZ/MOZ to TIS/MOS";
+  }
+
+  if (complete || isQuantizeZ() != DEF_QUANTIZE_Z) {
+    if (!sum.empty()) sum += ", ";
+    if (isQuantizeZ()) sum += "TIZ/MOZ color quantization = tileconv";
+    else sum += "TIZ/MOZ color quantization = libjpeg";
+  }
+
   if (complete || assumeTis() != DEF_ASSUMETIS) {
     if (!sum.empty()) sum += ", ";
     if (assumeTis()) sum += "headerless TIS allowed";
     else sum += "headerless TIS not allowed";
   }
 
+  if (isCache()) {
+    if (!sum.empty()) sum += ", ";
+    sum += "cache = \"" + getCachePath() + "\" (";
+    sum += (getCacheSize() > 0) ? "max. " + std::to_string(getCacheSize()) + " MB" : "unlimited";
+    sum += ")";
+  }
+
+  if (getMaxMemory() > 0) {
+    if (!sum.empty()) sum += ", ";
+    sum += "max. memory = " + std::to_string(getMaxMemory()) + " MB";
+  }
+
+  if (complete || getAffinity() != DEF_AFFINITY) {
+    if (!sum.empty()) sum += ", ";
+    sum += "affinity = ";
+    sum += Affinity::GetModeName(getAffinity());
+  }
+
+  if (complete || isCostOrder() != DEF_COST_ORDER) {
+    if (!sum.empty()) sum += ", ";
+    sum += "tile order = ";
+    sum += isCostOrder() ? "cost" : "index";
+  }
+
+  if (complete || isBatchIO() != DEF_BATCH_IO) {
+    if (!sum.empty()) sum += ", ";
+    sum += "I/O engine = ";
+    sum += isBatchIO() ? "auto" : "stdio";
+  }
+
   if (complete || getThreads() != DEF_THREADS) {
     if (!sum.empty()) sum += ", ";
     sum += "jobs = ";
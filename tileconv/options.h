@@ -25,6 +25,7 @@ THE SOFTWARE.
 #include <vector>
 #include <unordered_map>
 #include "types.h"
+#include "affinity.h"
 
 namespace tc {
 
@@ -32,6 +33,9 @@ namespace tc {
 class Options
 {
 public:
+  /** Max. PVRZ page index of MOS V2 files (mosXXXX.pvrz). */
+  static const int MAX_PVRZ_INDEX;
+
   /**
    * Attempts to determine the type of the given file.
    * \param fileName The file to check.
@@ -65,12 +69,27 @@ class Options
   /** Returns a descriptive name of the given encoding type. */
   static const std::string& GetEncodingName(int code) noexcept;
 
+  /** Returns the color format code of the given name (e.g. "rgba"). Returns -1 on error. */
+  static int GetColorFormatCode(const std::string &name) noexcept;
+
+  /** Returns the name of the given color format code. Returns empty string on error. */
+  static std::string GetColorFormatName(int code) noexcept;
+
+  /**
+   * Splits a job line into arguments, using the same syntax as the command line.
+   * Arguments containing whitespace can be enclosed in single or double quotes.
+   */
+  static std::vector<std::string> SplitArguments(const std::string &line) noexcept;
+
 public:
   Options() noexcept;
   ~Options() noexcept;
 
-  /** Initialize options from the specified arguments. */
-  bool init(int argc, char *argv[]) noexcept;
+  /**
+   * Initialize options from the specified arguments. Specify inputRequired = false to accept
+   * arguments without input files (e.g. for conversions of memory buffers).
+   */
+  bool init(int argc, char *argv[], bool inputRequired = true) noexcept;
 
   /** Display a short syntax help. */
   void showHelp() noexcept;
@@ -82,6 +101,15 @@ class Options
   int getInputCount() const noexcept { return m_inFiles.size(); }
   const std::string& getInput(int idx) const noexcept;
 
+  /**
+   * Adds the jobs of the specified manifest file. Each non-empty line not starting with '#' defines
+   * a single job with options and input files, overriding the global options for this job only.
+   */
+  bool addManifest(const std::string &fileName) noexcept;
+  void clearJobs() noexcept { m_jobs.clear(); }
+  int getJobCount() const noexcept { return m_jobs.size(); }
+  const std::string& getJob(int idx) const noexcept { return m_jobs[idx]; }
+
   /** Define output file name or path. */
   bool setOutput(const std::string &outFile) noexcept;
   /** Call to activate auto-generation of output filename. */
@@ -129,6 +157,73 @@ class Options
   void setEncoding(Encoding type) noexcept { m_encoding = type; }
   Encoding getEncoding() const noexcept { return m_encoding; }
 
+  /**
+   * Color format of 32-bit bitmap output for TBC/MBC decoding (see Converter::ColorFormat),
+   * or -1 to decode into paletted TIS/MOS.
+   */
+  void setBitmapFormat(int fmt) noexcept;
+  int getBitmapFormat() const noexcept { return m_bitmapFormat; }
+  bool isBitmapOutput() const noexcept { return m_bitmapFormat >= 0; }
+
+  /**
+   * Transcode TBC/MBC into PVRZ-based TIS/MOS V2. Index specifies the first PVRZ page
+   * for MOS output, or -1 to decode into paletted TIS/MOS.
+   */
+  void setPvrzIndex(int index) noexcept;
+  int getPvrzIndex() const noexcept { return m_pvrzIndex; }
+  bool isPvrzOutput() const noexcept { return m_pvrzIndex >= 0; }
+
+  /** Convert TIZ/MOZ directly into TBC/MBC instead of TIS/MOS. */
+  void setEncodeZ(bool b) noexcept { m_encodeZ = b; }
+  bool isEncodeZ() const noexcept { return m_encodeZ; }
+
+  /** Decode JPEG compressed TIZ/MOZ tiles (TIL2) with tileconv's color quantization instead of libjpeg's. */
+  void setQuantizeZ(bool b) noexcept { m_quantizeZ = b; }
+  bool isQuantizeZ() const noexcept { return m_quantizeZ; }
+
+  /** Read conversion jobs from the given source ("-" for stdin, or a local socket path). */
+  void setServer(const std::string &source) noexcept { m_server = source; }
+  const std::string& getServer() const noexcept { return m_server; }
+  bool isServer() const noexcept { return !m_server.empty(); }
+
+  /** Folder for cached conversion results (empty: disabled). */
+  void setCachePath(const std::string &path) noexcept { m_cachePath = path; }
+  const std::string& getCachePath() const noexcept { return m_cachePath; }
+  bool isCache() const noexcept { return !m_cachePath.empty(); }
+
+  /** Max. size of the cache folder in MB (0: unlimited). */
+  void setCacheSize(int size) noexcept;
+  int getCacheSize() const noexcept { return m_cacheSize; }
+
+  /** Max. memory in MB held by queued tiles, file buffers and caches (0: unlimited). */
+  void setMaxMemory(int size) noexcept;
+  int getMaxMemory() const noexcept { return m_maxMemory; }
+
+  /** Placement of worker and I/O threads on the available CPUs. */
+  void setAffinity(Affinity::Mode mode) noexcept { m_affinity = mode; }
+  Affinity::Mode getAffinity() const noexcept { return m_affinity; }
+
+  /** Process expensive tiles of a file first instead of in file order. Output is not affected. */
+  void setCostOrder(bool b) noexcept { m_costOrder = b; }
+  bool isCostOrder() const noexcept { return m_costOrder; }
+
+  /** Read and write files of multiple input files in batches if supported by the system. */
+  void setBatchIO(bool b) noexcept { m_batchIO = b; }
+  bool isBatchIO() const noexcept { return m_batchIO; }
+
+  /** File to receive the JSON report of per-stage timings ("-" for stdout, empty: disabled). */
+  void setStatsFile(const std::string &fileName) noexcept { m_statsFile = fileName; }
+  const std::string& getStatsFile() const noexcept { return m_statsFile; }
+  bool isStats() const noexcept { return !m_statsFile.empty(); }
+
+  /** File to receive a timeline of all stages and tiles in trace event format (empty: disabled). */
+  void setTraceFile(const std::string &fileName) noexcept { m_traceFile = fileName; }
+  const std::string& getTraceFile() const noexcept { return m_traceFile; }
+  bool isTrace() const noexcept { return !m_traceFile.empty(); }
+
+  /** Returns a textual representation of all options affecting the content of output files. */
+  std::string getCacheKey() const noexcept;
+
   /** Treat unknown input files as headerless TIS files. */
   void setAssumeTis(bool b) noexcept { m_assumeTis = b; }
   bool assumeTis() const noexcept { return m_assumeTis; }
@@ -151,27 +246,55 @@ class Options
   static const bool         DEF_DEFLATE;
   static const bool         DEF_SHOWINFO;
   static const bool         DEF_ASSUMETIS;
+  static const bool         DEF_ENCODE_Z;
+  static const bool         DEF_QUANTIZE_Z;
+  static const bool         DEF_COST_ORDER;
+  static const bool         DEF_BATCH_IO;
   static const int          DEF_VERBOSITY;
   static const int          DEF_QUALITY_ENCODING;
   static const int          DEF_QUALITY_DECODING;
   static const int          DEF_THREADS;
+  static const int          DEF_BITMAP_FORMAT;
+  static const int          DEF_PVRZ_INDEX;
+  static const int          DEF_CACHE_SIZE;
+  static const int          MAX_CACHE_SIZE;
+  static const int          DEF_MAX_MEMORY;
+  static const int          MAX_MAX_MEMORY;
+  static const Affinity::Mode DEF_AFFINITY;
   static const Encoding     DEF_ENCODING;
 
   static const char         ParamNames[];
 
+  // Return values of long-only parameters
+  enum { PARAM_STATS = 256, PARAM_TRACE, PARAM_MAX_MEMORY, PARAM_AFFINITY, PARAM_TILE_ORDER, PARAM_IO_ENGINE };
+
   bool                      m_haltOnError;      // cancel operation on error
   bool                      m_mosc;             // create MOSC output
   bool                      m_deflate;          // apply zlib compression to TBC/MBC
   bool                      m_showInfo;
   bool                      m_assumeTis;        // Treat unknown file types as headerless TIS files
+  bool                      m_encodeZ;          // convert TIZ/MOZ into TBC/MBC
+  bool                      m_quantizeZ;        // use ColorQuant for TIL2 tiles
+  bool                      m_costOrder;        // process expensive tiles first
+  bool                      m_batchIO;          // use the batch I/O engine if available
   int                       m_verbosity;        // verbosity level (2:verbose, 1:summary only, 0:no output)
   int                       m_qualityDecoding;  // color reduction quality (0:fast, 9:slow)
   int                       m_qualityEncoding;  // DXTn compression quality (0:fast, 9:slow)
   int                       m_threads;          // how many threads to use for encoding/decoding
+  int                       m_bitmapFormat;     // color format of 32-bit bitmap output (-1: disabled)
+  int                       m_pvrzIndex;        // first PVRZ page index of MOS V2 output (-1: disabled)
+  int                       m_cacheSize;        // max. size of the cache folder in MB (0: unlimited)
+  int                       m_maxMemory;        // memory budget in MB (0: unlimited)
+  Affinity::Mode            m_affinity;         // placement of worker and I/O threads
   Encoding                  m_encoding;         // encoding type
   std::vector<std::string>  m_inFiles;
+  std::vector<std::string>  m_jobs;             // job lines of manifest files
   std::string               m_outPath;          // file path (empty or with trailing path separator) only!
   std::string               m_outFile;          // file name only!
+  std::string               m_server;           // job source of server mode (empty: disabled)
+  std::string               m_cachePath;        // folder of cached conversion results (empty: disabled)
+  std::string               m_statsFile;        // JSON report of per-stage timings (empty: disabled)
+  std::string               m_traceFile;        // trace events of all stages and tiles (empty: disabled)
 };
 
 }   // namespace tc
@@ -0,0 +1,226 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <cstring>
+#include <cstdio>
+#include "funcs.h"
+#include "logger.h"
+#include "fileio.h"
+#include "compress.h"
+#include "pvrz.h"
+
+namespace tc {
+
+const int Pvrz::PAGE_DIMENSION          = 1024;
+const unsigned Pvrz::HEADER_PVR3_SIZE   = 52;
+const uint32_t Pvrz::PVR3_SIGNATURE     = 0x03525650;
+const uint64_t Pvrz::PVR3_FORMAT_DXT1   = 7;
+const uint64_t Pvrz::PVR3_FORMAT_DXT3   = 9;
+const uint64_t Pvrz::PVR3_FORMAT_DXT5   = 11;
+
+
+Pvrz::Pvrz(unsigned type, int width, int height) noexcept
+: m_type(type & 0xff)
+, m_width(width)
+, m_height(height)
+, m_data(nullptr)
+, m_memory()
+{
+  if ((m_type == ENCODE_DXT1 || m_type == ENCODE_DXT3 || m_type == ENCODE_DXT5) &&
+      width > 0 && height > 0 && (width & 3) == 0 && (height & 3) == 0 &&
+      width <= PAGE_DIMENSION && height <= PAGE_DIMENSION) {
+    unsigned size = (width >> 2)*(height >> 2)*getBlockSize();
+    m_data.reset(new uint8_t[size], std::default_delete<uint8_t[]>());
+    m_memory.reset(size);
+    std::memset(m_data.get(), 0, size);
+  }
+}
+
+
+Pvrz::Pvrz(const std::string &fileName) noexcept
+: m_type(0)
+, m_width(0)
+, m_height(0)
+, m_data(nullptr)
+, m_memory()
+{
+  File fin(fileName.c_str(), "rb");
+  if (!fin.error()) {
+    uint32_t v32, pvrzSize, pvrSize;
+    long size = fin.getsize();
+    if (size > 4 && fin.read(&v32, 4, 1) == 1) {
+      pvrzSize = (uint32_t)size - 4;
+      pvrSize = get32u_le(&v32);
+      if (pvrSize > HEADER_PVR3_SIZE) {
+        BytePtr pvrzData(new uint8_t[pvrzSize], std::default_delete<uint8_t[]>());
+        BytePtr pvrData(new uint8_t[pvrSize], std::default_delete<uint8_t[]>());
+        Compression compression;
+        if (fin.read(pvrzData.get(), 1, pvrzSize) == pvrzSize &&
+            compression.inflate(pvrzData.get(), pvrzSize, pvrData.get(), pvrSize) == pvrSize &&
+            load(pvrData.get(), pvrSize)) {
+          return;
+        }
+      }
+    }
+    Logger::Print("\nInvalid or unsupported PVRZ file \"%s\"\n", fileName.c_str());
+  } else {
+    Logger::Print("\nError opening file \"%s\"\n", fileName.c_str());
+  }
+}
+
+
+Pvrz::~Pvrz() noexcept
+{
+}
+
+
+bool Pvrz::load(uint8_t *data, uint32_t size) noexcept
+{
+  if (get32u_le((uint32_t*)data) != PVR3_SIGNATURE) return false;
+
+  uint64_t format = get64u_le((uint64_t*)(data+0x08));
+  if (format == PVR3_FORMAT_DXT1) {
+    m_type = ENCODE_DXT1;
+  } else if (format == PVR3_FORMAT_DXT3) {
+    m_type = ENCODE_DXT3;
+  } else if (format == PVR3_FORMAT_DXT5) {
+    m_type = ENCODE_DXT5;
+  } else {
+    return false;
+  }
+
+  m_height = (int)get32u_le((uint32_t*)(data+0x18));
+  m_width = (int)get32u_le((uint32_t*)(data+0x1c));
+  if (m_width <= 0 || m_height <= 0 || (m_width & 3) != 0 || (m_height & 3) != 0 ||
+      m_width > PAGE_DIMENSION || m_height > PAGE_DIMENSION) {
+    return false;
+  }
+
+  // only the first surface of the top-most mipmap level is used
+  uint32_t dataOfs = HEADER_PVR3_SIZE + get32u_le((uint32_t*)(data+0x30));
+  uint32_t dataSize = (m_width >> 2)*(m_height >> 2)*getBlockSize();
+  if (dataOfs < HEADER_PVR3_SIZE || dataOfs + dataSize > size) return false;
+
+  m_data.reset(new uint8_t[dataSize], std::default_delete<uint8_t[]>());
+  m_memory.reset(dataSize);
+  std::memcpy(m_data.get(), data + dataOfs, dataSize);
+  return true;
+}
+
+
+bool Pvrz::putBlocks(const uint8_t *blocks, int width, int height, int x, int y) noexcept
+{
+  if (blocks != nullptr && isBlockRect(width, height, x, y)) {
+    int blockSize = getBlockSize();
+    int srcStride = ((width + 3) >> 2)*blockSize;
+    int dstStride = (m_width >> 2)*blockSize;
+    uint8_t *dst = m_data.get() + (y >> 2)*dstStride + (x >> 2)*blockSize;
+    for (int by = 0, rows = (height + 3) >> 2; by < rows; by++, blocks += srcStride, dst += dstStride) {
+      std::memcpy(dst, blocks, srcStride);
+    }
+    return true;
+  }
+  return false;
+}
+
+
+bool Pvrz::getBlocks(uint8_t *blocks, int width, int height, int x, int y) const noexcept
+{
+  if (blocks != nullptr && isBlockRect(width, height, x, y)) {
+    int blockSize = getBlockSize();
+    int srcStride = (m_width >> 2)*blockSize;
+    int dstStride = ((width + 3) >> 2)*blockSize;
+    const uint8_t *src = m_data.get() + (y >> 2)*srcStride + (x >> 2)*blockSize;
+    for (int by = 0, rows = (height + 3) >> 2; by < rows; by++, blocks += dstStride, src += srcStride) {
+      std::memcpy(blocks, src, dstStride);
+    }
+    return true;
+  }
+  return false;
+}
+
+
+bool Pvrz::isBlockRect(int width, int height, int x, int y) const noexcept
+{
+  return (isValid() && width > 0 && height > 0 &&
+          x >= 0 && y >= 0 && (x & 3) == 0 && (y & 3) == 0 &&
+          x + ((width + 3) & ~3) <= m_width && y + ((height + 3) & ~3) <= m_height);
+}
+
+
+bool Pvrz::save(const std::string &fileName) const noexcept
+{
+  if (isValid() && !fileName.empty()) {
+    uint32_t dataSize = (m_width >> 2)*(m_height >> 2)*getBlockSize();
+    uint32_t pvrSize = HEADER_PVR3_SIZE + dataSize;
+    BytePtr pvrData(new uint8_t[pvrSize], std::default_delete<uint8_t[]>());
+
+    // creating PVR3 header
+    uint8_t *p = pvrData.get();
+    uint32_t v32;
+    uint64_t v64;
+    std::memset(p, 0, HEADER_PVR3_SIZE);
+    v32 = PVR3_SIGNATURE; *(uint32_t*)(p+0x00) = get32u_le(&v32);        // signature
+    v64 = (m_type == ENCODE_DXT1) ? PVR3_FORMAT_DXT1 : ((m_type == ENCODE_DXT3) ? PVR3_FORMAT_DXT3 : PVR3_FORMAT_DXT5);
+    *(uint64_t*)(p+0x08) = get64u_le(&v64);                               // pixel format
+    v32 = m_height; *(uint32_t*)(p+0x18) = get32u_le(&v32);               // height
+    v32 = m_width; *(uint32_t*)(p+0x1c) = get32u_le(&v32);                // width
+    v32 = 1;
+    *(uint32_t*)(p+0x20) = get32u_le(&v32);                               // depth
+    *(uint32_t*)(p+0x24) = get32u_le(&v32);                               // number of surfaces
+    *(uint32_t*)(p+0x28) = get32u_le(&v32);                               // number of faces
+    *(uint32_t*)(p+0x2c) = get32u_le(&v32);                               // number of mipmap levels
+    std::memcpy(p+HEADER_PVR3_SIZE, m_data.get(), dataSize);
+
+    // compressing PVR3 data
+    uint32_t pvrzSize = pvrSize*2;
+    BytePtr pvrzData(new uint8_t[pvrzSize], std::default_delete<uint8_t[]>());
+    v32 = pvrSize; *(uint32_t*)pvrzData.get() = get32u_le(&v32);
+    Compression compression;
+    pvrzSize = compression.deflate(pvrData.get(), pvrSize, pvrzData.get()+4, pvrzSize-4);
+    if (pvrzSize == 0) {
+      Logger::Print("\nError while compressing PVRZ data\n");
+      return false;
+    }
+    pvrzSize += 4;
+
+    File fout(fileName.c_str(), "wb");
+    if (!fout.error()) {
+      fout.setDeleteOnClose(true);
+      if (fout.write(pvrzData.get(), 1, pvrzSize) == pvrzSize) {
+        fout.setDeleteOnClose(false);
+        return true;
+      }
+    }
+    Logger::Print("\nError writing file \"%s\"\n", fileName.c_str());
+  }
+  return false;
+}
+
+
+int Pvrz::GetPageDimension(int v) noexcept
+{
+  int retVal = 4;
+  while (retVal < v && retVal < PAGE_DIMENSION) retVal <<= 1;
+  return retVal;
+}
+
+}   // namespace tc
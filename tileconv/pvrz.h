@@ -0,0 +1,124 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _PVRZ_H_
+#define _PVRZ_H_
+#include <string>
+#include <memory>
+#include "types.h"
+#include "membudget.h"
+
+namespace tc {
+
+/** Manages a single PVRZ page (zlib compressed PVR3 texture) containing DXT1, DXT3 or DXT5 blocks. */
+class Pvrz
+{
+public:
+  /**
+   * Creates an empty page of the given dimensions.
+   * \param type The pixel encoding type of the page (ENCODE_DXT1, ENCODE_DXT3 or ENCODE_DXT5).
+   * \param width Page width in pixels. Must be a multiple of 4.
+   * \param height Page height in pixels. Must be a multiple of 4.
+   */
+  Pvrz(unsigned type, int width, int height) noexcept;
+  /** Loads the page from the specified PVRZ file. Only DXT1, DXT3 and DXT5 pixel formats are supported. */
+  explicit Pvrz(const std::string &fileName) noexcept;
+  ~Pvrz() noexcept;
+
+  /** Returns whether the page has been initialized successfully. */
+  bool isValid() const noexcept { return m_data != nullptr; }
+
+  /** Pixel encoding type of the page (ENCODE_DXT1, ENCODE_DXT3 or ENCODE_DXT5). */
+  unsigned getType() const noexcept { return m_type; }
+
+  /** Page dimensions in pixels. */
+  int getWidth() const noexcept { return m_width; }
+  int getHeight() const noexcept { return m_height; }
+
+  /**
+   * Copies a rectangle of encoded blocks into the page.
+   * \param blocks Encoded blocks in row-major order (without tile header).
+   * \param width Width of the rectangle in pixels. Rounded up to a multiple of 4.
+   * \param height Height of the rectangle in pixels. Rounded up to a multiple of 4.
+   * \param x Horizontal target position in pixels. Must be a multiple of 4.
+   * \param y Vertical target position in pixels. Must be a multiple of 4.
+   * \return Success state.
+   */
+  bool putBlocks(const uint8_t *blocks, int width, int height, int x, int y) noexcept;
+
+  /**
+   * Copies a rectangle of encoded blocks from the page.
+   * \param blocks Storage for the encoded blocks in row-major order (without tile header).
+   * \param width Width of the rectangle in pixels. Rounded up to a multiple of 4.
+   * \param height Height of the rectangle in pixels. Rounded up to a multiple of 4.
+   * \param x Horizontal source position in pixels. Must be a multiple of 4.
+   * \param y Vertical source position in pixels. Must be a multiple of 4.
+   * \return Success state.
+   */
+  bool getBlocks(uint8_t *blocks, int width, int height, int x, int y) const noexcept;
+
+  /** Writes the page as PVRZ file to disk. */
+  bool save(const std::string &fileName) const noexcept;
+
+  /** Returns the smallest power of two that is greater than or equal to v. */
+  static int GetPageDimension(int v) noexcept;
+
+public:
+  static const int PAGE_DIMENSION;            // max. supported page width and height
+  static const unsigned HEADER_PVR3_SIZE;     // PVR3 header size
+  static const uint32_t PVR3_SIGNATURE;       // PVR3 signature
+  static const uint64_t PVR3_FORMAT_DXT1;     // PVR3 pixel format code for DXT1
+  static const uint64_t PVR3_FORMAT_DXT3;     // PVR3 pixel format code for DXT3
+  static const uint64_t PVR3_FORMAT_DXT5;     // PVR3 pixel format code for DXT5
+
+private:
+  // Returns the size of a single encoded block in bytes
+  int getBlockSize() const noexcept { return (m_type == ENCODE_DXT1) ? 8 : 16; }
+
+  // Returns whether the given rectangle is located inside the page and aligned to block boundaries
+  bool isBlockRect(int width, int height, int x, int y) const noexcept;
+
+  // Parses the uncompressed PVR3 data
+  bool load(uint8_t *data, uint32_t size) noexcept;
+
+private:
+  unsigned  m_type;
+  int       m_width;
+  int       m_height;
+  BytePtr   m_data;       // encoded blocks of the page (row-major order)
+  MemoryBudget::Reservation m_memory;   // accounted size of m_data
+};
+
+typedef std::shared_ptr<Pvrz> PvrzPtr;
+
+
+/** Maps a rectangular region of a PVRZ page onto a tile. */
+struct PvrzRegion
+{
+  PvrzPtr page;
+  int     srcX, srcY;       // top-left corner in the page
+  int     dstX, dstY;       // top-left corner in the tile
+  int     width, height;    // region dimensions
+};
+
+}   // namespace tc
+
+#endif		// _PVRZ_H_
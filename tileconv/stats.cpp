@@ -0,0 +1,469 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <vector>
+#include "fileio.h"
+#include "logger.h"
+#include "stats.h"
+
+namespace tc {
+
+std::atomic<bool>& Stats::GetEnabled() noexcept
+{
+  static std::atomic<bool> enabled(false);
+  return enabled;
+}
+
+
+std::atomic<bool>& Stats::GetTracing() noexcept
+{
+  static std::atomic<bool> tracing(false);
+  return tracing;
+}
+
+
+std::atomic<Stats::ThreadCounters*>& Stats::GetThreads() noexcept
+{
+  static std::atomic<ThreadCounters*> threads(nullptr);
+  return threads;
+}
+
+
+Stats::Clock::time_point& Stats::GetStartTime() noexcept
+{
+  static Clock::time_point start = Clock::now();
+  return start;
+}
+
+
+void Stats::SetEnabled(bool b) noexcept
+{
+  GetEnabled().store(b);
+}
+
+
+void Stats::SetTracing(bool b) noexcept
+{
+  GetTracing().store(b);
+  if (b) SetEnabled(true);
+}
+
+
+Stats::ThreadSlot& Stats::GetThreadSlot() noexcept
+{
+  static thread_local ThreadSlot slot = { nullptr };
+  return slot;
+}
+
+
+Stats::ThreadCounters* Stats::GetThreadCounters() noexcept
+{
+  ThreadSlot &slot = GetThreadSlot();
+  if (slot.counters == nullptr) slot.counters = Acquire(std::string(), 0);
+  return slot.counters;
+}
+
+
+Stats::ThreadCounters* Stats::Acquire(const std::string &name, int id) noexcept
+{
+  std::atomic<ThreadCounters*> &threads = GetThreads();
+  for (ThreadCounters *t = threads.load(); t != nullptr; t = t->next) {
+    bool used = false;
+    if (t->id == id && t->name == name && t->used.compare_exchange_strong(used, true)) return t;
+  }
+
+  ThreadCounters *counters = new(std::nothrow) ThreadCounters;
+  if (counters != nullptr) {
+    counters->name = name;
+    counters->id = id;
+    counters->used.store(true);
+    std::memset(counters->stages, 0, sizeof(counters->stages));
+    std::memset(&counters->window, 0, sizeof(counters->window));
+    std::memset(&counters->tail, 0, sizeof(counters->tail));
+    counters->traceId = 0;
+    counters->tileIndex = -1;
+    counters->next = threads.load();
+    do {
+      counters->index = (counters->next != nullptr) ? counters->next->index + 1 : 0;
+    } while (!threads.compare_exchange_weak(counters->next, counters));
+  }
+  return counters;
+}
+
+
+void Stats::Release(ThreadCounters *counters) noexcept
+{
+  counters->traceId = 0;
+  counters->tileIndex = -1;
+  counters->used.store(false);
+}
+
+
+void Stats::AddTileWindow(unsigned tiles) noexcept
+{
+  ThreadCounters *counters = GetThreadCounters();
+  if (counters != nullptr) {
+    WindowCounter &w = counters->window;
+    w.min = (w.samples > 0) ? std::min(w.min, tiles) : tiles;
+    w.max = std::max(w.max, tiles);
+    w.sum += tiles;
+    w.samples++;
+  }
+}
+
+
+void Stats::AddTail(uint64_t tailNs, uint64_t idleNs, unsigned threads) noexcept
+{
+  ThreadCounters *counters = GetThreadCounters();
+  if (counters != nullptr) {
+    TailCounter &t = counters->tail;
+    t.files++;
+    t.tailNs += tailNs;
+    t.idleNs += idleNs;
+    t.capacityNs += tailNs * threads;
+  }
+}
+
+
+void Stats::Add(Stage stage, Clock::time_point start, Clock::time_point end,
+                uint64_t bytesIn, uint64_t bytesOut) noexcept
+{
+  ThreadCounters *counters = GetThreadCounters();
+  if (counters != nullptr && stage < Stage::COUNT) {
+    uint64_t ns = (uint64_t)std::max((Clock::rep)0, std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    Counter &c = counters->stages[(int)stage];
+    c.calls++;
+    c.totalNs += ns;
+    c.maxNs = std::max(c.maxNs, ns);
+    c.bytesIn += bytesIn;
+    c.bytesOut += bytesOut;
+    c.histogram[GetBucket(ns)]++;
+
+    // queue waits overlap with other stages of the worker thread and are shown by tile events instead
+    if (IsTracing() && stage != Stage::QUEUE_WAIT) {
+      TraceEvent event;
+      event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - GetStartTime()).count();
+      event.duration = (int64_t)ns;
+      event.traceId = counters->traceId;
+      event.index = counters->tileIndex;
+      event.type = (int)stage;
+      event.isStage = true;
+      counters->events.push_back(event);
+      if (stage == Stage::DRAIN && counters->tileIndex >= 0) {
+        // the tile result has been written
+        AddTileEvent(TileEvent::WRITTEN, counters->traceId, counters->tileIndex);
+        counters->tileIndex = -1;
+      }
+    }
+  }
+}
+
+
+void Stats::AddTileEvent(TileEvent event, uint64_t traceId, int index) noexcept
+{
+  ThreadCounters *counters = IsTracing() ? GetThreadCounters() : nullptr;
+  if (counters != nullptr) {
+    TraceEvent e;
+    e.start = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - GetStartTime()).count();
+    e.duration = 0;
+    e.traceId = traceId;
+    e.index = index;
+    e.type = (int)event;
+    e.isStage = false;
+    counters->events.push_back(e);
+  }
+}
+
+
+uint64_t Stats::NextTraceId() noexcept
+{
+  static std::atomic<uint64_t> traceId(0);
+  return ++traceId;
+}
+
+
+void Stats::SetCurrentTile(uint64_t traceId, int index) noexcept
+{
+  ThreadCounters *counters = GetThreadCounters();
+  if (counters != nullptr) {
+    counters->traceId = traceId;
+    counters->tileIndex = index;
+  }
+}
+
+
+void Stats::SetThreadName(const char *name, int id) noexcept
+{
+  // threads are registered on demand only
+  if (IsEnabled() && name != nullptr) {
+    ThreadSlot &slot = GetThreadSlot();
+    if (slot.counters != nullptr) {
+      if (slot.counters->id == id && slot.counters->name == name) return;
+      Release(slot.counters);
+    }
+    slot.counters = Acquire(name, id);
+  }
+}
+
+
+void Stats::Reset() noexcept
+{
+  for (ThreadCounters *t = GetThreads().load(); t != nullptr; t = t->next) {
+    std::memset(t->stages, 0, sizeof(t->stages));
+    std::memset(&t->window, 0, sizeof(t->window));
+    std::memset(&t->tail, 0, sizeof(t->tail));
+    t->events.clear();
+  }
+  GetStartTime() = Clock::now();
+}
+
+
+std::string Stats::GetReport() noexcept
+{
+  double wall = std::chrono::duration<double>(Clock::now() - GetStartTime()).count();
+  std::string report;
+  char buf[512];
+
+  // aggregating counters of all threads
+  Counter total[(int)Stage::COUNT];
+  std::memset(total, 0, sizeof(total));
+  WindowCounter window;
+  std::memset(&window, 0, sizeof(window));
+  TailCounter tail;
+  std::memset(&tail, 0, sizeof(tail));
+  int numThreads = 0;
+  for (ThreadCounters *t = GetThreads().load(); t != nullptr; t = t->next) {
+    if (t->window.samples > 0) {
+      window.min = (window.samples > 0) ? std::min(window.min, t->window.min) : t->window.min;
+      window.max = std::max(window.max, t->window.max);
+      window.samples += t->window.samples;
+      window.sum += t->window.sum;
+    }
+    tail.files += t->tail.files;
+    tail.tailNs += t->tail.tailNs;
+    tail.idleNs += t->tail.idleNs;
+    tail.capacityNs += t->tail.capacityNs;
+    bool active = false;
+    for (int s = 0; s < (int)Stage::COUNT; s++) {
+      const Counter &c = t->stages[s];
+      if (c.calls == 0) continue;
+      active = true;
+      total[s].calls += c.calls;
+      total[s].totalNs += c.totalNs;
+      total[s].maxNs = std::max(total[s].maxNs, c.maxNs);
+      total[s].bytesIn += c.bytesIn;
+      total[s].bytesOut += c.bytesOut;
+      for (int i = 0; i < BUCKETS; i++) total[s].histogram[i] += c.histogram[i];
+    }
+    if (active) numThreads++;
+  }
+
+  std::snprintf(buf, sizeof(buf), "{\n  \"wall_seconds\": %.6f,\n  \"threads\": %d,\n", wall, numThreads);
+  report += buf;
+  if (window.samples > 0) {
+    std::snprintf(buf, sizeof(buf),
+                  "  \"tile_window\": {\"samples\": %llu, \"mean\": %.1f, \"min\": %u, \"max\": %u},\n",
+                  (unsigned long long)window.samples, (double)window.sum / window.samples, window.min, window.max);
+    report += buf;
+  }
+  if (tail.files > 0) {
+    std::snprintf(buf, sizeof(buf),
+                  "  \"tail\": {\"files\": %llu, \"tail_ms\": %.3f, \"idle_ms\": %.3f, \"idle_ratio\": %.3f},\n",
+                  (unsigned long long)tail.files, tail.tailNs / 1e6, tail.idleNs / 1e6,
+                  (tail.capacityNs > 0) ? (double)tail.idleNs / tail.capacityNs : 0.0);
+    report += buf;
+  }
+  report += "  \"stages\": [";
+  bool first = true;
+  for (int s = 0; s < (int)Stage::COUNT; s++) {
+    const Counter &c = total[s];
+    if (c.calls == 0) continue;
+    std::snprintf(buf, sizeof(buf),
+                  "%s\n    {\"stage\": \"%s\", \"calls\": %llu, \"total_ms\": %.3f, \"mean_us\": %.3f, "
+                  "\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, "
+                  "\"bytes_in\": %llu, \"bytes_out\": %llu}",
+                  first ? "" : ",", GetStageName((Stage)s), (unsigned long long)c.calls,
+                  c.totalNs / 1e6, c.totalNs / 1e3 / c.calls,
+                  GetPercentile(c, 50.0) / 1e3, GetPercentile(c, 90.0) / 1e3, GetPercentile(c, 99.0) / 1e3,
+                  c.maxNs / 1e3, (unsigned long long)c.bytesIn, (unsigned long long)c.bytesOut);
+    report += buf;
+    first = false;
+  }
+  report += "\n  ],\n  \"per_thread\": [";
+
+  // per-thread totals in order of registration, threads of equal name and id are combined
+  std::vector<const ThreadCounters*> threads;
+  for (ThreadCounters *t = GetThreads().load(); t != nullptr; t = t->next) threads.push_back(t);
+  first = true;
+  for (auto iter = threads.crbegin(); iter != threads.crend(); ++iter) {
+    std::string stages;
+    for (int s = 0; s < (int)Stage::COUNT; s++) {
+      const Counter &c = (*iter)->stages[s];
+      if (c.calls == 0) continue;
+      std::snprintf(buf, sizeof(buf), "%s\"%s\": %.3f", stages.empty() ? "" : ", ",
+                    GetStageName((Stage)s), c.totalNs / 1e6);
+      stages += buf;
+    }
+    if (stages.empty()) continue;
+    std::snprintf(buf, sizeof(buf), "%s\n    {\"thread\": \"%s\", \"total_ms\": {", first ? "" : ",",
+                  GetThreadLabel(**iter).c_str());
+    report += buf;
+    report += stages;
+    report += "}}";
+    first = false;
+  }
+  report += "\n  ]\n}\n";
+  return report;
+}
+
+
+bool Stats::WriteReport(const std::string &fileName) noexcept
+{
+  std::string report = GetReport();
+  if (fileName == "-") {
+    Logger::Print("%s", report.c_str());
+    return true;
+  }
+  File f(fileName.c_str(), "wb");
+  if (!f.error()) {
+    return (f.write(report.c_str(), 1, report.size()) == report.size());
+  }
+  return false;
+}
+
+
+bool Stats::WriteTrace(const std::string &fileName) noexcept
+{
+  // writing the trace must not add further events
+  bool enabled = IsEnabled(), tracing = IsTracing();
+  GetTracing().store(false);
+  GetEnabled().store(false);
+
+  bool retVal = false;
+  File f(fileName.c_str(), "wb");
+  if (!f.error()) {
+    // tile lifetime from being queued until written, with instant events in between
+    static const char *tileEvents[] = { "tile", "started", "result queued", "tile" };
+    static const char tilePhases[] = { 'b', 'n', 'n', 'e' };
+    std::string data("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    char buf[512];
+    bool first = true;
+    retVal = true;
+    for (ThreadCounters *t = GetThreads().load(); t != nullptr && retVal; t = t->next) {
+      if (t->events.empty()) continue;
+      std::snprintf(buf, sizeof(buf),
+                    "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", t->index, GetThreadLabel(*t).c_str());
+      data += buf;
+      first = false;
+      for (auto iter = t->events.cbegin(); iter != t->events.cend(); ++iter) {
+        if (iter->isStage) {
+          int len = std::snprintf(buf, sizeof(buf),
+                                  ",\n{\"name\": \"%s\", \"cat\": \"stage\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                                  GetStageName((Stage)iter->type), t->index, iter->start / 1e3, iter->duration / 1e3);
+          if (iter->index >= 0) {
+            std::snprintf(buf + len, sizeof(buf) - len, ", \"args\": {\"tile\": %d}}", iter->index);
+          } else {
+            std::snprintf(buf + len, sizeof(buf) - len, "}");
+          }
+        } else {
+          std::snprintf(buf, sizeof(buf),
+                        ",\n{\"name\": \"%s\", \"cat\": \"tile\", \"ph\": \"%c\", \"id\": \"0x%llx\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"args\": {\"tile\": %d}}",
+                        tileEvents[iter->type], tilePhases[iter->type], (unsigned long long)iter->traceId, t->index, iter->start / 1e3, iter->index);
+        }
+        data += buf;
+        if (data.size() >= 1 << 20) {
+          retVal = (f.write(data.c_str(), 1, data.size()) == data.size());
+          data.clear();
+          if (!retVal) break;
+        }
+      }
+    }
+    data += "\n]}\n";
+    if (retVal) retVal = (f.write(data.c_str(), 1, data.size()) == data.size());
+  }
+
+  GetEnabled().store(enabled);
+  GetTracing().store(tracing);
+  return retVal;
+}
+
+
+std::string Stats::GetThreadLabel(const ThreadCounters &counters) noexcept
+{
+  // unnamed threads are told apart by their counters
+  char buf[32];
+  if (counters.name.empty()) {
+    std::snprintf(buf, sizeof(buf), "thread #%d", counters.index);
+    return std::string(buf);
+  }
+  std::snprintf(buf, sizeof(buf), " #%d", counters.id);
+  return counters.name + buf;
+}
+
+
+const char* Stats::GetStageName(Stage stage) noexcept
+{
+  static const char *names[] = {
+    "read", "write", "palette_expand", "dxt_encode", "dxt_decode", "quantize", "jpeg_decode",
+    "deflate", "inflate", "tile", "queue_wait", "submit_wait", "result_wait", "drain", "idle", "help" };
+  return (stage < Stage::COUNT) ? names[(int)stage] : "";
+}
+
+
+int Stats::GetBucket(uint64_t ns) noexcept
+{
+  if (ns < 8) return (int)ns;
+  int e = 63;
+  while (((ns >> e) & 1) == 0) e--;
+  return std::min(BUCKETS - 1, 8 + (e - 3)*8 + (int)((ns >> (e - 3)) & 7));
+}
+
+
+double Stats::GetBucketValue(int bucket) noexcept
+{
+  if (bucket < 8) return bucket;
+  int e = (bucket - 8) / 8 + 3;
+  int sub = (bucket - 8) % 8;
+  // center of the bucket range
+  return (double)(8 + sub) * (double)(1ull << (e - 3)) + (double)(1ull << (e - 3)) * 0.5;
+}
+
+
+double Stats::GetPercentile(const Counter &counter, double percent) noexcept
+{
+  if (counter.calls > 0) {
+    uint64_t rank = (uint64_t)(counter.calls * percent / 100.0 + 0.5);
+    rank = std::max((uint64_t)1, std::min(counter.calls, rank));
+    uint64_t sum = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+      sum += counter.histogram[i];
+      if (sum >= rank) return std::min(GetBucketValue(i), (double)counter.maxNs);
+    }
+  }
+  return 0.0;
+}
+
+}   // namespace tc
@@ -0,0 +1,227 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _STATS_H_
+#define _STATS_H_
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tc {
+
+/**
+ * Low-overhead timing of the individual conversion stages. Counters are collected per thread
+ * and aggregated when the report is created. Timers don't query the clock while disabled.
+ * Optionally records a timeline of all stages and tiles in the Chrome trace event format.
+ */
+class Stats
+{
+public:
+  /** Instrumented conversion stages. */
+  enum class Stage {
+    READ,         // reading input data (includes waiting for read-ahead)
+    WRITE,        // writing output data (includes waiting for write-behind)
+    EXPAND,       // palette expansion into 32-bit pixels
+    ENCODE,       // DXTn encoding of a tile (squish)
+    DECODE,       // DXTn decoding of a tile
+    QUANTIZE,     // color reduction of 32-bit pixels
+    JPEG,         // JPEG decoding of TIZ/MOZ tiles
+    DEFLATE,      // zlib compression
+    INFLATE,      // zlib decompression
+    TILE,         // total processing time of a tile by a worker thread
+    QUEUE_WAIT,   // time a tile waits in the thread pool queue for a worker thread
+    SUBMIT_WAIT,  // time the main thread is blocked because the thread pool queue is full
+    RESULT_WAIT,  // time the main thread waits for the next tile result in order
+    DRAIN,        // main thread retrieves and writes a single tile result
+    IDLE,         // worker thread sleeps while the thread pool queue is empty
+    HELP,         // worker thread runs part of a tile processed by another worker thread
+    COUNT
+  };
+
+  typedef std::chrono::steady_clock Clock;
+
+  /** Measures the lifetime of the object as a single call of the specified stage. */
+  class Timer
+  {
+  public:
+    explicit Timer(Stage stage, uint64_t bytesIn = 0) noexcept
+    : m_stage(stage), m_active(IsEnabled()), m_bytesIn(bytesIn), m_bytesOut(0), m_start()
+    { if (m_active) m_start = Clock::now(); }
+    ~Timer() noexcept { if (m_active) Add(m_stage, m_start, Clock::now(), m_bytesIn, m_bytesOut); }
+
+    void setBytesIn(uint64_t bytes) noexcept { m_bytesIn = bytes; }
+    void setBytesOut(uint64_t bytes) noexcept { m_bytesOut = bytes; }
+
+  private:
+    Stage             m_stage;
+    bool              m_active;
+    uint64_t          m_bytesIn;
+    uint64_t          m_bytesOut;
+    Clock::time_point m_start;
+  };
+
+  /** Enables or disables collecting statistics. (Default: disabled) */
+  static void SetEnabled(bool b) noexcept;
+  static bool IsEnabled() noexcept { return GetEnabled().load(std::memory_order_relaxed); }
+
+  /** Enables recording of trace events. Implies SetEnabled(true). (Default: disabled) */
+  static void SetTracing(bool b) noexcept;
+  static bool IsTracing() noexcept { return GetTracing().load(std::memory_order_relaxed); }
+
+  /** Adds a single call of the given stage to the counters of the current thread. */
+  static void Add(Stage stage, Clock::time_point start, Clock::time_point end,
+                  uint64_t bytesIn, uint64_t bytesOut) noexcept;
+
+  /** Records the input queue size chosen by the thread pool for the current thread. */
+  static void AddTileWindow(unsigned tiles) noexcept;
+
+  /**
+   * Records the tail of a file for the current thread: the time between submitting the last tile and
+   * finishing all tiles, and the idle time of the given number of worker threads during the tail.
+   */
+  static void AddTail(uint64_t tailNs, uint64_t idleNs, unsigned threads) noexcept;
+
+  /** Events in the life of a tile, recorded as asynchronous trace events. */
+  enum class TileEvent { QUEUED, STARTED, FINISHED, WRITTEN };
+
+  /** Records the tile event for the tile with the given trace id and index (tracing only). */
+  static void AddTileEvent(TileEvent event, uint64_t traceId, int index) noexcept;
+
+  /** Returns a unique id to identify a tile in trace events. */
+  static uint64_t NextTraceId() noexcept;
+
+  /** Tile processed by the current thread. Stage events are associated with it. (index -1: none) */
+  static void SetCurrentTile(uint64_t traceId, int index) noexcept;
+
+  /**
+   * Name and number of the current thread in the report and trace events, e.g. the worker number
+   * within its thread pool. Threads of equal name and number share their counters, so counters of
+   * a finished thread are continued by its successor. Has no effect while disabled.
+   */
+  static void SetThreadName(const char *name, int id = 0) noexcept;
+
+  /** Clears the counters of all threads and restarts the wall clock. Threads must be idle. */
+  static void Reset() noexcept;
+
+  /** Returns the aggregated report as JSON. Threads must be idle. */
+  static std::string GetReport() noexcept;
+
+  /** Writes the JSON report to the specified file, or to standard output for "-". */
+  static bool WriteReport(const std::string &fileName) noexcept;
+
+  /** Writes recorded trace events as JSON to the specified file. Threads must be idle. */
+  static bool WriteTrace(const std::string &fileName) noexcept;
+
+  /** Returns a short name of the stage. */
+  static const char* GetStageName(Stage stage) noexcept;
+
+private:
+  // Log-linear histogram: 8 sub-buckets for each power of two of the duration in nanoseconds
+  static const int BUCKETS = 8 + 45*8;
+
+  struct Counter
+  {
+    uint64_t  calls;
+    uint64_t  totalNs;
+    uint64_t  maxNs;
+    uint64_t  bytesIn;
+    uint64_t  bytesOut;
+    uint32_t  histogram[BUCKETS];
+  };
+
+  // Input queue sizes chosen by the adaptive thread pool
+  struct WindowCounter
+  {
+    uint64_t  samples;
+    uint64_t  sum;
+    unsigned  min;
+    unsigned  max;
+  };
+
+  // Tails of converted files
+  struct TailCounter
+  {
+    uint64_t  files;
+    uint64_t  tailNs;
+    uint64_t  idleNs;
+    uint64_t  capacityNs;   // tail time multiplied by the number of worker threads
+  };
+
+  // Single trace event. Stage events are complete events, tile events asynchronous events.
+  struct TraceEvent
+  {
+    int64_t   start;      // in ns, relative to the start time
+    int64_t   duration;   // in ns (stage events only)
+    uint64_t  traceId;
+    int       index;      // tile index (-1: none)
+    int       type;       // Stage or TileEvent
+    bool      isStage;
+  };
+
+  // Counters of a single thread, identified by name and id. Blocks are released for reuse by another
+  // thread of the same name and id when the thread ends. They are never freed and form a lock-free list.
+  struct ThreadCounters
+  {
+    int             index;
+    ThreadCounters *next;
+    std::string     name;
+    int             id;
+    std::atomic<bool> used;       // owned by a running thread
+    Counter         stages[(int)Stage::COUNT];
+    WindowCounter   window;
+    TailCounter     tail;
+    std::vector<TraceEvent> events;
+    uint64_t        traceId;      // current tile
+    int             tileIndex;    // current tile (-1: none)
+  };
+
+  // Releases the counters of the owning thread when the thread ends
+  struct ThreadSlot
+  {
+    ThreadCounters *counters;
+    ~ThreadSlot() noexcept { if (counters != nullptr) Release(counters); }
+  };
+
+  static std::atomic<bool>& GetEnabled() noexcept;
+  static std::atomic<bool>& GetTracing() noexcept;
+  static std::atomic<ThreadCounters*>& GetThreads() noexcept;
+  static Clock::time_point& GetStartTime() noexcept;
+  // Returns the counters of the current thread, acquires unnamed counters on first use
+  static ThreadCounters* GetThreadCounters() noexcept;
+  // Returns the thread slot of the current thread
+  static ThreadSlot& GetThreadSlot() noexcept;
+  // Claims released counters of the given name and id, or registers new counters
+  static ThreadCounters* Acquire(const std::string &name, int id) noexcept;
+  static void Release(ThreadCounters *counters) noexcept;
+  // Returns the name of the thread in the report and trace events
+  static std::string GetThreadLabel(const ThreadCounters &counters) noexcept;
+
+  static int GetBucket(uint64_t ns) noexcept;
+  static double GetBucketValue(int bucket) noexcept;
+  // Returns the approximated duration in ns below which the given percentage of calls lies
+  static double GetPercentile(const Counter &counter, double percent) noexcept;
+};
+
+}   // namespace tc
+
+#endif		// _STATS_H_
@@ -21,12 +21,28 @@ THE SOFTWARE.
 */
 #include <cstdio>
 #include <cstring>
+#include <vector>
+#ifndef _WIN32
+#include <csignal>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#else
+#include <io.h>
+#endif
 #include "version.h"
 #include "funcs.h"
 #include "fileio.h"
+#include "ioengine.h"
 #include "options.h"
 #include "compress.h"
 #include "graphics.h"
+#include "library.h"
+#include "stats.h"
+#include "membudget.h"
 #include "tileconv.h"
 
 
@@ -71,7 +87,8 @@ bool TileConv::execute() noexcept
 {
   // checking state
   if (!isInitialized()) return false;
-  if (getOptions().getInputCount() == 0) return false;
+  if (getOptions().isServer()) return serve();
+  if (getOptions().getInputCount() == 0 && getOptions().getJobCount() == 0) return false;
 
   // Special case: show information of input files only
   if (getOptions().isShowInfo()) {
@@ -87,163 +104,309 @@ bool TileConv::execute() noexcept
     std::printf("Options: %s\n", getOptions().getOptionsSummary(true).c_str());
   }
 
-  Graphics gfx(m_options);
+  // batch I/O pays off for multiple input files only
+  if (getOptions().getInputCount() > 1 && getOptions().isBatchIO()) {
+    std::vector<std::string> inputFiles;
+    for (int i = 0; i < getOptions().getInputCount(); i++) {
+      inputFiles.push_back(getOptions().getInput(i));
+    }
+    IOEngine &engine = IOEngine::GetInstance();
+    engine.setReadList(inputFiles);
+    if (getOptions().isVerbose()) {
+      std::printf("I/O engine: %s%s\n", engine.getName(), engine.isBatchMode() ? " (batch mode)" : "");
+    }
+  }
+
+  // stage timings are collected for all input files and jobs
+  const std::string statsFile = getOptions().getStatsFile();
+  const std::string traceFile = getOptions().getTraceFile();
+  startStatistics(statsFile, traceFile);
+
+  Library lib(m_options);
   bool retVal = true;
   for (int i = 0; i < getOptions().getInputCount(); i++) {
     if (!getOptions().isSilent() && getOptions().getInputCount() > 1) {
       std::printf("\nProcessing file %d of %d\n", i+1, getOptions().getInputCount());
     }
-    const std::string &inputFile = getOptions().getInput(i);
-    if (!File::Exists(inputFile)) {
+    if (!convertFile(lib, getOptions().getInput(i))) {
       retVal = false;
-      std::printf("File does not exist: \"%s\"\n", inputFile.c_str());
-      if (getOptions().isHaltOnError()) {
-        return retVal;
-      } else {
-        continue;
-      }
+      if (getOptions().isHaltOnError()) break;
     }
+  }
 
-    FileType fileType = Options::GetFileType(inputFile, getOptions().assumeTis());
-
-    std::string outputFile;
-    // generating output filename
-    if (getOptions().isOutFile()) {
-      outputFile = File::CreateFileName(getOptions().getOutPath(), getOptions().getOutFile());
-    } else {
-      switch (fileType) {
-        case FileType::TIS:
-          outputFile = Options::GetOutputFileName(getOptions().getOutPath(), inputFile, FileType::TBC, false);
-          break;
-        case FileType::MOS:
-          outputFile = Options::GetOutputFileName(getOptions().getOutPath(), inputFile, FileType::MBC, false);
-          break;
-        case FileType::TBC:
-        case FileType::TIZ:
-          outputFile = Options::GetOutputFileName(getOptions().getOutPath(), inputFile, FileType::TIS, false);
-          break;
-        case FileType::MBC:
-        case FileType::MOZ:
-          outputFile = Options::GetOutputFileName(getOptions().getOutPath(), inputFile, FileType::MOS, false);
-          break;
-        default:
-          outputFile.clear();
-          break;
+  // jobs of manifest files share library object and thread pool with the input files above
+  if (getOptions().getJobCount() > 0 && (retVal || !getOptions().isHaltOnError())) {
+    const Options globals(m_options);
+    Options defaults(m_options);
+    defaults.clearInput();
+    defaults.clearJobs();
+    for (int i = 0; i < globals.getJobCount(); i++) {
+      if (!globals.isSilent()) {
+        std::printf("\nProcessing job %d of %d\n", i+1, globals.getJobCount());
+      }
+      if (!executeJob(lib, defaults, globals.getJob(i))) {
+        retVal = false;
+        if (globals.isHaltOnError()) break;
       }
     }
-    if (outputFile.empty()) {
+    m_options = globals;
+  }
+
+  // writing remaining output files of the I/O engine
+  IOEngine *engine = IOEngine::GetBatchInstance();
+  if (engine != nullptr && !engine->flush()) retVal = false;
+
+  showCacheStatistics(lib);
+  showMemoryStatistics();
+  if (!writeStatistics(statsFile, traceFile)) retVal = false;
+  return retVal;
+}
+
+
+bool TileConv::convertFile(Library &lib, const std::string &inputFile) noexcept
+{
+  return (lib.convertFile(inputFile) == Library::Result::OK);
+}
+
+
+bool TileConv::serve() noexcept
+{
+  const std::string source = getOptions().getServer();
+  const bool silent = getOptions().isSilent();
+  const std::string statsFile = getOptions().getStatsFile();
+  const std::string traceFile = getOptions().getTraceFile();
+  startStatistics(statsFile, traceFile);
+
+  // library object and its thread pool are kept alive for all jobs
+  Library lib(m_options);
+  bool quit = false;
+
+  // options of the server command line apply to all jobs, as for manifest files
+  const Options globals(m_options);
+  Options defaults(m_options);
+  defaults.setServer(std::string());
+  defaults.clearInput();
+  defaults.clearJobs();
+
+  if (source == "-") {
+    // standard output is reserved for status lines, messages of the jobs are written to standard error
+    std::FILE *out = DetachStdout();
+    if (out == nullptr) {
+      std::printf("Error redirecting standard output\n");
+      return false;
+    }
+    bool retVal = serveJobs(lib, defaults, stdin, out, quit);
+    std::fclose(out);
+    m_options = globals;
+    showCacheStatistics(lib);
+    showMemoryStatistics();
+    return writeStatistics(statsFile, traceFile) && retVal;
+  }
+
+#ifndef _WIN32
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (source.size() >= sizeof(addr.sun_path)) {
+    std::printf("Socket path too long: \"%s\"\n", source.c_str());
+    return false;
+  }
+  std::strcpy(addr.sun_path, source.c_str());
+
+  // removing stale socket of a previous server instance
+  struct stat st;
+  if (::stat(source.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) ::unlink(source.c_str());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || ::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 4) != 0) {
+    std::printf("Error creating socket \"%s\"\n", source.c_str());
+    if (fd >= 0) ::close(fd);
+    return false;
+  }
+
+  // clients may disconnect without waiting for status lines
+  std::signal(SIGPIPE, SIG_IGN);
+
+  if (!silent) {
+    std::printf("Listening on \"%s\"\n", source.c_str());
+    std::fflush(stdout);
+  }
+  while (!quit) {
+    int client = ::accept(fd, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    std::FILE *in = ::fdopen(client, "r");
+    std::FILE *out = ::fdopen(::dup(client), "w");
+    if (in != nullptr && out != nullptr) {
+      serveJobs(lib, defaults, in, out, quit);
+    }
+    if (out != nullptr) std::fclose(out);
+    if (in != nullptr) std::fclose(in); else ::close(client);
+  }
+  ::close(fd);
+  ::unlink(source.c_str());
+  m_options = globals;
+  showCacheStatistics(lib);
+  showMemoryStatistics();
+  return writeStatistics(statsFile, traceFile);
+#else
+  std::printf("Local sockets are not supported on this platform. Use \"-S -\" instead.\n");
+  return false;
+#endif
+}
+
+
+bool TileConv::serveJobs(Library &lib, const Options &defaults, std::FILE *in, std::FILE *out, bool &quit) noexcept
+{
+  bool retVal = true;
+  unsigned jobIndex = 0;
+  std::string line;
+  while (ReadLine(in, line)) {
+    // skipping empty lines and comments
+    size_t pos = line.find_first_not_of(" \t");
+    if (pos == std::string::npos || line[pos] == '#') continue;
+    if (line.compare(pos, std::string::npos, "quit") == 0) {
+      quit = true;
+      break;
+    }
+
+    jobIndex++;
+    bool success = executeJob(lib, defaults, line);
+    if (!success) retVal = false;
+
+    // status line is written after all messages of the job
+    std::fflush(stdout);
+    std::fprintf(out, "JOB %u %s\n", jobIndex, success ? "OK" : "FAILED");
+    std::fflush(out);
+  }
+  return retVal;
+}
+
+
+std::FILE* TileConv::DetachStdout() noexcept
+{
+  std::fflush(stdout);
+  int fd = ::dup(::fileno(stdout));
+  if (fd < 0) return nullptr;
+  std::FILE *out = ::fdopen(fd, "w");
+  if (out == nullptr || ::dup2(::fileno(stderr), ::fileno(stdout)) < 0) {
+    if (out != nullptr) std::fclose(out); else ::close(fd);
+    return nullptr;
+  }
+  return out;
+}
+
+
+bool TileConv::executeJob(Library &lib, const Options &defaults, const std::string &line) noexcept
+{
+  std::vector<std::string> args = Options::SplitArguments(line);
+  std::vector<char*> argv;
+  argv.push_back(prog_name);
+  for (auto iter = args.begin(); iter != args.end(); ++iter) {
+    argv.push_back(&(*iter)[0]);
+  }
+  argv.push_back(nullptr);
+
+  Options options(defaults);
+  if (!options.init((int)argv.size() - 1, argv.data())) return false;
+  if (options.isServer()) {
+    std::printf("Server mode can not be started by a job\n");
+    return false;
+  } else if (options.getJobCount() > 0) {
+    std::printf("Job manifests can not be nested\n");
+    return false;
+  }
+
+  m_options = options;
+  lib.setOptions(options);
+
+  bool retVal = true;
+  for (int i = 0; i < getOptions().getInputCount(); i++) {
+    if (getOptions().isShowInfo()) {
+      retVal &= showInfo(getOptions().getInput(i));
+    } else if (!convertFile(lib, getOptions().getInput(i))) {
       retVal = false;
-      std::printf("Error creating output filename\n");
-      if (getOptions().isHaltOnError()) {
-        return retVal;
-      }
-    } else if (File::IsEqual(inputFile, outputFile)) {
-      std::printf("Error: Input file and output file are equal: %s\n", inputFile.c_str());
-      if (getOptions().isHaltOnError()) {
-        return retVal;
-      }
+      if (getOptions().isHaltOnError()) break;
     }
+  }
+  return retVal;
+}
 
-    if (!inputFile.empty()) {
-      switch (Options::GetFileType(inputFile, getOptions().assumeTis())) {
-        case FileType::TIS:
-          // converting
-          if (!getOptions().isSilent()) {
-            std::printf("Converting TIS -> TBC\n");
-            std::printf("Input: \"%s\", output: \"%s\"\n", inputFile.c_str(), outputFile.c_str());
-          }
-          if (!gfx.tisToTBC(inputFile, outputFile)) {
-            retVal = false;
-            std::printf("Error while converting \"%s\"\n", inputFile.c_str());
-            if (getOptions().isHaltOnError()) {
-              return retVal;
-            }
-          }
-          break;
-        case FileType::MOS:
-          // converting
-          if (!getOptions().isSilent()) {
-            std::printf("Converting MOS -> MBC\n");
-            std::printf("Input: \"%s\", output: \"%s\"\n", inputFile.c_str(), outputFile.c_str());
-          }
-          if (!gfx.mosToMBC(inputFile, outputFile)) {
-            retVal = false;
-            std::printf("Error while converting \"%s\"\n", inputFile.c_str());
-            if (getOptions().isHaltOnError()) {
-              return retVal;
-            }
-          }
-          break;
-        case FileType::TBC:
-          // converting
-          if (!getOptions().isSilent()) {
-            std::printf("Converting TBC -> TIS\n");
-            std::printf("Input: \"%s\", output: \"%s\"\n", inputFile.c_str(), outputFile.c_str());
-          }
-          if (!gfx.tbcToTIS(inputFile, outputFile)) {
-            retVal = false;
-            std::printf("Error while converting \"%s\"\n", inputFile.c_str());
-            if (getOptions().isHaltOnError()) {
-              return retVal;
-            }
-          }
-          break;
-        case FileType::MBC:
-          // converting
-          if (!getOptions().isSilent()) {
-            std::printf("Converting MBC -> MOS\n");
-            std::printf("Input: \"%s\", output: \"%s\"\n", inputFile.c_str(), outputFile.c_str());
-          }
-          if (!gfx.mbcToMOS(inputFile, outputFile)) {
-            retVal = false;
-            std::printf("Error while converting \"%s\"\n", inputFile.c_str());
-            if (getOptions().isHaltOnError()) {
-              return retVal;
-            }
-          }
-          break;
-        case FileType::TIZ:
-          // converting
-          if (!getOptions().isSilent()) {
-            std::printf("Converting TIZ -> TIS\n");
-            std::printf("Input: \"%s\", output: \"%s\"\n", inputFile.c_str(), outputFile.c_str());
-          }
-          if (!gfx.tizToTIS(inputFile, outputFile)) {
-            retVal = false;
-            std::printf("Error while converting \"%s\"\n", inputFile.c_str());
-            if (getOptions().isHaltOnError()) {
-              return retVal;
-            }
-          }
-          break;
-        case FileType::MOZ:
-          // converting
-          if (!getOptions().isSilent()) {
-            std::printf("Converting MOZ -> MOS\n");
-            std::printf("Input: \"%s\", output: \"%s\"\n", inputFile.c_str(), outputFile.c_str());
-          }
-          if (!gfx.mozToMOS(inputFile, outputFile)) {
-            retVal = false;
-            std::printf("Error while converting \"%s\"\n", inputFile.c_str());
-            if (getOptions().isHaltOnError()) {
-              return retVal;
-            }
-          }
-          break;
-        default:
-          retVal = false;
-          std::printf("Unsupported file type: \"%s\"\n", inputFile.c_str());
-          if (getOptions().isHaltOnError()) {
-            return retVal;
-          }
-          break;
-      }
+
+void TileConv::showCacheStatistics(const Library &lib) const noexcept
+{
+  if (lib.getCache().isEnabled() && !getOptions().isSilent()) {
+    std::printf("\nCache: %s\n", lib.getCache().getStatistics().c_str());
+  }
+}
+
+
+void TileConv::showMemoryStatistics() const noexcept
+{
+  if ((MemoryBudget::IsLimited() || getOptions().isVerbose()) && !getOptions().isSilent()) {
+    std::printf("\nMemory: peak usage %.1f MB", MemoryBudget::GetPeakUsage() / 1048576.0);
+    if (MemoryBudget::IsLimited()) std::printf(" of %.1f MB", MemoryBudget::GetLimit() / 1048576.0);
+    uint64_t rss = MemoryBudget::GetPeakRss();
+    if (rss > 0) std::printf(", peak RSS %.1f MB", rss / 1048576.0);
+    std::printf("\n");
+  }
+}
+
+
+void TileConv::startStatistics(const std::string &statsFile, const std::string &traceFile) const noexcept
+{
+  Stats::SetEnabled(!statsFile.empty() || !traceFile.empty());
+  Stats::SetTracing(!traceFile.empty());
+  Stats::SetThreadName("main");
+  Stats::Reset();
+  MemoryBudget::ResetPeak();
+}
+
+
+bool TileConv::writeStatistics(const std::string &statsFile, const std::string &traceFile) const noexcept
+{
+  bool retVal = true;
+  if (!statsFile.empty()) {
+    if (statsFile != "-" && !getOptions().isSilent()) {
+      std::printf("\nWriting statistics to \"%s\"\n", statsFile.c_str());
+    }
+    if (!Stats::WriteReport(statsFile)) {
+      std::printf("Error writing statistics to \"%s\"\n", statsFile.c_str());
+      retVal = false;
+    }
+  }
+  if (!traceFile.empty()) {
+    if (!getOptions().isSilent()) {
+      std::printf("\nWriting trace to \"%s\"\n", traceFile.c_str());
+    }
+    if (!Stats::WriteTrace(traceFile)) {
+      std::printf("Error writing trace to \"%s\"\n", traceFile.c_str());
+      retVal = false;
     }
   }
   return retVal;
 }
 
 
+bool TileConv::ReadLine(std::FILE *f, std::string &line) noexcept
+{
+  line.clear();
+  char buf[1024];
+  while (std::fgets(buf, sizeof(buf), f) != nullptr) {
+    line.append(buf);
+    if (!line.empty() && line.back() == '\n') break;
+  }
+  if (line.empty()) return false;
+
+  while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+    line.pop_back();
+  }
+  return true;
+}
+
+
 bool TileConv::showInfo(const std::string &fileName) noexcept
 {
   if (!fileName.empty()) {
@@ -356,7 +519,8 @@ bool TileConv::showInfo(const std::string &fileName) noexcept
         // Parsing TBC file
         uint32_t compType, tileNum;
         if (f.read(ver, 1, 4) != 4) return false;
-        if (std::strncmp(ver, Graphics::HEADER_VERSION_V1_0, 4) != 0) {
+        bool isV1_1 = (std::strncmp(ver, Graphics::HEADER_VERSION_V1_1, 4) == 0);
+        if (!isV1_1 && std::strncmp(ver, Graphics::HEADER_VERSION_V1_0, 4) != 0) {
           std::printf("Invalid or unsupported TBC version.\n");
           return false;
         }
@@ -367,14 +531,15 @@ bool TileConv::showInfo(const std::string &fileName) noexcept
 
         // Displaying TBC stats
         std::printf("File type:       TBC\n");
-        std::printf("TBC version:     1.0\n");
+        std::printf("TBC version:     %s\n", isV1_1 ? "1.1" : "1.0");
         std::printf("Compression:     0x%04x - %s\n", compType, Options::GetEncodingName(compType).c_str());
         std::printf("Number of tiles: %d\n", tileNum);
       } else if (std::strncmp(sig, Graphics::HEADER_MBC_SIGNATURE, 4) == 0) {
         // Parsing MBC file
         uint32_t compType, width, height, tileNum;
         if (f.read(ver, 1, 4) != 4) return false;
-        if (std::strncmp(ver, Graphics::HEADER_VERSION_V1_0, 4) != 0) {
+        bool isV1_1 = (std::strncmp(ver, Graphics::HEADER_VERSION_V1_1, 4) == 0);
+        if (!isV1_1 && std::strncmp(ver, Graphics::HEADER_VERSION_V1_0, 4) != 0) {
           std::printf("Invalid or unsupported MBC version.\n");
           return false;
         }
@@ -389,11 +554,37 @@ bool TileConv::showInfo(const std::string &fileName) noexcept
 
         // Displaying TBC stats
         std::printf("File type:       MBC\n");
-        std::printf("MBC version:     1.0\n");
+        std::printf("MBC version:     %s\n", isV1_1 ? "1.1" : "1.0");
         std::printf("Compression:     0x%04x - %s\n", compType, Options::GetEncodingName(compType).c_str());
         std::printf("Width:           %d\n", width);
         std::printf("Height:          %d\n", height);
         std::printf("Number of tiles: %d\n", tileNum);
+      } else if (std::strncmp(sig, Graphics::HEADER_BM32_SIGNATURE, 4) == 0) {
+        // Parsing BM32 file
+        uint32_t fmt, width, height, tileNum;
+        if (f.read(ver, 1, 4) != 4) return false;
+        if (std::strncmp(ver, Graphics::HEADER_VERSION_V1_0, 4) != 0) {
+          std::printf("Invalid or unsupported BM32 version.\n");
+          return false;
+        }
+        if (f.read(&fmt, 4, 1) != 1) return false;
+        fmt = get32u_le(&fmt);
+        if (f.read(&width, 4, 1) != 1) return false;
+        width = get32u_le(&width);
+        if (f.read(&height, 4, 1) != 1) return false;
+        height = get32u_le(&height);
+        if (f.read(&tileNum, 4, 1) != 1) return false;
+        tileNum = get32u_le(&tileNum);
+
+        // Displaying BM32 stats
+        std::printf("File type:       BM32\n");
+        std::printf("BM32 version:    1.0\n");
+        std::printf("Color format:    %d - %s\n", fmt, Options::GetColorFormatName(fmt).c_str());
+        std::printf("Width:           %d\n", width);
+        std::printf("Height:          %d\n", height);
+        if (tileNum > 0) {
+          std::printf("Number of tiles: %d\n", tileNum);
+        }
       } else if (std::strncmp(sig, Graphics::HEADER_TIZ_SIGNATURE, 4) == 0) {
         // Parsing TIZ file
         uint16_t tileNum;
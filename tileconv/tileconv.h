@@ -21,11 +21,16 @@ THE SOFTWARE.
 */
 #ifndef _TILECONV_H_
 #define _TILECONV_H_
+#include <cstdio>
+#include <string>
+#include <vector>
 #include "types.h"
 #include "options.h"
 
 namespace tc {
 
+class Library;
+
 /** High level conversion class. */
 class TileConv
 {
@@ -45,6 +50,38 @@ class TileConv
   const Options& getOptions() const noexcept { return m_options; }
 
 private:
+  // Reads a single line without line break from the specified stream. Returns false on end of stream.
+  static bool ReadLine(std::FILE *f, std::string &line) noexcept;
+
+  // Returns a new stream to the current standard output and redirects standard output to standard error.
+  // Returns nullptr on error.
+  static std::FILE* DetachStdout() noexcept;
+
+private:
+  // Converts a single input file into the output file or path defined by the current options
+  bool convertFile(Library &lib, const std::string &inputFile) noexcept;
+
+  // Reads jobs from the source specified by option -S until the source is closed
+  bool serve() noexcept;
+
+  // Executes each job line from "in" on top of "defaults" and writes a status line per job to "out".
+  // Sets "quit" if the "quit" command has been received. Returns false if a job failed.
+  bool serveJobs(Library &lib, const Options &defaults, std::FILE *in, std::FILE *out, bool &quit) noexcept;
+
+  // Parses and executes a single job line. Options of the job are applied on top of "defaults".
+  bool executeJob(Library &lib, const Options &defaults, const std::string &line) noexcept;
+
+  // Prints statistics of the conversion cache if enabled
+  void showCacheStatistics(const Library &lib) const noexcept;
+
+  // Prints the peak memory usage if a memory budget is set or in verbose mode
+  void showMemoryStatistics() const noexcept;
+
+  // Enables collecting stage timings and trace events for the given output files, resets peak memory usage
+  void startStatistics(const std::string &statsFile, const std::string &traceFile) const noexcept;
+  // Writes the report of stage timings and trace events to the given files if not empty
+  bool writeStatistics(const std::string &statsFile, const std::string &traceFile) const noexcept;
+
   // Display information about the specified filename
   bool showInfo(const std::string &fileName) noexcept;
 
@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2014 Argent77
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+#ifndef _TILECONV_C_H_
+#define _TILECONV_C_H_
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Opaque conversion object. */
+typedef struct tc_library tc_library;
+/** Opaque thread pool that can be shared by several conversion objects. */
+typedef struct tc_thread_pool tc_thread_pool;
+
+/** Result codes of the conversion functions. */
+enum {
+  TC_OK = 0,
+  TC_INVALID_ARGUMENT,
+  TC_UNSUPPORTED_FORMAT,
+  TC_READ_ERROR,
+  TC_WRITE_ERROR,
+  TC_CONVERSION_ERROR,
+  TC_INVALID_DATA,
+  TC_OUT_OF_MEMORY
+};
+
+/**
+ * Receives an output file of tc_convert(). name is the file name without path.
+ * Return nonzero on success and zero on error.
+ */
+typedef int (*tc_sink)(void *context, const char *name, const unsigned char *data, size_t size);
+
+/** Creates a conversion object with default options. Messages are captured. Returns NULL on error. */
+tc_library* tc_create(void);
+void tc_destroy(tc_library *lib);
+
+/** Sets conversion options from a command line string, e.g. "-s -t 2". Returns a result code. */
+int tc_set_options(tc_library *lib, const char *args);
+
+/** Converts the file inFile on disk into the output file or path defined by the options. */
+int tc_convert_file(tc_library *lib, const char *inFile);
+
+/**
+ * Converts the memory buffer data. name is the file name of the input data, which determines
+ * input file type and names of output files. Output files are passed to sink.
+ */
+int tc_convert(tc_library *lib, const void *data, size_t size, const char *name,
+               tc_sink sink, void *context);
+
+/** Returns the messages of the last conversion. Valid until the next call for lib. */
+const char* tc_get_messages(const tc_library *lib);
+
+/** Returns a short description of the specified result code. */
+const char* tc_get_result_name(int result);
+
+/** Creates a thread pool with the specified number of threads (0: autodetect). */
+tc_thread_pool* tc_create_thread_pool(int threads);
+void tc_destroy_thread_pool(tc_thread_pool *pool);
+
+/** Uses the specified thread pool for conversions of lib (NULL: internal pool). */
+void tc_set_thread_pool(tc_library *lib, tc_thread_pool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif		// _TILECONV_C_H_
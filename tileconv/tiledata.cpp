@@ -24,6 +24,7 @@ THE SOFTWARE.
 #include "funcs.h"
 #include "converterfactory.h"
 #include "compress.h"
+#include "colors.h"
 #include "tiledata.h"
 
 namespace tc {
@@ -31,6 +32,8 @@ namespace tc {
 const unsigned TileData::PALETTE_SIZE      = 1024;
 const unsigned TileData::MAX_TILE_SIZE_8   = 64*64;
 const unsigned TileData::MAX_TILE_SIZE_32  = 64*64*4;
+const double   TileData::AUTO_ERROR_WEIGHT = 3.0;   // accepted RAW size overhead in percent per unit of BCn error
+const uint32_t TileData::UNKNOWN_COST      = 0xffffffff;
 
 
 TileData::TileData(const Options &options) noexcept
@@ -40,12 +43,25 @@ TileData::TileData(const Options &options) noexcept
 , m_ptrPalette(nullptr)
 , m_ptrIndexed(nullptr)
 , m_ptrDeflated(nullptr)
+, m_ptrPixels(nullptr)
+, m_ptrSource(nullptr)
+, m_sourceType(0)
+, m_pvrzRegions()
+, m_colorFormat(Converter::ColorFormat::ARGB)
 , m_index(-1)
 , m_width(0)
 , m_height(0)
 , m_type(0)
+, m_tileType(0)
 , m_size(0)
 , m_errorMsg()
+, m_queueTime()
+, m_traceId(0)
+, m_logTarget(Logger::GetTarget())
+, m_processStart()
+, m_processEnd()
+, m_cost(UNKNOWN_COST)
+, m_memory()
 {
 }
 
@@ -55,6 +71,52 @@ TileData::~TileData() noexcept
 }
 
 
+uint64_t TileData::getMemorySize() const noexcept
+{
+  uint64_t size = sizeof(TileData);
+  if (m_ptrPalette != nullptr) size += PALETTE_SIZE;
+  if (m_ptrIndexed != nullptr) size += MAX_TILE_SIZE_8;
+  if (m_ptrPixels != nullptr) size += MAX_TILE_SIZE_32;
+  if (m_ptrSource != nullptr) size += MAX_TILE_SIZE_32;
+  if (m_ptrDeflated != nullptr) size += isEncoding() ? MAX_TILE_SIZE_32*2 : std::max(0, getSize());
+  return size;
+}
+
+
+uint64_t TileData::getProcessTime() const noexcept
+{
+  return (uint64_t)std::max((Stats::Clock::rep)0,
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(m_processEnd - m_processStart).count());
+}
+
+
+void TileData::estimateCost() noexcept
+{
+  m_cost = UNKNOWN_COST;
+  uint32_t size = std::max(0, getWidth()) * std::max(0, getHeight());
+  if (!isEncoding()) {
+    // detailed tiles compress worse and take longer to decode and to quantize
+    if (getDeflatedData() != nullptr && getSize() > 0) m_cost = getSize();
+  } else if (getIndexedData() != nullptr && getPaletteData() != nullptr && size > 0) {
+    // the number of colors determines the effort of the cluster fit
+    bool used[256] = {};
+    const uint8_t *src = getIndexedData().get();
+    m_cost = 0;
+    for (uint32_t i = 0; i < size; i++) {
+      if (!used[src[i]]) { used[src[i]] = true; m_cost++; }
+    }
+  } else if (getPixelData() != nullptr && size > 0) {
+    // counting up to 256 colors of every 4th pixel
+    ColorTable colors;
+    const uint32_t *src = (const uint32_t*)getPixelData().get();
+    for (uint32_t i = 0; i < size; i += 4) {
+      if (colors.add(src[i]) < 0) break;
+    }
+    m_cost = colors.size();
+  }
+}
+
+
 TileData& TileData::operator()() noexcept
 {
   if (isEncoding()) {
@@ -99,11 +161,12 @@ void TileData::setSize(int size) noexcept
 bool TileData::isValid() const noexcept
 {
   if (isEncoding()) {
-    return (m_ptrPalette != nullptr && m_ptrIndexed != nullptr && m_ptrDeflated != nullptr &&
-            m_index >= 0 && m_width > 0 && m_height > 0);
+    return (((m_ptrPalette != nullptr && m_ptrIndexed != nullptr) || m_ptrPixels != nullptr ||
+             m_ptrSource != nullptr || !m_pvrzRegions.empty()) &&
+            m_ptrDeflated != nullptr && m_index >= 0 && m_width > 0 && m_height > 0);
   } else {
-    return (m_ptrPalette != nullptr && m_ptrIndexed != nullptr && m_ptrDeflated != nullptr &&
-            m_index >= 0 && m_size > 0);
+    return (((m_ptrPalette != nullptr && m_ptrIndexed != nullptr) || m_ptrPixels != nullptr) &&
+            m_ptrDeflated != nullptr && m_index >= 0 && m_size > 0);
   }
 }
 
@@ -111,61 +174,287 @@ bool TileData::isValid() const noexcept
 void TileData::encode() noexcept
 {
   if (isValid()) {
-    ConverterPtr converter =
-        ConverterFactory::GetConverter(getOptions(),
-                                       Options::GetEncodingCode(getOptions().getEncoding(),
-                                                                getOptions().isDeflate()));
+    setSize(0);
+    if (!m_pvrzRegions.empty() && !extractPvrzTile()) return;
+    if (m_ptrSource != nullptr && !decodeSource()) return;
+    if (Options::GetEncodingType(getType()) == Encoding::AUTO) {
+      encodeAuto();
+    } else {
+      m_tileType = getType();
+      setSize(encodeType(getType(), getDeflatedData().get(), nullptr));
+    }
+  } else {
+    setError(true);
+    setErrorMsg("Invalid tile data found\n");
+  }
+}
 
-    if (converter != nullptr) {
-      converter->setEncoding(true);
-      converter->setColorFormat(Converter::ColorFormat::ARGB);
 
-      unsigned tileSizeEncoded = converter->getRequiredSpace(getWidth(), getHeight()) + HEADER_TILE_ENCODED_SIZE;
-      if (tileSizeEncoded <= HEADER_TILE_ENCODED_SIZE) {
-        setError(true);
-        setErrorMsg("Error while calculating space\n");
-        return;
+void TileData::encodeAuto() noexcept
+{
+  // opaque tiles don't need BC3, tiles with transparency can't use BC1 without loss
+  bool deflate = Options::IsTileDeflated(getType());
+  Colors colors(getOptions());
+  bool hasAlpha;
+  if (getPixelData() != nullptr) {
+    hasAlpha = colors.hasTransparency(getPixelData().get(), getWidth()*getHeight());
+  } else {
+    hasAlpha = colors.hasTransparency(getIndexedData().get(), getPaletteData().get(),
+                                      getWidth()*getHeight());
+  }
+  unsigned typeRaw = Options::GetEncodingCode(Encoding::RAW, deflate);
+  unsigned typeBC = Options::GetEncodingCode(hasAlpha ? Encoding::BC3 : Encoding::BC1, deflate);
+  if (m_ptrSource != nullptr && (m_sourceType == ENCODE_DXT1 || m_sourceType == ENCODE_DXT5)) {
+    // source blocks are passed through without loss
+    typeBC = Options::GetEncodingCode(Options::GetEncodingType(m_sourceType), deflate);
+  }
+
+  // tile data is stored behind the tile type byte
+  uint8_t *dst = getDeflatedData().get();
+  int sizeRaw = encodeType(typeRaw, dst + HEADER_TILE_TYPE_SIZE, nullptr);
+  if (sizeRaw == 0) return;
+
+  BytePtr ptrBC(new uint8_t[MAX_TILE_SIZE_32*2], std::default_delete<uint8_t[]>());
+  double error = 0.0;
+  int sizeBC = encodeType(typeBC, ptrBC.get(), &error);
+  if (sizeBC == 0) return;
+
+  // RAW is lossless: accept a size overhead that grows with the error of the BCn encoded tile
+  int size;
+  if ((double)sizeRaw*100.0 <= (double)sizeBC*(100.0 + error*AUTO_ERROR_WEIGHT)) {
+    m_tileType = typeRaw;
+    size = sizeRaw;
+  } else {
+    m_tileType = typeBC;
+    size = sizeBC;
+    std::memcpy(dst + HEADER_TILE_TYPE_SIZE, ptrBC.get(), size);
+  }
+  dst[0] = (uint8_t)(m_tileType & 0xff);
+  setSize(size + HEADER_TILE_TYPE_SIZE);
+}
+
+
+bool TileData::copyPvrzBlocks() noexcept
+{
+  static const int MAX_COLS = TILE_DIMENSION / 4;
+
+  if (m_pvrzRegions.front().page == nullptr) return false;
+  unsigned type = m_pvrzRegions.front().page->getType();
+  int blockSize = (type == ENCODE_DXT1) ? 8 : 16;
+  int cols = (getWidth() + 3) >> 2;
+  int rows = (getHeight() + 3) >> 2;
+  bool covered[MAX_COLS*MAX_COLS] = {};
+  BytePtr ptrBlocks(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+  uint8_t *dst = ptrBlocks.get() + HEADER_TILE_ENCODED_SIZE;
+  uint8_t rowBlocks[MAX_COLS*16];
+
+  for (auto iter = m_pvrzRegions.cbegin(); iter != m_pvrzRegions.cend(); ++iter) {
+    if (iter->page == nullptr || iter->page->getType() != type) return false;
+
+    // clipped region must start at block boundaries and end at block boundaries or tile edges
+    int x0 = std::max(0, iter->dstX), y0 = std::max(0, iter->dstY);
+    int x1 = std::min(getWidth(), iter->dstX + iter->width);
+    int y1 = std::min(getHeight(), iter->dstY + iter->height);
+    if (x0 >= x1 || y0 >= y1) continue;
+    int srcX = iter->srcX + x0 - iter->dstX, srcY = iter->srcY + y0 - iter->dstY;
+    if (((x0 | y0 | srcX | srcY) & 3) != 0 ||
+        ((x1 & 3) != 0 && x1 != getWidth()) || ((y1 & 3) != 0 && y1 != getHeight())) {
+      return false;
+    }
+
+    int numCols = (x1 - x0 + 3) >> 2;
+    for (int y = y0; y < y1; y += 4) {
+      if (!iter->page->getBlocks(rowBlocks, x1 - x0, 4, srcX, srcY + y - y0)) return false;
+      std::memcpy(dst + ((y >> 2)*cols + (x0 >> 2))*blockSize, rowBlocks, numCols*blockSize);
+      std::fill(covered + (y >> 2)*MAX_COLS + (x0 >> 2), covered + (y >> 2)*MAX_COLS + (x0 >> 2) + numCols, true);
+    }
+  }
+
+  // uncovered pixels are opaque black and have to be composited
+  for (int row = 0; row < rows; row++) {
+    if (std::find(covered + row*MAX_COLS, covered + row*MAX_COLS + cols, false) != covered + row*MAX_COLS + cols) {
+      return false;
+    }
+  }
+
+  uint16_t v16;
+  v16 = (uint16_t)getWidth(); *(uint16_t*)ptrBlocks.get() = get16u_le(&v16);
+  v16 = (uint16_t)getHeight(); *(uint16_t*)(ptrBlocks.get()+2) = get16u_le(&v16);
+  setSourceData(ptrBlocks, type);
+  return true;
+}
+
+
+bool TileData::extractPvrzTile() noexcept
+{
+  // tiles composed of whole blocks are passed through as encoded data
+  if (copyPvrzBlocks()) return true;
+
+  // compositing tile from individual blocks of all regions
+  BytePtr ptrPixels(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+  uint32_t *pixels = (uint32_t*)ptrPixels.get();
+  uint32_t black = 0xff000000; black = get32u_le(&black);
+  std::fill(pixels, pixels + getWidth()*getHeight(), black);
+  uint8_t block[HEADER_TILE_ENCODED_SIZE + 16];
+  uint32_t decoded[16];
+  uint16_t v16 = 4;
+  *(uint16_t*)block = get16u_le(&v16);
+  *(uint16_t*)(block+2) = get16u_le(&v16);
+  for (auto iter = m_pvrzRegions.cbegin(); iter != m_pvrzRegions.cend(); ++iter) {
+    ConverterPtr converter = (iter->page != nullptr) ? ConverterFactory::GetConverter(getOptions(), iter->page->getType()) : nullptr;
+    if (converter == nullptr) {
+      setError(true);
+      setErrorMsg("Invalid PVRZ tile region found\n");
+      return false;
+    }
+    converter->setEncoding(false);
+    converter->setColorFormat(Converter::ColorFormat::ARGB);
+
+    // clipping region to tile dimensions
+    int x0 = std::max(0, iter->dstX), y0 = std::max(0, iter->dstY);
+    int x1 = std::min(getWidth(), iter->dstX + iter->width);
+    int y1 = std::min(getHeight(), iter->dstY + iter->height);
+    int ofsX = iter->srcX - iter->dstX, ofsY = iter->srcY - iter->dstY;
+    for (int by = (y0 + ofsY) & ~3; by < y1 + ofsY; by += 4) {
+      for (int bx = (x0 + ofsX) & ~3; bx < x1 + ofsX; bx += 4) {
+        if (!iter->page->getBlocks(block + HEADER_TILE_ENCODED_SIZE, 4, 4, bx, by) ||
+            converter->decodePixels(block, (uint8_t*)decoded) == 0) {
+          setError(true);
+          setErrorMsg("Error while decoding PVRZ tile data\n");
+          return false;
+        }
+        for (int y = std::max(by, y0 + ofsY); y < std::min(by + 4, y1 + ofsY); y++) {
+          for (int x = std::max(bx, x0 + ofsX); x < std::min(bx + 4, x1 + ofsX); x++) {
+            pixels[(y - ofsY)*getWidth() + (x - ofsX)] = decoded[(y - by)*4 + (x - bx)];
+          }
+        }
       }
-      BytePtr  ptrEncoded(new uint8_t[tileSizeEncoded], std::default_delete<uint8_t[]>());
-      setSize(0);
+    }
+  }
+  setPixelData(ptrPixels);
+  setColorFormat(Converter::ColorFormat::ARGB);
+  return true;
+}
+
+
+bool TileData::decodeSource() noexcept
+{
+  // source data is passed through if possible
+  if ((getType() & 0xff) == m_sourceType) return true;
+
+  ConverterPtr converter = ConverterFactory::GetConverter(getOptions(), m_sourceType);
+  if (converter != nullptr && converter->canDecode()) {
+    converter->setEncoding(false);
+    converter->setColorFormat(Converter::ColorFormat::ARGB);
+    int size;
+    if (Options::GetEncodingType(getType()) == Encoding::RAW) {
+      // paletted target: using the palette provided by the source decoder
+      BytePtr ptrPalette(new uint8_t[PALETTE_SIZE], std::default_delete<uint8_t[]>());
+      BytePtr ptrIndexed(new uint8_t[MAX_TILE_SIZE_8], std::default_delete<uint8_t[]>());
+      size = converter->convert(ptrPalette.get(), ptrIndexed.get(), m_ptrSource.get());
+      setPaletteData(ptrPalette);
+      setIndexedData(ptrIndexed);
+      setPixelData(nullptr);
+    } else {
+      BytePtr ptrPixels(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
+      size = converter->decodePixels(m_ptrSource.get(), ptrPixels.get());
+      setPixelData(ptrPixels);
+      setColorFormat(Converter::ColorFormat::ARGB);
+    }
+    if (size > 0) {
+      setWidth(converter->getWidth());
+      setHeight(converter->getHeight());
+      return true;
+    }
+  }
+  setError(true);
+  setErrorMsg("Error while decoding source tile data\n");
+  return false;
+}
+
+
+int TileData::encodeType(unsigned type, uint8_t *dst, double *error) noexcept
+{
+  ConverterPtr converter = ConverterFactory::GetConverter(getOptions(), type);
+
+  if (converter != nullptr) {
+    converter->setEncoding(true);
+    converter->setColorFormat(Converter::ColorFormat::ARGB);
+    converter->setMeasureError(error != nullptr);
 
-      if (!converter->convert(getPaletteData().get(), getIndexedData().get(), ptrEncoded.get(),
-                              getWidth(), getHeight())) {
+    unsigned tileSizeEncoded = converter->getRequiredSpace(getWidth(), getHeight()) + HEADER_TILE_ENCODED_SIZE;
+    if (tileSizeEncoded <= HEADER_TILE_ENCODED_SIZE) {
+      setError(true);
+      setErrorMsg("Error while calculating space\n");
+      return 0;
+    }
+    BytePtr  ptrEncoded(new uint8_t[tileSizeEncoded], std::default_delete<uint8_t[]>());
+
+    if (m_ptrSource != nullptr && (type & 0xff) == m_sourceType) {
+      // passing through encoded source data
+      std::memcpy(ptrEncoded.get(), m_ptrSource.get(), tileSizeEncoded);
+      if (error != nullptr) *error = 0.0;
+    } else {
+      int size;
+      if (getPixelData() != nullptr) {
+        converter->setColorFormat(getColorFormat());
+        size = converter->encodePixels(getPixelData().get(), ptrEncoded.get(), getWidth(), getHeight());
+      } else {
+        size = converter->convert(getPaletteData().get(), getIndexedData().get(), ptrEncoded.get(),
+                                  getWidth(), getHeight());
+      }
+      if (size == 0) {
         setError(true);
         setErrorMsg("Error while encoding tile data\n");
-        return;
+        return 0;
       }
+      if (error != nullptr) *error = converter->getEncodingError();
+    }
 
-      if (getOptions().isDeflate()) {
-        // applying zlib compression
-        Compression compression;
-        setSize(compression.deflate(ptrEncoded.get(), tileSizeEncoded,
-                                    getDeflatedData().get(), tileSizeEncoded*2));
-        if (getSize() == 0) {
-          setError(true);
-          setErrorMsg("Error while compressing tile data\n");
-          return;
-        }
-      } else {
-        // using pixel encoding only
-        setSize(tileSizeEncoded);
-        std::memcpy(getDeflatedData().get(), ptrEncoded.get(), getSize());
+    if (Options::IsTileDeflated(type)) {
+      // applying zlib compression
+      Compression compression;
+      int size = compression.deflate(ptrEncoded.get(), tileSizeEncoded, dst, tileSizeEncoded*2);
+      if (size == 0) {
+        setError(true);
+        setErrorMsg("Error while compressing tile data\n");
       }
+      return size;
     } else {
-      setError(true);
-      setErrorMsg("Unsupported source format found\n");
+      // using pixel encoding only
+      std::memcpy(dst, ptrEncoded.get(), tileSizeEncoded);
+      return tileSizeEncoded;
     }
   } else {
     setError(true);
-    setErrorMsg("Invalid tile data found\n");
+    setErrorMsg("Unsupported source format found\n");
   }
+  return 0;
 }
 
 
 void TileData::decode() noexcept
 {
   if (isValid()) {
-    ConverterPtr converter = ConverterFactory::GetConverter(getOptions(), getType());
+    unsigned type = getType();
+    uint8_t *src = getDeflatedData().get();
+    int srcSize = getSize();
+    if (Options::GetEncodingType(type) == Encoding::AUTO) {
+      // pixel encoding is stored per tile
+      Encoding tileEncoding = (srcSize > (int)HEADER_TILE_TYPE_SIZE) ? Options::GetEncodingType(src[0]) : Encoding::UNKNOWN;
+      if (tileEncoding != Encoding::RAW && tileEncoding != Encoding::BC1 &&
+          tileEncoding != Encoding::BC2 && tileEncoding != Encoding::BC3) {
+        setError(true);
+        setErrorMsg("Invalid tile encoding type found\n");
+        return;
+      }
+      type = Options::GetEncodingCode(tileEncoding, Options::IsTileDeflated(type));
+      src += HEADER_TILE_TYPE_SIZE;
+      srcSize -= HEADER_TILE_TYPE_SIZE;
+    }
+    m_tileType = type;
+
+    ConverterPtr converter = ConverterFactory::GetConverter(getOptions(), type);
 
     if (converter != nullptr) {
       converter->setEncoding(false);
@@ -173,17 +462,23 @@ void TileData::decode() noexcept
 
       BytePtr  ptrEncoded(new uint8_t[MAX_TILE_SIZE_32], std::default_delete<uint8_t[]>());
 
-      if (Options::IsTileDeflated(getType())) {
+      if (Options::IsTileDeflated(type)) {
         // inflating zlib compressed data
         Compression compression;
-        compression.inflate(getDeflatedData().get(), getSize(), ptrEncoded.get(), MAX_TILE_SIZE_32);
+        compression.inflate(src, srcSize, ptrEncoded.get(), MAX_TILE_SIZE_32);
       } else {
         // copy pixel encoded tile data
-        std::memcpy(ptrEncoded.get(), getDeflatedData().get(), getSize());
+        std::memcpy(ptrEncoded.get(), src, std::min(srcSize, (int)MAX_TILE_SIZE_32));
       }
 
-      setSize(converter->convert(getPaletteData().get(), getIndexedData().get(),
-                                 ptrEncoded.get()));
+      if (getPixelData() != nullptr) {
+        // decoding into 32-bit pixels without color reduction
+        converter->setColorFormat(getColorFormat());
+        setSize(converter->decodePixels(ptrEncoded.get(), getPixelData().get()));
+      } else {
+        setSize(converter->convert(getPaletteData().get(), getIndexedData().get(),
+                                   ptrEncoded.get()));
+      }
       if (getSize() == 0) {
         setError(true);
         setErrorMsg("Error while decoding tile data\n");
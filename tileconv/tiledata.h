@@ -22,8 +22,14 @@ THE SOFTWARE.
 #ifndef _TILEDATA_H_
 #define _TILEDATA_H_
 #include <string>
+#include <vector>
 #include "types.h"
 #include "options.h"
+#include "converter.h"
+#include "logger.h"
+#include "pvrz.h"
+#include "stats.h"
+#include "membudget.h"
 
 namespace tc {
 
@@ -51,6 +57,9 @@ class TileData
   void setType(unsigned type) noexcept;
   unsigned getType() const noexcept { return m_type; }
 
+  /** Pixel encoding type selected for this tile. Differs from getType() only for Encoding::AUTO. (encoding: out) */
+  unsigned getTileType() const noexcept { return m_tileType; }
+
   /** Storage for palette (encoding: in, decoding: out). */
   void setPaletteData(BytePtr palette) noexcept { m_ptrPalette = palette; }
   BytePtr getPaletteData() const noexcept { return m_ptrPalette; }
@@ -59,6 +68,33 @@ class TileData
   void setIndexedData(BytePtr indexed) noexcept { m_ptrIndexed = indexed; }
   BytePtr getIndexedData() const noexcept { return m_ptrIndexed; }
 
+  /**
+   * Storage for 32-bit pixel data (encoding: in, decoding: out). If set, tiles are encoded from or
+   * decoded into pixels of the current color format instead of palette and indexed data.
+   */
+  void setPixelData(BytePtr pixels) noexcept { m_ptrPixels = pixels; }
+  BytePtr getPixelData() const noexcept { return m_ptrPixels; }
+
+  /** Color format of 32-bit pixel data. (Default: ARGB) */
+  void setColorFormat(Converter::ColorFormat fmt) noexcept { m_colorFormat = fmt; }
+  Converter::ColorFormat getColorFormat() const noexcept { return m_colorFormat; }
+
+  /**
+   * Encoded tile data of the given pixel encoding type as encoding source (encoding: in). Data is
+   * passed through if the type matches the requested pixel encoding, and decoded otherwise.
+   */
+  void setSourceData(BytePtr data, unsigned type) noexcept { m_ptrSource = data; m_sourceType = type & 0xff; }
+  BytePtr getSourceData() const noexcept { return m_ptrSource; }
+  unsigned getSourceType() const noexcept { return m_sourceType; }
+
+  /**
+   * Adds a PVRZ page region as pixel source of the tile (encoding: in). Pixels not covered by any
+   * region are opaque black. If a single block-aligned region covers the whole tile, its encoded
+   * blocks are used as source data (see setSourceData()).
+   */
+  void addPvrzRegion(const PvrzRegion &region) noexcept { m_pvrzRegions.push_back(region); }
+  const std::vector<PvrzRegion>& getPvrzRegions() const noexcept { return m_pvrzRegions; }
+
   /** Storage for compressed tile data (encoding: out, decoding: in). */
   void setDeflatedData(BytePtr deflated) noexcept { m_ptrDeflated = deflated; }
   BytePtr getDeflatedData() const noexcept { return m_ptrDeflated; }
@@ -71,10 +107,44 @@ class TileData
   void setHeight(int height) noexcept;
   int getHeight() const noexcept { return m_height; }
 
-  /** Data size (encoding: deflated size, decoding input: deflated size, decoding output: sizeof palette+indexed, error: 0). */
+  /** Data size (encoding: deflated size, decoding input: deflated size, decoding output: sizeof palette+indexed or pixels, error: 0). */
   void setSize(int size) noexcept;
   int getSize() const noexcept { return m_size; }
 
+  /** Time the tile has been added to the thread pool queue. (Only set if statistics are enabled.) */
+  void setQueueTime(Stats::Clock::time_point t) noexcept { m_queueTime = t; }
+  Stats::Clock::time_point getQueueTime() const noexcept { return m_queueTime; }
+
+  /** Start and end of processing the tile by a worker thread. */
+  void setProcessTime(Stats::Clock::time_point start, Stats::Clock::time_point end) noexcept
+  { m_processStart = start; m_processEnd = end; }
+  Stats::Clock::time_point getProcessStart() const noexcept { return m_processStart; }
+  Stats::Clock::time_point getProcessEnd() const noexcept { return m_processEnd; }
+  /** Time spent by a worker thread to process the tile (in ns). */
+  uint64_t getProcessTime() const noexcept;
+
+  /**
+   * Estimated relative cost of processing the tile. Only comparable between tiles of the same file.
+   * (Default: UNKNOWN_COST)
+   */
+  uint32_t getCost() const noexcept { return m_cost; }
+  /** Estimates the cost from unique colors (encoding) or the compressed size (decoding). */
+  void estimateCost() noexcept;
+  /** Cost of tiles which can't be estimated. Such tiles are treated as most expensive. */
+  static const uint32_t UNKNOWN_COST;
+
+  /** Identifies the tile in trace events. (Only set if tracing is enabled.) */
+  void setTraceId(uint64_t id) noexcept { m_traceId = id; }
+  uint64_t getTraceId() const noexcept { return m_traceId; }
+
+  /** Message handler of the thread which created the tile. Used while processing the tile. */
+  const Logger::Target& getLogTarget() const noexcept { return m_logTarget; }
+
+  /** Returns the estimated number of bytes held by the data buffers of the tile. */
+  uint64_t getMemorySize() const noexcept;
+  /** Accounts getMemorySize() in the memory budget until the tile data is released. */
+  void reserveMemory() noexcept { m_memory.reset(getMemorySize()); }
+
   /** Return information on error. */
   bool isError() const noexcept { return m_error; }
   const std::string& getErrorMsg() const noexcept { return m_errorMsg; }
@@ -91,10 +161,27 @@ class TileData
   void encode() noexcept;
   void decode() noexcept;
 
+  // Prepares source data or pixels from the PVRZ regions of the tile
+  bool extractPvrzTile() noexcept;
+
+  // Copies encoded blocks of the PVRZ regions into source data. Returns false if the regions don't
+  // cover the tile with whole blocks of a single pixel encoding type.
+  bool copyPvrzBlocks() noexcept;
+
+  // Decodes source data into pixels or palette and indexed data if it can't be passed through
+  bool decodeSource() noexcept;
+
+  // Selects the best pixel encoding for the current tile (Encoding::AUTO only)
+  void encodeAuto() noexcept;
+
+  // Encodes the current tile with the given type into dst. Returns size of data in dst or 0 on error.
+  int encodeType(unsigned type, uint8_t *dst, double *error) noexcept;
+
 private:
   static const unsigned PALETTE_SIZE;
   static const unsigned MAX_TILE_SIZE_8;
   static const unsigned MAX_TILE_SIZE_32;
+  static const double   AUTO_ERROR_WEIGHT;
 
   const Options& m_options;   // read-only reference to options instance
   bool        m_encoding;
@@ -102,12 +189,25 @@ class TileData
   BytePtr     m_ptrPalette;   // storage for palette (encoding: in, decoding: out)
   BytePtr     m_ptrIndexed;   // storage for indexed tile (encoding: in, decoding out)
   BytePtr     m_ptrDeflated;  // storage for compressed tile (encoding: out, decoding: in)
+  BytePtr     m_ptrPixels;    // storage for 32-bit pixels (encoding: in, decoding: out, optional)
+  BytePtr     m_ptrSource;    // encoded source tile (encoding: in, optional)
+  unsigned    m_sourceType;   // pixel encoding type of m_ptrSource
+  std::vector<PvrzRegion> m_pvrzRegions;  // PVRZ page regions (encoding: in, optional)
+  Converter::ColorFormat m_colorFormat; // color format of 32-bit pixels
   int         m_index;        // the tile index/serial number (starting at 0)
   int         m_width;        // width of the tile (encoding: in, decoding: out)
   int         m_height;       // height of the tile (encoding: in, decoding: out)
   int         m_type;         // encoding type (needed for decoding)
+  int         m_tileType;     // pixel encoding type selected for the tile (encoding: out)
   int         m_size;         // data size (encoding: deflated size, decoding input: deflated size, decoding output: size of palette+indexed tile, error: 0)
   std::string m_errorMsg;     // contains a descriptive message if an error occurred
+  Stats::Clock::time_point m_queueTime; // time of adding the tile to the thread pool queue
+  uint64_t    m_traceId;      // unique id of the tile in trace events
+  Logger::Target m_logTarget; // message handler of the creating thread
+  Stats::Clock::time_point m_processStart; // start of processing by a worker thread
+  Stats::Clock::time_point m_processEnd;   // end of processing by a worker thread
+  uint32_t    m_cost;         // estimated relative processing cost
+  MemoryBudget::Reservation m_memory; // accounted size of the tile data buffers
 };
 
 typedef std::shared_ptr<TileData> TileDataPtr;
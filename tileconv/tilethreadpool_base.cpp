@@ -20,19 +20,44 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #include <algorithm>
+#include <cmath>
+#include "affinity.h"
 #include "tilethreadpool_base.h"
 
 namespace tc {
 
 const unsigned TileThreadPool::MAX_THREADS  = 256u;
 const unsigned TileThreadPool::MAX_TILES    = std::numeric_limits<int>::max();
+const unsigned TileThreadPool::MIN_ADAPTIVE_TILES             = 4u;
+const unsigned TileThreadPool::MAX_ADAPTIVE_TILES_PER_THREAD  = 16u;
 
 
-TileThreadPool::TileThreadPool(unsigned tileNum) noexcept
+TileThreadPool::TileThreadPool(unsigned threadNum, unsigned tileNum) noexcept
 : m_terminate(false)
+, m_adaptive(false)
+, m_costOrdered(false)
+, m_threadCount(std::max(1u, std::min(MAX_THREADS, threadNum)))
+, m_workerIds(0)
 , m_maxTiles(MAX_TILES)
+, m_cpus()
 , m_tiles()
+, m_jobs()
 , m_results()
+, m_pending()
+, m_tileSum(0.0)
+, m_samples(0)
+, m_stalls(0)
+, m_minTilesUsed(0)
+, m_maxTilesUsed(0)
+, m_resultSamples(0)
+, m_latency(0.0)
+, m_backlog(0.0)
+, m_drainCost(0.0)
+, m_draining(false)
+, m_lastResult()
+, m_lastAdded()
+, m_tailEnd()
+, m_tailBusy(0)
 {
   setMaxTiles(tileNum);
 }
@@ -40,7 +65,295 @@ TileThreadPool::TileThreadPool(unsigned tileNum) noexcept
 
 void TileThreadPool::setMaxTiles(unsigned maxTiles) noexcept
 {
+  m_adaptive = false;
   m_maxTiles = std::max(1u, std::min(MAX_TILES, maxTiles));
+  m_minTilesUsed = m_maxTilesUsed = m_maxTiles;
+}
+
+
+void TileThreadPool::setAdaptiveTiles() noexcept
+{
+  m_adaptive = true;
+  m_resultSamples = 0;
+  m_latency = m_backlog = m_drainCost = 0.0;
+  m_draining = false;
+  // enough to keep all threads busy until the first results have been measured
+  m_maxTiles = std::max(MIN_ADAPTIVE_TILES, 2*m_threadCount);
+  m_minTilesUsed = m_maxTilesUsed = m_maxTiles;
+}
+
+
+bool TileThreadPool::setThreadAffinity(const std::vector<int> &cpus) noexcept
+{
+  if (cpus == m_cpus) return true;
+  m_cpus = cpus;
+  return pinThreads();
+}
+
+
+std::vector<int> TileThreadPool::getThreadCpus(unsigned thread) const noexcept
+{
+  return m_cpus.empty() ? Affinity::GetCpus() : std::vector<int>(1, m_cpus[thread % m_cpus.size()]);
+}
+
+
+double TileThreadPool::getAverageTiles() const noexcept
+{
+  return (m_samples > 0) ? m_tileSum / (double)m_samples : 0.0;
+}
+
+
+void TileThreadPool::resetStatistics() noexcept
+{
+  m_tileSum = 0.0;
+  m_samples = 0;
+  m_stalls = 0;
+  m_minTilesUsed = m_maxTilesUsed = m_maxTiles;
+  m_lastAdded = m_tailEnd = Stats::Clock::time_point();
+  m_tailBusy = 0;
+}
+
+
+uint64_t TileThreadPool::getTailTime() const noexcept
+{
+  return (uint64_t)std::max((Stats::Clock::rep)0,
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(m_tailEnd - m_lastAdded).count());
+}
+
+
+uint64_t TileThreadPool::getTailIdleTime() const noexcept
+{
+  uint64_t capacity = getTailTime() * m_threadCount;
+  return (capacity > m_tailBusy) ? capacity - m_tailBusy : 0;
+}
+
+
+void TileThreadPool::sampleTileQueue(bool stalled) noexcept
+{
+  m_tileSum += m_tiles.size();
+  m_samples++;
+  if (stalled) m_stalls++;
+  // the tail starts anew with each added tile
+  m_lastAdded = m_tailEnd = Stats::Clock::now();
+  m_tailBusy = 0;
+}
+
+
+void TileThreadPool::sampleResult(TileDataPtr tileData, size_t backlog) noexcept
+{
+  static const double WEIGHT = 1.0 / 16.0;    // of the latest sample in the moving averages
+
+  if (tileData == nullptr) return;
+
+  // processing time after adding the latest tile contributes to the tail
+  if (tileData->getProcessEnd() > m_lastAdded) {
+    Stats::Clock::time_point start = std::max(tileData->getProcessStart(), m_lastAdded);
+    m_tailBusy += std::chrono::duration_cast<std::chrono::nanoseconds>(tileData->getProcessEnd() - start).count();
+    m_tailEnd = std::max(m_tailEnd, tileData->getProcessEnd());
+  }
+
+  if (!m_adaptive) return;
+
+  // results retrieved one after another without waiting: the interval is the time needed to write a tile
+  Stats::Clock::time_point now = Stats::Clock::now();
+  if (m_draining) {
+    double cost = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_lastResult).count();
+    m_drainCost = (m_drainCost > 0.0) ? m_drainCost + (cost - m_drainCost) * WEIGHT : cost;
+  }
+  m_lastResult = now;
+  m_draining = (!m_results.empty() && m_results.top()->getIndex() == tileData->getIndex() + 1);
+
+  // results finished out of order are held back until the slower tiles before them are done
+  double held = (backlog > 0) ? (double)(backlog - 1) : 0.0;
+  double latency = (double)tileData->getProcessTime();
+  if (m_resultSamples == 0) {
+    m_latency = latency;
+    m_backlog = held;
+  } else {
+    m_latency += (latency - m_latency) * WEIGHT;
+    m_backlog += (held - m_backlog) * WEIGHT;
+  }
+  m_resultSamples++;
+
+  // While the main thread writes the backlog in one go, each worker thread consumes a tile from the
+  // input queue per tile latency. The queue has to hold these tiles in addition to one per thread.
+  double refill = (m_latency > 0.0) ? (m_backlog + 1.0) * m_drainCost / m_latency : 0.0;
+  unsigned window = m_threadCount + (unsigned)std::min(1e6, std::ceil(m_threadCount * refill));
+  window = std::max(std::max(MIN_ADAPTIVE_TILES, 2*m_threadCount),
+                    std::min(MAX_ADAPTIVE_TILES_PER_THREAD*m_threadCount, window));
+  setWindow(window);
+}
+
+
+void TileThreadPool::setWindow(unsigned window) noexcept
+{
+  m_maxTiles = window;
+  m_minTilesUsed = std::min(m_minTilesUsed, window);
+  m_maxTilesUsed = std::max(m_maxTilesUsed, window);
+  if (Stats::IsEnabled()) Stats::AddTileWindow(window);
+}
+
+
+TileDataPtr TileThreadPool::takeTileData() noexcept
+{
+  if (m_tiles.empty()) return TileDataPtr(nullptr);
+
+  TileQueue::iterator selected = m_tiles.begin();
+  if (m_costOrdered && m_threadCount > 1) {
+    // Tiles may be processed ahead of the oldest queued tile by up to two tiles per thread. This
+    // limits the results held back for in-order retrieval and prevents cheap tiles from starving.
+    int maxIndex = m_tiles.front()->getIndex() + 2*(int)m_threadCount;
+    for (auto iter = m_tiles.begin() + 1; iter != m_tiles.end(); ++iter) {
+      if ((*iter)->getIndex() < maxIndex && (*iter)->getCost() > (*selected)->getCost()) selected = iter;
+    }
+  }
+  TileDataPtr retVal = *selected;
+  m_tiles.erase(selected);
+  return retVal;
+}
+
+
+TileThreadPool::ParallelJobPtr TileThreadPool::takeJob() noexcept
+{
+  // exhausted jobs are no longer offered, but may still have calls running
+  while (!m_jobs.empty() && m_jobs.front()->next.load() >= m_jobs.front()->count) {
+    m_jobs.pop_front();
+  }
+  return m_jobs.empty() ? ParallelJobPtr(nullptr) : m_jobs.front();
+}
+
+
+void TileThreadPool::RunParallel(unsigned count, const std::function<void(unsigned)> &func) noexcept
+{
+  TileThreadPool *pool = GetCurrentPoolRef();
+  if (pool != nullptr) {
+    pool->runParallel(count, func);
+  } else {
+    for (unsigned i = 0; i < count; i++) {
+      func(i);
+    }
+  }
+}
+
+
+void TileThreadPool::runParallel(unsigned count, const std::function<void(unsigned)> &func) noexcept
+{
+  if (count > 1) {
+    ParallelJobPtr job(new(std::nothrow) ParallelJob);
+    if (job != nullptr) {
+      job->func = &func;
+      job->count = count;
+      job->next.store(0);
+      job->done.store(0);
+      if (postJob(job)) {
+        RunJob(*job);
+        finishJob(job);
+        return;
+      }
+    }
+  }
+
+  for (unsigned i = 0; i < count; i++) {
+    func(i);
+  }
+}
+
+
+bool TileThreadPool::RunJob(ParallelJob &job) noexcept
+{
+  bool retVal = false;
+  for (unsigned i = job.next.fetch_add(1); i < job.count; i = job.next.fetch_add(1)) {
+    (*job.func)(i);
+    if (job.done.fetch_add(1) + 1 == job.count) retVal = true;
+  }
+  return retVal;
+}
+
+
+TileThreadPool*& TileThreadPool::GetCurrentPoolRef() noexcept
+{
+  static thread_local TileThreadPool *pool = nullptr;
+  return pool;
+}
+
+
+void TileThreadPool::estimateCost(TileDataPtr tileData) const noexcept
+{
+  if (m_costOrdered && m_threadCount > 1) tileData->estimateCost();
+}
+
+
+void TileThreadPool::addPending(TileDataPtr tileData) noexcept
+{
+  m_pending.push_back(tileData->getIndex());
+}
+
+
+void TileThreadPool::removePending(TileDataPtr tileData) noexcept
+{
+  // results are usually retrieved in order
+  auto iter = std::find(m_pending.begin(), m_pending.end(), tileData->getIndex());
+  if (iter != m_pending.end()) m_pending.erase(iter);
+}
+
+
+bool TileThreadPool::isMemoryThrottled() const noexcept
+{
+  if (!MemoryBudget::IsExceeded() || m_pending.empty()) return false;
+  // consumers retrieve results in order: waiting for other tiles would not release memory
+  return (m_results.empty() || m_results.top()->getIndex() != m_pending.front());
+}
+
+
+void TileThreadPool::MarkQueued(TileDataPtr tileData) noexcept
+{
+  tileData->reserveMemory();
+  if (Stats::IsEnabled()) {
+    tileData->setQueueTime(Stats::Clock::now());
+    if (Stats::IsTracing()) {
+      tileData->setTraceId(Stats::NextTraceId());
+      Stats::AddTileEvent(Stats::TileEvent::QUEUED, tileData->getTraceId(), tileData->getIndex());
+    }
+  }
+}
+
+
+void TileThreadPool::MarkRetrieved(TileDataPtr tileData) noexcept
+{
+  // stages of the main thread are associated with the tile until it has been written
+  if (Stats::IsTracing() && tileData != nullptr) {
+    Stats::SetCurrentTile(tileData->getTraceId(), tileData->getIndex());
+  }
+}
+
+
+void TileThreadPool::ProcessTileData(TileDataPtr tileData) noexcept
+{
+  // processing time is always measured for the adaptive input queue size and the tail time
+  bool enabled = Stats::IsEnabled();
+  bool tracing = enabled && Stats::IsTracing();
+  Stats::Clock::time_point start = Stats::Clock::now();
+  if (enabled && tileData->getQueueTime() != Stats::Clock::time_point()) {
+    Stats::Add(Stats::Stage::QUEUE_WAIT, tileData->getQueueTime(), start, 0, 0);
+  }
+  if (tracing) {
+    Stats::SetCurrentTile(tileData->getTraceId(), tileData->getIndex());
+    Stats::AddTileEvent(Stats::TileEvent::STARTED, tileData->getTraceId(), tileData->getIndex());
+  }
+
+  // messages of the tile are passed to the handler of the converting thread
+  Logger::Target logTarget = Logger::GetTarget();
+  Logger::SetTarget(tileData->getLogTarget());
+  (*tileData)();
+  Logger::SetTarget(logTarget);
+
+  Stats::Clock::time_point end = Stats::Clock::now();
+  tileData->setProcessTime(start, end);
+  if (enabled) Stats::Add(Stats::Stage::TILE, start, end, 0, 0);
+  if (tracing) {
+    Stats::AddTileEvent(Stats::TileEvent::FINISHED, tileData->getTraceId(), tileData->getIndex());
+    Stats::SetCurrentTile(0, -1);
+  }
 }
 
 }   // namespace tc
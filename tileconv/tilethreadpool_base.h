@@ -21,7 +21,11 @@ THE SOFTWARE.
 */
 #ifndef _TILETHREADPOOL_BASE_H_
 #define _TILETHREADPOOL_BASE_H_
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <queue>
+#include <vector>
 #include "tiledata.h"
 
 namespace tc {
@@ -32,8 +36,8 @@ typedef std::shared_ptr<TileThreadPool> ThreadPoolPtr;
 
 
 /**
- * Detected number of separate threads on the current CPU.
- * (Defined together with specialized thread pool classes.)
+ * Detected number of separate threads available to the process, limited by CPU affinity and
+ * CPU quota. (Defined together with specialized thread pool classes.)
  */
 unsigned getThreadPoolAutoThreads();
 
@@ -53,13 +57,55 @@ class TileThreadPool
   /** Max. number of allowed tile data blocks to add for processing. */
   static const unsigned MAX_TILES;
 
+  /** Bounds of the adaptive input queue size: absolute minimum and max. number per thread. */
+  static const unsigned MIN_ADAPTIVE_TILES;
+  static const unsigned MAX_ADAPTIVE_TILES_PER_THREAD;
+
 public:
   virtual ~TileThreadPool() noexcept {}
 
-  /** Get/set max. number of tile data blocks to add. */
+  /** Number of worker threads. */
+  unsigned getThreadCount() const noexcept { return m_threadCount; }
+
+  /**
+   * Pins worker thread i to cpus[i % cpus.size()]. An empty list allows all CPUs of the process.
+   * Returns false if pinning is not supported.
+   */
+  bool setThreadAffinity(const std::vector<int> &cpus) noexcept;
+  const std::vector<int>& getThreadAffinity() const noexcept { return m_cpus; }
+
+  /** Get/set max. number of tile data blocks to add. Setting a fixed number disables the adaptive size. */
   unsigned getMaxTiles() const noexcept { return m_maxTiles; }
   void setMaxTiles(unsigned maxTiles) noexcept;
 
+  /**
+   * Sizes the input queue dynamically from the number of threads, the measured processing time
+   * per tile and the backlog of results waiting behind slow tiles, which are retrieved in order.
+   */
+  void setAdaptiveTiles() noexcept;
+  bool isAdaptiveTiles() const noexcept { return m_adaptive; }
+
+  /**
+   * Whether worker threads pick the most expensive queued tile first (see TileData::getCost()) to
+   * shorten the tail of the file. Results are still returned in order. (Default: false)
+   */
+  void setCostOrdered(bool b) noexcept { m_costOrdered = b; }
+  bool isCostOrdered() const noexcept { return m_costOrdered; }
+
+  /**
+   * Calls func(0) to func(count-1) and returns when all calls have finished. If called by a worker
+   * thread while no tiles are waiting in the input queue, idle worker threads of the same thread
+   * pool run part of the calls concurrently. Calls are run sequentially otherwise.
+   */
+  static void RunParallel(unsigned count, const std::function<void(unsigned)> &func) noexcept;
+
+  /**
+   * Calls func(0) to func(count-1) on the calling thread and returns when all calls have finished.
+   * Idle worker threads of this thread pool run part of the calls concurrently if no tiles are
+   * waiting in the input queue.
+   */
+  void runParallel(unsigned count, const std::function<void(unsigned)> &func) noexcept;
+
   /** Add tile data to input queue. Blocks execution as long as the input queue is full. */
   virtual void addTileData(TileDataPtr tileData) noexcept = 0;
   /** Returns whether you can still add new tile data blocks to the input queue. */
@@ -73,6 +119,11 @@ class TileThreadPool
   virtual const TileDataPtr peekResult() noexcept = 0;
   /** Waits until a result is ready or the threadpool is idle. */
   virtual void waitForResult() noexcept = 0;
+  /**
+   * Waits until the result of the given tile index is next in order or the threadpool is idle.
+   * Results of later tiles don't end the wait. Returns immediately if the result is available.
+   */
+  virtual void waitForResult(int index) noexcept = 0;
 
   /**
    * Returns if all data blocks in the input queue have been processed and
@@ -80,12 +131,36 @@ class TileThreadPool
    */
   virtual bool finished() noexcept = 0;
 
+  /** Average number of queued tile data blocks, sampled whenever a block is added. */
+  double getAverageTiles() const noexcept;
+  /** Number of times addTileData() had to wait for a free slot in the input queue. */
+  unsigned getStalls() const noexcept { return m_stalls; }
+  /** Smallest and largest input queue size chosen by the adaptive sizing. */
+  unsigned getMinTilesUsed() const noexcept { return m_minTilesUsed; }
+  unsigned getMaxTilesUsed() const noexcept { return m_maxTilesUsed; }
+  /** Time between adding the last tile and finishing all tiles retrieved since then (in ns). */
+  uint64_t getTailTime() const noexcept;
+  /** Accumulated time worker threads have been idle during getTailTime() (in ns). */
+  uint64_t getTailIdleTime() const noexcept;
+  /** Clears queue statistics, e.g. when the thread pool is reused for another file. */
+  void resetStatistics() noexcept;
+
 
 protected:
-  typedef std::queue<TileDataPtr> TileQueue;
+  typedef std::deque<TileDataPtr> TileQueue;
   typedef std::priority_queue<TileDataPtr, std::vector<TileDataPtr>, std::greater<TileDataPtr>> ResultQueue;
 
-  TileThreadPool(unsigned tileNum) noexcept;
+  // Calls of RunParallel() shared with idle worker threads
+  struct ParallelJob
+  {
+    const std::function<void(unsigned)> *func;
+    unsigned              count;
+    std::atomic<unsigned> next;     // next call to run
+    std::atomic<unsigned> done;     // number of finished calls
+  };
+  typedef std::shared_ptr<ParallelJob> ParallelJobPtr;
+
+  TileThreadPool(unsigned threadNum, unsigned tileNum) noexcept;
 
   // Called whenever a thread is about to execute another encoding/decoding function
   virtual void threadActivated() noexcept = 0;
@@ -93,25 +168,101 @@ class TileThreadPool
   virtual void threadDeactivated() noexcept = 0;
   // Returns the number of active threads
   virtual int getActiveThreads() noexcept = 0;
+  // Restricts each worker thread to the CPUs returned by getThreadCpus()
+  virtual bool pinThreads() noexcept = 0;
+  // Makes the job available to idle worker threads. Returns false if no worker thread is idle.
+  virtual bool postJob(ParallelJobPtr job) noexcept = 0;
+  // Waits until all calls of the posted job have finished and withdraws it from the worker threads
+  virtual void finishJob(ParallelJobPtr job) noexcept = 0;
+
+  // CPUs of the given worker thread as specified by setThreadAffinity()
+  std::vector<int> getThreadCpus(unsigned thread) const noexcept;
 
   // Access to input queue
   TileQueue& getTileQueue() noexcept { return m_tiles; }
   const TileQueue& getTileQueue() const noexcept { return m_tiles; }
 
+  // Removes and returns the next tile data to process from the input queue. Requires access to the input queue.
+  TileDataPtr takeTileData() noexcept;
+  // Estimates the cost of the tile data if needed for the processing order. Called by addTileData().
+  void estimateCost(TileDataPtr tileData) const noexcept;
+
+  // Access to jobs posted by RunParallel(). Requires access to the input queue.
+  std::deque<ParallelJobPtr>& getJobs() noexcept { return m_jobs; }
+  // Returns a posted job with calls left, or a null pointer otherwise. Requires access to the input queue.
+  ParallelJobPtr takeJob() noexcept;
+
   // Access to result queue
   ResultQueue& getResultQueue() noexcept { return m_results; }
   const ResultQueue& getResultQueue() const noexcept { return m_results; }
+  // Returns whether the next result in order belongs to the given tile index or an earlier one.
+  // Requires access to the result queue.
+  bool isResultReady(int index) const noexcept
+  { return !m_results.empty() && m_results.top()->getIndex() <= index; }
 
   // Queried by each thread function
   bool terminate() const noexcept { return m_terminate; }
   // Called by the destructor to signal all threads to finish
   void setTerminate(bool b) noexcept { m_terminate = b; }
 
+  // Called by addTileData() to update queue statistics
+  void sampleTileQueue(bool stalled) noexcept;
+  // Called by getResult() for the returned tile data to update the adaptive input queue size.
+  // Requires access to the result queue.
+  void sampleResult(TileDataPtr tileData, size_t backlog) noexcept;
+
+  // Called by addTileData() right before tile data is added to the input queue
+  static void MarkQueued(TileDataPtr tileData) noexcept;
+  // Called by getResult() for the returned tile data
+  static void MarkRetrieved(TileDataPtr tileData) noexcept;
+  // Called by each thread function to encode or decode the tile data, includes stage timings
+  static void ProcessTileData(TileDataPtr tileData) noexcept;
+  // Called by each thread function on start to make the thread pool available to RunParallel()
+  static void SetCurrentPool(TileThreadPool *pool) noexcept { GetCurrentPoolRef() = pool; }
+  // Called by each thread function on start to get the number of the worker thread in statistics
+  int nextWorkerId() noexcept { return m_workerIds++; }
+  // Runs calls of the job until none are left. Returns true if this thread finished the last call.
+  static bool RunJob(ParallelJob &job) noexcept;
+
+  // Tracks tiles which have been added, but not retrieved yet. Requires access to the result queue.
+  void addPending(TileDataPtr tileData) noexcept;
+  void removePending(TileDataPtr tileData) noexcept;
+  // Returns whether adding tiles has to wait until memory is released. Never waits if the result of
+  // the oldest pending tile is available. Requires access to the result queue.
+  bool isMemoryThrottled() const noexcept;
+
 private:
+  // Thread pool of the current worker thread (null pointer: none)
+  static TileThreadPool*& GetCurrentPoolRef() noexcept;
+
+  // Applies the input queue size and updates its statistics
+  void setWindow(unsigned window) noexcept;
+
   bool          m_terminate;
+  bool          m_adaptive;     // input queue size is chosen by sampleResult()
+  bool          m_costOrdered;  // takeTileData() prefers expensive tiles
+  unsigned      m_threadCount;
+  std::atomic<int> m_workerIds;  // number of started worker threads
   unsigned      m_maxTiles;
+  std::vector<int> m_cpus;      // CPUs of the worker threads (empty: not pinned)
   TileQueue     m_tiles;
+  std::deque<ParallelJobPtr> m_jobs;  // jobs posted by RunParallel()
   ResultQueue   m_results;
+  std::deque<int> m_pending;    // indices of added tiles in order, until retrieved
+  double        m_tileSum;      // sum of input queue sizes
+  unsigned      m_samples;
+  unsigned      m_stalls;
+  unsigned      m_minTilesUsed;
+  unsigned      m_maxTilesUsed;
+  unsigned      m_resultSamples;  // number of results sampled for the adaptive size
+  double        m_latency;      // average processing time of a tile (in ns)
+  double        m_backlog;      // average number of results held back by the next tile in order
+  double        m_drainCost;    // average time between retrieving consecutive results (in ns)
+  bool          m_draining;     // the next result in order has been available
+  Stats::Clock::time_point m_lastResult;
+  Stats::Clock::time_point m_lastAdded;   // time of adding the latest tile
+  Stats::Clock::time_point m_tailEnd;     // latest end of processing a tile since m_lastAdded
+  uint64_t      m_tailBusy;     // processing time of all threads since m_lastAdded (in ns)
 };
 
 }   // namespace tc
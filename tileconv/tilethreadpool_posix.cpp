@@ -20,13 +20,18 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #ifndef USE_WINTHREADS
+#include <algorithm>
+#ifdef __linux__
+# include <pthread.h>
+#endif
+#include "affinity.h"
 #include "tilethreadpool_posix.h"
 
 namespace tc {
 
 unsigned getThreadPoolAutoThreads()
 {
-  return std::max(1u, std::min(TileThreadPool::MAX_THREADS, std::thread::hardware_concurrency()));
+  return std::max(1u, std::min(TileThreadPool::MAX_THREADS, Affinity::GetAutoThreads(Affinity::Mode::NONE)));
 }
 
 
@@ -37,12 +42,16 @@ ThreadPoolPtr createThreadPool(int threadNum, int tileNum)
 
 
 TileThreadPoolPosix::TileThreadPoolPosix(unsigned threadNum, unsigned tileNum) noexcept
-: TileThreadPool(tileNum)
+: TileThreadPool(threadNum, tileNum)
 , m_activeThreads(0)
 , m_mainThread(std::this_thread::get_id())
 , m_activeMutex()
 , m_tilesMutex()
 , m_resultsMutex()
+, m_tileAdded()
+, m_tileRemoved()
+, m_resultAdded()
+, m_jobFinished()
 , m_threads()
 {
   threadNum = std::max(1u, std::min(MAX_THREADS, threadNum));
@@ -54,7 +63,11 @@ TileThreadPoolPosix::TileThreadPoolPosix(unsigned threadNum, unsigned tileNum) n
 
 TileThreadPoolPosix::~TileThreadPoolPosix() noexcept
 {
-  setTerminate(true);
+  {
+    std::lock_guard<std::mutex> lock(m_tilesMutex);
+    setTerminate(true);
+  }
+  m_tileAdded.notify_all();
   for (auto iter = m_threads.begin(); iter != m_threads.end(); ++iter) {
     iter->join();
   }
@@ -63,12 +76,25 @@ TileThreadPoolPosix::~TileThreadPoolPosix() noexcept
 
 void TileThreadPoolPosix::addTileData(TileDataPtr tileData) noexcept
 {
-  while (!canAddTileData()) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  estimateCost(tileData);
+  std::unique_lock<std::mutex> lock(m_tilesMutex);
+  bool stalled = !canSubmit();
+  if (stalled) {
+    Stats::Timer timer(Stats::Stage::SUBMIT_WAIT);
+    while (!canSubmit()) {
+      m_tileRemoved.wait(lock);
+    }
   }
 
-  std::lock_guard<std::mutex> lock(m_tilesMutex);
-  getTileQueue().emplace(tileData);
+  sampleTileQueue(stalled);
+  MarkQueued(tileData);
+  {
+    std::lock_guard<std::mutex> lockResults(m_resultsMutex);
+    addPending(tileData);
+  }
+  getTileQueue().push_back(tileData);
+  lock.unlock();
+  m_tileAdded.notify_one();
 }
 
 
@@ -76,8 +102,12 @@ TileDataPtr TileThreadPoolPosix::getResult() noexcept
 {
   std::lock_guard<std::mutex> lock(m_resultsMutex);
   if (!getResultQueue().empty()) {
+    size_t backlog = getResultQueue().size();
     TileDataPtr retVal = getResultQueue().top();
     getResultQueue().pop();
+    removePending(retVal);
+    sampleResult(retVal, backlog);
+    MarkRetrieved(retVal);
     return retVal;
   } else {
     return TileDataPtr(nullptr);
@@ -98,8 +128,34 @@ const TileDataPtr TileThreadPoolPosix::peekResult() noexcept
 
 void TileThreadPoolPosix::waitForResult() noexcept
 {
+  Stats::Timer timer(Stats::Stage::RESULT_WAIT);
   while (!hasResult() && !finished()) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // timeout covers the last active thread finishing without a result
+    std::unique_lock<std::mutex> lock(m_resultsMutex);
+    if (getResultQueue().empty()) {
+      m_resultAdded.wait_for(lock, std::chrono::milliseconds(50));
+    }
+  }
+}
+
+
+void TileThreadPoolPosix::waitForResult(int index) noexcept
+{
+  std::unique_lock<std::mutex> lock(m_resultsMutex);
+  if (isResultReady(index)) return;
+  lock.unlock();
+  if (isIdle()) return;
+
+  // results of later tiles don't wake the main thread
+  Stats::Timer timer(Stats::Stage::RESULT_WAIT);
+  lock.lock();
+  while (!isResultReady(index)) {
+    if (m_resultAdded.wait_for(lock, std::chrono::milliseconds(50)) == std::cv_status::timeout) {
+      // timeout covers a missing result of the given index
+      lock.unlock();
+      if (isIdle()) return;
+      lock.lock();
+    }
   }
 }
 
@@ -118,6 +174,8 @@ bool TileThreadPoolPosix::finished() noexcept
 
 void TileThreadPoolPosix::threadMain() noexcept
 {
+  Stats::SetThreadName("worker", nextWorkerId());
+  SetCurrentPool(this);
   std::unique_lock<std::mutex> lockTiles(m_tilesMutex, std::defer_lock);
   std::unique_lock<std::mutex> lockResults(m_resultsMutex, std::defer_lock);
   while (!terminate()) {
@@ -125,11 +183,11 @@ void TileThreadPoolPosix::threadMain() noexcept
     if (!getTileQueue().empty()) {
       threadActivated();
 
-      TileDataPtr tileData = getTileQueue().front();
-      getTileQueue().pop();
+      TileDataPtr tileData = takeTileData();
       lockTiles.unlock();
+      m_tileRemoved.notify_one();
 
-      (*tileData)();
+      ProcessTileData(tileData);
 
       // storing results
       lockResults.lock();
@@ -137,14 +195,97 @@ void TileThreadPoolPosix::threadMain() noexcept
       lockResults.unlock();
 
       threadDeactivated();
+      m_resultAdded.notify_all();
+      if (MemoryBudget::IsLimited()) {
+        // addTileData() may wait for this result to release memory
+        lockTiles.lock();
+        lockTiles.unlock();
+        m_tileRemoved.notify_one();
+      }
+    } else if (ParallelJobPtr job = takeJob()) {
+      // helping a worker thread with the calls of a single tile
+      lockTiles.unlock();
+      Stats::Timer timer(Stats::Stage::HELP);
+      if (RunJob(*job)) {
+        lockTiles.lock();
+        lockTiles.unlock();
+        m_jobFinished.notify_all();
+      }
     } else {
+      // idle threads of a reused pool are woken up as soon as new tiles or jobs arrive
+      if (!terminate()) {
+        Stats::Timer timer(Stats::Stage::IDLE);
+        m_tileAdded.wait(lockTiles);
+      }
       lockTiles.unlock();
-      std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
   }
 }
 
 
+bool TileThreadPoolPosix::canSubmit() noexcept
+{
+  if (!canAddTileData()) return false;
+  if (!MemoryBudget::IsExceeded()) return true;
+  std::lock_guard<std::mutex> lock(m_resultsMutex);
+  return !isMemoryThrottled();
+}
+
+
+bool TileThreadPoolPosix::isIdle() noexcept
+{
+  std::unique_lock<std::mutex> lock1(m_tilesMutex, std::defer_lock);
+  std::unique_lock<std::mutex> lock2(m_activeMutex, std::defer_lock);
+  std::lock(lock1, lock2);
+  return (getTileQueue().empty() && getActiveThreads() == 0);
+}
+
+
+bool TileThreadPoolPosix::postJob(ParallelJobPtr job) noexcept
+{
+  std::unique_lock<std::mutex> lock(m_tilesMutex);
+  {
+    // queued tiles keep all worker threads busy
+    std::lock_guard<std::mutex> lockActive(m_activeMutex);
+    if (!getTileQueue().empty() || getActiveThreads() >= (int)getThreadCount()) return false;
+  }
+  getJobs().push_back(job);
+  lock.unlock();
+  m_tileAdded.notify_all();
+  return true;
+}
+
+
+void TileThreadPoolPosix::finishJob(ParallelJobPtr job) noexcept
+{
+  // waiting for calls still run by other threads
+  std::unique_lock<std::mutex> lock(m_tilesMutex);
+  m_jobFinished.wait(lock, [&job] { return job->done.load() >= job->count; });
+  auto iter = std::find(getJobs().begin(), getJobs().end(), job);
+  if (iter != getJobs().end()) getJobs().erase(iter);
+}
+
+
+bool TileThreadPoolPosix::pinThreads() noexcept
+{
+#ifdef __linux__
+  bool retVal = true;
+  for (unsigned i = 0; i < m_threads.size(); i++) {
+    std::vector<int> cpus = getThreadCpus(i);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto iter = cpus.cbegin(); iter != cpus.cend(); ++iter) {
+      if (*iter < CPU_SETSIZE) CPU_SET(*iter, &set);
+    }
+    if (::pthread_setaffinity_np(m_threads[i].native_handle(), sizeof(set), &set) != 0) retVal = false;
+  }
+  return retVal;
+#else
+  return false;
+#endif
+}
+
+
 void TileThreadPoolPosix::threadActivated() noexcept
 {
   std::lock_guard<std::mutex> lock(m_activeMutex);
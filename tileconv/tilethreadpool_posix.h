@@ -26,6 +26,7 @@ THE SOFTWARE.
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include "tilethreadpool_base.h"
 
 namespace tc {
@@ -46,6 +47,7 @@ class TileThreadPoolPosix : public TileThreadPool
   const TileDataPtr peekResult() noexcept;
   /** See TileThreadPool::waitForResult() */
   void waitForResult() noexcept;
+  void waitForResult(int index) noexcept;
 
   /** See TileThreadPool::finished() */
   bool finished() noexcept;
@@ -54,17 +56,29 @@ class TileThreadPoolPosix : public TileThreadPool
   void threadActivated() noexcept;
   void threadDeactivated() noexcept;
   int getActiveThreads() noexcept { return m_activeThreads; }
+  bool pinThreads() noexcept;
+  bool postJob(ParallelJobPtr job) noexcept;
+  void finishJob(ParallelJobPtr job) noexcept;
 
 private:
   // Executed by each thread.
   void threadMain() noexcept;
 
+  // Returns whether tile data can be added without exceeding queue size or memory budget (requires m_tilesMutex)
+  bool canSubmit() noexcept;
+  // Returns whether no tiles are queued or being processed (acquires the input queue and active thread locks)
+  bool isIdle() noexcept;
+
 private:
   int                       m_activeThreads;
   std::thread::id           m_mainThread;
   std::mutex                m_activeMutex;
   std::mutex                m_tilesMutex;
   std::mutex                m_resultsMutex;
+  std::condition_variable   m_tileAdded;        // wakes idle threads (m_tilesMutex)
+  std::condition_variable   m_tileRemoved;      // wakes addTileData() on a full input queue or memory budget (m_tilesMutex)
+  std::condition_variable   m_resultAdded;      // wakes waitForResult() (m_resultsMutex)
+  std::condition_variable   m_jobFinished;      // wakes finishJob() when the last call of a job has finished (m_tilesMutex)
   std::vector<std::thread>  m_threads;
 };
 
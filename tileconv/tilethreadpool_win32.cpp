@@ -20,15 +20,15 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 #ifdef USE_WINTHREADS
+#include <algorithm>
+#include "affinity.h"
 #include "tilethreadpool_win32.h"
 
 namespace tc {
 
 unsigned getThreadPoolAutoThreads()
 {
-  SYSTEM_INFO sysinfo;
-  ::GetSystemInfo(&sysinfo);
-  return std::max(1u, (unsigned)sysinfo.dwNumberOfProcessors);
+  return std::max(1u, std::min(TileThreadPool::MAX_THREADS, Affinity::GetAutoThreads(Affinity::Mode::NONE)));
 }
 
 
@@ -39,12 +39,13 @@ ThreadPoolPtr createThreadPool(int threadNum, int tileNum)
 
 
 TileThreadPoolWin32::TileThreadPoolWin32(unsigned threadNum, unsigned tileNum) noexcept
-: TileThreadPool(tileNum)
+: TileThreadPool(threadNum, tileNum)
 , m_activeThreads(0)
 , m_mainThread(::GetCurrentThread())
 , m_activeMutex(::CreateMutex(NULL, FALSE, NULL))
 , m_tilesMutex(::CreateMutex(NULL, FALSE, NULL))
 , m_resultsMutex(::CreateMutex(NULL, FALSE, NULL))
+, m_jobFinished(::CreateEvent(NULL, FALSE, FALSE, NULL))
 , m_threadsNum()
 , m_threads(nullptr)
 {
@@ -66,17 +67,28 @@ TileThreadPoolWin32::~TileThreadPoolWin32() noexcept
   ::CloseHandle(m_activeMutex);
   ::CloseHandle(m_tilesMutex);
   ::CloseHandle(m_resultsMutex);
+  ::CloseHandle(m_jobFinished);
 }
 
 
 void TileThreadPoolWin32::addTileData(TileDataPtr tileData) noexcept
 {
-  while (!canAddTileData()) {
-    ::Sleep(50);
+  estimateCost(tileData);
+  bool stalled = !canSubmit();
+  if (stalled) {
+    Stats::Timer timer(Stats::Stage::SUBMIT_WAIT);
+    while (!canSubmit()) {
+      ::Sleep(50);
+    }
   }
 
   ::WaitForSingleObject(m_tilesMutex, INFINITE);
-  getTileQueue().emplace(tileData);
+  sampleTileQueue(stalled);
+  MarkQueued(tileData);
+  ::WaitForSingleObject(m_resultsMutex, INFINITE);
+  addPending(tileData);
+  ::ReleaseMutex(m_resultsMutex);
+  getTileQueue().push_back(tileData);
   ::ReleaseMutex(m_tilesMutex);
 }
 
@@ -85,9 +97,13 @@ TileDataPtr TileThreadPoolWin32::getResult() noexcept
 {
   ::WaitForSingleObject(m_resultsMutex, INFINITE);
   if (!getResultQueue().empty()) {
+    size_t backlog = getResultQueue().size();
     TileDataPtr retVal = getResultQueue().top();
     getResultQueue().pop();
+    removePending(retVal);
+    sampleResult(retVal, backlog);
     ::ReleaseMutex(m_resultsMutex);
+    MarkRetrieved(retVal);
     return retVal;
   } else {
     ::ReleaseMutex(m_resultsMutex);
@@ -112,12 +128,32 @@ const TileDataPtr TileThreadPoolWin32::peekResult() noexcept
 
 void TileThreadPoolWin32::waitForResult() noexcept
 {
+  Stats::Timer timer(Stats::Stage::RESULT_WAIT);
   while (!hasResult() && !finished()) {
     ::Sleep(50);
   }
 }
 
 
+void TileThreadPoolWin32::waitForResult(int index) noexcept
+{
+  ::WaitForSingleObject(m_resultsMutex, INFINITE);
+  bool ready = isResultReady(index);
+  ::ReleaseMutex(m_resultsMutex);
+  if (ready || isIdle()) return;
+
+  // results of later tiles don't end the wait, short polling keeps the latency of the next result low
+  Stats::Timer timer(Stats::Stage::RESULT_WAIT);
+  while (!isIdle()) {
+    ::Sleep(1);
+    ::WaitForSingleObject(m_resultsMutex, INFINITE);
+    ready = isResultReady(index);
+    ::ReleaseMutex(m_resultsMutex);
+    if (ready) break;
+  }
+}
+
+
 bool TileThreadPoolWin32::finished() noexcept
 {
   HANDLE locks[] = { m_tilesMutex, m_activeMutex, m_resultsMutex };
@@ -130,20 +166,43 @@ bool TileThreadPoolWin32::finished() noexcept
 }
 
 
+bool TileThreadPoolWin32::canSubmit() noexcept
+{
+  if (!canAddTileData()) return false;
+  if (!MemoryBudget::IsExceeded()) return true;
+  ::WaitForSingleObject(m_resultsMutex, INFINITE);
+  bool retVal = !isMemoryThrottled();
+  ::ReleaseMutex(m_resultsMutex);
+  return retVal;
+}
+
+
+bool TileThreadPoolWin32::isIdle() noexcept
+{
+  HANDLE locks[] = { m_tilesMutex, m_activeMutex };
+  ::WaitForMultipleObjects(2, locks, TRUE, INFINITE);
+  bool retVal = (getTileQueue().empty() && getActiveThreads() == 0);
+  ::ReleaseMutex(m_tilesMutex);
+  ::ReleaseMutex(m_activeMutex);
+  return retVal;
+}
+
+
 DWORD WINAPI TileThreadPoolWin32::threadMain(LPVOID lpParam)
 {
   TileThreadPoolWin32 *instance = (TileThreadPoolWin32*)lpParam;
   if (instance != nullptr) {
+    Stats::SetThreadName("worker", instance->nextWorkerId());
+    SetCurrentPool(instance);
     while (!instance->terminate()) {
       ::WaitForSingleObject(instance->m_tilesMutex, INFINITE);
       if (!instance->getTileQueue().empty()) {
         instance->threadActivated();
 
-        TileDataPtr tileData = instance->getTileQueue().front();
-        instance->getTileQueue().pop();
+        TileDataPtr tileData = instance->takeTileData();
         ::ReleaseMutex(instance->m_tilesMutex);
 
-        (*tileData)();
+        ProcessTileData(tileData);
 
         // storing results
         ::WaitForSingleObject(instance->m_resultsMutex, INFINITE);
@@ -151,8 +210,14 @@ DWORD WINAPI TileThreadPoolWin32::threadMain(LPVOID lpParam)
         ::ReleaseMutex(instance->m_resultsMutex);
 
         instance->threadDeactivated();
+      } else if (ParallelJobPtr job = instance->takeJob()) {
+        // helping a worker thread with the calls of a single tile
+        ::ReleaseMutex(instance->m_tilesMutex);
+        Stats::Timer timer(Stats::Stage::HELP);
+        if (RunJob(*job)) ::SetEvent(instance->m_jobFinished);
       } else {
         ::ReleaseMutex(instance->m_tilesMutex);
+        Stats::Timer timer(Stats::Stage::IDLE);
         ::Sleep(50);
       }
     }
@@ -161,6 +226,47 @@ DWORD WINAPI TileThreadPoolWin32::threadMain(LPVOID lpParam)
 }
 
 
+bool TileThreadPoolWin32::postJob(ParallelJobPtr job) noexcept
+{
+  HANDLE locks[] = { m_tilesMutex, m_activeMutex };
+  ::WaitForMultipleObjects(2, locks, TRUE, INFINITE);
+  // queued tiles keep all worker threads busy
+  bool retVal = (getTileQueue().empty() && getActiveThreads() < (int)getThreadCount());
+  if (retVal) getJobs().push_back(job);
+  ::ReleaseMutex(m_tilesMutex);
+  ::ReleaseMutex(m_activeMutex);
+  return retVal;
+}
+
+
+void TileThreadPoolWin32::finishJob(ParallelJobPtr job) noexcept
+{
+  // waiting for calls still run by other threads, the timeout covers a signal taken by the caller of another job
+  while (job->done.load() < job->count) {
+    ::WaitForSingleObject(m_jobFinished, 1);
+  }
+  ::WaitForSingleObject(m_tilesMutex, INFINITE);
+  auto iter = std::find(getJobs().begin(), getJobs().end(), job);
+  if (iter != getJobs().end()) getJobs().erase(iter);
+  ::ReleaseMutex(m_tilesMutex);
+}
+
+
+bool TileThreadPoolWin32::pinThreads() noexcept
+{
+  bool retVal = true;
+  for (unsigned i = 0; i < m_threadsNum; i++) {
+    std::vector<int> cpus = getThreadCpus(i);
+    DWORD_PTR mask = 0;
+    for (auto iter = cpus.cbegin(); iter != cpus.cend(); ++iter) {
+      if (*iter < (int)(sizeof(DWORD_PTR)*8)) mask |= (DWORD_PTR)1 << *iter;
+    }
+    if (mask == 0 || ::SetThreadAffinityMask(m_threads.get()[i], mask) == 0) retVal = false;
+  }
+  return retVal;
+}
+
+
 void TileThreadPoolWin32::threadActivated() noexcept
 {
   ::WaitForSingleObject(m_activeMutex, INFINITE);
@@ -43,6 +43,7 @@ class TileThreadPoolWin32 : public TileThreadPool
   const TileDataPtr peekResult() noexcept;
   /** See TileThreadPool::waitForResult() */
   void waitForResult() noexcept;
+  void waitForResult(int index) noexcept;
 
   /** See TileThreadPool::finished() */
   bool finished() noexcept;
@@ -51,17 +52,26 @@ class TileThreadPoolWin32 : public TileThreadPool
   void threadActivated() noexcept;
   void threadDeactivated() noexcept;
   int getActiveThreads() noexcept { return m_activeThreads; }
+  bool pinThreads() noexcept;
+  bool postJob(ParallelJobPtr job) noexcept;
+  void finishJob(ParallelJobPtr job) noexcept;
 
 private:
   // Executed by each thread. lpParam points to the current TileThreadPoolWin32 class instance.
   static DWORD WINAPI threadMain(LPVOID lpParam);
 
+  // Returns whether tile data can be added without exceeding queue size or memory budget
+  bool canSubmit() noexcept;
+  // Returns whether no tiles are queued or being processed (acquires the input queue and active thread locks)
+  bool isIdle() noexcept;
+
 private:
   int                       m_activeThreads;
   HANDLE                    m_mainThread;
   HANDLE                    m_activeMutex;
   HANDLE                    m_tilesMutex;
   HANDLE                    m_resultsMutex;
+  HANDLE                    m_jobFinished;      // signaled when the last call of a job has finished
 //  std::vector<HANDLE>       m_threads;
   unsigned                  m_threadsNum;
   std::shared_ptr<HANDLE>   m_threads;
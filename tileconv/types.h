@@ -32,6 +32,7 @@ namespace tc {
 #define ENCODE_DXT1 1
 #define ENCODE_DXT3 2
 #define ENCODE_DXT5 3
+#define ENCODE_AUTO 4     // per-tile selection of RAW, DXT1 or DXT5 (TBC/MBC V1.1 only)
 #define ENCODE_Z    255
 
 /**
@@ -43,8 +44,9 @@ namespace tc {
  * MBC:     Block compressed MOS resource type
  * TIZ:     Legacy block compressed TIS resource type
  * MOZ:     Legacy block compressed MOS resource type
+ * BM32:    32-bit bitmap (output only)
  */
-enum class FileType { UNKNOWN, TIS, MOS, TBC, MBC, TIZ, MOZ };
+enum class FileType { UNKNOWN, TIS, MOS, TBC, MBC, TIZ, MOZ, BM32 };
 
 /**
  * Supported pixel compression types:
@@ -53,16 +55,21 @@ enum class FileType { UNKNOWN, TIS, MOS, TBC, MBC, TIZ, MOZ };
  * BC1:     Using DXT1 compression
  * BC2:     Using DXT3 compression
  * BC3:     Using DXT5 compression
+ * AUTO:    Selects RAW, BC1 or BC3 individually for each tile
  * Z:       Compression used by the TIZ/MOZ format
  */
-enum class Encoding { UNKNOWN, RAW, BC1, BC2, BC3, Z };
+enum class Encoding { UNKNOWN, RAW, BC1, BC2, BC3, AUTO, Z };
 
 typedef std::shared_ptr<uint8_t> BytePtr;
 
 static const unsigned HEADER_TBC_SIZE             = 16;       // TBC header size
 static const unsigned HEADER_MBC_SIZE             = 20;       // MBC header size
+static const unsigned HEADER_BM32_SIZE            = 24;       // BM32 header size
+static const unsigned HEADER_TIS_V2_SIZE          = 24;       // PVRZ-based TIS header size
+static const unsigned HEADER_MOS_V2_SIZE          = 24;       // PVRZ-based MOS header size
 static const unsigned HEADER_TILE_ENCODED_SIZE    = 4;        // header size for a raw/BCx encoded tile
 static const unsigned HEADER_TILE_COMPRESSED_SIZE = 4;        // header size for a zlib compressed tile
+static const unsigned HEADER_TILE_TYPE_SIZE       = 1;        // size of the per-tile encoding type (TBC/MBC V1.1)
 
 static const unsigned PALETTE_SIZE                = 1024;     // palette size in bytes
 static const unsigned TILE_DIMENSION              = 64;       // max. tile dimension